@@ -0,0 +1,97 @@
+#define DMALLOC_DISABLE 1
+#include "dmalloc.hh"
+#include <chrono>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+
+// Benchmarks the base allocator (base_malloc and base_free) by replaying
+// the allocation patterns of the test programs:
+//
+// - loop: malloc and free of 0-99 bytes, as in test010, test011, test029
+//   and test030;
+// - random: 200 slots, each freed if full and filled with 1-128 bytes
+//   otherwise, as in test035;
+// - mixed: the same, with 1-4096 bytes.
+//
+// `allocbench WORKLOAD [NOPS]` reports time per operation. With `-r`, it
+// instead reports how often base_malloc hands out a block that was freed
+// before, and how many distinct blocks the workload touches. Tracking that
+// is much slower than the allocator itself, so it's left out of timed runs.
+// Run `make bench` for every workload, both ways.
+
+
+static constexpr size_t NSLOTS = 200;
+
+static unsigned rnd() {
+    static uint64_t x = 1;
+    x = x * 6364136223846793005ULL + 1;
+    return x >> 33;
+}
+
+static void usage() {
+    fprintf(stderr, "Usage: allocbench [-r] loop|random|mixed [NOPS]\n");
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    bool track = argc > 1 && strcmp(argv[1], "-r") == 0;
+    if (argc < 2 + track || argc > 3 + track) {
+        usage();
+    }
+    const char* workload = argv[1 + track];
+    long nops = argc > 2 + track ? atol(argv[2 + track]) : 1000000;
+    size_t max_size;
+    if (strcmp(workload, "loop") == 0) {
+        max_size = 0;
+    } else if (strcmp(workload, "random") == 0) {
+        max_size = 128;
+    } else if (strcmp(workload, "mixed") == 0) {
+        max_size = 4096;
+    } else {
+        usage();
+    }
+
+    std::vector<void*> slots(NSLOTS, nullptr);
+    std::unordered_set<uintptr_t> freed;
+    long nmallocs = 0, nreused = 0;
+    auto malloc_block = [&] (size_t sz) {
+        void* ptr = base_malloc(sz);
+        ++nmallocs;
+        if (track) {
+            nreused += freed.count(reinterpret_cast<uintptr_t>(ptr));
+        }
+        return ptr;
+    };
+    auto free_block = [&] (void* ptr) {
+        base_free(ptr);
+        if (track) {
+            freed.insert(reinterpret_cast<uintptr_t>(ptr));
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i != nops; ++i) {
+        if (max_size == 0) {
+            free_block(malloc_block(rnd() % 100));
+            continue;
+        }
+        void*& slot = slots[rnd() % NSLOTS];
+        if (slot) {
+            free_block(slot);
+            slot = nullptr;
+        } else {
+            slot = malloc_block(1 + rnd() % max_size);
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (track) {
+        printf("%-8s reuse %5.1f%%  distinct blocks %zu\n", workload,
+               100.0 * nreused / nmallocs, freed.size());
+    } else {
+        printf("%-8s %8.1f ns/op\n", workload, elapsed.count() / nops);
+    }
+}
@@ -1,26 +1,125 @@
 #define DMALLOC_DISABLE 1
 #include "dmalloc.hh"
-#include <unordered_map>
+#include <deque>
+#include <utility>
 #include <vector>
-#include <sys/mman.h>
 
 
 // This file contains a base memory allocator guaranteed not to
 // overwrite freed allocations. No need to understand it.
+//
+// Blocks come in power-of-two size classes. Small blocks are carved out
+// of 1 MiB chunks, one size class per chunk; larger blocks get chunks of
+// their own. All bookkeeping lives outside the blocks, so a freed block
+// is left exactly as it was. It goes to the back of its class's
+// quarantine, and is only handed out again once `QUARANTINE` more blocks
+// of its class have been freed after it.
 
 
-using base_allocation = std::pair<uintptr_t, size_t>;
+static constexpr unsigned MIN_SHIFT = 4;       // smallest blocks: 16 bytes
+static constexpr unsigned CHUNK_SHIFT = 20;    // chunks: 1 MiB, aligned
+static constexpr unsigned ADDRESS_BITS = 48;
+static constexpr unsigned NCLASSES = ADDRESS_BITS;
+static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_SHIFT;
+static constexpr size_t QUARANTINE = 32;
 
-// `allocs` is a hash table mapping active pointer address to allocation size.
-// `frees` is a vector of freed allocations.
-static std::unordered_map<uintptr_t, size_t> allocs;
-static std::vector<base_allocation> frees;
+// A chunk, holding blocks of `block_size` bytes. The first `ncarved`
+// blocks have been handed out; `live[i]` is true if block `i` is active.
+struct base_chunk {
+    uintptr_t base;
+    size_t size;
+    size_t block_size;
+    size_t nblocks;
+    size_t ncarved = 0;
+    size_t nlive = 0;
+    std::vector<bool> live;
+};
+
+// A freed block and its chunk.
+using base_allocation = std::pair<uintptr_t, base_chunk*>;
+
+// Blocks of up to 2^c bytes come from class `c`. `carving` is the chunk
+// new blocks of the class are carved from; `frees` holds its freed
+// blocks, oldest first.
+struct base_size_class {
+    base_chunk* carving = nullptr;
+    std::deque<base_allocation> frees;
+};
+
+static base_size_class classes[NCLASSES];
 static int disabled;
 
-static unsigned alloc_random() {
-    static uint64_t x = 8973443640547502487ULL;
-    x = x * 6364136223846793005ULL + 1ULL;
-    return x >> 32;
+// `chunkmap` maps a chunk-aligned address to the chunk starting there, so
+// any pointer can be checked without touching the memory it points to.
+static constexpr unsigned CHUNKMAP_LEAF_BITS = 14;
+static constexpr unsigned CHUNKMAP_ROOT_BITS =
+    ADDRESS_BITS - CHUNK_SHIFT - CHUNKMAP_LEAF_BITS;
+static base_chunk** chunkmap[size_t(1) << CHUNKMAP_ROOT_BITS];
+
+static base_chunk* chunk_lookup(uintptr_t addr) {
+    uintptr_t index = addr >> CHUNK_SHIFT;
+    if (index >> (CHUNKMAP_ROOT_BITS + CHUNKMAP_LEAF_BITS)) {
+        return nullptr;
+    }
+    base_chunk** leaf = chunkmap[index >> CHUNKMAP_LEAF_BITS];
+    if (!leaf) {
+        return nullptr;
+    }
+    return leaf[index & ((size_t(1) << CHUNKMAP_LEAF_BITS) - 1)];
+}
+
+static bool chunk_register(base_chunk* c) {
+    uintptr_t index = c->base >> CHUNK_SHIFT;
+    if (index >> (CHUNKMAP_ROOT_BITS + CHUNKMAP_LEAF_BITS)) {
+        return false;
+    }
+    base_chunk**& leaf = chunkmap[index >> CHUNKMAP_LEAF_BITS];
+    if (!leaf) {
+        leaf = reinterpret_cast<base_chunk**>(
+            calloc(size_t(1) << CHUNKMAP_LEAF_BITS, sizeof(base_chunk*)));
+        if (!leaf) {
+            return false;
+        }
+    }
+    leaf[index & ((size_t(1) << CHUNKMAP_LEAF_BITS) - 1)] = c;
+    return true;
+}
+
+// Returns a new chunk of at least `sz` bytes holding blocks of
+// `block_size` bytes, or nullptr if out of memory.
+static base_chunk* chunk_new(size_t sz, size_t block_size) {
+    size_t size = (sz + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+    void* mem = aligned_alloc(CHUNK_SIZE, size);
+    if (!mem) {
+        return nullptr;
+    }
+    base_chunk* c = new (std::nothrow) base_chunk;
+    if (!c) {
+        free(mem);
+        return nullptr;
+    }
+    c->base = reinterpret_cast<uintptr_t>(mem);
+    c->size = size;
+    c->block_size = block_size;
+    c->nblocks = size / block_size;
+    c->live.resize(c->nblocks);
+    if (!chunk_register(c)) {
+        free(mem);
+        delete c;
+        return nullptr;
+    }
+    return c;
+}
+
+// Returns the size class for a request of `sz` bytes: the smallest `c`
+// with `sz <= 2^c`. Requests too large for any class get NCLASSES.
+static unsigned size_class(size_t sz) {
+    if (sz <= (size_t(1) << MIN_SHIFT)) {
+        return MIN_SHIFT;
+    } else if (sz > (size_t(1) << (NCLASSES - 1))) {
+        return NCLASSES;
+    }
+    return 64 - __builtin_clzll(sz - 1);
 }
 
 static void base_allocator_atexit();
@@ -29,8 +128,13 @@ void* base_malloc(size_t sz) {
     if (disabled) {
         return malloc(sz);
     }
+    unsigned c = size_class(sz);
+    if (c >= NCLASSES) {
+        return nullptr;
+    }
     ++disabled;
     uintptr_t ptr = 0;
+    base_chunk* chunk = nullptr;
 
     static int base_alloc_atexit_installed = 0;
     if (!base_alloc_atexit_installed) {
@@ -38,27 +142,29 @@ void* base_malloc(size_t sz) {
         base_alloc_atexit_installed = 1;
     }
 
-    // try to use a previously-freed block 75% of the time
-    unsigned r = alloc_random();
-    if (r % 4 != 0) {
-        for (unsigned ntries = 0; ntries < 10 && ntries < frees.size(); ++ntries) {
-            auto& f = frees[alloc_random() % frees.size()];
-            if (f.second >= sz) {
-                allocs.insert(f);
-                ptr = f.first;
-                f = frees.back();
-                frees.pop_back();
-                break;
-            }
+    // reuse the oldest freed block once it has served its quarantine
+    base_size_class& cl = classes[c];
+    if (cl.frees.size() > QUARANTINE) {
+        ptr = cl.frees.front().first;
+        chunk = cl.frees.front().second;
+        cl.frees.pop_front();
+    } else if (c <= CHUNK_SHIFT) {
+        // carve a new block, starting a new chunk if the last one is full
+        if (!cl.carving || cl.carving->ncarved == cl.carving->nblocks) {
+            cl.carving = chunk_new(CHUNK_SIZE, size_t(1) << c);
+        }
+        if ((chunk = cl.carving)) {
+            ptr = chunk->base + chunk->ncarved * chunk->block_size;
+            ++chunk->ncarved;
         }
+    } else if ((chunk = chunk_new(size_t(1) << c, size_t(1) << c))) {
+        ptr = chunk->base;
+        chunk->ncarved = 1;
     }
 
-    if (!ptr) {
-        // need a new allocation
-        ptr = reinterpret_cast<uintptr_t>(malloc(sz ? sz : 1));
-    }
     if (ptr) {
-        allocs[reinterpret_cast<uintptr_t>(ptr)] = sz;
+        chunk->live[(ptr - chunk->base) / chunk->block_size] = true;
+        ++chunk->nlive;
     }
 
     --disabled;
@@ -66,18 +172,27 @@ void* base_malloc(size_t sz) {
 }
 
 void base_free(void* ptr) {
-    if (disabled || !ptr) {
-        free(ptr);
-    } else {
-        // mark free if found; if not found, invalid free: silently ignore
-        ++disabled;
-        auto it = allocs.find(reinterpret_cast<uintptr_t>(ptr));
-        if (it != allocs.end()) {
-            frees.push_back(*it);
-            allocs.erase(it);
+    // mark free if active; if not, invalid free: silently ignore
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    base_chunk* chunk = chunk_lookup(addr);
+    if (!chunk) {
+        if (disabled) {
+            free(ptr);
         }
-        --disabled;
+        return;
+    }
+    size_t offset = addr - chunk->base;
+    size_t i = offset / chunk->block_size;
+    if (offset % chunk->block_size != 0 || i >= chunk->ncarved
+        || !chunk->live[i]) {
+        return;
     }
+    ++disabled;
+    chunk->live[i] = false;
+    --chunk->nlive;
+    unsigned c = __builtin_ctzll(chunk->block_size);
+    classes[c].frees.emplace_back(addr, chunk);
+    --disabled;
 }
 
 void base_allocator_disable(bool d) {
@@ -85,8 +200,19 @@ void base_allocator_disable(bool d) {
 }
 
 static void base_allocator_atexit() {
-    // clean up freed memory to shut up leak detector
-    for (auto& alloc : frees) {
-        free(reinterpret_cast<void*>(alloc.first));
+    // clean up chunks with no active blocks to shut up leak detector
+    for (unsigned c = 0; c != NCLASSES; ++c) {
+        classes[c].frees.clear();
+        classes[c].carving = nullptr;
+    }
+    for (auto leaf : chunkmap) {
+        size_t n = leaf ? size_t(1) << CHUNKMAP_LEAF_BITS : 0;
+        for (size_t i = 0; i != n; ++i) {
+            if (leaf[i] && leaf[i]->nlive == 0) {
+                free(reinterpret_cast<void*>(leaf[i]->base));
+                delete leaf[i];
+                leaf[i] = nullptr;
+            }
+        }
     }
 }
@@ -0,0 +1,350 @@
+#include "async_client.hpp"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <cerrno>
+#include <memory>
+
+#include "net/network_helpers.hpp"
+
+// epoll user data for the wake eventfd; connections use their index
+constexpr uint64_t WAKE_EVENT = UINT64_MAX;
+constexpr int MAX_EVENTS = 64;
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+// How long a connection waits after failing to connect before trying again
+constexpr auto RECONNECT_DELAY = std::chrono::milliseconds(100);
+
+AsyncClient::AsyncClient(const std::string& server_addr, size_t n_conns)
+    : server_addr(server_addr), conns(std::max(n_conns, size_t(1))) {
+  this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  this->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (this->epoll_fd == -1 || this->wake_fd == -1) {
+    perror_color(RED, "AsyncClient");
+    exit(EXIT_FAILURE);
+  }
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.u64 = WAKE_EVENT;
+  epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->wake_fd, &ev);
+
+  this->loop_thread = std::thread(&AsyncClient::event_loop, this);
+}
+
+AsyncClient::~AsyncClient() {
+  {
+    // Under the lock, so that no submission slips in after the event loop's
+    // final sweep
+    std::unique_lock lock(this->submit_mtx);
+    this->is_stopped = true;
+  }
+  uint64_t one = 1;
+  (void)!write(this->wake_fd, &one, sizeof(one));
+  this->loop_thread.join();
+  close(this->wake_fd);
+  close(this->epoll_fd);
+}
+
+template <typename T>
+std::future<T> AsyncClient::submit(
+    Request req, std::function<T(std::optional<Response>)> convert) {
+  auto promise = std::make_shared<std::promise<T>>();
+  std::future<T> future = promise->get_future();
+  Callback done = [promise, convert](std::optional<Response> res) {
+    promise->set_value(convert(std::move(res)));
+  };
+
+  {
+    std::unique_lock lock(this->submit_mtx);
+    if (!this->is_stopped) {
+      this->submissions.push_back(Submission{std::move(req), std::move(done)});
+      done = nullptr;
+    }
+  }
+  if (done) {
+    // The event loop is gone, so nothing would ever complete this request
+    done(std::nullopt);
+    return future;
+  }
+
+  uint64_t one = 1;
+  (void)!write(this->wake_fd, &one, sizeof(one));
+  return future;
+}
+
+std::future<std::optional<std::string>> AsyncClient::Get(
+    const std::string& key) {
+  return this->submit<std::optional<std::string>>(
+      GetRequest{key},
+      [](std::optional<Response> res) -> std::optional<std::string> {
+        if (!res) return std::nullopt;
+        if (auto* get_res = std::get_if<GetResponse>(&*res)) {
+          return std::move(get_res->value);
+        }
+        return std::nullopt;
+      });
+}
+
+std::future<bool> AsyncClient::Put(const std::string& key,
+                                   const std::string& value) {
+  return this->submit<bool>(
+      PutRequest{key, value}, [](std::optional<Response> res) {
+        return res && std::holds_alternative<PutResponse>(*res);
+      });
+}
+
+std::future<bool> AsyncClient::Append(const std::string& key,
+                                      const std::string& value) {
+  return this->submit<bool>(
+      AppendRequest{key, value}, [](std::optional<Response> res) {
+        return res && std::holds_alternative<AppendResponse>(*res);
+      });
+}
+
+std::future<std::optional<std::string>> AsyncClient::Delete(
+    const std::string& key) {
+  return this->submit<std::optional<std::string>>(
+      DeleteRequest{key},
+      [](std::optional<Response> res) -> std::optional<std::string> {
+        if (!res) return std::nullopt;
+        if (auto* delete_res = std::get_if<DeleteResponse>(&*res)) {
+          return std::move(delete_res->value);
+        }
+        return std::nullopt;
+      });
+}
+
+std::future<std::optional<std::vector<std::string>>> AsyncClient::MultiGet(
+    const std::vector<std::string>& keys) {
+  return this->submit<std::optional<std::vector<std::string>>>(
+      MultiGetRequest{keys},
+      [](std::optional<Response> res)
+          -> std::optional<std::vector<std::string>> {
+        if (!res) return std::nullopt;
+        if (auto* multiget_res = std::get_if<MultiGetResponse>(&*res)) {
+          return std::move(multiget_res->values);
+        }
+        return std::nullopt;
+      });
+}
+
+std::future<bool> AsyncClient::MultiPut(
+    const std::vector<std::string>& keys,
+    const std::vector<std::string>& values) {
+  return this->submit<bool>(
+      MultiPutRequest{keys, values}, [](std::optional<Response> res) {
+        return res && std::holds_alternative<MultiPutResponse>(*res);
+      });
+}
+
+std::future<std::optional<CasResult>> AsyncClient::CAS(
+    const std::string& key, const std::string& expected,
+    const std::string& value) {
+  return this->submit<std::optional<CasResult>>(
+      CasRequest{key, expected, value},
+      [](std::optional<Response> res) -> std::optional<CasResult> {
+        if (!res) return std::nullopt;
+        if (auto* cas_res = std::get_if<CasResponse>(&*res)) {
+          return CasResult{cas_res->swapped, std::move(cas_res->value)};
+        }
+        return std::nullopt;
+      });
+}
+
+std::future<std::optional<int64_t>> AsyncClient::Incr(const std::string& key,
+                                                      int64_t delta) {
+  return this->submit<std::optional<int64_t>>(
+      IncrRequest{key, delta},
+      [](std::optional<Response> res) -> std::optional<int64_t> {
+        if (!res) return std::nullopt;
+        if (auto* incr_res = std::get_if<IncrResponse>(&*res)) {
+          return incr_res->value;
+        }
+        return std::nullopt;
+      });
+}
+
+void AsyncClient::event_loop() {
+  epoll_event events[MAX_EVENTS];
+  while (!this->is_stopped) {
+    int n = epoll_wait(this->epoll_fd, events, MAX_EVENTS, -1);
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      perror_color(RED, "epoll_wait");
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      uint64_t id = events[i].data.u64;
+      if (id == WAKE_EVENT) {
+        uint64_t count;
+        (void)!read(this->wake_fd, &count, sizeof(count));
+
+        std::vector<Submission> batch;
+        {
+          std::unique_lock lock(this->submit_mtx);
+          batch.swap(this->submissions);
+        }
+        for (auto&& submission : batch) this->dispatch(std::move(submission));
+        continue;
+      }
+
+      // A connection may have failed earlier in this batch of events
+      if (this->conns[id].fd == -1) continue;
+      uint32_t flags = events[i].events;
+      bool ok = true;
+      if (flags & (EPOLLIN | EPOLLERR | EPOLLHUP)) ok = this->fill(id);
+      if (ok && (flags & EPOLLOUT)) {
+        ok = this->conns[id].connecting ? this->finish_connect(id)
+                                        : this->flush(id);
+      }
+      if (!ok) this->fail(id);
+    }
+  }
+
+  // Fail everything still outstanding, so no caller waits forever
+  std::vector<Submission> leftover;
+  {
+    std::unique_lock lock(this->submit_mtx);
+    leftover.swap(this->submissions);
+  }
+  for (auto&& submission : leftover) submission.done(std::nullopt);
+  for (size_t id = 0; id < this->conns.size(); id++) {
+    if (this->conns[id].fd != -1) this->fail(id);
+  }
+}
+
+void AsyncClient::dispatch(Submission submission) {
+  size_t id = this->next_conn;
+  this->next_conn = (this->next_conn + 1) % this->conns.size();
+  Conn& conn = this->conns[id];
+
+  if (conn.fd == -1 && (std::chrono::steady_clock::now() < conn.retry_at ||
+                        !this->connect(id))) {
+    submission.done(std::nullopt);
+    return;
+  }
+
+  std::optional<Message> msg = serialize_request(submission.req);
+  if (!msg) {
+    submission.done(std::nullopt);
+    return;
+  }
+  encode_message(*msg, &conn.out);
+  conn.pending.push_back(std::move(submission.done));
+  // A connecting socket is flushed once it has connected
+  if (!conn.connecting && !this->flush(id)) this->fail(id);
+}
+
+bool AsyncClient::connect(size_t conn_id) {
+  Conn& conn = this->conns[conn_id];
+  int fd = connect_to_address(this->server_addr, true);
+  if (fd == -1) {
+    cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
+               '.');
+    conn.retry_at = std::chrono::steady_clock::now() + RECONNECT_DELAY;
+    return false;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  // The socket becomes writable once it has connected (or failed to)
+  epoll_event ev{};
+  ev.events = EPOLLIN | EPOLLOUT;
+  ev.data.u64 = conn_id;
+  epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  conn.fd = fd;
+  conn.connecting = true;
+  conn.want_write = true;
+  return true;
+}
+
+bool AsyncClient::finish_connect(size_t conn_id) {
+  Conn& conn = this->conns[conn_id];
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err) {
+    return false;
+  }
+  conn.connecting = false;
+  return this->flush(conn_id);
+}
+
+bool AsyncClient::flush(size_t conn_id) {
+  Conn& conn = this->conns[conn_id];
+  while (conn.out_offset < conn.out.size()) {
+    ssize_t n = send(conn.fd, conn.out.data() + conn.out_offset,
+                     conn.out.size() - conn.out_offset, MSG_NOSIGNAL);
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      return false;
+    }
+    conn.out_offset += n;
+  }
+  if (conn.out_offset == conn.out.size()) {
+    conn.out.clear();
+    conn.out_offset = 0;
+  }
+
+  // Only ask to hear about writability while there's something to write
+  bool want_write = !conn.out.empty();
+  if (want_write != conn.want_write) {
+    epoll_event ev{};
+    ev.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.u64 = conn_id;
+    epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+    conn.want_write = want_write;
+  }
+  return true;
+}
+
+bool AsyncClient::fill(size_t conn_id) {
+  Conn& conn = this->conns[conn_id];
+  while (true) {
+    size_t old_size = conn.in.size();
+    conn.in.resize(old_size + READ_CHUNK_SIZE);
+    ssize_t n = recv(conn.fd, conn.in.data() + old_size, READ_CHUNK_SIZE, 0);
+    conn.in.resize(old_size + std::max(n, ssize_t(0)));
+    if (n == 0) return false;
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      return false;
+    }
+  }
+
+  size_t offset = 0;
+  Message msg;
+  while (size_t used = decode_message(conn.in.data() + offset,
+                                      conn.in.size() - offset, &msg)) {
+    offset += used;
+    // A response to nothing means we've lost track of the stream
+    if (conn.pending.empty()) return false;
+    Callback done = std::move(conn.pending.front());
+    conn.pending.pop_front();
+
+    done(deserialize_response(msg));
+    msg = Message{};
+  }
+  conn.in.erase(conn.in.begin(), conn.in.begin() + offset);
+  return true;
+}
+
+void AsyncClient::fail(size_t conn_id) {
+  Conn& conn = this->conns[conn_id];
+  epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+  close(conn.fd);
+
+  std::deque<Callback> pending = std::move(conn.pending);
+  bool connecting = conn.connecting;
+  conn = Conn{};
+  if (connecting) {
+    cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
+               '.');
+    conn.retry_at = std::chrono::steady_clock::now() + RECONNECT_DELAY;
+  }
+  for (auto&& done : pending) done(std::nullopt);
+}
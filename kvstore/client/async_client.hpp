@@ -0,0 +1,131 @@
+#ifndef ASYNC_CLIENT_HPP
+#define ASYNC_CLIENT_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client.hpp"
+#include "net/network_messages.hpp"
+
+/**
+ * A client for a single KvServer that doesn't block on requests.
+ *
+ * Every call returns a std::future right away. Requests are sent over a few
+ * long-lived connections, pipelined (the server answers requests on a
+ * connection in order), so one thread can keep many requests in flight at
+ * once. All socket I/O happens on a single event-loop thread, on non-blocking
+ * sockets; futures are fulfilled from that thread, with std::nullopt/false if
+ * the request failed.
+ *
+ * Note that each connection occupies one of the server's workers for as long
+ * as it's open, so `n_conns` should be less than the server's worker count.
+ * Values larger than VALUE_CHUNK_SIZE (which need chunked transfers) aren't
+ * supported; use a SimpleClient for those.
+ */
+class AsyncClient {
+ public:
+  explicit AsyncClient(const std::string& server_addr, size_t n_conns = 4);
+  ~AsyncClient();
+
+  AsyncClient(const AsyncClient&) = delete;
+  AsyncClient& operator=(const AsyncClient&) = delete;
+
+  std::future<std::optional<std::string>> Get(const std::string& key);
+
+  std::future<bool> Put(const std::string& key, const std::string& value);
+
+  std::future<bool> Append(const std::string& key, const std::string& value);
+
+  std::future<std::optional<std::string>> Delete(const std::string& key);
+
+  std::future<std::optional<std::vector<std::string>>> MultiGet(
+      const std::vector<std::string>& keys);
+
+  std::future<bool> MultiPut(const std::vector<std::string>& keys,
+                             const std::vector<std::string>& values);
+
+  std::future<std::optional<CasResult>> CAS(const std::string& key,
+                                            const std::string& expected,
+                                            const std::string& value);
+
+  std::future<std::optional<int64_t>> Incr(const std::string& key,
+                                           int64_t delta);
+
+ private:
+  // Called on the event-loop thread with the request's response, or
+  // std::nullopt if its connection failed.
+  using Callback = std::function<void(std::optional<Response>)>;
+
+  struct Submission {
+    Request req;
+    Callback done;
+  };
+
+  struct Conn {
+    int fd = -1;
+    // Framed requests not yet written to the socket
+    std::vector<std::byte> out;
+    size_t out_offset = 0;
+    // Bytes read from the socket but not yet decoded
+    std::vector<std::byte> in;
+    // Callbacks for requests sent on this connection, in the order they were
+    // sent (and so the order their responses will arrive)
+    std::deque<Callback> pending;
+    bool want_write = false;
+    // Whether the socket is still connecting; requests are buffered until it
+    // has connected
+    bool connecting = false;
+    // After a failed connection attempt, requests on this connection fail
+    // straight away until then, rather than each trying to connect again
+    std::chrono::steady_clock::time_point retry_at;
+  };
+
+  std::string server_addr;
+  std::vector<Conn> conns;
+  size_t next_conn = 0;
+
+  int epoll_fd = -1;
+  // eventfd, written to wake the event loop when there are new submissions
+  int wake_fd = -1;
+
+  // Requests submitted by callers, yet to be picked up by the event loop
+  std::mutex submit_mtx;
+  std::vector<Submission> submissions;
+
+  std::atomic<bool> is_stopped = false;
+  std::thread loop_thread;
+
+  // Submits a request, converting its response with `convert` (which is
+  // passed std::nullopt on failure).
+  template <typename T>
+  std::future<T> submit(Request req,
+                        std::function<T(std::optional<Response>)> convert);
+
+  void event_loop();
+  // Sends `submission` on the next connection, connecting it if needed.
+  void dispatch(Submission submission);
+  // Starts connecting the connection's socket, without blocking the event
+  // loop. Returns false if it failed straight away.
+  bool connect(size_t conn_id);
+  // Called once a connecting socket is writable: fails it if it didn't
+  // connect, and otherwise sends the requests buffered while it connected.
+  bool finish_connect(size_t conn_id);
+  // Writes as much of the connection's buffered output as the socket takes.
+  bool flush(size_t conn_id);
+  // Reads everything available on the connection, completing the requests
+  // whose responses arrived.
+  bool fill(size_t conn_id);
+  // Closes the connection, failing all requests pending on it.
+  void fail(size_t conn_id);
+};
+
+#endif /* end of include guard */
@@ -0,0 +1,179 @@
+#include "bulk_loader.hpp"
+
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "common/utils.hpp"
+#include "net/server_commands.hpp"
+#include "simple_client.hpp"
+
+namespace {
+
+constexpr std::string_view WHITESPACE = " \t\r";
+
+std::string_view trim(std::string_view s) {
+  size_t start = s.find_first_not_of(WHITESPACE);
+  if (start == std::string_view::npos) return {};
+  return s.substr(start, s.find_last_not_of(WHITESPACE) - start + 1);
+}
+
+// Removes the first whitespace-separated token from `line`, and returns it.
+std::string_view next_token(std::string_view& line) {
+  line = trim(line);
+  size_t end = std::min(line.find_first_of(WHITESPACE), line.size());
+  std::string_view token = line.substr(0, end);
+  line.remove_prefix(end);
+  return token;
+}
+
+// The value in the rest of a `put` line, as PutCommand::handle reads it: the
+// line's space-separated words, joined by single spaces.
+std::string parse_value(std::string_view line) {
+  std::string value;
+  for (auto&& word : split(std::string(line))) {
+    if (!value.empty()) value += ' ';
+    value += word;
+  }
+  return value;
+}
+
+}  // namespace
+
+std::optional<BulkLoadReport> BulkLoader::load_file(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return std::nullopt;
+  std::stringstream contents;
+  contents << file.rdbuf();
+  if (!file) return std::nullopt;
+  return this->load(contents.view());
+}
+
+BulkLoadReport BulkLoader::load(std::string_view data) {
+  auto start = steady_clock::now();
+
+  // Split the data into a chunk per thread, each ending at a line break
+  std::vector<std::string_view> chunks;
+  size_t n_chunks = std::max(this->config.n_threads, size_t(1));
+  for (size_t i = 0, lo = 0; i < n_chunks && lo < data.size(); i++) {
+    size_t hi = data.find('\n', std::max(lo, data.size() * (i + 1) / n_chunks));
+    hi = hi == std::string_view::npos ? data.size() : hi + 1;
+    chunks.push_back(data.substr(lo, hi - lo));
+    lo = hi;
+  }
+
+  std::vector<Totals> totals(chunks.size());
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < chunks.size(); t++) {
+    threads.emplace_back(
+        [&, t] { totals[t] = this->load_chunk(chunks[t]); });
+  }
+  for (auto&& thr : threads) thr.join();
+
+  BulkLoadReport report{};
+  for (auto&& chunk_totals : totals) {
+    report.n_records += chunk_totals.n_records;
+    report.n_errors += chunk_totals.n_errors;
+    report.n_skipped += chunk_totals.n_skipped;
+  }
+  report.elapsed = duration_cast<milliseconds>(steady_clock::now() - start);
+  report.throughput =
+      report.n_records * 1000.0 / std::max<int64_t>(report.elapsed.count(), 1);
+  return report;
+}
+
+AsyncClient& BulkLoader::client_for(const std::string& server) {
+  std::unique_lock lock(this->clients_mtx);
+  std::unique_ptr<AsyncClient>& client = this->clients[server];
+  if (!client) {
+    client =
+        std::make_unique<AsyncClient>(server, this->config.conns_per_server);
+  }
+  return *client;
+}
+
+BulkLoader::Totals BulkLoader::load_chunk(std::string_view chunk) {
+  Totals totals;
+
+  // MultiPuts sent but not yet answered, oldest first
+  struct InFlight {
+    std::string server;
+    Batch batch;
+    std::future<bool> done;
+  };
+  std::deque<InFlight> in_flight;
+  auto settle_oldest = [&] {
+    InFlight& oldest = in_flight.front();
+    size_t n = oldest.batch.keys.size();
+    if (oldest.done.get() ||
+        SimpleClient{oldest.server}.MultiPut(oldest.batch.keys,
+                                             oldest.batch.values)) {
+      totals.n_records += n;
+    } else {
+      totals.n_errors += n;
+    }
+    in_flight.pop_front();
+  };
+  auto send = [&](const std::string& server, Batch batch) {
+    if (in_flight.size() >= this->config.max_in_flight) settle_oldest();
+    std::future<bool> done =
+        this->client_for(server).MultiPut(batch.keys, batch.values);
+    in_flight.push_back(InFlight{server, std::move(batch), std::move(done)});
+  };
+
+  // Records waiting to be sent, by server
+  std::map<std::string, Batch> batches;
+  while (!chunk.empty()) {
+    size_t end = std::min(chunk.find('\n'), chunk.size());
+    std::string_view line = chunk.substr(0, end);
+    chunk.remove_prefix(std::min(end + 1, chunk.size()));
+
+    std::string_view command = next_token(line);
+    if (command.empty()) continue;
+    std::string key(next_token(line));
+    std::string value = parse_value(line);
+    if (command != "put" || key.empty() || value.empty()) {
+      totals.n_skipped++;
+      continue;
+    }
+
+    std::optional<std::string> server = this->route(key);
+    if (!server) {
+      totals.n_errors++;
+      continue;
+    }
+    if (value.size() > VALUE_CHUNK_SIZE) {
+      bool ok = SimpleClient{*server}.Put(key, value);
+      (ok ? totals.n_records : totals.n_errors)++;
+      continue;
+    }
+
+    Batch& batch = batches[*server];
+    batch.bytes += key.size() + value.size();
+    batch.keys.push_back(std::move(key));
+    batch.values.push_back(std::move(value));
+    if (batch.keys.size() >= this->config.batch_records ||
+        batch.bytes >= this->config.batch_bytes) {
+      send(*server, std::move(batch));
+      batch = Batch{};
+    }
+  }
+
+  for (auto&& [server, batch] : batches) {
+    if (!batch.keys.empty()) send(server, std::move(batch));
+  }
+  while (!in_flight.empty()) settle_oldest();
+  return totals;
+}
+
+std::string format_bulk_report(const BulkLoadReport& report) {
+  std::stringstream ss;
+  ss << report.n_records << " records loaded (" << report.n_errors
+     << " failed, " << report.n_skipped << " lines skipped) in "
+     << report.elapsed.count() << "ms: " << std::fixed << std::setprecision(1)
+     << report.throughput << " records/second\n";
+  return ss.str();
+}
@@ -0,0 +1,100 @@
+#ifndef BULK_LOADER_HPP
+#define BULK_LOADER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "async_client.hpp"
+
+using namespace std::chrono;
+
+struct BulkLoadConfig {
+  // Number of threads parsing (and sending) the file, a chunk each.
+  size_t n_threads = 8;
+  // Most records, and bytes of keys and values, in one MultiPut.
+  size_t batch_records = 1000;
+  size_t batch_bytes = 1 << 20;
+  // Most MultiPuts each thread keeps in flight at once.
+  size_t max_in_flight = 8;
+  // Connections to each server, shared by every thread.
+  size_t conns_per_server = 4;
+};
+
+struct BulkLoadReport {
+  uint64_t n_records;
+  // Records that couldn't be stored (after a retry).
+  uint64_t n_errors;
+  // Lines that weren't `put` commands.
+  uint64_t n_skipped;
+  milliseconds elapsed;
+  // Records/second.
+  double throughput;
+};
+
+/**
+ * Loads a file of REPL `put <key> <value>` commands (such as
+ * gdpr/database.txt) into a kvstore deployment, much faster than feeding it
+ * to a client a line (and a connection) at a time.
+ *
+ * The file is split into a chunk per thread. Each thread parses its chunk,
+ * groups the records by the server that owns their key, and sends each
+ * server's records as MultiPuts of up to `batch_records`, pipelined over a
+ * few connections per server (see AsyncClient) that all threads share.
+ * A batch that fails is retried once on its own connection; records whose
+ * key no server owns fail outright.
+ *
+ * Values are read as the REPL's put command reads them: the words after the
+ * key, joined by single spaces. Values larger than VALUE_CHUNK_SIZE are Put
+ * one at a time, in chunks.
+ */
+class BulkLoader {
+ public:
+  // Maps a key to the address of the server that owns it.
+  using Router = std::function<std::optional<std::string>(const std::string&)>;
+
+  BulkLoader(BulkLoadConfig config, Router route)
+      : config(config), route(route) {
+  }
+
+  // Loads the file at `path`; std::nullopt if it can't be read.
+  std::optional<BulkLoadReport> load_file(const std::string& path);
+  // Loads commands already in memory.
+  BulkLoadReport load(std::string_view data);
+
+ private:
+  struct Batch {
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    size_t bytes = 0;
+  };
+  struct Totals {
+    uint64_t n_records = 0;
+    uint64_t n_errors = 0;
+    uint64_t n_skipped = 0;
+  };
+
+  BulkLoadConfig config;
+  Router route;
+
+  // One AsyncClient per server, created as servers come up; guarded by
+  // `clients_mtx`.
+  std::mutex clients_mtx;
+  std::map<std::string, std::unique_ptr<AsyncClient>> clients;
+
+  AsyncClient& client_for(const std::string& server);
+
+  // Parses and sends one chunk of the file.
+  Totals load_chunk(std::string_view chunk);
+};
+
+// Human-readable summary of a load.
+std::string format_bulk_report(const BulkLoadReport& report);
+
+#endif /* end of include guard */
@@ -1,6 +1,7 @@
 #ifndef CLIENT_HPP
 #define CLIENT_HPP
 
+#include <cstdint>
 #include <iostream>
 #include <optional>
 #include <string>
@@ -8,6 +9,21 @@
 
 #include "common/color.hpp"
 
+// One page of a scan: some key-value pairs, and the cursor to pass to get the
+// next page, which is empty once the scan is done.
+struct ScanPage {
+  std::vector<std::string> keys;
+  std::vector<std::string> values;
+  std::string cursor;
+};
+
+// The outcome of a CAS: whether the swap happened, and the key's value after
+// it, so that a failed CAS can be retried without a separate Get.
+struct CasResult {
+  bool swapped;
+  std::string value;
+};
+
 class Client {
  public:
   virtual ~Client() = default;
@@ -26,6 +42,23 @@ class Client {
   virtual bool MultiPut(const std::vector<std::string>& keys,
                         const std::vector<std::string>& values) = 0;
 
+  // Sets `key` to `value` if its value is currently `expected`. Returns whether
+  // the swap happened and the key's current value, or std::nullopt if the
+  // request failed.
+  virtual std::optional<CasResult> CAS(const std::string& key,
+                                       const std::string& expected,
+                                       const std::string& value) = 0;
+
+  // Adds `delta` to `key`'s integer value, returning the new value.
+  virtual std::optional<int64_t> Incr(const std::string& key,
+                                      int64_t delta) = 0;
+
+  // Reads up to about `count` key-value pairs, resuming where the scan left off
+  // at `cursor` (empty to start). A key present for the whole scan is returned
+  // at least once; keys added or removed during it may or may not be.
+  virtual std::optional<ScanPage> Scan(const std::string& cursor,
+                                       uint32_t count) = 0;
+
   virtual bool GDPRDelete(const std::string& user) = 0;
 };
 
@@ -0,0 +1,36 @@
+#include "cascommand.hpp"
+
+void CasCommand::handle(const std::string& s) {
+  std::vector<std::string> tokens = split(s);
+  if (tokens.size() < 3) {
+    cerr_color(RED, "Missing key, expected value and/or new value. ", usage());
+    return;
+  } else if (tokens.size() > 3) {
+    cerr_color(RED, "Too many parameters. ", usage());
+    return;
+  }
+
+  auto res = this->client->CAS(tokens[0], tokens[1], tokens[2]);
+  if (!res) {
+    return;
+  }
+
+  if (res->swapped) {
+    std::cout << "Swapped value.\n";
+  } else {
+    std::cout << "Value did not match <expected>; not swapped. Current value: "
+              << res->value << "\n";
+  }
+}
+
+std::string CasCommand::name() const {
+  return "cas";
+}
+
+std::string CasCommand::params() const {
+  return "<key> <expected> <value>";
+}
+
+std::string CasCommand::description() const {
+  return "Atomically sets <key> to <value> if its value is <expected>";
+}
@@ -0,0 +1,42 @@
+#include "incrcommand.hpp"
+
+void IncrCommand::handle(const std::string& s) {
+  std::vector<std::string> tokens = split(s);
+  if (tokens.size() == 0) {
+    cerr_color(RED, "Missing key. ", usage());
+    return;
+  } else if (tokens.size() > 2) {
+    cerr_color(RED, "Too many parameters. ", usage());
+    return;
+  }
+
+  int64_t delta = 1;
+  if (tokens.size() == 2) {
+    auto parsed = parse_int64(tokens[1]);
+    if (!parsed) {
+      cerr_color(RED, "Delta must be an integer. ", usage());
+      return;
+    }
+    delta = *parsed;
+  }
+
+  auto res = this->client->Incr(tokens[0], delta);
+  if (!res) {
+    return;
+  }
+
+  std::cout << "Got value: " << *res << '\n';
+}
+
+std::string IncrCommand::name() const {
+  return "incr";
+}
+
+std::string IncrCommand::params() const {
+  return "<key> [delta]";
+}
+
+std::string IncrCommand::description() const {
+  return "Atomically adds [delta] (default 1) to <key>'s integer value; "
+         "a nonexistent <key> counts as 0";
+}
@@ -0,0 +1,50 @@
+#include "scancommand.hpp"
+
+void ScanCommand::handle(const std::string& s) {
+  std::vector<std::string> tokens = split(s);
+  if (tokens.size() > 2) {
+    cerr_color(RED, "Too many parameters. ", usage());
+    return;
+  }
+
+  std::string cursor = tokens.size() > 0 ? tokens[0] : "";
+  // "0" starts a scan too, as in Redis
+  if (cursor == "0") cursor.clear();
+  int64_t count = 10;
+  if (tokens.size() == 2) {
+    auto parsed = parse_int64(tokens[1]);
+    if (!parsed || *parsed <= 0 || *parsed > MAX_SCAN_COUNT) {
+      cerr_color(RED, "Count must be between 1 and ", MAX_SCAN_COUNT, ". ",
+                 usage());
+      return;
+    }
+    count = *parsed;
+  }
+
+  auto res = this->client->Scan(cursor, count);
+  if (!res) {
+    return;
+  }
+
+  for (size_t i = 0; i < res->keys.size(); i++) {
+    std::cout << res->keys[i] << ": " << res->values[i] << '\n';
+  }
+  if (res->cursor.empty()) {
+    std::cout << "Scan complete\n";
+  } else {
+    std::cout << "Next cursor: " << res->cursor << '\n';
+  }
+}
+
+std::string ScanCommand::name() const {
+  return "scan";
+}
+
+std::string ScanCommand::params() const {
+  return "[cursor] [count]";
+}
+
+std::string ScanCommand::description() const {
+  return "Lists up to [count] (default 10) key-value pairs, starting from "
+         "[cursor] (omitted or 0 to start), and the cursor to continue from";
+}
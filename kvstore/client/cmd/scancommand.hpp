@@ -0,0 +1,27 @@
+#ifndef CLIENT_SCANCOMMAND_HPP
+#define CLIENT_SCANCOMMAND_HPP
+
+#include <memory>
+#include <sstream>
+
+#include "../client.hpp"
+#include "common/utils.hpp"
+#include "net/server_commands.hpp"
+#include "repl/replcommand.hpp"
+
+class ScanCommand : public ReplCommand {
+ public:
+  explicit ScanCommand(std::shared_ptr<Client> c) : client(c) {
+  }
+
+  void handle(const std::string& s) override;
+
+  std::string name() const override;
+  std::string params() const override;
+  std::string description() const override;
+
+ private:
+  std::shared_ptr<Client> client;
+};
+
+#endif /* end of include guard */
@@ -0,0 +1,149 @@
+#include "load_generator.hpp"
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+constexpr size_t PRELOAD_BATCH_SIZE = 100;
+
+bool LoadGenerator::preload() {
+  std::atomic<bool> ok = true;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < this->config.n_threads; t++) {
+    threads.emplace_back([&, t] {
+      std::shared_ptr<Client> client = this->make_client();
+      std::string value(this->config.value_size, 'v');
+
+      // Thread t loads batches t, t + n_threads, t + 2 * n_threads, ...
+      size_t stride = PRELOAD_BATCH_SIZE * this->config.n_threads;
+      for (size_t lo = t * PRELOAD_BATCH_SIZE; lo < this->config.n_keys;
+           lo += stride) {
+        size_t hi = std::min(lo + PRELOAD_BATCH_SIZE, this->config.n_keys);
+        std::vector<std::string> batch_keys, batch_values;
+        for (size_t i = lo; i < hi; i++) {
+          batch_keys.push_back(KeyGenerator::key_for(i));
+          batch_values.push_back(value);
+        }
+        if (!client->MultiPut(batch_keys, batch_values)) ok = false;
+      }
+    });
+  }
+  for (auto&& thr : threads) thr.join();
+  return ok;
+}
+
+LoadReport LoadGenerator::run() {
+  std::deque<Histogram> latencies(this->config.n_threads);
+  std::vector<uint64_t> errors(this->config.n_threads);
+
+  // Give every thread the same start time, slightly in the future, so that
+  // they all begin together once their clients are connected
+  auto start = steady_clock::now() + 100ms;
+  auto end = start + this->config.duration;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < this->config.n_threads; t++) {
+    threads.emplace_back([&, t] {
+      errors[t] = this->run_thread(t, start, end, &latencies[t]);
+    });
+  }
+  for (auto&& thr : threads) thr.join();
+  auto elapsed = duration_cast<milliseconds>(steady_clock::now() - start);
+
+  Histogram all;
+  for (auto&& hist : latencies) all.merge(hist);
+  LoadReport report{};
+  report.n_ops = all.count();
+  for (auto&& n : errors) report.n_errors += n;
+  report.elapsed = elapsed;
+  report.throughput =
+      elapsed.count() == 0 ? 0 : report.n_ops * 1000.0 / elapsed.count();
+  report.mean_ns = all.mean();
+  report.p50_ns = all.percentile(50);
+  report.p99_ns = all.percentile(99);
+  report.p999_ns = all.percentile(99.9);
+  report.max_ns = all.max();
+  return report;
+}
+
+uint64_t LoadGenerator::run_thread(size_t thread_id,
+                                   steady_clock::time_point start,
+                                   steady_clock::time_point end,
+                                   Histogram* latencies) {
+  std::shared_ptr<Client> client = this->make_client();
+  std::mt19937_64 rng(std::random_device{}() + thread_id);
+  std::bernoulli_distribution is_read(this->config.read_fraction);
+  std::string value(this->config.value_size, 'v');
+  uint64_t n_errors = 0;
+
+  auto do_op = [&] {
+    std::string key = KeyGenerator::key_for(this->keys.next(rng));
+    bool ok = is_read(rng) ? client->Get(key).has_value()
+                           : client->Put(key, value);
+    if (!ok) n_errors++;
+  };
+
+  if (this->config.mode == LoadMode::CLOSED) {
+    std::this_thread::sleep_until(start);
+    for (auto now = steady_clock::now(); now < end;) {
+      do_op();
+      auto done = steady_clock::now();
+      latencies->record(duration_cast<nanoseconds>(done - now).count());
+      now = done;
+    }
+    return n_errors;
+  }
+
+  // Open loop: each thread sends at rate / n_threads, with the threads'
+  // schedules staggered evenly over one interval
+  auto interval = duration_cast<nanoseconds>(
+      duration<double>(this->config.n_threads / this->config.rate));
+  auto scheduled = start + interval * thread_id / this->config.n_threads;
+  for (; scheduled < end; scheduled += interval) {
+    // If we're behind schedule, send right away; the time spent behind is
+    // charged to this request's latency
+    std::this_thread::sleep_until(scheduled);
+    do_op();
+    auto done = steady_clock::now();
+    latencies->record(duration_cast<nanoseconds>(done - scheduled).count());
+  }
+  return n_errors;
+}
+
+std::string format_report(const LoadReport& report) {
+  auto us = [](double ns) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << ns / 1000.0 << "us";
+    return ss.str();
+  };
+
+  std::stringstream ss;
+  ss << report.n_ops << " ops (" << report.n_errors << " failed) in "
+     << report.elapsed.count() << "ms: " << std::fixed << std::setprecision(1)
+     << report.throughput << " ops/second\n";
+  ss << "Latency: mean " << us(report.mean_ns) << ", p50 "
+     << us(report.p50_ns) << ", p99 " << us(report.p99_ns) << ", p99.9 "
+     << us(report.p999_ns) << ", max " << us(report.max_ns) << "\n";
+  return ss.str();
+}
+
+bool append_csv(const std::string& path, const std::string& title,
+                const LoadReport& report) {
+  struct stat st;
+  bool exists = stat(path.c_str(), &st) == 0;
+
+  std::ofstream file(path, std::ios::app);
+  if (!file) return false;
+  // plot_performance.py only reads the first three columns
+  if (!exists) file << "title,time,tput,p50_us,p99_us,p999_us\n";
+  file << title << "," << report.elapsed.count() << "," << std::fixed
+       << std::setprecision(0) << report.throughput << std::setprecision(1)
+       << "," << report.p50_ns / 1000.0 << "," << report.p99_ns / 1000.0 << ","
+       << report.p999_ns / 1000.0 << "\n";
+  return bool(file);
+}
@@ -0,0 +1,101 @@
+#ifndef LOAD_GENERATOR_HPP
+#define LOAD_GENERATOR_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "client.hpp"
+#include "common/histogram.hpp"
+#include "common/key_generator.hpp"
+
+using namespace std::chrono;
+
+enum class LoadMode {
+  // Each thread issues its next request as soon as the previous one returns.
+  CLOSED,
+  // Requests are issued on a fixed schedule, whether or not earlier ones have
+  // returned yet.
+  OPEN
+};
+
+struct LoadConfig {
+  // Number of client threads; each thread has its own Client.
+  size_t n_threads = 8;
+  milliseconds duration = 10s;
+  size_t n_keys = 10000;
+  size_t value_size = 64;
+  KeyDistribution distribution = KeyDistribution::UNIFORM;
+  double zipf_theta = 0.99;
+  // Fraction of operations that are Gets; the rest are Puts.
+  double read_fraction = 0.9;
+  LoadMode mode = LoadMode::CLOSED;
+  // Target throughput over all threads (operations/second), in OPEN mode.
+  double rate = 1000;
+};
+
+struct LoadReport {
+  uint64_t n_ops;
+  uint64_t n_errors;
+  milliseconds elapsed;
+  // Operations/second.
+  double throughput;
+  // Latencies, in nanoseconds.
+  double mean_ns;
+  uint64_t p50_ns;
+  uint64_t p99_ns;
+  uint64_t p999_ns;
+  uint64_t max_ns;
+};
+
+/**
+ * Drives a kvstore deployment with a mix of Gets and Puts from several client
+ * threads, and measures throughput and latency.
+ *
+ * In OPEN mode, each request's latency is measured from the time it was
+ * *scheduled* to be sent rather than when it actually was. A thread stuck
+ * waiting on a slow response falls behind its schedule, and the requests it
+ * should have sent in the meantime are charged for the wait; measuring from
+ * the actual send time would silently drop exactly those requests
+ * ("coordinated omission") and understate tail latency.
+ */
+class LoadGenerator {
+ public:
+  using ClientFactory = std::function<std::shared_ptr<Client>()>;
+
+  LoadGenerator(LoadConfig config, ClientFactory make_client)
+      : config(config),
+        make_client(make_client),
+        keys(config.n_keys, config.distribution, config.zipf_theta) {
+  }
+
+  // Puts every key in the keyspace (in MultiPut batches), so that Gets during
+  // run() find their keys. Returns false if any batch fails.
+  bool preload();
+
+  // Runs the workload for the configured duration.
+  LoadReport run();
+
+ private:
+  LoadConfig config;
+  ClientFactory make_client;
+  KeyGenerator keys;
+
+  // Issues operations from one thread until `end`, recording their latencies.
+  // Returns the number of failed operations.
+  uint64_t run_thread(size_t thread_id, steady_clock::time_point start,
+                      steady_clock::time_point end, Histogram* latencies);
+};
+
+// Human-readable summary of a run.
+std::string format_report(const LoadReport& report);
+
+// Appends a row for `report` to the CSV at `path` (creating it, with a header,
+// if needed), in the format read by build/plot_performance.py. Returns false
+// if the file can't be written.
+bool append_csv(const std::string& path, const std::string& title,
+                const LoadReport& report);
+
+#endif /* end of include guard */
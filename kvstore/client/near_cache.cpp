@@ -0,0 +1,43 @@
+#include "near_cache.hpp"
+
+#include <algorithm>
+
+std::optional<std::string> NearCache::get(const std::string& key) {
+  Stripe& stripe = this->stripe_for(key);
+  std::unique_lock lock(stripe.mtx);
+  auto it = stripe.entries.find(key);
+  if (it == stripe.entries.end() ||
+      it->second.expiry <= steady_clock::now()) {
+    this->n_misses.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  this->n_hits.fetch_add(1, std::memory_order_relaxed);
+  return it->second.value;
+}
+
+void NearCache::put(const std::string& key, std::string value,
+                    steady_clock::time_point expiry) {
+  Stripe& stripe = this->stripe_for(key);
+  std::unique_lock lock(stripe.mtx);
+  if (stripe.entries.size() >= this->stripe_capacity &&
+      !stripe.entries.contains(key)) {
+    auto now = steady_clock::now();
+    std::erase_if(stripe.entries, [&](const auto& entry) {
+      return entry.second.expiry <= now;
+    });
+    if (stripe.entries.size() >= this->stripe_capacity) {
+      stripe.entries.erase(stripe.entries.begin());
+    }
+  }
+  stripe.entries.insert_or_assign(key, Entry{std::move(value), expiry});
+}
+
+void NearCache::invalidate(const std::string& key) {
+  Stripe& stripe = this->stripe_for(key);
+  std::unique_lock lock(stripe.mtx);
+  stripe.entries.erase(key);
+}
+
+NearCache::Stripe& NearCache::stripe_for(const std::string& key) {
+  return this->stripes[std::hash<std::string>()(key) % N_STRIPES];
+}
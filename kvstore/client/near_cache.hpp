@@ -0,0 +1,71 @@
+#ifndef NEAR_CACHE_HPP
+#define NEAR_CACHE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+using namespace std::chrono;
+
+/**
+ * Client-side copies of values the server has leased (see GetLeaseRequest),
+ * each kept only until its lease runs out, so that Gets answered from it are
+ * as fresh as Gets sent to the server. Hot keys are then read at most once
+ * per lease, however often they're read.
+ *
+ * Safe to share between clients, and threads. Holds at most `capacity` keys:
+ * once full, expired copies are dropped, or else arbitrary ones.
+ */
+class NearCache {
+ public:
+  static constexpr size_t DEFAULT_CAPACITY = 100'000;
+
+  explicit NearCache(size_t capacity = DEFAULT_CAPACITY)
+      : stripe_capacity(std::max<size_t>(1, capacity / N_STRIPES)) {
+  }
+  NearCache(const NearCache&) = delete;
+  NearCache& operator=(const NearCache&) = delete;
+
+  // `key`'s value, if its lease hasn't run out.
+  std::optional<std::string> get(const std::string& key);
+  // Keeps `value` for `key` until `expiry`.
+  void put(const std::string& key, std::string value,
+           steady_clock::time_point expiry);
+  // Drops `key`'s copy (say, because this client just wrote the key).
+  void invalidate(const std::string& key);
+
+  // Gets answered from the cache, and not.
+  uint64_t hits() const {
+    return this->n_hits;
+  }
+  uint64_t misses() const {
+    return this->n_misses;
+  }
+
+ private:
+  static constexpr size_t N_STRIPES = 16;
+
+  struct Entry {
+    std::string value;
+    steady_clock::time_point expiry;
+  };
+  struct Stripe {
+    std::mutex mtx;
+    std::unordered_map<std::string, Entry> entries;
+  };
+
+  const size_t stripe_capacity;
+  std::array<Stripe, N_STRIPES> stripes;
+  std::atomic<uint64_t> n_hits = 0;
+  std::atomic<uint64_t> n_misses = 0;
+
+  Stripe& stripe_for(const std::string& key);
+};
+
+#endif /* end of include guard */
@@ -1,6 +1,11 @@
 #include "shardkv_client.hpp"
 
+#include <iterator>
+
+#include "common/utils.hpp"
+
 std::optional<std::string> ShardKvClient::Get(const std::string& key) {
+  Span span("ShardKvClient::Get", sample_trace());
   // Query shardcontroller for config
   auto config = this->Query();
   if (!config) return std::nullopt;
@@ -13,6 +18,7 @@ std::optional<std::string> ShardKvClient::Get(const std::string& key) {
 }
 
 bool ShardKvClient::Put(const std::string& key, const std::string& value) {
+  Span span("ShardKvClient::Put", sample_trace());
   // Query shardcontroller for config
   auto config = this->Query();
   if (!config) return false;
@@ -24,6 +30,7 @@ bool ShardKvClient::Put(const std::string& key, const std::string& value) {
 }
 
 bool ShardKvClient::Append(const std::string& key, const std::string& value) {
+  Span span("ShardKvClient::Append", sample_trace());
   // Query shardcontroller for config
   auto config = this->Query();
   if (!config) return false;
@@ -35,6 +42,7 @@ bool ShardKvClient::Append(const std::string& key, const std::string& value) {
 }
 
 std::optional<std::string> ShardKvClient::Delete(const std::string& key) {
+  Span span("ShardKvClient::Delete", sample_trace());
   // Query shardcontroller for config
   auto config = this->Query();
   if (!config) return std::nullopt;
@@ -59,12 +67,91 @@ bool ShardKvClient::MultiPut(const std::vector<std::string>& keys,
   return true;
 }
 
+std::optional<CasResult> ShardKvClient::CAS(const std::string& key,
+                                            const std::string& expected,
+                                            const std::string& value) {
+  Span span("ShardKvClient::CAS", sample_trace());
+  // Query shardcontroller for config
+  auto config = this->Query();
+  if (!config) return std::nullopt;
+
+  // find responsible server in config, then make CAS request
+  std::optional<std::string> server = config->get_server(key);
+  if (!server) return std::nullopt;
+  return SimpleClient{*server}.CAS(key, expected, value);
+}
+
+std::optional<int64_t> ShardKvClient::Incr(const std::string& key,
+                                           int64_t delta) {
+  Span span("ShardKvClient::Incr", sample_trace());
+  // Query shardcontroller for config
+  auto config = this->Query();
+  if (!config) return std::nullopt;
+
+  // find responsible server in config, then make Incr request
+  std::optional<std::string> server = config->get_server(key);
+  if (!server) return std::nullopt;
+  return SimpleClient{*server}.Incr(key, delta);
+}
+
+std::optional<ScanPage> ShardKvClient::Scan(const std::string& cursor,
+                                            uint32_t count) {
+  Span span("ShardKvClient::Scan", sample_trace());
+  // Query shardcontroller for config
+  auto config = this->Query();
+  if (!config) return std::nullopt;
+
+  // Scans each server in turn, in address order; the cursor is the server
+  // being scanned, and the cursor within it. A key moved from a server not yet
+  // scanned to one already scanned may be missed.
+  std::string server, server_cursor;
+  if (!cursor.empty() && !split_cursor(cursor, &server, &server_cursor)) {
+    cerr_color(RED, "Invalid scan cursor.");
+    return std::nullopt;
+  }
+  const auto& servers = config->server_to_shards;
+  auto it = cursor.empty() ? servers.begin() : servers.lower_bound(server);
+  // If the server has left since, carry on from the next one
+  if (it != servers.end() && it->first != server) server_cursor.clear();
+
+  ScanPage page;
+  while (it != servers.end() && page.keys.size() < count) {
+    std::optional<ScanPage> server_page =
+        SimpleClient{it->first}.Scan(server_cursor, count - page.keys.size());
+    if (!server_page) return std::nullopt;
+    std::move(server_page->keys.begin(), server_page->keys.end(),
+              std::back_inserter(page.keys));
+    std::move(server_page->values.begin(), server_page->values.end(),
+              std::back_inserter(page.values));
+    server_cursor = std::move(server_page->cursor);
+    if (server_cursor.empty()) {
+      it++;
+    } else if (server_page->keys.empty()) {
+      break;
+    }
+  }
+  if (it != servers.end()) page.cursor = join_cursor(it->first, server_cursor);
+  return page;
+}
+
+Transaction ShardKvClient::Begin() {
+  // Keys stay where they were when the transaction began; if one has moved by
+  // the time it's read or committed, that server refuses it, and the
+  // transaction aborts
+  std::optional<ShardControllerConfig> config = this->Query();
+  auto router = [config](const std::string& key) mutable
+      -> std::optional<std::string> {
+    if (!config) return std::nullopt;
+    return config->get_server(key);
+  };
+  return Transaction(std::move(router));
+}
+
 // Shardcontroller functions
 std::optional<ShardControllerConfig> ShardKvClient::Query() {
+  Span span("Query");
   QueryRequest req;
-  if (!this->shardcontroller_conn->send_request(req)) return std::nullopt;
-
-  std::optional<Response> res = this->shardcontroller_conn->recv_response();
+  std::optional<Response> res = this->call_shardcontroller(req);
   if (!res) return std::nullopt;
   if (auto* query_res = std::get_if<QueryResponse>(&*res)) {
     return query_res->config;
@@ -76,9 +163,7 @@ std::optional<ShardControllerConfig> ShardKvClient::Query() {
 bool ShardKvClient::Move(const std::string& dest_server,
                          const std::vector<Shard>& shards) {
   MoveRequest req{dest_server, shards};
-  if (!this->shardcontroller_conn->send_request(req)) return false;
-
-  std::optional<Response> res = this->shardcontroller_conn->recv_response();
+  std::optional<Response> res = this->call_shardcontroller(req);
   if (!res) return false;
   if (auto* move_res = std::get_if<MoveResponse>(&*res)) {
     return true;
@@ -86,3 +171,18 @@ bool ShardKvClient::Move(const std::string& dest_server,
 
   return false;
 }
+
+std::optional<Response> ShardKvClient::call_shardcontroller(
+    const Request& req) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (this->shardcontroller_conn->send_request(req)) {
+      std::optional<Response> res = this->shardcontroller_conn->recv_response();
+      if (res) return res;
+    }
+    std::shared_ptr<ServerConn> conn =
+        connect_to_server(this->shardcontroller_addr);
+    if (!conn) return std::nullopt;
+    this->shardcontroller_conn = std::move(conn);
+  }
+  return std::nullopt;
+}
@@ -12,6 +12,7 @@
 #include "net/network_conn.hpp"
 #include "net/network_messages.hpp"
 #include "simple_client.hpp"
+#include "transaction.hpp"
 
 class ShardKvClient : public Client {
  public:
@@ -46,10 +47,22 @@ class ShardKvClient : public Client {
   bool MultiPut(const std::vector<std::string>& keys,
                 const std::vector<std::string>& values);
 
+  std::optional<CasResult> CAS(const std::string& key,
+                               const std::string& expected,
+                               const std::string& value);
+
+  std::optional<int64_t> Incr(const std::string& key, int64_t delta);
+
+  std::optional<ScanPage> Scan(const std::string& cursor, uint32_t count);
+
   bool GDPRDelete(const std::string& user) {
     assert(false);
   }
 
+  // Starts a transaction over keys on any number of servers, routed by the
+  // current shardcontroller config.
+  Transaction Begin();
+
   // Shardcontroller functions
   std::optional<ShardControllerConfig> Query();
   bool Move(const std::string& dest_server, const std::vector<Shard>& shards);
@@ -57,6 +70,10 @@ class ShardKvClient : public Client {
  private:
   std::string shardcontroller_addr;
   std::shared_ptr<ServerConn> shardcontroller_conn;
+
+  // Sends a request to the shardcontroller, reconnecting once if the
+  // connection has failed (to another of its nodes, if it's replicated).
+  std::optional<Response> call_shardcontroller(const Request& req);
 };
 
 #endif /* end of include guard */
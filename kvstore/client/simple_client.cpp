@@ -1,20 +1,43 @@
 #include "simple_client.hpp"
 
 std::optional<std::string> SimpleClient::Get(const std::string& key) {
-  std::shared_ptr<ServerConn> conn = connect_to_server(this->server_addr);
+  Span span("SimpleClient::Get", sample_trace());
+  if (this->cache) {
+    if (auto value = this->cache->get(key)) return value;
+  }
+
+  std::shared_ptr<ServerConn> conn = this->connect();
   if (!conn) {
     cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
                '.');
     return std::nullopt;
   }
 
-  GetRequest req{key};
-  if (!conn->send_request(req)) return std::nullopt;
+  // The lease counts from when the server read the value, which is after
+  // this
+  auto sent_at = steady_clock::now();
+  if (this->cache) {
+    if (!conn->send_request(GetLeaseRequest{key}, this->budget)) {
+      return std::nullopt;
+    }
+  } else {
+    GetRequest req{key};
+    if (!conn->send_request(req, this->budget)) return std::nullopt;
+  }
 
   std::optional<Response> res = conn->recv_response();
   if (!res) return std::nullopt;
   if (auto* get_res = std::get_if<GetResponse>(&*res)) {
     return get_res->value;
+  } else if (auto* lease_res = std::get_if<GetLeaseResponse>(&*res)) {
+    if (lease_res->lease_ms > 0) {
+      this->cache->put(key, lease_res->value,
+                       sent_at + milliseconds(lease_res->lease_ms));
+    }
+    return lease_res->value;
+  } else if (auto* chunk_res = std::get_if<GetChunkResponse>(&*res)) {
+    // The value is too large for one message
+    return this->get_remaining_chunks(*conn, key, std::move(*chunk_res));
   } else if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
     cerr_color(YELLOW, "Failed to Get value from server: ", error_res->msg);
   }
@@ -23,19 +46,25 @@ std::optional<std::string> SimpleClient::Get(const std::string& key) {
 }
 
 bool SimpleClient::Put(const std::string& key, const std::string& value) {
-  std::shared_ptr<ServerConn> conn = connect_to_server(this->server_addr);
+  Span span("SimpleClient::Put", sample_trace());
+  std::shared_ptr<ServerConn> conn = this->connect();
   if (!conn) {
     cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
                '.');
     return false;
   }
 
-  PutRequest req{key, value};
-  if (!conn->send_request(req)) return false;
+  if (value.size() > VALUE_CHUNK_SIZE) {
+    if (!conn->send_chunked(key, value, false)) return false;
+  } else {
+    PutRequest req{key, value};
+    if (!conn->send_request(req, this->budget)) return false;
+  }
 
   std::optional<Response> res = conn->recv_response();
   if (!res) return false;
   if (auto* put_res = std::get_if<PutResponse>(&*res)) {
+    this->invalidate(key);
     return true;
   } else if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
     cerr_color(YELLOW, "Failed to Put value to server: ", error_res->msg);
@@ -45,19 +74,25 @@ bool SimpleClient::Put(const std::string& key, const std::string& value) {
 }
 
 bool SimpleClient::Append(const std::string& key, const std::string& value) {
-  std::shared_ptr<ServerConn> conn = connect_to_server(this->server_addr);
+  Span span("SimpleClient::Append", sample_trace());
+  std::shared_ptr<ServerConn> conn = this->connect();
   if (!conn) {
     cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
                '.');
     return false;
   }
 
-  AppendRequest req{key, value};
-  if (!conn->send_request(req)) return false;
+  if (value.size() > VALUE_CHUNK_SIZE) {
+    if (!conn->send_chunked(key, value, true)) return false;
+  } else {
+    AppendRequest req{key, value};
+    if (!conn->send_request(req, this->budget)) return false;
+  }
 
   std::optional<Response> res = conn->recv_response();
   if (!res) return false;
   if (auto* append_res = std::get_if<AppendResponse>(&*res)) {
+    this->invalidate(key);
     return true;
   } else if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
     cerr_color(YELLOW, "Failed to Append value to server: ", error_res->msg);
@@ -67,7 +102,8 @@ bool SimpleClient::Append(const std::string& key, const std::string& value) {
 }
 
 std::optional<std::string> SimpleClient::Delete(const std::string& key) {
-  std::shared_ptr<ServerConn> conn = connect_to_server(this->server_addr);
+  Span span("SimpleClient::Delete", sample_trace());
+  std::shared_ptr<ServerConn> conn = this->connect();
   if (!conn) {
     cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
                '.');
@@ -75,11 +111,12 @@ std::optional<std::string> SimpleClient::Delete(const std::string& key) {
   }
 
   DeleteRequest req{key};
-  if (!conn->send_request(req)) return std::nullopt;
+  if (!conn->send_request(req, this->budget)) return std::nullopt;
 
   std::optional<Response> res = conn->recv_response();
   if (!res) return std::nullopt;
   if (auto* delete_res = std::get_if<DeleteResponse>(&*res)) {
+    this->invalidate(key);
     return delete_res->value;
   } else if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
     cerr_color(YELLOW, "Failed to Delete value on server: ", error_res->msg);
@@ -90,7 +127,8 @@ std::optional<std::string> SimpleClient::Delete(const std::string& key) {
 
 std::optional<std::vector<std::string>> SimpleClient::MultiGet(
     const std::vector<std::string>& keys) {
-  std::shared_ptr<ServerConn> conn = connect_to_server(this->server_addr);
+  Span span("SimpleClient::MultiGet", sample_trace());
+  std::shared_ptr<ServerConn> conn = this->connect();
   if (!conn) {
     cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
                '.');
@@ -98,7 +136,7 @@ std::optional<std::vector<std::string>> SimpleClient::MultiGet(
   }
 
   MultiGetRequest req{keys};
-  if (!conn->send_request(req)) return std::nullopt;
+  if (!conn->send_request(req, this->budget)) return std::nullopt;
 
   std::optional<Response> res = conn->recv_response();
   if (!res) return std::nullopt;
@@ -113,7 +151,8 @@ std::optional<std::vector<std::string>> SimpleClient::MultiGet(
 
 bool SimpleClient::MultiPut(const std::vector<std::string>& keys,
                             const std::vector<std::string>& values) {
-  std::shared_ptr<ServerConn> conn = connect_to_server(this->server_addr);
+  Span span("SimpleClient::MultiPut", sample_trace());
+  std::shared_ptr<ServerConn> conn = this->connect();
   if (!conn) {
     cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
                '.');
@@ -121,11 +160,12 @@ bool SimpleClient::MultiPut(const std::vector<std::string>& keys,
   }
 
   MultiPutRequest req{keys, values};
-  if (!conn->send_request(req)) return false;
+  if (!conn->send_request(req, this->budget)) return false;
 
   std::optional<Response> res = conn->recv_response();
   if (!res) return false;
   if (auto* multiput_res = std::get_if<MultiPutResponse>(&*res)) {
+    for (auto&& key : keys) this->invalidate(key);
     return true;
   } else if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
     cerr_color(YELLOW, "Failed to MultiPut values on server: ", error_res->msg);
@@ -134,6 +174,138 @@ bool SimpleClient::MultiPut(const std::vector<std::string>& keys,
   return false;
 }
 
+std::optional<CasResult> SimpleClient::CAS(const std::string& key,
+                                           const std::string& expected,
+                                           const std::string& value) {
+  Span span("SimpleClient::CAS", sample_trace());
+  std::shared_ptr<ServerConn> conn = this->connect();
+  if (!conn) {
+    cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
+               '.');
+    return std::nullopt;
+  }
+
+  CasRequest req{key, expected, value};
+  if (!conn->send_request(req, this->budget)) return std::nullopt;
+
+  std::optional<Response> res = conn->recv_response();
+  if (!res) return std::nullopt;
+  if (auto* cas_res = std::get_if<CasResponse>(&*res)) {
+    this->invalidate(key);
+    return CasResult{cas_res->swapped, std::move(cas_res->value)};
+  } else if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
+    cerr_color(YELLOW, "Failed to CAS value on server: ", error_res->msg);
+  }
+
+  return std::nullopt;
+}
+
+std::optional<int64_t> SimpleClient::Incr(const std::string& key,
+                                          int64_t delta) {
+  Span span("SimpleClient::Incr", sample_trace());
+  std::shared_ptr<ServerConn> conn = this->connect();
+  if (!conn) {
+    cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
+               '.');
+    return std::nullopt;
+  }
+
+  IncrRequest req{key, delta};
+  if (!conn->send_request(req, this->budget)) return std::nullopt;
+
+  std::optional<Response> res = conn->recv_response();
+  if (!res) return std::nullopt;
+  if (auto* incr_res = std::get_if<IncrResponse>(&*res)) {
+    this->invalidate(key);
+    return incr_res->value;
+  } else if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
+    cerr_color(YELLOW, "Failed to Incr value on server: ", error_res->msg);
+  }
+
+  return std::nullopt;
+}
+
+std::optional<ScanPage> SimpleClient::Scan(const std::string& cursor,
+                                           uint32_t count) {
+  Span span("SimpleClient::Scan", sample_trace());
+  std::shared_ptr<ServerConn> conn = this->connect();
+  if (!conn) {
+    cerr_color(RED, "Failed to connect to KvServer at ", this->server_addr,
+               '.');
+    return std::nullopt;
+  }
+
+  ScanRequest req{cursor, count};
+  if (!conn->send_request(req, this->budget)) return std::nullopt;
+
+  std::optional<Response> res = conn->recv_response();
+  if (!res) return std::nullopt;
+  auto* scan_res = std::get_if<ScanResponse>(&*res);
+  if (!scan_res) {
+    if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
+      cerr_color(YELLOW, "Failed to Scan server: ", error_res->msg);
+    }
+    return std::nullopt;
+  }
+
+  // The server only sends the first chunk of large values; Get the rest, and
+  // leave out those that have since been deleted
+  std::vector<bool> deleted(scan_res->keys.size(), false);
+  for (auto&& i : scan_res->large) {
+    if (i >= scan_res->keys.size()) return std::nullopt;
+    std::optional<std::string> value = this->Get(scan_res->keys[i]);
+    if (value) {
+      scan_res->values[i] = std::move(*value);
+    } else {
+      deleted[i] = true;
+    }
+  }
+
+  ScanPage page{{}, {}, std::move(scan_res->cursor)};
+  for (size_t i = 0; i < scan_res->keys.size(); i++) {
+    if (deleted[i]) continue;
+    page.keys.push_back(std::move(scan_res->keys[i]));
+    page.values.push_back(std::move(scan_res->values[i]));
+  }
+  return page;
+}
+
+std::optional<std::string> SimpleClient::get_remaining_chunks(
+    ServerConn& conn, const std::string& key, GetChunkResponse first) {
+  std::string value;
+  value.reserve(first.size);
+  value += first.chunk;
+
+  // Ask for every remaining chunk up front, then read them as they arrive
+  size_t n_chunks = 0;
+  for (size_t offset = value.size(); offset < first.size;
+       offset += VALUE_CHUNK_SIZE) {
+    if (!conn.send_request(GetChunkRequest{key, offset})) return std::nullopt;
+    n_chunks++;
+  }
+
+  bool overwritten = false;
+  for (size_t i = 0; i < n_chunks; i++) {
+    std::optional<Response> res = conn.recv_response();
+    if (!res) return std::nullopt;
+    auto* chunk_res = std::get_if<GetChunkResponse>(&*res);
+    if (!chunk_res) {
+      if (auto* error_res = std::get_if<ErrorResponse>(&*res)) {
+        cerr_color(YELLOW, "Failed to Get value from server: ",
+                   error_res->msg);
+      }
+      return std::nullopt;
+    }
+    if (chunk_res->version != first.version) overwritten = true;
+    value += chunk_res->chunk;
+  }
+
+  // The value changed part way through, so the chunks don't fit together;
+  // start over
+  if (overwritten || value.size() != first.size) return this->Get(key);
+  return value;
+}
+
 bool SimpleClient::GDPRDelete(const std::string& user) {
   // TODO: Write your GDPR deletion code here!
   // You can invoke operations directly on the client object, like so:
@@ -147,3 +319,18 @@ bool SimpleClient::GDPRDelete(const std::string& user) {
   cerr_color(RED, "GDPR deletion is unimplemented!");
   return false;
 }
+
+void SimpleClient::invalidate(const std::string& key) {
+  // The server waited for every lease on the key to run out before writing
+  // it, so the cache's copy has expired already; dropping it just frees it
+  if (this->cache) this->cache->invalidate(key);
+}
+
+std::shared_ptr<ServerConn> SimpleClient::connect() {
+  Span span("connect");
+  std::shared_ptr<ServerConn> conn = connect_to_server(this->server_addr);
+  if (conn && this->compress && !conn->negotiate(FEATURE_COMPRESSION)) {
+    return nullptr;
+  }
+  return conn;
+}
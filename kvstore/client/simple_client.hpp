@@ -1,16 +1,28 @@
 #ifndef SIMPLE_CLIENT_HPP
 #define SIMPLE_CLIENT_HPP
 
+#include <memory>
 #include <optional>
 #include <string>
 
 #include "client.hpp"
+#include "near_cache.hpp"
 #include "net/network_conn.hpp"
 
 class SimpleClient : public Client {
  public:
-  explicit SimpleClient(const std::string& server_addr)
-      : server_addr(server_addr) {
+  // If `budget` is non-zero, the server drops requests that it can't start on
+  // within `budget`, failing them instead. If `compress`, large messages are
+  // sent compressed both ways, at the cost of a FEATURE_COMPRESSION handshake
+  // per request. With a `cache`, Gets ask for leases on the values they
+  // read, and are answered from the cache while the leases last.
+  explicit SimpleClient(const std::string& server_addr,
+                        milliseconds budget = 0ms, bool compress = false,
+                        std::shared_ptr<NearCache> cache = nullptr)
+      : server_addr(server_addr),
+        budget(budget),
+        compress(compress),
+        cache(std::move(cache)) {
   }
   ~SimpleClient() = default;
 
@@ -29,10 +41,33 @@ class SimpleClient : public Client {
   bool MultiPut(const std::vector<std::string>& keys,
                 const std::vector<std::string>& values);
 
+  std::optional<CasResult> CAS(const std::string& key,
+                               const std::string& expected,
+                               const std::string& value);
+
+  std::optional<int64_t> Incr(const std::string& key, int64_t delta);
+
+  std::optional<ScanPage> Scan(const std::string& cursor, uint32_t count);
+
   bool GDPRDelete(const std::string& user);
 
  private:
   std::string server_addr;
+  milliseconds budget;
+  bool compress;
+  std::shared_ptr<NearCache> cache;
+
+  // Drops the cache's copy of a key this client wrote.
+  void invalidate(const std::string& key);
+
+  // Connects to the server, negotiating compression if it's turned on.
+  std::shared_ptr<ServerConn> connect();
+
+  // Reads the rest of a value too large to fit in one message, given its
+  // first chunk, over the connection the first chunk came in on.
+  std::optional<std::string> get_remaining_chunks(ServerConn& conn,
+                                                  const std::string& key,
+                                                  GetChunkResponse first);
 };
 
 #endif /* end of include guard */
@@ -0,0 +1,148 @@
+#include "transaction.hpp"
+
+#include <random>
+
+Transaction::Transaction(Router router) : router(std::move(router)) {
+  thread_local std::mt19937_64 rng(std::random_device{}());
+  // 0 is reserved for locks taken by plain writes
+  do {
+    this->txn_id = rng();
+  } while (this->txn_id == 0);
+}
+
+std::optional<std::string> Transaction::Read(const std::string& key) {
+  if (auto it = this->writes.find(key); it != this->writes.end()) {
+    return it->second;
+  }
+  if (auto it = this->reads.find(key); it != this->reads.end()) {
+    return it->second;
+  }
+  if (this->doomed) return std::nullopt;
+
+  std::optional<std::string> server = this->router(key);
+  std::optional<Response> res;
+  if (server) res = call(*server, TxnReadRequest{{key}});
+  auto* read_res = res ? std::get_if<TxnReadResponse>(&*res) : nullptr;
+  if (!read_res || read_res->values.size() != 1 ||
+      read_res->versions.size() != 1) {
+    if (auto* error_res = res ? std::get_if<ErrorResponse>(&*res) : nullptr) {
+      cerr_color(YELLOW, "Failed to read in transaction: ", error_res->msg);
+    }
+    this->doomed = true;
+    return std::nullopt;
+  }
+
+  TxnPrepareRequest& participant = this->participants[*server];
+  participant.read_keys.push_back(key);
+  participant.read_versions.push_back(read_res->versions[0]);
+  this->reads[key] = read_res->values[0];
+  return std::move(read_res->values[0]);
+}
+
+void Transaction::Write(const std::string& key, const std::string& value) {
+  this->writes[key] = value;
+}
+
+bool Transaction::Commit() {
+  if (this->doomed) return false;
+  this->doomed = true;
+
+  for (auto&& [key, value] : this->writes) {
+    std::optional<std::string> server = this->router(key);
+    if (!server) return false;
+    TxnPrepareRequest& participant = this->participants[*server];
+    participant.write_keys.push_back(key);
+    participant.write_values.push_back(value);
+  }
+
+  // The first server written to decides the outcome
+  std::optional<std::string> primary;
+  for (auto&& [server, participant] : this->participants) {
+    if (!participant.write_keys.empty()) {
+      primary = server;
+      break;
+    }
+  }
+
+  // Phase one, in two rounds: lock the writes on every server written to,
+  // then, with all of them locked, check the reads on every server read from.
+  // Checking a server's reads before another server's writes are locked would
+  // let a transaction that reads those writes and writes these reads commit
+  // in between (write skew). Servers that are only read from are done once
+  // their reads check out.
+  std::vector<std::string> prepared;
+  auto prepare = [&](const std::string& server, TxnPrepareRequest req) {
+    req.txn_id = this->txn_id;
+    req.primary = primary && server != *primary ? *primary : std::string();
+    std::optional<Response> res = call(server, req);
+    auto* prepare_res =
+        res ? std::get_if<TxnPrepareResponse>(&*res) : nullptr;
+    return prepare_res && prepare_res->prepared;
+  };
+  for (auto&& [server, participant] : this->participants) {
+    if (participant.write_keys.empty()) continue;
+    TxnPrepareRequest writes;
+    writes.write_keys = participant.write_keys;
+    writes.write_values = participant.write_values;
+    if (!prepare(server, std::move(writes))) {
+      this->abort_prepared(prepared);
+      return false;
+    }
+    prepared.push_back(server);
+  }
+  for (auto&& [server, participant] : this->participants) {
+    if (participant.read_keys.empty()) continue;
+    TxnPrepareRequest reads;
+    reads.read_keys = participant.read_keys;
+    reads.read_versions = participant.read_versions;
+    if (!prepare(server, std::move(reads))) {
+      this->abort_prepared(prepared);
+      return false;
+    }
+  }
+  if (!primary) return true;
+
+  // Phase two: the transaction commits once the primary says so. Asking it
+  // again is safe, since it remembers what it decided.
+  std::optional<bool> committed;
+  for (int attempt = 0; attempt < 3 && !committed; attempt++) {
+    std::optional<Response> res =
+        call(*primary, TxnFinishRequest{this->txn_id, true});
+    if (auto* finish_res = res ? std::get_if<TxnFinishResponse>(&*res)
+                               : nullptr) {
+      committed = finish_res->committed;
+    }
+  }
+  // If the primary can't be reached, the others find out what happened from
+  // it later
+  if (!committed) return false;
+
+  for (auto&& server : prepared) {
+    if (server == *primary) continue;
+    call(server, TxnFinishRequest{this->txn_id, *committed});
+  }
+  return *committed;
+}
+
+void Transaction::Abort() {
+  // Nothing is prepared until Commit(), so there's nothing to undo
+  this->doomed = true;
+  this->writes.clear();
+}
+
+std::optional<Response> Transaction::call(const std::string& addr,
+                                          const Request& req) {
+  std::shared_ptr<ServerConn> conn = connect_to_server(addr);
+  if (!conn) {
+    cerr_color(RED, "Failed to connect to KvServer at ", addr, '.');
+    return std::nullopt;
+  }
+  if (!conn->send_request(req)) return std::nullopt;
+  return conn->recv_response();
+}
+
+void Transaction::abort_prepared(const std::vector<std::string>& servers) {
+  for (auto&& server : servers) {
+    call(server, TxnFinishRequest{this->txn_id, false});
+  }
+}
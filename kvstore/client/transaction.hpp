@@ -0,0 +1,83 @@
+#ifndef TRANSACTION_HPP
+#define TRANSACTION_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+
+#include "net/network_conn.hpp"
+#include "net/network_messages.hpp"
+
+/**
+ * A serializable transaction over keys that may live on different servers.
+ *
+ * Reads go to the servers right away, and remember the version of each key
+ * read; writes are buffered until Commit(). The client coordinates the commit
+ * with two-phase commit: every server involved is asked to prepare (first, each
+ * server written to locks the keys written to it; then, with all of those
+ * locked, each server read from checks that the keys read from it haven't
+ * changed), then, if they all did, the primary (the first server written to) is
+ * told to commit, which is the point at which the transaction commits, and then
+ * the rest. If this client disappears part way through, the servers find out
+ * what became of the transaction from the primary (see TxnTable).
+ *
+ * A transaction that only reads takes no locks at all: Commit() just checks
+ * that nothing it read has changed since.
+ *
+ * Not thread-safe; each transaction belongs to one thread.
+ */
+class Transaction {
+ public:
+  // Returns the address of the server responsible for a key, or std::nullopt
+  // if there is none.
+  using Router =
+      std::function<std::optional<std::string>(const std::string& key)>;
+
+  explicit Transaction(Router router);
+
+  // Returns the value of `key` as of this transaction (including its own
+  // writes), or std::nullopt if the key doesn't exist. If the read failed
+  // (e.g., because a committing transaction held the key for too long), also
+  // returns std::nullopt, and the transaction can no longer commit.
+  std::optional<std::string> Read(const std::string& key);
+
+  // Buffers a write of `value` to `key`, applied if the transaction commits.
+  void Write(const std::string& key, const std::string& value);
+
+  // Tries to commit the transaction. Returns false if it aborted instead (or,
+  // if the primary couldn't be reached, its outcome isn't known), in which
+  // case it can be retried as a new transaction.
+  bool Commit();
+
+  // Gives up on the transaction, discarding its writes.
+  void Abort();
+
+  // Whether the transaction can still commit.
+  bool is_doomed() const {
+    return this->doomed;
+  }
+
+ private:
+  Router router;
+  uint64_t txn_id;
+  // Set once a read has failed, or the transaction has finished
+  bool doomed = false;
+
+  // Values read, by key, to make reads repeatable
+  std::map<std::string, std::optional<std::string>> reads;
+  // Buffered writes
+  std::map<std::string, std::string> writes;
+  // The keys read from (and, on Commit(), written to) each server involved,
+  // which phase one sends the server in its two rounds
+  std::map<std::string, TxnPrepareRequest> participants;
+
+  // Sends `req` to the server at `addr`, and returns its response.
+  static std::optional<Response> call(const std::string& addr,
+                                      const Request& req);
+  // Tells the servers in `servers` to abort the transaction.
+  void abort_prepared(const std::vector<std::string>& servers);
+};
+
+#endif /* end of include guard */
@@ -0,0 +1,40 @@
+#include "watcher.hpp"
+
+#include <poll.h>
+
+std::unique_ptr<Watcher> Watcher::open(const std::vector<std::string>& servers,
+                                       const std::string& prefix) {
+  std::vector<std::shared_ptr<ServerConn>> conns;
+  for (auto&& server : servers) {
+    std::shared_ptr<ServerConn> conn = connect_to_server(server);
+    if (!conn || !conn->send_request(WatchRequest{prefix})) return nullptr;
+    // The server acknowledges once the watch is in place
+    std::optional<Response> res = conn->recv_response();
+    if (!res || !std::holds_alternative<WatchResponse>(*res)) return nullptr;
+    conns.push_back(std::move(conn));
+  }
+  return std::unique_ptr<Watcher>(new Watcher(std::move(conns)));
+}
+
+std::optional<WatchResponse> Watcher::next(milliseconds timeout) {
+  std::vector<struct pollfd> pfds;
+  for (auto&& conn : this->conns) pfds.push_back({conn->fd, POLLIN, 0});
+  int ret;
+  do {
+    ret = poll(pfds.data(), pfds.size(), timeout.count());
+  } while (ret == -1 && errno == EINTR);
+  if (ret < 0) return std::nullopt;
+
+  WatchResponse changes{};
+  for (size_t i = 0; i < pfds.size(); i++) {
+    if (!pfds[i].revents) continue;
+    std::optional<Response> res = this->conns[i]->recv_response();
+    auto* watch_res = res ? std::get_if<WatchResponse>(&*res) : nullptr;
+    if (!watch_res) return std::nullopt;
+    for (auto&& event : watch_res->events) {
+      changes.events.push_back(std::move(event));
+    }
+    changes.lost |= watch_res->lost;
+  }
+  return changes;
+}
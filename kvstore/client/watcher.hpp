@@ -0,0 +1,46 @@
+#ifndef WATCHER_HPP
+#define WATCHER_HPP
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "net/network_conn.hpp"
+
+using namespace std::chrono;
+
+/**
+ * Watches the keys starting with a prefix, getting their changes pushed as
+ * they're made (see WatchRequest), instead of polling them with Gets.
+ *
+ * Keys are spread over every server of a sharded deployment, so a watch is
+ * opened on each of the servers given, over a connection of its own. Note
+ * that each of those connections occupies one of its server's workers for as
+ * long as the watch is open.
+ */
+class Watcher {
+ public:
+  // Opens a watch on the keys starting with `prefix` on each of `servers`;
+  // nullptr if any can't be opened. Changes made once this returns are all
+  // reported.
+  static std::unique_ptr<Watcher> open(const std::vector<std::string>& servers,
+                                       const std::string& prefix);
+
+  /*
+   * Waits up to `timeout` for changes, and returns those that have come in
+   * from any server (none, if `timeout` passed first), or std::nullopt if a
+   * server's watch broke (say, because it stopped).
+   */
+  std::optional<WatchResponse> next(milliseconds timeout);
+
+ private:
+  explicit Watcher(std::vector<std::shared_ptr<ServerConn>> conns)
+      : conns(std::move(conns)) {
+  }
+
+  std::vector<std::shared_ptr<ServerConn>> conns;
+};
+
+#endif /* end of include guard */
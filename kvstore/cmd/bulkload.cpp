@@ -0,0 +1,94 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "client/bulk_loader.hpp"
+#include "client/shardkv_client.hpp"
+#include "common/color.hpp"
+
+void usage() {
+  cerr_color(
+      RED,
+      "Usage: ./bulkload <shardcontroller hostname:port> <file> [options]\n"
+      "Loads a file of `put <key> <value>` commands (e.g. "
+      "gdpr/database.txt).\n"
+      "Options:\n"
+      "\t--simple            address is a single KvServer, not a "
+      "shardcontroller\n"
+      "\t--threads <n>       parsing threads (default 8)\n"
+      "\t--batch <n>         records per MultiPut (default 1000)\n"
+      "\t--in-flight <n>     MultiPuts in flight per thread (default 8)\n"
+      "\t--conns <n>         connections per server (default 4)");
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  std::string addr = argv[1];
+  std::string path = argv[2];
+  BulkLoadConfig config;
+  bool simple = false;
+  try {
+    for (int i = 3; i < argc; i++) {
+      std::string flag = argv[i];
+      if (flag == "--simple") {
+        simple = true;
+        continue;
+      }
+
+      // Every other flag takes a value
+      if (i + 1 == argc) throw std::invalid_argument("missing value");
+      std::string value = argv[++i];
+      if (flag == "--threads") {
+        config.n_threads = std::stoul(value);
+      } else if (flag == "--batch") {
+        config.batch_records = std::stoul(value);
+      } else if (flag == "--in-flight") {
+        config.max_in_flight = std::stoul(value);
+      } else if (flag == "--conns") {
+        config.conns_per_server = std::stoul(value);
+      } else {
+        throw std::invalid_argument(flag);
+      }
+    }
+  } catch (const std::exception&) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  if (config.n_threads == 0 || config.batch_records == 0 ||
+      config.max_in_flight == 0 || config.conns_per_server == 0) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  // Keys are routed by the config as of the start of the load; records for
+  // shards that move during it fail, and are counted as such
+  BulkLoader::Router route;
+  if (simple) {
+    route = [&](const std::string&) { return addr; };
+  } else {
+    std::optional<ShardControllerConfig> shard_config =
+        ShardKvClient(addr).Query();
+    if (!shard_config) {
+      cerr_color(RED, "Failed to query shardcontroller at ", addr, '.');
+      return EXIT_FAILURE;
+    }
+    route = [shard_config](const std::string& key) mutable {
+      return shard_config->get_server(key);
+    };
+  }
+
+  cout_color(BLUE, "Loading ", path, "...");
+  BulkLoader loader(config, route);
+  std::optional<BulkLoadReport> report = loader.load_file(path);
+  if (!report) {
+    cerr_color(RED, "Failed to read ", path, '.');
+    return EXIT_FAILURE;
+  }
+  std::cout << format_bulk_report(*report);
+  return report->n_errors == 0 ? 0 : EXIT_FAILURE;
+}
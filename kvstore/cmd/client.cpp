@@ -6,14 +6,17 @@
 
 // Commands
 #include "client/cmd/appendcommand.hpp"
+#include "client/cmd/cascommand.hpp"
 #include "client/cmd/deletecommand.hpp"
 #include "client/cmd/gdpr_deletecommand.hpp"
 #include "client/cmd/getcommand.hpp"
+#include "client/cmd/incrcommand.hpp"
 #include "client/cmd/movecommand.hpp"
 #include "client/cmd/multigetcommand.hpp"
 #include "client/cmd/multiputcommand.hpp"
 #include "client/cmd/putcommand.hpp"
 #include "client/cmd/querycommand.hpp"
+#include "client/cmd/scancommand.hpp"
 #include "common/color.hpp"
 #include "repl/repl.hpp"
 
@@ -58,6 +61,12 @@ int main(int argc, char* argv[]) {
   repl.add_command(mgc);
   MultiPutCommand mpc{client};
   repl.add_command(mpc);
+  CasCommand cc{client};
+  repl.add_command(cc);
+  IncrCommand ic{client};
+  repl.add_command(ic);
+  ScanCommand sc{client};
+  repl.add_command(sc);
   GDPRDeleteCommand gdel{client};
   repl.add_command(gdel);
 
@@ -0,0 +1,134 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "client/load_generator.hpp"
+#include "client/shardkv_client.hpp"
+#include "client/simple_client.hpp"
+#include "common/color.hpp"
+#include "common/utils.hpp"
+
+void usage() {
+  cerr_color(
+      RED,
+      "Usage: ./loadgen <shardcontroller hostname:port> [options]\n"
+      "Options:\n"
+      "\t--simple            address is a single KvServer, not a "
+      "shardcontroller\n"
+      "\t--threads <n>       client threads (default 8)\n"
+      "\t--duration <s>      seconds to run for (default 10)\n"
+      "\t--keys <n>          size of the keyspace (default 10000)\n"
+      "\t--value-size <n>    bytes per value (default 64)\n"
+      "\t--dist <uniform|zipf>\n"
+      "\t--theta <t>         Zipf skew, in (0, 1) (default 0.99)\n"
+      "\t--reads <f>         fraction of Gets; the rest are Puts (default "
+      "0.9)\n"
+      "\t--rate <ops/s>      run open-loop at this rate (default: closed "
+      "loop)\n"
+      "\t--no-preload        don't Put every key before running\n"
+      "\t--near-cache        with --simple, clients share a NearCache of "
+      "leased values\n"
+      "\t--csv <path>        append results to a CSV for plot_performance.py\n"
+      "\t--title <name>      row title in the CSV (default \"loadgen\")");
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  std::string addr = argv[1];
+  LoadConfig config;
+  bool simple = false, preload = true, near_cache = false;
+  std::string csv_path, title = "loadgen";
+  try {
+    for (int i = 2; i < argc; i++) {
+      std::string flag = argv[i];
+      if (flag == "--simple") {
+        simple = true;
+        continue;
+      } else if (flag == "--no-preload") {
+        preload = false;
+        continue;
+      } else if (flag == "--near-cache") {
+        near_cache = true;
+        continue;
+      }
+
+      // Every other flag takes a value
+      if (i + 1 == argc) throw std::invalid_argument("missing value");
+      std::string value = argv[++i];
+      if (flag == "--threads") {
+        config.n_threads = std::stoul(value);
+      } else if (flag == "--duration") {
+        config.duration = milliseconds(std::stoul(value) * 1000);
+      } else if (flag == "--keys") {
+        config.n_keys = std::stoul(value);
+      } else if (flag == "--value-size") {
+        config.value_size = std::stoul(value);
+      } else if (flag == "--dist" && to_lower(value) == "uniform") {
+        config.distribution = KeyDistribution::UNIFORM;
+      } else if (flag == "--dist" && to_lower(value) == "zipf") {
+        config.distribution = KeyDistribution::ZIPF;
+      } else if (flag == "--theta") {
+        config.zipf_theta = std::stod(value);
+      } else if (flag == "--reads") {
+        config.read_fraction = std::stod(value);
+      } else if (flag == "--rate") {
+        config.mode = LoadMode::OPEN;
+        config.rate = std::stod(value);
+      } else if (flag == "--csv") {
+        csv_path = value;
+      } else if (flag == "--title") {
+        title = value;
+      } else {
+        throw std::invalid_argument(flag);
+      }
+    }
+  } catch (const std::exception&) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  if ((near_cache && !simple) || config.n_threads == 0 ||
+      config.n_keys == 0 || config.rate <= 0 || config.zipf_theta <= 0 ||
+      config.zipf_theta >= 1) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  LoadGenerator::ClientFactory make_client;
+  std::shared_ptr<NearCache> cache;
+  if (near_cache) cache = std::make_shared<NearCache>();
+  if (simple) {
+    make_client = [&] {
+      return std::make_shared<SimpleClient>(addr, 0ms, false, cache);
+    };
+  } else {
+    make_client = [&] { return std::make_shared<ShardKvClient>(addr); };
+  }
+  LoadGenerator generator(config, make_client);
+
+  if (preload) {
+    cout_color(BLUE, "Preloading ", config.n_keys, " keys...");
+    if (!generator.preload()) {
+      cerr_color(RED, "Failed to preload keys.");
+      return EXIT_FAILURE;
+    }
+  }
+
+  cout_color(BLUE, "Running for ", config.duration.count() / 1000, "s...");
+  LoadReport report = generator.run();
+  std::cout << format_report(report);
+  if (cache) {
+    std::cout << "Near-cache hits: " << cache->hits() << ", misses: "
+              << cache->misses() << '\n';
+  }
+
+  if (!csv_path.empty() && !append_csv(csv_path, title, report)) {
+    cerr_color(RED, "Failed to write to ", csv_path, '.');
+    return EXIT_FAILURE;
+  }
+  return 0;
+}
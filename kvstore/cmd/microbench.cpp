@@ -0,0 +1,648 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/color.hpp"
+#include "common/config.hpp"
+#include "common/shard.hpp"
+#include "kvstore/concurrent_kvstore.hpp"
+#include "net/network_conn.hpp"
+#include "net/network_messages.hpp"
+
+/*
+ * In-process microbenchmarks of kvstore's building blocks: DbMap, message
+ * (de)serialization, shard routing and splitting, and sending messages over
+ * loopback.
+ *
+ * Each benchmark is first run for longer and longer until one run takes
+ * --min-time, which also warms it up; the operation count that took is then
+ * timed --reps more times. Results are reported per operation, as the mean
+ * and standard deviation over the repetitions (and their coefficient of
+ * variation, so noisy benchmarks stand out), along with the machine they ran
+ * on. Compare runs on the same machine, built the same way (`make bench`
+ * builds with -O3).
+ */
+
+static constexpr size_t KEY_SIZE = 16;
+static constexpr size_t VALUE_SIZE = 64;
+
+void usage() {
+  cerr_color(
+      RED,
+      "Usage: ./microbench [options]\n"
+      "Options:\n"
+      "\t--reps <n>          timed repetitions per benchmark (default 5)\n"
+      "\t--min-time <ms>     how long each repetition runs for, at least "
+      "(default 50)\n"
+      "\t--filter <s>        only run benchmarks whose names contain <s>\n"
+      "\t--list              list the benchmarks, without running them\n"
+      "\t--csv <path>        append results to a CSV");
+}
+
+// Keeps the compiler from optimizing away the computation of `value`, which
+// the benchmark doesn't otherwise use.
+template <typename T>
+void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Options {
+  size_t reps = 5;
+  milliseconds min_time = 50ms;
+  std::string filter;
+  bool list = false;
+  std::string csv_path;
+};
+
+struct Benchmark {
+  std::string name;
+  // Performs `n` operations.
+  std::function<void(size_t n)> run;
+  // If set, and it returns a reason, the benchmark is skipped for that reason
+  // (say, because what it measures is left to students). Only called if the
+  // benchmark is selected.
+  std::function<std::optional<std::string>()> skip_reason = nullptr;
+};
+
+struct Result {
+  std::string name;
+  // Operations per repetition
+  size_t ops;
+  // Nanoseconds per operation, in each repetition
+  std::vector<double> ns_per_op;
+
+  double mean() const {
+    double sum = 0;
+    for (double ns : this->ns_per_op) sum += ns;
+    return sum / this->ns_per_op.size();
+  }
+  // Sample standard deviation
+  double stddev() const {
+    if (this->ns_per_op.size() < 2) return 0;
+    double mean = this->mean(), sum = 0;
+    for (double ns : this->ns_per_op) sum += (ns - mean) * (ns - mean);
+    return std::sqrt(sum / (this->ns_per_op.size() - 1));
+  }
+  double min() const {
+    return *std::min_element(this->ns_per_op.begin(), this->ns_per_op.end());
+  }
+  double max() const {
+    return *std::max_element(this->ns_per_op.begin(), this->ns_per_op.end());
+  }
+};
+
+// Times one run of `n` operations.
+nanoseconds time_run(const Benchmark& bench, size_t n) {
+  auto start = steady_clock::now();
+  bench.run(n);
+  return steady_clock::now() - start;
+}
+
+Result measure(const Benchmark& bench, const Options& opts) {
+  // Calibrate: grow n until a run takes min_time, aiming a little past it
+  size_t n = 1;
+  for (nanoseconds took = time_run(bench, n); took < opts.min_time;
+       took = time_run(bench, n)) {
+    double scale = took.count() > 0
+                       ? 1.2 * nanoseconds(opts.min_time).count() / took.count()
+                       : 10;
+    n = std::max(n + 1, size_t(n * std::clamp(scale, 1.5, 10.0)));
+  }
+
+  Result result{bench.name, n, {}};
+  for (size_t rep = 0; rep < opts.reps; rep++) {
+    result.ns_per_op.push_back(double(time_run(bench, n).count()) / n);
+  }
+  return result;
+}
+
+/* ===== Machine info ===== */
+
+std::string read_first_line(const std::string& path, const std::string& key) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.rfind(key, 0) != 0) continue;
+    size_t colon = line.find(':');
+    return colon == std::string::npos ? line : line.substr(colon + 2);
+  }
+  return "";
+}
+
+void print_machine_info(std::ostream& os) {
+  char host[256] = {};
+  gethostname(host, sizeof(host) - 1);
+  utsname uts{};
+  uname(&uts);
+  std::time_t now = std::time(nullptr);
+  char date[64];
+  std::strftime(date, sizeof(date), "%F %T %Z", std::localtime(&now));
+
+  std::string cpu = read_first_line("/proc/cpuinfo", "model name");
+  std::string governor;
+  std::ifstream(
+      "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor") >> governor;
+
+  os << "Date:      " << date << '\n'
+     << "Host:      " << host << " (" << uts.sysname << ' ' << uts.release
+     << ' ' << uts.machine << ")\n"
+     << "CPU:       " << (cpu.empty() ? "unknown" : cpu) << ", "
+     << std::thread::hardware_concurrency() << " hardware threads"
+     << (governor.empty() ? "" : ", " + governor + " governor") << '\n'
+     << "Compiler:  " << __VERSION__ << '\n'
+     << "Build:     "
+#ifdef __OPTIMIZE__
+     << "optimized"
+#else
+     << "unoptimized"
+#endif
+#ifdef NDEBUG
+     << ", NDEBUG"
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+     << ", sanitized"
+#endif
+     << '\n';
+}
+
+/* ===== DbMap ===== */
+
+// Maps keys onto only the first `n_buckets` of DbMap's buckets, to vary how
+// many keys (and threads) share each bucket.
+struct BucketsHash {
+  size_t n_buckets;
+
+  size_t operator()(std::string_view key) const {
+    return KeyHash()(key) % this->n_buckets;
+  }
+};
+
+// A DbMap with a reader-writer lock per bucket: the synchronization
+// ConcurrentKvStore puts around it.
+struct LockedDbMap {
+  explicit LockedDbMap(size_t n_buckets)
+      : map(BucketsHash{n_buckets}, CompressionOptions{.enabled = false}) {
+  }
+
+  DbMap<BucketsHash> map;
+  std::array<std::shared_mutex, DbMap<BucketsHash>::BUCKET_COUNT> locks;
+};
+
+std::vector<std::string> make_keys(size_t n, size_t size) {
+  std::mt19937_64 rng(n);
+  std::uniform_int_distribution<size_t> pick(0, VALID_CHARS.size() - 1);
+  std::vector<std::string> keys(n);
+  for (auto& key : keys) {
+    for (size_t i = 0; i < size; i++) key += VALID_CHARS[pick(rng)];
+  }
+  return keys;
+}
+
+// Splits op(i), for i in [0, n), across `n_threads` threads, which start
+// together.
+template <typename Op>
+void run_threads(size_t n_threads, size_t n, const Op& op) {
+  std::latch start(n_threads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < n_threads; t++) {
+    threads.emplace_back([&, t] {
+      start.arrive_and_wait();
+      for (size_t i = t; i < n; i += n_threads) op(i);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+void add_dbmap_benchmarks(std::vector<Benchmark>& benchmarks) {
+  static constexpr size_t N_KEYS = 1000;
+  auto keys =
+      std::make_shared<std::vector<std::string>>(make_keys(N_KEYS, KEY_SIZE));
+  std::string value(VALUE_SIZE, 'v');
+
+  for (size_t n_buckets : {1, 4, 16, 60}) {
+    auto map = std::make_shared<LockedDbMap>(n_buckets);
+    for (auto&& key : *keys) {
+      map->map.insertItem(map->map.bucket(key), key, value);
+    }
+
+    for (size_t n_threads : {1, 2, 4, 8}) {
+      std::string suffix = "/" + std::to_string(n_buckets) + "_buckets/" +
+                           std::to_string(n_threads) + "_threads";
+      benchmarks.push_back({"dbmap/get" + suffix, [=](size_t n) {
+        run_threads(n_threads, n, [&](size_t i) {
+          thread_local std::string out;
+          const std::string& key = (*keys)[i % N_KEYS];
+          size_t b = map->map.bucket(key);
+          std::shared_lock lock(map->locks[b]);
+          if (!map->map.readValue(b, key, &out)) std::abort();
+        });
+      }});
+      benchmarks.push_back({"dbmap/put" + suffix, [=](size_t n) {
+        run_threads(n_threads, n, [&](size_t i) {
+          const std::string& key = (*keys)[i % N_KEYS];
+          size_t b = map->map.bucket(key);
+          std::unique_lock lock(map->locks[b]);
+          map->map.insertItem(b, key, value);
+        });
+      }});
+    }
+  }
+}
+
+/* ===== Serialization ===== */
+
+// One message of every type (and its name), of a typical size.
+std::vector<std::pair<std::string, Request>> sample_requests() {
+  auto keys = make_keys(16, KEY_SIZE);
+  std::vector<std::string> values(keys.size(), std::string(VALUE_SIZE, 'v'));
+  std::vector<uint64_t> versions(keys.size(), 1);
+  return {
+      {"join", JoinRequest{"127.0.0.1:8080"}},
+      {"leave", LeaveRequest{"127.0.0.1:8080"}},
+      {"move", MoveRequest{"127.0.0.1:8080", split_into(16)}},
+      {"query", QueryRequest{}},
+      {"raft_vote", RaftVoteRequest{2, "127.0.0.1:9000", 100, 1}},
+      {"raft_append",
+       RaftAppendRequest{2, "127.0.0.1:9000", 100, 1,
+                         std::vector<RaftEntry>(
+                             4, RaftEntry{2, 0, std::vector<std::byte>(64)}),
+                         99}},
+      {"get", GetRequest{keys[0]}},
+      {"put", PutRequest{keys[0], values[0], 0}},
+      {"append", AppendRequest{keys[0], values[0]}},
+      {"delete", DeleteRequest{keys[0]}},
+      {"multi_get", MultiGetRequest{keys}},
+      {"multi_put", MultiPutRequest{keys, values, 0}},
+      {"cas", CasRequest{keys[0], values[0], values[1]}},
+      {"incr", IncrRequest{keys[0], 1}},
+      {"stats", StatsRequest{}},
+      {"put_chunk", PutChunkRequest{keys[0], values[0], false, true, 0}},
+      {"get_chunk", GetChunkRequest{keys[0], VALUE_CHUNK_SIZE}},
+      {"hello", HelloRequest{FEATURE_COMPRESSION, ""}},
+      {"txn_read", TxnReadRequest{keys}},
+      {"txn_prepare", TxnPrepareRequest{1, "127.0.0.1:8081", keys, versions,
+                                        keys, values}},
+      {"txn_finish", TxnFinishRequest{1, true}},
+      {"txn_status", TxnStatusRequest{1}},
+      {"scan", ScanRequest{"", 100}},
+      {"watch", WatchRequest{"prefix"}},
+      {"get_lease", GetLeaseRequest{keys[0]}},
+  };
+}
+
+std::vector<std::pair<std::string, Response>> sample_responses() {
+  auto keys = make_keys(16, KEY_SIZE);
+  std::vector<std::string> values(keys.size(), std::string(VALUE_SIZE, 'v'));
+  std::vector<std::optional<std::string>> maybe_values(values.begin(),
+                                                       values.end());
+  std::vector<uint64_t> versions(keys.size(), 1);
+  ShardControllerConfig config;
+  std::vector<Shard> shards = split_into(16);
+  for (size_t i = 0; i < shards.size(); i++) {
+    config.server_to_shards["127.0.0.1:" + std::to_string(8081 + i)] = {
+        shards[i]};
+  }
+  LatencySummary latency{1000, 50'000, 40'000, 90'000, 200'000, 500'000,
+                         1'000'000};
+  std::vector<WatchEvent> events;
+  for (auto&& key : keys) {
+    events.push_back(WatchEvent{WatchEventType::PUT, key, values[0]});
+  }
+  return {
+      {"join", JoinResponse{}},
+      {"leave", LeaveResponse{}},
+      {"move", MoveResponse{}},
+      {"query", QueryResponse{config, 1, 16}},
+      {"raft_vote", RaftVoteResponse{2, true}},
+      {"raft_append", RaftAppendResponse{2, true, 104}},
+      {"get", GetResponse{values[0]}},
+      {"put", PutResponse{}},
+      {"append", AppendResponse{}},
+      {"delete", DeleteResponse{values[0]}},
+      {"multi_get", MultiGetResponse{values}},
+      {"multi_put", MultiPutResponse{}},
+      {"cas", CasResponse{true, values[0]}},
+      {"incr", IncrResponse{2}},
+      {"stats",
+       StatsResponse{std::vector<OpStats>(4, OpStats{"GET", 0, latency}),
+                     std::vector<uint64_t>(8, 0), 1 << 20, 1 << 20, 0, 0,
+                     latency}},
+      {"get_chunk", GetChunkResponse{values[0], 2 * VALUE_CHUNK_SIZE, 1}},
+      {"hello", HelloResponse{FEATURE_COMPRESSION}},
+      {"txn_read", TxnReadResponse{maybe_values, versions}},
+      {"txn_prepare", TxnPrepareResponse{true}},
+      {"txn_finish", TxnFinishResponse{true}},
+      {"txn_status", TxnStatusResponse{true}},
+      {"scan", ScanResponse{keys, values, {}, {}, keys.back()}},
+      {"watch", WatchResponse{events, false}},
+      {"get_lease", GetLeaseResponse{values[0], 50}},
+      {"error", ErrorResponse{"Server overloaded", 10}},
+  };
+}
+
+// Checks that `samples` has a message of every type in `Variant`, so that new
+// message types get benchmarked too.
+template <typename Variant>
+void check_coverage(
+    const std::vector<std::pair<std::string, Variant>>& samples) {
+  std::set<size_t> types;
+  for (auto&& [name, sample] : samples) types.insert(sample.index());
+  if (types.size() != std::variant_size_v<Variant>) {
+    cerr_color(RED, "Not every message type has a sample to benchmark.");
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+void add_serialization_benchmarks(std::vector<Benchmark>& benchmarks) {
+  auto requests = sample_requests();
+  auto responses = sample_responses();
+  check_coverage(requests);
+  check_coverage(responses);
+
+  for (auto&& [name, req] : requests) {
+    benchmarks.push_back({"serialize/request/" + name, [req](size_t n) {
+      Message msg{};
+      for (size_t i = 0; i < n; i++) {
+        if (!serialize_request(req, &msg)) std::abort();
+      }
+    }});
+    auto msg = std::make_shared<Message>(*serialize_request(req));
+    benchmarks.push_back({"deserialize/request/" + name, [msg](size_t n) {
+      for (size_t i = 0; i < n; i++) {
+        if (!deserialize_request(*msg)) std::abort();
+      }
+    }});
+  }
+  for (auto&& [name, res] : responses) {
+    benchmarks.push_back({"serialize/response/" + name, [res](size_t n) {
+      Message msg{};
+      for (size_t i = 0; i < n; i++) {
+        if (!serialize_response(res, &msg)) std::abort();
+      }
+    }});
+    auto msg = std::make_shared<Message>(*serialize_response(res));
+    benchmarks.push_back({"deserialize/response/" + name, [msg](size_t n) {
+      for (size_t i = 0; i < n; i++) {
+        if (!deserialize_response(*msg)) std::abort();
+      }
+    }});
+  }
+}
+
+/* ===== Shards ===== */
+
+void add_shard_benchmarks(std::vector<Benchmark>& benchmarks) {
+  static constexpr size_t N_KEYS = 1024;
+  auto keys =
+      std::make_shared<std::vector<std::string>>(make_keys(N_KEYS, KEY_SIZE));
+
+  for (size_t n_servers : {1, 16, 256}) {
+    auto config = std::make_shared<ShardControllerConfig>();
+    std::vector<Shard> shards = split_into(n_servers);
+    for (size_t i = 0; i < n_servers; i++) {
+      config->server_to_shards["server" + std::to_string(i)] = {shards[i]};
+    }
+    benchmarks.push_back(
+        {"route/get_server/" + std::to_string(n_servers) + "_servers",
+         [=](size_t n) {
+           for (size_t i = 0; i < n; i++) {
+             if (!config->get_server((*keys)[i % N_KEYS])) std::abort();
+           }
+         },
+         [=]() -> std::optional<std::string> {
+           // Routing is left to students (Part B), and unrouted keys would
+           // abort the run
+           for (auto&& key : *keys) {
+             if (!config->get_server(key)) {
+               return "ShardControllerConfig::get_server didn't route " + key;
+             }
+           }
+           return std::nullopt;
+         }});
+  }
+
+  // Shards of every granularity, and keys (of the matching granularity) to
+  // split them at
+  auto shards = std::make_shared<std::vector<Shard>>();
+  for (size_t n_shards : {2, 10, 100, 1000, 10000}) {
+    for (auto&& shard : split_into(n_shards)) {
+      if (str_to_bucket(shard.upper) > str_to_bucket(shard.lower)) {
+        shards->push_back(shard);
+      }
+    }
+  }
+  std::shuffle(shards->begin(), shards->end(), std::mt19937_64(0));
+  benchmarks.push_back({"shard/split_shard", [shards](size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      keep(split_shard((*shards)[i % shards->size()]));
+    }
+  }});
+  benchmarks.push_back({"shard/split_shard_at", [shards](size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      const Shard& shard = (*shards)[i % shards->size()];
+      keep(split_shard(shard, shard.lower));
+    }
+  }});
+  benchmarks.push_back({"shard/get_overlap", [shards](size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      const Shard& a = (*shards)[i % shards->size()];
+      const Shard& b = (*shards)[(i * 7 + 1) % shards->size()];
+      keep(get_overlap(a, b));
+    }
+  }});
+}
+
+/* ===== Loopback ===== */
+
+// A connection to an in-process server that answers every PutRequest with a
+// PutResponse, and nothing else.
+struct Loopback {
+  std::shared_ptr<ServerConn> conn;
+  std::thread server;
+
+  explicit Loopback(const std::string& address) {
+    int listener = open_listener_socket(address);
+    if (listener < 0) throw std::runtime_error("can't listen on " + address);
+
+    // A TCP address with port 0 listens on any free port
+    std::string connect_to = address;
+    if (!is_unix_address(address)) {
+      sockaddr_storage addr{};
+      socklen_t len = sizeof(addr);
+      getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+      uint16_t port = ntohs(reinterpret_cast<sockaddr_in*>(&addr)->sin_port);
+      connect_to = address.substr(0, address.rfind(':') + 1) +
+                   std::to_string(port);
+    }
+
+    this->server = std::thread([listener, address] {
+      std::shared_ptr<ClientConn> client = accept_client(listener);
+      ::close(listener);
+      if (is_unix_address(address)) {
+        ::unlink(address.substr(UNIX_ADDRESS_PREFIX.size()).c_str());
+      }
+      if (!client) return;
+      while (client->recv_request()) {
+        if (!client->send_response(PutResponse{})) break;
+      }
+    });
+    this->conn = connect_to_server(connect_to);
+    if (!this->conn) {
+      this->server.join();
+      throw std::runtime_error("can't connect to " + connect_to);
+    }
+  }
+  ~Loopback() {
+    this->conn.reset();
+    this->server.join();
+  }
+};
+
+void add_loopback_benchmarks(std::vector<Benchmark>& benchmarks) {
+  std::string unix_address =
+      "unix:/tmp/kvstore-microbench-" + std::to_string(getpid()) + ".sock";
+  for (auto&& [transport, address] :
+       {std::pair<std::string, std::string>("tcp", "127.0.0.1:0"),
+        std::pair<std::string, std::string>("unix", unix_address)}) {
+    for (size_t value_size : {size_t(64), size_t(64 << 10)}) {
+      std::string size = value_size < 1024
+                             ? std::to_string(value_size) + "B"
+                             : std::to_string(value_size >> 10) + "KiB";
+      // Connected when the benchmark first runs, and kept until exit
+      auto loopback = std::make_shared<std::unique_ptr<Loopback>>();
+      PutRequest req{"key", std::string(value_size, 'v'), 0};
+      benchmarks.push_back(
+          {"loopback/" + transport + "/put_" + size, [=](size_t n) {
+             if (!*loopback) *loopback = std::make_unique<Loopback>(address);
+             ServerConn& conn = *(*loopback)->conn;
+             for (size_t i = 0; i < n; i++) {
+               if (!conn.send_request(req) || !conn.recv_response()) {
+                 std::abort();
+               }
+             }
+           }});
+    }
+  }
+}
+
+/* ===== Reporting ===== */
+
+void print_result(const Result& result) {
+  double mean = result.mean(), stddev = result.stddev();
+  std::cout << std::left << std::setw(48) << result.name << std::right
+            << std::fixed << std::setprecision(1) << std::setw(11) << mean
+            << " ns/op  +- " << std::setw(8) << stddev << " (" << std::setw(5)
+            << (mean > 0 ? 100 * stddev / mean : 0) << "%)  min "
+            << std::setw(10) << result.min() << "  max " << std::setw(10)
+            << result.max() << "  x" << result.ns_per_op.size() << " of "
+            << result.ops << '\n';
+}
+
+bool append_csv(const std::string& path, const std::vector<Result>& results) {
+  bool exists = std::ifstream(path).good();
+  std::ofstream file(path, std::ios::app);
+  if (!file) return false;
+  if (!exists) file << "name,reps,ops,mean_ns,stddev_ns,min_ns,max_ns\n";
+  for (auto&& result : results) {
+    file << result.name << ',' << result.ns_per_op.size() << ','
+         << result.ops << ',' << result.mean() << ',' << result.stddev() << ','
+         << result.min() << ',' << result.max() << '\n';
+  }
+  return bool(file);
+}
+
+int main(int argc, char* argv[]) {
+  Options opts;
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string flag = argv[i];
+      if (flag == "--list") {
+        opts.list = true;
+        continue;
+      }
+
+      // Every other flag takes a value
+      if (i + 1 == argc) throw std::invalid_argument("missing value");
+      std::string value = argv[++i];
+      if (flag == "--reps") {
+        opts.reps = std::stoul(value);
+      } else if (flag == "--min-time") {
+        opts.min_time = milliseconds(std::stoul(value));
+      } else if (flag == "--filter") {
+        opts.filter = value;
+      } else if (flag == "--csv") {
+        opts.csv_path = value;
+      } else {
+        throw std::invalid_argument(flag);
+      }
+    }
+  } catch (const std::exception&) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  if (opts.reps == 0 || opts.min_time <= 0ms) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Benchmark> benchmarks;
+  add_dbmap_benchmarks(benchmarks);
+  add_serialization_benchmarks(benchmarks);
+  add_shard_benchmarks(benchmarks);
+  add_loopback_benchmarks(benchmarks);
+  std::erase_if(benchmarks, [&](const Benchmark& bench) {
+    return bench.name.find(opts.filter) == std::string::npos;
+  });
+
+  if (opts.list) {
+    for (auto&& bench : benchmarks) std::cout << bench.name << '\n';
+    return 0;
+  }
+
+  print_machine_info(std::cout);
+#ifndef __OPTIMIZE__
+  cout_color(YELLOW, "Built without optimization: run `make bench` for "
+                     "representative numbers.");
+#endif
+  std::cout << "Repetitions: " << opts.reps << " of at least "
+            << opts.min_time.count() << "ms each\n\n";
+
+  std::vector<Result> results;
+  for (auto&& bench : benchmarks) {
+    if (bench.skip_reason) {
+      if (std::optional<std::string> reason = bench.skip_reason()) {
+        std::cout << std::left << std::setw(48) << bench.name << " skipped: "
+                  << *reason << '\n';
+        continue;
+      }
+    }
+    results.push_back(measure(bench, opts));
+    print_result(results.back());
+  }
+
+  if (!opts.csv_path.empty() && !append_csv(opts.csv_path, results)) {
+    cerr_color(RED, "Failed to write to ", opts.csv_path, '.');
+    return EXIT_FAILURE;
+  }
+  return 0;
+}
@@ -3,26 +3,53 @@
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "kvstore/kvstore.hpp"
 #include "repl/repl.hpp"
 #include "server/cmd/joincommand.hpp"
 #include "server/cmd/leavecommand.hpp"
 #include "server/cmd/printcommand.hpp"
+#include "server/cmd/statscommand.hpp"
 
 int main(int argc, char* argv[]) {
+  // Placement flags may go anywhere; the other arguments are positional
+  WorkerPlacement placement;
+  std::vector<char*> positional = {argv[0]};
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--pin-workers") {
+      placement.pin_workers = true;
+    } else if (arg == "--numa") {
+      placement.numa = true;
+    } else {
+      positional.push_back(argv[i]);
+    }
+  }
+  argc = positional.size();
+  argv = positional.data();
+
   if (argc < 2 || argc > 4) {
     cerr_color(RED,
                "\nIf on Concurrent Store:\n"
                "\t./server <port> [n_workers]\n"
                "If on Distributed Store:\n"
-               "\t./server <port> <shardcontroller hostname:port> [n_workers]");
+               "\t./server <port> <shardcontroller hostname:port> [n_workers]\n"
+               "For clients on this host only, <port> may be a Unix domain "
+               "socket's unix:<path>.\n"
+               "Options:\n"
+               "\t--pin-workers  pin each worker thread to one CPU\n"
+               "\t--numa         keep workers, their connections, and their "
+               "memory on\n"
+               "\t               NUMA nodes, spread evenly over the nodes");
     return EXIT_FAILURE;
   }
 
   std::shared_ptr<KvServer> server;
 
-  std::string addr = get_host_address(argv[1]);
+  std::string addr = is_unix_address(argv[1]) ? std::string(argv[1])
+                                              : get_host_address(argv[1]);
   std::string shardcontroller_addr;
   uint64_t n_workers = N_WORKERS;
 
@@ -46,9 +73,11 @@ int main(int argc, char* argv[]) {
   // If no shardcontroller address specified, Concurrent Store; otherwise,
   // Distributed Store
   if (shardcontroller_addr.empty()) {
-    server = std::make_shared<KvServer>(addr, n_workers);
+    server = std::make_shared<KvServer>(addr, n_workers, AdmissionLimits{},
+                                        placement);
   } else {
-    server = std::make_shared<KvServer>(addr, shardcontroller_addr, n_workers);
+    server = std::make_shared<KvServer>(addr, shardcontroller_addr, n_workers,
+                                        AdmissionLimits{}, placement);
   }
 
   int ret = server->start();
@@ -64,9 +93,12 @@ int main(int argc, char* argv[]) {
     LeaveCommand lc{server};
     repl.add_command(lc);
   }
-  // - `print <store|config>` (display store/config)
+  // - `print <store|config|memory>` (display store/config/memory usage)
   PrintCommand pc{server};
   repl.add_command(pc);
+  // - `stats` (display request counts and latencies)
+  StatsCommand sc{server};
+  repl.add_command(sc);
 
   repl.run();
 
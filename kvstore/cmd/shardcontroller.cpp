@@ -1,21 +1,46 @@
 #include "shardcontroller/shardcontroller.hpp"
 
 #include <iostream>
+#include <sstream>
 
 #include "repl/repl.hpp"
 #include "shardcontroller/cmd/querycommand.hpp"
+#include "shardcontroller/replicated_shardcontroller.hpp"
 #include "shardcontroller/static_shardcontroller.hpp"
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    cerr_color(RED, "Usage: ./shardcontroller <PORT>");
+  if (argc < 2 || argc > 4) {
+    cerr_color(RED,
+               "Usage: ./shardcontroller <PORT> [state directory] "
+               "[comma-separated addresses of all nodes]");
     exit(EXIT_FAILURE);
   }
 
-  // Get shardcontroller address, for servers to connect
+  // Get shardcontroller address, for servers to connect. With a state
+  // directory, the config survives restarts; with a list of addresses (which
+  // includes this node's) after it, the controller is replicated over those
+  // nodes. The arguments go by position, since either may contain a ':'.
   std::string addr = get_host_address(argv[1]);
-  std::shared_ptr<Shardcontroller> shardcontroller =
-      std::make_shared<StaticShardController>(addr);
+  std::string state_dir = argc > 2 ? argv[2] : "";
+  std::string node_list = argc > 3 ? argv[3] : "";
+  std::shared_ptr<Shardcontroller> shardcontroller;
+  if (argc > 3) {
+    if (state_dir.empty() || node_list.empty()) {
+      cerr_color(RED,
+                 "A replicated shardcontroller needs a state directory and "
+                 "the addresses of its nodes");
+      exit(EXIT_FAILURE);
+    }
+    std::vector<std::string> nodes;
+    std::stringstream list(node_list);
+    for (std::string node; std::getline(list, node, ',');) {
+      nodes.push_back(node);
+    }
+    shardcontroller = std::make_shared<ReplicatedShardController>(
+        addr, std::move(nodes), state_dir);
+  } else {
+    shardcontroller = std::make_shared<StaticShardController>(addr, state_dir);
+  }
 
   int ret = shardcontroller->start();
   if (ret < 0) {
@@ -0,0 +1,257 @@
+#include "compression.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr size_t HASH_BITS = 12;
+// Lengths of at least this much spill over from a token's nibble into extra
+// bytes
+constexpr size_t NIBBLE_MAX = 15;
+
+uint32_t read32(const char* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+size_t hash32(uint32_t v) {
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void write_varint(std::string& out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(char(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(char(v));
+}
+
+bool read_varint(const char*& p, const char* end, uint64_t* v) {
+  *v = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t byte = *p++;
+    *v |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+// Writes the part of a length that didn't fit in its token's nibble.
+char* write_length(char* op, size_t len) {
+  if (len < NIBBLE_MAX) return op;
+  for (len -= NIBBLE_MAX; len >= 255; len -= 255) *op++ = char(255);
+  *op++ = char(len);
+  return op;
+}
+
+bool read_length(const char*& p, const char* end, size_t* len) {
+  if (*len < NIBBLE_MAX) return true;
+  while (p < end) {
+    uint8_t byte = *p++;
+    *len += byte;
+    if (byte != 255) return true;
+  }
+  return false;
+}
+
+// Writes `literals`, followed by a match of `match_len` bytes from `offset`
+// bytes back (or no match, if `match_len` is 0), at `op`. Returns the end of
+// what it wrote.
+char* emit(char* op, std::string_view literals, size_t offset,
+           size_t match_len) {
+  size_t match_code = match_len ? match_len - MIN_MATCH : 0;
+  *op++ = char(std::min(literals.size(), NIBBLE_MAX) << 4 |
+               std::min(match_code, NIBBLE_MAX));
+  op = write_length(op, literals.size());
+  std::memcpy(op, literals.data(), literals.size());
+  op += literals.size();
+  if (match_len == 0) return op;
+  *op++ = char(offset & 0xff);
+  *op++ = char(offset >> 8);
+  return write_length(op, match_code);
+}
+
+}  // namespace
+
+std::string lz_compress(std::string_view data) {
+  const char* src = data.data();
+  size_t n = data.size();
+
+  std::string out;
+  write_varint(out, n);
+  size_t header_size = out.size();
+  // Worst case: every byte is a literal, plus length bytes
+  out.resize(header_size + n + n / 255 + 16);
+  char* op = out.data() + header_size;
+
+  // Most recent position (plus one, so that 0 means none) of each hash
+  std::array<uint32_t, 1 << HASH_BITS> table{};
+  size_t anchor = 0;
+  size_t pos = 0;
+  while (pos + MIN_MATCH <= n) {
+    uint32_t v = read32(src + pos);
+    uint32_t& slot = table[hash32(v)];
+    size_t candidate = slot;
+    slot = pos + 1;
+    if (candidate == 0 || pos + 1 - candidate > MAX_OFFSET ||
+        read32(src + candidate - 1) != v) {
+      // Skip ahead faster the longer it's been since the last match, so that
+      // data that doesn't compress is passed over quickly
+      pos += 1 + ((pos - anchor) >> 6);
+      continue;
+    }
+
+    candidate--;
+    size_t len = MIN_MATCH;
+    while (pos + len < n && src[candidate + len] == src[pos + len]) len++;
+    op = emit(op, data.substr(anchor, pos - anchor), pos - candidate, len);
+    pos += len;
+    anchor = pos;
+  }
+  op = emit(op, data.substr(anchor), 0, 0);
+  out.resize(op - out.data());
+  return out;
+}
+
+std::optional<std::string> lz_decompress(std::string_view data) {
+  const char* p = data.data();
+  const char* end = p + data.size();
+  uint64_t size;
+  if (!read_varint(p, end, &size) || size > data.size() * 255 + 16) {
+    return std::nullopt;
+  }
+
+  std::string out(size, '\0');
+  char* op = out.data();
+  char* op_end = op + size;
+  bool is_complete = false;
+  while (p < end) {
+    uint8_t token = *p++;
+    size_t literal_len = token >> 4;
+    if (!read_length(p, end, &literal_len)) return std::nullopt;
+    if (size_t(end - p) < literal_len || size_t(op_end - op) < literal_len) {
+      return std::nullopt;
+    }
+    std::memcpy(op, p, literal_len);
+    op += literal_len;
+    p += literal_len;
+    // The last sequence has no match
+    if (p == end) {
+      is_complete = true;
+      break;
+    }
+
+    if (end - p < 2) return std::nullopt;
+    size_t offset = uint8_t(p[0]) | size_t(uint8_t(p[1])) << 8;
+    p += 2;
+    size_t match_len = token & 0xf;
+    if (!read_length(p, end, &match_len)) return std::nullopt;
+    match_len += MIN_MATCH;
+    if (offset == 0 || offset > size_t(op - out.data()) ||
+        size_t(op_end - op) < match_len) {
+      return std::nullopt;
+    }
+    const char* from = op - offset;
+    if (offset >= match_len) {
+      std::memcpy(op, from, match_len);
+      op += match_len;
+    } else {
+      // The match overlaps the bytes it produces, so copy byte by byte
+      for (size_t i = 0; i < match_len; i++) *op++ = from[i];
+    }
+  }
+  if (!is_complete || op != op_end) return std::nullopt;
+  return out;
+}
+
+std::optional<std::string> Compressor::compress(std::string_view value) {
+  if (!this->options.enabled || value.size() < this->options.min_size) {
+    return std::nullopt;
+  }
+  this->offered.fetch_add(1, std::memory_order_relaxed);
+
+  size_t size_class = std::min<size_t>(std::bit_width(value.size()),
+                                       N_SIZE_CLASSES - 1);
+  if (this->misses[size_class].load(std::memory_order_relaxed) >=
+          BACKOFF_AFTER &&
+      this->probes[size_class].fetch_add(1, std::memory_order_relaxed) %
+              PROBE_INTERVAL !=
+          0) {
+    this->skipped.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::string compressed = lz_compress(value);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  this->compress_ns.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+      std::memory_order_relaxed);
+
+  if (compressed.size() > value.size() * this->options.max_ratio) {
+    this->rejected.fetch_add(1, std::memory_order_relaxed);
+    if (this->misses[size_class].load(std::memory_order_relaxed) <
+        BACKOFF_AFTER) {
+      this->misses[size_class].fetch_add(1, std::memory_order_relaxed);
+    }
+    return std::nullopt;
+  }
+  this->misses[size_class].store(0, std::memory_order_relaxed);
+  this->kept.fetch_add(1, std::memory_order_relaxed);
+  this->raw_bytes.fetch_add(value.size(), std::memory_order_relaxed);
+  this->compressed_bytes.fetch_add(compressed.size(),
+                                   std::memory_order_relaxed);
+  return compressed;
+}
+
+std::string Compressor::decompress(std::string_view compressed) {
+  auto start = std::chrono::steady_clock::now();
+  std::optional<std::string> value = lz_decompress(compressed);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  this->decompressed.fetch_add(1, std::memory_order_relaxed);
+  this->decompress_ns.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+      std::memory_order_relaxed);
+
+  // Compressed values only ever come from compress()
+  assert(value);
+  return value ? std::move(*value) : std::string();
+}
+
+Compressor::Stats Compressor::stats() const {
+  return Stats{
+      this->offered.load(std::memory_order_relaxed),
+      this->kept.load(std::memory_order_relaxed),
+      this->rejected.load(std::memory_order_relaxed),
+      this->skipped.load(std::memory_order_relaxed),
+      this->raw_bytes.load(std::memory_order_relaxed),
+      this->compressed_bytes.load(std::memory_order_relaxed),
+      this->compress_ns.load(std::memory_order_relaxed),
+      this->decompressed.load(std::memory_order_relaxed),
+      this->decompress_ns.load(std::memory_order_relaxed),
+  };
+}
+
+std::string Compressor::report() const {
+  Stats s = this->stats();
+  uint64_t attempts = s.kept + s.rejected;
+  std::stringstream ss;
+  ss << "Compression: " << s.kept << " of " << s.offered
+     << " values kept compressed (" << s.rejected << " didn't compress well, "
+     << s.skipped << " skipped)\n";
+  ss << "  " << s.raw_bytes << " bytes stored in " << s.compressed_bytes
+     << " (" << s.raw_bytes - s.compressed_bytes << " bytes saved)\n";
+  ss << "  compress: " << (attempts ? s.compress_ns / attempts : 0)
+     << " ns/value, decompress: "
+     << (s.decompressed ? s.decompress_ns / s.decompressed : 0)
+     << " ns/value\n";
+  return ss.str();
+}
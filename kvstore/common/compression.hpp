@@ -0,0 +1,98 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * A small LZ77 codec, in the style of LZ4's block format.
+ *
+ * The input is split into sequences of literal bytes followed by a match: a
+ * copy of at least MIN_MATCH bytes from up to MAX_OFFSET bytes back. Matches
+ * are found through a hash table of the 4-byte strings seen so far, so
+ * compression is a single greedy pass, and decompression is a plain loop of
+ * copies. The output starts with the input's size, as a varint.
+ */
+std::string lz_compress(std::string_view data);
+// Returns std::nullopt if `data` isn't the output of lz_compress.
+std::optional<std::string> lz_decompress(std::string_view data);
+
+// Which values a Compressor compresses; see below.
+struct CompressionOptions {
+  bool enabled = true;
+  size_t min_size = 512;
+  double max_ratio = 0.875;
+};
+
+/**
+ * Decides which values are worth storing compressed, and keeps track of what
+ * that costs and saves. Safe to use from multiple threads.
+ *
+ * Values smaller than `min_size` are never compressed. Larger values are kept
+ * compressed only if that shrinks them to at most `max_ratio` of their size;
+ * otherwise, the time spent compressing them was wasted. To stop wasting it on
+ * data that doesn't compress, the compressor adapts its threshold per size
+ * class (powers of two): once BACKOFF_AFTER values in a row of some class
+ * fail to compress well, it only tries one in PROBE_INTERVAL values of that
+ * class, until one of them compresses well again.
+ */
+class Compressor {
+ public:
+  static constexpr uint32_t BACKOFF_AFTER = 8;
+  static constexpr uint32_t PROBE_INTERVAL = 32;
+
+  explicit Compressor(CompressionOptions options = {}) : options(options) {
+  }
+  Compressor(const Compressor&) = delete;
+  Compressor& operator=(const Compressor&) = delete;
+
+  // Returns `value`, compressed, if it's worth keeping that way.
+  std::optional<std::string> compress(std::string_view value);
+  // Decompresses a value returned by compress().
+  std::string decompress(std::string_view compressed);
+
+  struct Stats {
+    // Values offered to compress(), and how many of those were compressed
+    // (kept), compressed but not kept, or skipped without trying.
+    uint64_t offered;
+    uint64_t kept;
+    uint64_t rejected;
+    uint64_t skipped;
+    // Size of the kept values before and after compression.
+    uint64_t raw_bytes;
+    uint64_t compressed_bytes;
+    uint64_t compress_ns;
+    uint64_t decompressed;
+    uint64_t decompress_ns;
+  };
+  Stats stats() const;
+  // Human-readable summary of stats().
+  std::string report() const;
+
+ private:
+  static constexpr size_t N_SIZE_CLASSES = 64;
+
+  CompressionOptions options;
+
+  // Per size class: values in a row that didn't compress well, and values
+  // seen while backed off
+  std::array<std::atomic<uint32_t>, N_SIZE_CLASSES> misses{};
+  std::array<std::atomic<uint32_t>, N_SIZE_CLASSES> probes{};
+
+  std::atomic<uint64_t> offered{0};
+  std::atomic<uint64_t> kept{0};
+  std::atomic<uint64_t> rejected{0};
+  std::atomic<uint64_t> skipped{0};
+  std::atomic<uint64_t> raw_bytes{0};
+  std::atomic<uint64_t> compressed_bytes{0};
+  std::atomic<uint64_t> compress_ns{0};
+  std::atomic<uint64_t> decompressed{0};
+  std::atomic<uint64_t> decompress_ns{0};
+};
+
+#endif /* end of include guard */
@@ -0,0 +1,88 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+size_t Histogram::bucket_for(uint64_t value) {
+  if (value < SUB_BUCKET_COUNT) return value;
+  size_t shift = std::bit_width(value) - 1 - SUB_BUCKET_BITS;
+  size_t sub_bucket = (value >> shift) - SUB_BUCKET_COUNT;
+  return (shift + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t Histogram::highest_equivalent(size_t bucket) {
+  if (bucket < SUB_BUCKET_COUNT) return bucket;
+  size_t shift = bucket / SUB_BUCKET_COUNT - 1;
+  uint64_t lowest = (SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+  return lowest + ((uint64_t(1) << shift) - 1);
+}
+
+void Histogram::record(uint64_t value) {
+  // Single writer, so load + store is enough (and avoids a locked instruction)
+  auto bump = [](std::atomic<uint64_t>& counter, uint64_t by) {
+    counter.store(counter.load(std::memory_order_relaxed) + by,
+                  std::memory_order_relaxed);
+  };
+  bump(this->counts[bucket_for(value)], 1);
+  bump(this->total, 1);
+  bump(this->sum, value);
+  if (value > this->max_value.load(std::memory_order_relaxed)) {
+    this->max_value.store(value, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::merge(const Histogram& other) {
+  for (size_t i = 0; i < N_BUCKETS; i++) {
+    uint64_t n = other.counts[i].load(std::memory_order_relaxed);
+    if (n != 0) this->counts[i].fetch_add(n, std::memory_order_relaxed);
+  }
+  this->total.fetch_add(other.total.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+  this->sum.fetch_add(other.sum.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+  uint64_t other_max = other.max_value.load(std::memory_order_relaxed);
+  uint64_t curr_max = this->max_value.load(std::memory_order_relaxed);
+  while (other_max > curr_max &&
+         !this->max_value.compare_exchange_weak(curr_max, other_max)) {
+  }
+}
+
+void Histogram::reset() {
+  for (auto&& count : this->counts) count.store(0, std::memory_order_relaxed);
+  this->total.store(0, std::memory_order_relaxed);
+  this->sum.store(0, std::memory_order_relaxed);
+  this->max_value.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::count() const {
+  return this->total.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::max() const {
+  return this->max_value.load(std::memory_order_relaxed);
+}
+
+double Histogram::mean() const {
+  uint64_t n = this->count();
+  if (n == 0) return 0.0;
+  return static_cast<double>(this->sum.load(std::memory_order_relaxed)) / n;
+}
+
+uint64_t Histogram::percentile(double percentile) const {
+  // Sum the buckets rather than trusting `total`, which a concurrent writer
+  // may have bumped independently of the buckets we're about to read.
+  uint64_t n = 0;
+  for (auto&& count : this->counts) n += count.load(std::memory_order_relaxed);
+  if (n == 0) return 0;
+
+  auto rank = static_cast<uint64_t>(
+      std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * n));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < N_BUCKETS; i++) {
+    seen += this->counts[i].load(std::memory_order_relaxed);
+    if (seen >= rank) return std::min(highest_equivalent(i), this->max());
+  }
+  return this->max();
+}
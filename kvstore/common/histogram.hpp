@@ -0,0 +1,58 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Log-linear latency histogram, in the style of HdrHistogram.
+ *
+ * Values are bucketed by their most significant bit, and each power-of-two
+ * range is split into SUB_BUCKET_COUNT linear sub-buckets, so every recorded
+ * value is kept with a relative error below 1 / SUB_BUCKET_COUNT (~3%) over
+ * the whole uint64_t range, in a fixed amount of memory.
+ *
+ * A histogram must only be recorded into by one thread at a time: record()
+ * uses plain (relaxed) loads and stores rather than atomic read-modify-writes,
+ * so it costs the same as bumping a local counter. Other threads may read or
+ * merge() it concurrently, and see a slightly stale (but never torn) count.
+ */
+class Histogram {
+ public:
+  static constexpr size_t SUB_BUCKET_BITS = 5;
+  static constexpr size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+  // One group of sub-buckets per MSB position above SUB_BUCKET_BITS, plus the
+  // values below SUB_BUCKET_COUNT, which are stored exactly.
+  static constexpr size_t N_BUCKETS =
+      (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+  Histogram() = default;
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void record(uint64_t value);
+  // Adds all of `other`'s values to this histogram.
+  void merge(const Histogram& other);
+  void reset();
+
+  uint64_t count() const;
+  uint64_t max() const;
+  double mean() const;
+  // Smallest recorded value that is >= `percentile`% of recorded values (up to
+  // bucket precision); 0 if the histogram is empty.
+  uint64_t percentile(double percentile) const;
+
+  static size_t bucket_for(uint64_t value);
+  // Largest value that falls into `bucket`.
+  static uint64_t highest_equivalent(size_t bucket);
+
+ private:
+  std::array<std::atomic<uint64_t>, N_BUCKETS> counts{};
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> max_value{0};
+};
+
+#endif /* end of include guard */
@@ -0,0 +1,59 @@
+#include "key_generator.hpp"
+
+#include <cmath>
+
+#include "common/shard.hpp"
+
+namespace {
+
+double zeta(size_t n, double theta) {
+  double sum = 0;
+  for (size_t i = 1; i <= n; i++) sum += 1 / std::pow(i, theta);
+  return sum;
+}
+
+}  // namespace
+
+KeyGenerator::KeyGenerator(size_t n_keys, KeyDistribution distribution,
+                           double theta)
+    : n_keys(n_keys), distribution(distribution), theta(theta) {
+  if (distribution != KeyDistribution::ZIPF) return;
+
+  // theta = 1 makes alpha divide by zero; nudge it off
+  if (this->theta == 1.0) this->theta = 0.9999;
+  this->zeta_n = zeta(n_keys, this->theta);
+  this->alpha = 1 / (1 - this->theta);
+  this->eta = (1 - std::pow(2.0 / n_keys, 1 - this->theta)) /
+              (1 - zeta(2, this->theta) / this->zeta_n);
+}
+
+size_t KeyGenerator::next(std::mt19937_64& rng) const {
+  if (this->distribution == KeyDistribution::UNIFORM || this->n_keys < 2) {
+    return std::uniform_int_distribution<size_t>(0, this->n_keys - 1)(rng);
+  }
+
+  double u = std::uniform_real_distribution<double>(0, 1)(rng);
+  double uz = u * this->zeta_n;
+  if (uz < 1) return 0;
+  if (uz < 1 + std::pow(0.5, this->theta)) return 1;
+  auto index = static_cast<size_t>(
+      this->n_keys * std::pow(this->eta * u - this->eta + 1, this->alpha));
+  return std::min(index, this->n_keys - 1);
+}
+
+std::string KeyGenerator::key_for(size_t index) {
+  // FNV-1a, so consecutive indices map to unrelated names
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < sizeof(index); i++) {
+    hash ^= (index >> (8 * i)) & 0xff;
+    hash *= 1099511628211ULL;
+  }
+
+  // 12 characters is enough to keep 64-bit hashes (mostly) distinct
+  std::string key(12, VALID_CHARS[0]);
+  for (auto&& c : key) {
+    c = VALID_CHARS[hash % VALID_CHARS.size()];
+    hash /= VALID_CHARS.size();
+  }
+  return key;
+}
@@ -0,0 +1,49 @@
+#ifndef COMMON_KEY_GENERATOR_HPP
+#define COMMON_KEY_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+enum class KeyDistribution { UNIFORM, ZIPF };
+
+/**
+ * Picks keys out of a fixed keyspace of `n_keys` keys, either uniformly or
+ * following a Zipf distribution (where the i-th most popular key is picked with
+ * probability proportional to 1 / i^theta).
+ *
+ * Zipf sampling uses the constant-time method from Gray et al., "Quickly
+ * Generating Billion-Record Synthetic Databases" (as YCSB does), after an O(n)
+ * precomputation in the constructor.
+ */
+class KeyGenerator {
+ public:
+  KeyGenerator(size_t n_keys, KeyDistribution distribution,
+               double theta = 0.99);
+
+  // Index of the next key, in [0, n_keys). Under a Zipf distribution, index 0
+  // is the most popular key.
+  size_t next(std::mt19937_64& rng) const;
+
+  size_t size() const {
+    return this->n_keys;
+  }
+
+  // Name of the key at `index`. Names are spread evenly over the sharded
+  // keyspace (see VALID_CHARS in common/shard.hpp), so popular keys don't all
+  // land on the same server.
+  static std::string key_for(size_t index);
+
+ private:
+  size_t n_keys;
+  KeyDistribution distribution;
+
+  // Precomputed Zipf constants.
+  double theta;
+  double zeta_n = 0;
+  double alpha = 0;
+  double eta = 0;
+};
+
+#endif /* end of include guard */
@@ -0,0 +1,140 @@
+#include "trace.hpp"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+
+namespace {
+
+thread_local TraceContext thread_trace;
+
+// Small per-thread IDs for the trace viewer's rows.
+std::atomic<uint64_t> next_thread_id = 1;
+thread_local const uint64_t thread_id = next_thread_id++;
+
+std::mt19937_64& thread_rng() {
+  thread_local std::mt19937_64 rng(std::random_device{}());
+  return rng;
+}
+
+}  // namespace
+
+TraceContext current_trace() {
+  return thread_trace;
+}
+
+TraceContext sample_trace() {
+  if (thread_trace) return thread_trace;
+  return Tracer::global().sample();
+}
+
+uint64_t new_trace_id() {
+  uint64_t id;
+  do {
+    id = thread_rng()();
+  } while (id == 0);
+  return id;
+}
+
+Tracer& Tracer::global() {
+  // Never destroyed, since detached threads may still be recording when the
+  // process exits; spans are written out by an exit handler instead
+  static Tracer* tracer = [] {
+    auto* tracer = new Tracer();
+    std::atexit([] { Tracer::global().flush(); });
+    return tracer;
+  }();
+  return *tracer;
+}
+
+Tracer::Tracer()
+    : clock_offset(system_clock::now().time_since_epoch() -
+                   duration_cast<system_clock::duration>(
+                       steady_clock::now().time_since_epoch())) {
+  const char* rate = std::getenv("KVSTORE_TRACE_RATE");
+  const char* path = std::getenv("KVSTORE_TRACE_FILE");
+  this->configure(rate ? std::atof(rate) : 0,
+                  path ? path
+                       : "kvstore-trace-" + std::to_string(getpid()) +
+                             ".json");
+}
+
+void Tracer::configure(double sample_rate, std::string path) {
+  std::unique_lock lock(this->mtx);
+  this->sample_rate = sample_rate;
+  this->path = std::move(path);
+}
+
+TraceContext Tracer::sample() {
+  double rate = this->sample_rate.load(std::memory_order_relaxed);
+  if (rate <= 0) return {};
+  if (rate < 1 &&
+      std::uniform_real_distribution<double>(0, 1)(thread_rng()) >= rate) {
+    return {};
+  }
+  return TraceContext{new_trace_id(), 0};
+}
+
+void Tracer::record(const char* name, TraceContext parent,
+                    steady_clock::time_point start,
+                    steady_clock::time_point end, uint64_t span_id) {
+  if (!parent) return;
+  if (span_id == 0) span_id = new_trace_id();
+  std::unique_lock lock(this->mtx);
+  if (this->spans.size() >= MAX_SPANS) return;
+  this->spans.push_back(SpanRecord{name, parent.trace_id, span_id,
+                                   parent.span_id, start, end, thread_id});
+}
+
+bool Tracer::flush() {
+  std::unique_lock lock(this->mtx);
+  if (this->spans.empty()) return true;
+  std::ofstream file(this->path, std::ios::trunc);
+  if (!file) return false;
+
+  auto micros = [this](steady_clock::time_point time) {
+    auto wall = time.time_since_epoch() + this->clock_offset;
+    return duration<double, std::micro>(wall).count();
+  };
+  auto hex = [](uint64_t id) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(id));
+    return std::string(buf);
+  };
+  file << std::fixed;
+  file.precision(3);
+  file << "{\"traceEvents\":[\n";
+  for (size_t i = 0; i < this->spans.size(); i++) {
+    const SpanRecord& span = this->spans[i];
+    file << "{\"name\":\"" << span.name << "\",\"cat\":\"kvstore\","
+         << "\"ph\":\"X\",\"pid\":" << getpid() << ",\"tid\":"
+         << span.thread_id << ",\"ts\":" << micros(span.start)
+         << ",\"dur\":" << micros(span.end) - micros(span.start)
+         << ",\"args\":{\"trace_id\":\"" << hex(span.trace_id)
+         << "\",\"span_id\":\"" << hex(span.span_id) << "\",\"parent_id\":\""
+         << hex(span.parent_id) << "\"}}"
+         << (i + 1 < this->spans.size() ? ",\n" : "\n");
+  }
+  file << "],\"displayTimeUnit\":\"ms\"}\n";
+  return bool(file);
+}
+
+Span::Span(const char* name, TraceContext parent)
+    : name(name), parent(parent) {
+  if (!parent) return;
+  this->ctx = TraceContext{parent.trace_id, new_trace_id()};
+  this->outer = thread_trace;
+  thread_trace = this->ctx;
+  this->start = steady_clock::now();
+}
+
+void Span::end() {
+  if (!this->ctx) return;
+  Tracer::global().record(this->name, this->parent, this->start,
+                          steady_clock::now(), this->ctx.span_id);
+  thread_trace = this->outer;
+  this->ctx = {};
+}
@@ -0,0 +1,127 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+// Identifies a sampled request's trace, and the span messages sent on its
+// behalf are sent from (the parent of the spans their receivers record).
+struct TraceContext {
+  // 0 if the request isn't sampled
+  uint64_t trace_id = 0;
+  uint64_t span_id = 0;
+
+  explicit operator bool() const {
+    return this->trace_id != 0;
+  }
+};
+
+/**
+ * Sampled, end-to-end tracing of requests, across the client, the
+ * shardcontroller and servers.
+ *
+ * Clients sample a fraction of their requests. A sampled request's context
+ * goes along with every message sent on its behalf (see Message::trace), so
+ * each process it passes through records spans (named, timed stages) of the
+ * same trace. Spans are kept in memory, and written out by flush() (and when
+ * the process exits) as a Chrome trace: a JSON file to open in
+ * chrome://tracing or ui.perfetto.dev. Timestamps are wall-clock, so the
+ * files of processes on one host line up when opened together.
+ *
+ * Tracing is configured with the KVSTORE_TRACE_RATE environment variable
+ * (the fraction of requests to sample; 0, the default, turns it off) and
+ * KVSTORE_TRACE_FILE (where to write spans; kvstore-trace-<pid>.json by
+ * default), or with configure(). Unsampled requests carry no context, and
+ * their spans cost a branch each.
+ */
+class Tracer {
+ public:
+  // Most spans kept; later ones are dropped.
+  static constexpr size_t MAX_SPANS = 1'000'000;
+
+  static Tracer& global();
+
+  Tracer();
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  void configure(double sample_rate, std::string path);
+
+  // A new trace, with probability `sample_rate`; otherwise an empty context.
+  TraceContext sample();
+
+  // Records a span of `parent`'s trace, if it's sampled, that has already
+  // ended.
+  void record(const char* name, TraceContext parent,
+              steady_clock::time_point start, steady_clock::time_point end,
+              uint64_t span_id = 0);
+
+  // Writes every span recorded so far (if any) to the trace file, returning
+  // false if it can't be written.
+  bool flush();
+
+ private:
+  struct SpanRecord {
+    const char* name;
+    uint64_t trace_id;
+    uint64_t span_id;
+    uint64_t parent_id;
+    steady_clock::time_point start;
+    steady_clock::time_point end;
+    uint64_t thread_id;
+  };
+
+  std::atomic<double> sample_rate = 0;
+  // Added to steady_clock times to give wall-clock ones.
+  const system_clock::duration clock_offset;
+
+  std::mutex mtx;
+  std::string path;
+  std::vector<SpanRecord> spans;
+};
+
+// The context of the trace the calling thread is working on, if any.
+TraceContext current_trace();
+// The calling thread's trace, or else a new one if this request is sampled:
+// the context of a request's outermost span.
+TraceContext sample_trace();
+// A random, non-zero ID for a trace or span.
+uint64_t new_trace_id();
+
+/*
+ * A stage of a traced request, recorded from when it's constructed until
+ * end() (or its destruction). While it lasts, it's the calling thread's
+ * current trace, so spans started (and messages sent) meanwhile are its
+ * children. Does nothing if `parent` isn't sampled.
+ */
+class Span {
+ public:
+  explicit Span(const char* name, TraceContext parent = current_trace());
+  ~Span() {
+    this->end();
+  }
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+  void end();
+
+  TraceContext context() const {
+    return this->ctx;
+  }
+
+ private:
+  const char* name;
+  TraceContext parent;
+  TraceContext ctx;
+  // The thread's trace before this span started, restored by end().
+  TraceContext outer;
+  steady_clock::time_point start;
+};
+
+#endif /* end of include guard */
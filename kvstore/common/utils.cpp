@@ -1,5 +1,7 @@
 #include "common/utils.hpp"
 
+#include <charconv>
+
 std::vector<std::string> split(const std::string& s, char delim) {
   std::vector<std::string> res;
 
@@ -19,6 +21,13 @@ bool is_number(const std::string& s) {
                                        });
 }
 
+std::optional<int64_t> parse_int64(const std::string& s) {
+  int64_t res;
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), res);
+  if (ec != std::errc() || end != s.data() + s.size()) return std::nullopt;
+  return res;
+}
+
 std::string to_upper(const std::string& s) {
   std::string res = s;
   std::transform(res.begin(), res.end(), res.begin(),
@@ -32,3 +41,20 @@ std::string to_lower(const std::string& s) {
                  [](unsigned char c) { return std::tolower(c); });
   return res;
 }
+
+std::string join_cursor(const std::string& head, const std::string& tail) {
+  return std::to_string(head.size()) + ":" + head + tail;
+}
+
+bool split_cursor(const std::string& cursor, std::string* head,
+                  std::string* tail) {
+  size_t colon = cursor.find(':');
+  if (colon == std::string::npos) return false;
+  std::optional<int64_t> len = parse_int64(cursor.substr(0, colon));
+  if (!len || *len < 0 || size_t(*len) > cursor.size() - colon - 1) {
+    return false;
+  }
+  *head = cursor.substr(colon + 1, *len);
+  *tail = cursor.substr(colon + 1 + *len);
+  return true;
+}
@@ -3,7 +3,9 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <numeric>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -16,10 +18,21 @@ std::vector<std::string> split(const std::string& s, char delim = ' ');
 // Checks if a string is a (positive) number
 bool is_number(const std::string& s);
 
+// Parses a (possibly negative) base-10 64-bit integer, returning std::nullopt
+// if the entire string isn't one (or if it's out of range).
+std::optional<int64_t> parse_int64(const std::string& s);
+
 // Convert a string to upper/lower case, because cpp doesn't have that
 // functionality yet... this is pretty fragile, it only works on ASCII
 // characters right now (sorry Unicode!)
 std::string to_upper(const std::string& s);
 std::string to_lower(const std::string& s);
 
+// Scan cursors made of two parts (say, a shard and a position within it) are
+// joined as "<length of head>:<head><tail>", which splits back unambiguously.
+std::string join_cursor(const std::string& head, const std::string& tail);
+// Returns false if `cursor` wasn't made by join_cursor.
+bool split_cursor(const std::string& cursor, std::string* head,
+                  std::string* tail);
+
 #endif /* end of include guard */
\ No newline at end of file
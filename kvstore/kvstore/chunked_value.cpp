@@ -0,0 +1,58 @@
+#include "chunked_value.hpp"
+
+#include <algorithm>
+
+void ChunkedValue::append(std::string_view data) {
+  // Top up a partial last chunk, so that small appends don't leave behind a
+  // trail of tiny chunks. Chunks are shared, so this replaces it with a copy.
+  if (!this->chunks.empty() && !data.empty()) {
+    const std::string& last = *this->chunks.back();
+    size_t n = std::min(data.size(), VALUE_CHUNK_SIZE - last.size());
+    if (n > 0) {
+      auto topped_up = std::make_shared<std::string>();
+      topped_up->reserve(last.size() + n);
+      topped_up->append(last).append(data.substr(0, n));
+      this->chunks.back() = std::move(topped_up);
+      this->total_size += n;
+      data.remove_prefix(n);
+    }
+  }
+
+  while (!data.empty()) {
+    size_t n = std::min(data.size(), VALUE_CHUNK_SIZE);
+    this->push_chunk(std::make_shared<const std::string>(data.substr(0, n)));
+    data.remove_prefix(n);
+  }
+}
+
+void ChunkedValue::append(const ChunkedValue& other) {
+  for (auto&& chunk : other.chunks) this->push_chunk(chunk);
+}
+
+std::string ChunkedValue::read(size_t offset, size_t len) const {
+  if (offset >= this->total_size) return "";
+  len = std::min(len, this->total_size - offset);
+
+  std::string out;
+  out.reserve(len);
+  // The chunk containing `offset` is the last one starting at or before it
+  auto it =
+      std::upper_bound(this->offsets.begin(), this->offsets.end(), offset);
+  for (size_t i = it - this->offsets.begin() - 1; out.size() < len; i++) {
+    const std::string& chunk = *this->chunks[i];
+    size_t start = offset + out.size() - this->offsets[i];
+    out.append(chunk, start, len - out.size());
+  }
+  return out;
+}
+
+std::string ChunkedValue::to_string() const {
+  return this->read(0, this->total_size);
+}
+
+void ChunkedValue::push_chunk(std::shared_ptr<const std::string> chunk) {
+  if (chunk->empty()) return;
+  this->offsets.push_back(this->total_size);
+  this->total_size += chunk->size();
+  this->chunks.push_back(std::move(chunk));
+}
@@ -0,0 +1,49 @@
+#ifndef CHUNKED_VALUE_HPP
+#define CHUNKED_VALUE_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net/server_commands.hpp"
+
+/**
+ * A value held as a list of chunks of at most VALUE_CHUNK_SIZE bytes, so that
+ * large values never need one contiguous allocation.
+ *
+ * Chunks are immutable and shared, so copying a ChunkedValue (or appending one
+ * to another) copies pointers, not bytes.
+ */
+class ChunkedValue {
+ public:
+  ChunkedValue() = default;
+  explicit ChunkedValue(std::string_view value) {
+    this->append(value);
+  }
+
+  // Total size of the value, in bytes.
+  size_t size() const {
+    return this->total_size;
+  }
+
+  // Appends `data` to the value, topping up the last chunk first.
+  void append(std::string_view data);
+  // Appends every chunk of `other` to the value.
+  void append(const ChunkedValue& other);
+
+  // Copies out up to `len` bytes, starting at `offset`.
+  std::string read(size_t offset, size_t len) const;
+  // Copies out the whole value.
+  std::string to_string() const;
+
+ private:
+  std::vector<std::shared_ptr<const std::string>> chunks;
+  // Offset of the start of each chunk within the value
+  std::vector<size_t> offsets;
+  size_t total_size = 0;
+
+  void push_chunk(std::shared_ptr<const std::string> chunk);
+};
+
+#endif /* end of include guard */
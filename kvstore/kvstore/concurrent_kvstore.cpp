@@ -11,6 +11,8 @@ bool ConcurrentKvStore::Get(const GetRequest* req, GetResponse* res) {
 
 bool ConcurrentKvStore::Put(const PutRequest* req, PutResponse*) {
   // TODO (Part A, Step 3 and Step 4): Implement!
+  // Pass DbItem::expiry_from_ttl(req->ttl_ms) to insertItem, so that a Put
+  // sets (or clears) the key's TTL.
 
   return true;
 }
@@ -37,12 +39,62 @@ bool ConcurrentKvStore::MultiGet(const MultiGetRequest* req,
 bool ConcurrentKvStore::MultiPut(const MultiPutRequest* req,
                                  MultiPutResponse*) {
   // TODO (Part A, Step 3 and Step 4): Implement!
+  // As with Put, every key gets DbItem::expiry_from_ttl(req->ttl_ms).
+
+  return true;
+}
+
+bool ConcurrentKvStore::CAS(const CasRequest* req, CasResponse* res) {
+  // TODO (Part A, Step 3 and Step 4): Implement!
+  // The compare and the swap must happen under the same (write) lock of the
+  // key's bucket, or another writer could sneak in between them.
+
+  return true;
+}
+
+bool ConcurrentKvStore::Incr(const IncrRequest* req, IncrResponse* res) {
+  // TODO (Part A, Step 3 and Step 4): Implement!
+  // Like CAS, the read, the addition and the write must be atomic. A
+  // nonexistent key counts as 0; fail if the value isn't an integer (see
+  // parse_int64 in common/utils.hpp).
 
   return true;
 }
 
 std::vector<std::string> ConcurrentKvStore::AllKeys() {
   // TODO (Part A, Step 3 and Step 4): Implement!
+  // DbMap::appendKeys skips items that have expired but haven't been reaped.
 
   return {};
 }
+
+bool ConcurrentKvStore::Scan(const ScanRequest* req, ScanResponse* res) {
+  // TODO (Part A, Step 3 and Step 4): Implement!
+  // Lock one bucket at a time, for reading, and page through it in key order
+  // with DbMap::scanBucket, moving on to the next bucket until the page is
+  // full. The cursor says which bucket to resume in, and after which key (see
+  // join_cursor in common/utils.hpp); leave it empty after the last bucket.
+
+  return true;
+}
+
+std::string ConcurrentKvStore::MemoryReport() {
+  return this->store.allocator.report() + this->store.compressor.report();
+}
+
+void ConcurrentKvStore::Reap(const std::string& key) {
+  // TODO (Part A, Step 4): Implement! Lock key's bucket for writing, then call
+  // DbMap::removeIfExpired. The key may have been re-Put with a new TTL (or
+  // none) since it was scheduled, so don't remove it unconditionally.
+}
+
+void ConcurrentKvStore::reap_loop() {
+  while (!this->is_stopped) {
+    std::this_thread::sleep_for(TimerWheel::TICK);
+    auto expired =
+        this->store.expirations.advance(TimerWheel::clock::now(), REAP_BATCH);
+    for (auto&& key : expired) {
+      this->Reap(key);
+    }
+  }
+}
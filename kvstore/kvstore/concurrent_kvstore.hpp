@@ -1,97 +1,376 @@
 #ifndef CONCURRENT_KVSTORE_HPP
 #define CONCURRENT_KVSTORE_HPP
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstring>
 #include <functional>
-#include <list>
 #include <map>
+#include <mutex>
 #include <optional>
 #include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 
+#include "common/compression.hpp"
 #include "common/utils.hpp"
 #include "kvstore.hpp"
 #include "net/server_commands.hpp"
+#include "slab_allocator.hpp"
+#include "timer_wheel.hpp"
 
 /**
  * Struct encapsulating a database item. This is optional, but you may find this
- * helpful in your DbMap implementation.
+ * helpful in your DbMap implementation. DbMap stores items as SlabItems, and
+ * hands out copies of them as DbItems.
  */
 struct DbItem {
+  using clock = TimerWheel::clock;
+
   std::string key;
   std::string value;
+  // When the item expires; clock::time_point::max() if it never does.
+  clock::time_point expiry = clock::time_point::max();
 
-  DbItem(std::string& k, std::string& v) {
+  DbItem(std::string& k, std::string& v,
+         clock::time_point e = clock::time_point::max()) {
     this->key = k;
     this->value = v;
+    this->expiry = e;
   }
 
   bool operator==(const DbItem& item) {
     return (this->key == item.key && this->value == item.value);
   }
+
+  // Whether the item's TTL has elapsed. Only reads the clock for items that
+  // actually have a TTL.
+  bool is_expired() const {
+    return this->expiry != clock::time_point::max() &&
+           clock::now() >= this->expiry;
+  }
+
+  // Converts a request's ttl_ms into an expiry (0 means never expire).
+  static clock::time_point expiry_from_ttl(uint64_t ttl_ms) {
+    if (ttl_ms == 0) return clock::time_point::max();
+    return clock::now() + std::chrono::milliseconds(ttl_ms);
+  }
+
+  // Converts an expiry back into the ttl_ms left until it (0 if it never
+  // expires, and at least 1 otherwise).
+  static uint64_t ttl_from_expiry(clock::time_point expiry) {
+    if (expiry == clock::time_point::max()) return 0;
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(expiry -
+                                                             clock::now());
+    return std::max<int64_t>(left.count(), 1);
+  }
+};
+
+/**
+ * Header of an item as DbMap stores it: the key's bytes, then the value's, are
+ * laid out right after the header, so each item takes a single (slab)
+ * allocation. Items in the same bucket are chained through `next`.
+ *
+ * If `compressed` is set, the value's bytes are its Compressor::compress()ed
+ * form, and `value_len` is their (compressed) length.
+ */
+struct SlabItem {
+  SlabItem* next;
+  DbItem::clock::time_point expiry;
+  uint32_t key_len;
+  uint32_t value_len : 31;
+  uint32_t compressed : 1;
+
+  // Number of bytes needed to store an item with the given key/value sizes.
+  static size_t size_for(size_t key_len, size_t value_len) {
+    return sizeof(SlabItem) + key_len + value_len;
+  }
+  size_t size() const {
+    return size_for(this->key_len, this->value_len);
+  }
+
+  char* data() {
+    return reinterpret_cast<char*>(this + 1);
+  }
+  const char* data() const {
+    return reinterpret_cast<const char*>(this + 1);
+  }
+  std::string_view key() const {
+    return std::string_view(this->data(), this->key_len);
+  }
+  std::string_view value() const {
+    return std::string_view(this->data() + this->key_len, this->value_len);
+  }
+
+  bool is_expired() const {
+    return this->expiry != DbItem::clock::time_point::max() &&
+           DbItem::clock::now() >= this->expiry;
+  }
+};
+
+/**
+ * DbMap's default hasher. It hashes std::string and std::string_view keys
+ * alike, so that looking a key up never needs a std::string, and gives the
+ * same hashes as std::hash<std::string>.
+ */
+struct KeyHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view key) const noexcept {
+    return std::hash<std::string_view>()(key);
+  }
 };
 
 /**
  * Implement your bucket-based map here!
+ *
+ * Keys are passed as std::string_views, so requests' keys are never copied
+ * just to look them up. Hash each request's key once, with bucket(), and pass
+ * the bucket along to every call for that key.
  */
+template <typename Hasher = KeyHash>
 class DbMap {
  public:
-  DbMap(std::function<size_t(std::string)> hasher) : hasher(hasher) {
+  explicit DbMap(Hasher hasher = Hasher(), CompressionOptions compression = {})
+      : compressor(compression), hasher(std::move(hasher)) {
   }
+  ~DbMap() {
+    for (SlabItem* head : this->buckets) {
+      while (head) {
+        SlabItem* next = head->next;
+        this->allocator.deallocate(head, head->size());
+        head = next;
+      }
+    }
+  }
+  DbMap(const DbMap&) = delete;
+  DbMap& operator=(const DbMap&) = delete;
 
   static constexpr size_t BUCKET_COUNT = 60;
 
   // Bucket associative array, with corresponding mutexes to protect access.
-  std::array<std::list<DbItem>, BUCKET_COUNT> buckets;
+  // Each bucket is an intrusive list of slab-allocated items.
+  std::array<SlabItem*, BUCKET_COUNT> buckets{};
 
   // TODO (Part A, Step 4): You will need to add fields to synchronize access to
   // the hashmap buckets!
 
   // Return the index of the bucket to search for `key`.
-  size_t bucket(std::string key) const {
-    return hasher(key) % BUCKET_COUNT;
+  size_t bucket(std::string_view key) const {
+    // Hashers that only take a std::string (which std::hash<std::string> and
+    // std::function<size_t(std::string)> do) cost a copy of the key
+    if constexpr (std::is_invocable_v<const Hasher&, std::string_view>) {
+      return this->hasher(key) % BUCKET_COUNT;
+    } else {
+      return this->hasher(std::string(key)) % BUCKET_COUNT;
+    }
   }
 
+  // Timers for items with a TTL, drained by ConcurrentKvStore's reaper.
+  TimerWheel expirations;
+  // Called once, when the first item is given a TTL (ConcurrentKvStore starts
+  // its reaper then, so stores without TTLs don't run one).
+  std::function<void()> on_first_ttl;
+  std::once_flag first_ttl;
+
+  // Storage for the items themselves.
+  SlabAllocator allocator;
+
+  // Values worth compressing are stored compressed, and decompressed whenever
+  // they're read, so callers only ever see the original values.
+  Compressor compressor;
+
   // Returns the DbItem with key 'key' in bucket `b` if it exists, std::nullopt
-  // otherwise Assumes that `b` == this->bucket(key).
-  std::optional<DbItem> getIfExists(size_t b, std::string key) {
+  // otherwise Assumes that `b` == this->bucket(key). Expired items are treated
+  // as nonexistent.
+  std::optional<DbItem> getIfExists(size_t b, std::string_view key) {
     assert(b < BUCKET_COUNT);
-    for (const auto& item : this->buckets[b]) {
-      if (item.key == key) {
-        return item;
-      }
+    SlabItem* item = *this->find(b, key);
+    if (!item || item->is_expired()) return std::nullopt;
+
+    std::string key_copy(key);
+    std::string value = item->compressed
+                            ? this->compressor.decompress(item->value())
+                            : std::string(item->value());
+    return DbItem(key_copy, value, item->expiry);
+  }
+
+  // Like getIfExists, but only copies out the value, into `*value` (reusing
+  // its capacity), and returns whether the item exists. Allocates nothing once
+  // `*value` is large enough, unless the value is stored compressed.
+  bool readValue(size_t b, std::string_view key, std::string* value) {
+    assert(b < BUCKET_COUNT);
+    SlabItem* item = *this->find(b, key);
+    if (!item || item->is_expired()) return false;
+
+    if (item->compressed) {
+      *value = this->compressor.decompress(item->value());
+    } else {
+      value->assign(item->value());
     }
-    return std::nullopt;
+    return true;
   }
 
   // Insert a new DbItem with key 'key' and value 'value' to bucket `b`.
-  // If key already exists, updates value to `value`.
+  // If key already exists, updates value to `value`. If `expiry` is given, it
+  // replaces the item's expiry (pass DbItem::expiry_from_ttl(0) to clear a
+  // TTL); otherwise an existing, unexpired item keeps its TTL.
   // Assumes that `b` == this->bucket(key).
-  void insertItem(size_t b, std::string key, std::string value) {
+  void insertItem(size_t b, std::string_view key, std::string_view value,
+                  std::optional<DbItem::clock::time_point> expiry =
+                      std::nullopt) {
     assert(b < BUCKET_COUNT);
 
-    for (auto& item : this->buckets[b]) {
-      if (item.key == key) {
-        item.value = value;
-        return;
+    if (expiry && *expiry != DbItem::clock::time_point::max()) {
+      std::call_once(this->first_ttl, [this] {
+        if (this->on_first_ttl) this->on_first_ttl();
+      });
+      this->expirations.schedule(std::string(key), *expiry);
+    }
+
+    std::optional<std::string> compressed = this->compressor.compress(value);
+    std::string_view stored = compressed ? *compressed : value;
+
+    SlabItem** link = this->find(b, key);
+    SlabItem* item = *link;
+    size_t new_size = SlabItem::size_for(key.size(), stored.size());
+    if (!item) {
+      // New key: allocate it and push it onto the front of the bucket
+      item = static_cast<SlabItem*>(this->allocator.allocate(new_size));
+      item->next = this->buckets[b];
+      item->expiry = expiry.value_or(DbItem::clock::time_point::max());
+      item->key_len = key.size();
+      std::memcpy(item->data(), key.data(), key.size());
+      this->buckets[b] = item;
+    } else {
+      if (item->is_expired()) {
+        item->expiry = DbItem::clock::time_point::max();
+      }
+      if (expiry) item->expiry = *expiry;
+
+      // Existing key: overwrite in place if the new value fits in the item's
+      // chunk; otherwise, move the item to a chunk of the right size.
+      if (!this->allocator.resize_in_place(item->size(), new_size)) {
+        auto* moved =
+            static_cast<SlabItem*>(this->allocator.allocate(new_size));
+        std::memcpy(moved, item, sizeof(SlabItem) + item->key_len);
+        *link = moved;
+        this->allocator.deallocate(item, item->size());
+        item = moved;
       }
     }
-    this->buckets[b].emplace_back(key, value);
+    item->value_len = stored.size();
+    item->compressed = compressed.has_value();
+    std::memcpy(item->data() + item->key_len, stored.data(), stored.size());
   }
 
-  // Remove a DbItem with key `key` from bucket `b`.
+  // Remove a DbItem with key `key` from bucket `b`. Returns false if no such
+  // item exists, or if it had already expired.
   // Assumes that `b` == this->getBucketIndex(key).
-  bool removeItem(size_t b, std::string key) {
+  bool removeItem(size_t b, std::string_view key) {
+    assert(b < BUCKET_COUNT);
+
+    SlabItem** link = this->find(b, key);
+    SlabItem* item = *link;
+    if (!item) return false;
+
+    bool removed_live = !item->is_expired();
+    *link = item->next;
+    this->allocator.deallocate(item, item->size());
+    return removed_live;
+  }
+
+  // Remove the DbItem with key `key` from bucket `b`, but only if its TTL has
+  // elapsed. Returns true if an item was removed.
+  // Assumes that `b` == this->bucket(key).
+  bool removeIfExpired(size_t b, std::string_view key) {
+    assert(b < BUCKET_COUNT);
+
+    SlabItem** link = this->find(b, key);
+    SlabItem* item = *link;
+    if (!item || !item->is_expired()) return false;
+
+    *link = item->next;
+    this->allocator.deallocate(item, item->size());
+    return true;
+  }
+
+  // Appends the (up to) `count` smallest keys in bucket `b` greater than
+  // `after` (or from the bucket's smallest, if std::nullopt), their values,
+  // and their remaining TTLs (see ScanResponse::ttl_ms), to `keys`, `values`,
+  // and `ttl_ms`, in ascending order. Returns whether the bucket has more keys
+  // after those. Expired items are skipped.
+  // Paging through a bucket by key, rather than by position in its chain,
+  // means a page picks up in the right place however the bucket changed
+  // since the last one.
+  bool scanBucket(size_t b, std::optional<std::string_view> after,
+                  size_t count, std::vector<std::string>& keys,
+                  std::vector<std::string>& values,
+                  std::vector<uint64_t>& ttl_ms) {
     assert(b < BUCKET_COUNT);
+    std::vector<SlabItem*> items;
+    for (SlabItem* item = this->buckets[b]; item; item = item->next) {
+      if (!item->is_expired() && (!after || item->key() > *after)) {
+        items.push_back(item);
+      }
+    }
 
-    size_t num_removed = this->buckets[b].remove_if(
-        [&](auto&& item) { return item.key == key; });
-    return num_removed > 0;
+    auto by_key = [](SlabItem* x, SlabItem* y) { return x->key() < y->key(); };
+    bool more = items.size() > count;
+    if (more) {
+      std::nth_element(items.begin(), items.begin() + count, items.end(),
+                       by_key);
+      items.resize(count);
+    }
+    std::sort(items.begin(), items.end(), by_key);
+    for (SlabItem* item : items) {
+      keys.emplace_back(item->key());
+      values.push_back(item->compressed
+                           ? this->compressor.decompress(item->value())
+                           : std::string(item->value()));
+      ttl_ms.push_back(DbItem::ttl_from_expiry(item->expiry));
+    }
+    return more;
+  }
+
+  // Appends the keys of every unexpired item in bucket `b` to `keys`.
+  void appendKeys(size_t b, std::vector<std::string>& keys) const {
+    assert(b < BUCKET_COUNT);
+    for (SlabItem* item = this->buckets[b]; item; item = item->next) {
+      if (!item->is_expired()) keys.emplace_back(item->key());
+    }
   }
 
  private:
-  std::function<size_t(std::string)> hasher;
+  Hasher hasher;
+
+  // Returns the link (either the bucket head, or the previous item's `next`)
+  // that points to the item with key `key` in bucket `b`. If there is no such
+  // item, the returned link points to nullptr.
+  SlabItem** find(size_t b, std::string_view key) {
+    SlabItem** link = &this->buckets[b];
+    while (*link && (*link)->key() != key) {
+      link = &(*link)->next;
+    }
+    return link;
+  }
+};
+
+/**
+ * ConcurrentKvStore's hasher: KeyHash, unless the store was given a custom
+ * hasher (as some performance tests do, to choose which keys share a bucket).
+ * Only custom hashers copy the key.
+ */
+struct StoreHash {
+  std::function<size_t(const std::string&)> custom;
+
+  size_t operator()(std::string_view key) const {
+    return this->custom ? this->custom(std::string(key)) : KeyHash()(key);
+  }
 };
 
 class ConcurrentKvStore : public KvStore {
@@ -100,10 +379,20 @@ class ConcurrentKvStore : public KvStore {
   // See the performance test comments if you're interested in how it works,
   // otherwise, feel free to ignore!
   ConcurrentKvStore(
-      std::function<size_t(std::string)> hasher = std::hash<std::string>())
-      : store(hasher) {
+      std::function<size_t(const std::string&)> hasher = nullptr)
+      : store(StoreHash{std::move(hasher)}), is_stopped(false) {
+    this->store.on_first_ttl = [this] {
+      this->reaper = std::thread(&ConcurrentKvStore::reap_loop, this);
+    };
   }
-  ~ConcurrentKvStore() = default;
+  ~ConcurrentKvStore() {
+    this->is_stopped = true;
+    if (this->reaper.joinable()) this->reaper.join();
+  }
+
+  // Maximum number of expired keys the reaper removes per tick, so that it
+  // never holds up workers for long.
+  static constexpr size_t REAP_BATCH = 64;
 
   bool Get(const GetRequest* req, GetResponse* res) override;
   bool Put(const PutRequest* req, PutResponse* res) override;
@@ -111,12 +400,30 @@ class ConcurrentKvStore : public KvStore {
   bool Delete(const DeleteRequest* req, DeleteResponse* res) override;
   bool MultiGet(const MultiGetRequest* req, MultiGetResponse* res) override;
   bool MultiPut(const MultiPutRequest* req, MultiPutResponse* res) override;
+  bool CAS(const CasRequest* req, CasResponse* res) override;
+  bool Incr(const IncrRequest* req, IncrResponse* res) override;
 
   std::vector<std::string> AllKeys() override;
+  bool Scan(const ScanRequest* req, ScanResponse* res) override;
+
+  // Fragmentation report for the store's slab allocator, and how much memory
+  // value compression saved.
+  std::string MemoryReport();
 
  private:
   // Your internal key-value store implementation!
-  DbMap store;
+  DbMap<StoreHash> store;
+
+  // Background thread that removes expired keys, and its stop flag. It's only
+  // started once a key is given a TTL.
+  std::atomic<bool> is_stopped;
+  std::thread reaper;
+
+  // Every TimerWheel::TICK, remove up to REAP_BATCH expired keys.
+  void reap_loop();
+
+  // Removes `key` from the store if (and only if) its TTL has elapsed.
+  void Reap(const std::string& key);
 };
 
 #endif /* end of include guard */
\ No newline at end of file
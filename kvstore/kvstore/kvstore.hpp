@@ -17,8 +17,16 @@ class KvStore {
   virtual bool Delete(const DeleteRequest* req, DeleteResponse* res) = 0;
   virtual bool MultiGet(const MultiGetRequest* req, MultiGetResponse* res) = 0;
   virtual bool MultiPut(const MultiPutRequest* req, MultiPutResponse*) = 0;
+  virtual bool CAS(const CasRequest* req, CasResponse* res) = 0;
+  virtual bool Incr(const IncrRequest* req, IncrResponse* res) = 0;
 
   virtual std::vector<std::string> AllKeys() = 0;
+
+  // Returns a page of (at most req->count, which must be positive) keys, their
+  // values, and their remaining TTLs, picking up where req->cursor left off;
+  // see ScanRequest.
+  // Unlike AllKeys, never holds on to more than a page of keys at once.
+  virtual bool Scan(const ScanRequest* req, ScanResponse* res) = 0;
 };
 
 #endif /* end of include guard */
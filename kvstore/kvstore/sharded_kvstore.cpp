@@ -0,0 +1,552 @@
+#include "sharded_kvstore.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <sstream>
+
+#include "common/utils.hpp"
+#include "concurrent_kvstore.hpp"
+
+bool ShardedKvStore::Get(const GetRequest* req, GetResponse* res) {
+  std::shared_lock lock(this->mtx);
+  SubStore* sub = this->route(req->key);
+  return sub && this->get_value(*sub, req->key, &res->value);
+}
+
+bool ShardedKvStore::Put(const PutRequest* req, PutResponse* res) {
+  {
+    std::shared_lock lock(this->mtx);
+    SubStore* sub = this->route(req->key);
+    if (!sub) return false;
+    if (req->value.size() <= VALUE_CHUNK_SIZE && !sub->large.count(req->key)) {
+      return sub->store->Put(req, res);
+    }
+  }
+
+  // Large values (and keys that had one) are written under an exclusive lock
+  std::unique_lock lock(this->mtx);
+  SubStore* sub = this->route(req->key);
+  return sub && this->put_value(*sub, *req);
+}
+
+bool ShardedKvStore::Append(const AppendRequest* req, AppendResponse* res) {
+  {
+    std::shared_lock lock(this->mtx);
+    SubStore* sub = this->route(req->key);
+    if (!sub) return false;
+    if (!sub->large.count(req->key)) return sub->store->Append(req, res);
+  }
+
+  std::unique_lock lock(this->mtx);
+  SubStore* sub = this->route(req->key);
+  if (!sub) return false;
+  if (LargeValue* large = this->find_large(*sub, req->key)) {
+    large->value.append(req->value);
+    large->version = this->next_version++;
+    return true;
+  }
+  this->erase_large(*sub, req->key);
+  return sub->store->Append(req, res);
+}
+
+bool ShardedKvStore::Delete(const DeleteRequest* req, DeleteResponse* res) {
+  {
+    std::shared_lock lock(this->mtx);
+    SubStore* sub = this->route(req->key);
+    if (!sub) return false;
+    if (!sub->large.count(req->key)) return sub->store->Delete(req, res);
+  }
+
+  std::unique_lock lock(this->mtx);
+  SubStore* sub = this->route(req->key);
+  if (!sub) return false;
+  if (!sub->large.count(req->key)) return sub->store->Delete(req, res);
+  LargeValue* large = this->find_large(*sub, req->key);
+  if (large) res->value = large->value.to_string();
+  this->erase_large(*sub, req->key);
+  return large != nullptr;
+}
+
+bool ShardedKvStore::MultiGet(const MultiGetRequest* req,
+                              MultiGetResponse* res) {
+  // Common case: every key is in the same shard
+  {
+    std::shared_lock lock(this->mtx);
+    auto groups = this->group(req->keys);
+    if (!groups) return false;
+    if (groups->size() == 1 && this->n_large == 0) {
+      return groups->begin()->first->MultiGet(req, res);
+    }
+  }
+
+  // Otherwise, split the request up by shard, under an exclusive lock so that
+  // no writes land in between the sub-requests
+  std::unique_lock lock(this->mtx);
+  res->values.resize(req->keys.size());
+  if (this->n_large > 0) {
+    // Some keys may have large values, so read the keys one by one
+    for (size_t i = 0; i < req->keys.size(); i++) {
+      SubStore* sub = this->route(req->keys[i]);
+      if (!sub || !this->get_value(*sub, req->keys[i], &res->values[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  auto groups = this->group(req->keys);
+  if (!groups) return false;
+  for (auto&& [store, indices] : *groups) {
+    MultiGetRequest sub_req{};
+    for (auto&& i : indices) sub_req.keys.push_back(req->keys[i]);
+    MultiGetResponse sub_res{};
+    if (!store->MultiGet(&sub_req, &sub_res)) return false;
+    for (size_t j = 0; j < indices.size(); j++) {
+      res->values[indices[j]] = std::move(sub_res.values[j]);
+    }
+  }
+  return true;
+}
+
+bool ShardedKvStore::MultiPut(const MultiPutRequest* req,
+                              MultiPutResponse* res) {
+  if (req->keys.size() != req->values.size()) return false;
+  bool has_large_values =
+      std::any_of(req->values.begin(), req->values.end(),
+                  [](auto&& value) { return value.size() > VALUE_CHUNK_SIZE; });
+
+  {
+    std::shared_lock lock(this->mtx);
+    auto groups = this->group(req->keys);
+    if (!groups) return false;
+    if (groups->size() == 1 && this->n_large == 0 && !has_large_values) {
+      return groups->begin()->first->MultiPut(req, res);
+    }
+  }
+
+  std::unique_lock lock(this->mtx);
+  auto groups = this->group(req->keys);
+  if (!groups) return false;
+  if (this->n_large > 0 || has_large_values) {
+    for (size_t i = 0; i < req->keys.size(); i++) {
+      PutRequest put_req{req->keys[i], req->values[i], req->ttl_ms};
+      if (!this->put_value(*this->route(req->keys[i]), put_req)) return false;
+    }
+    return true;
+  }
+
+  for (auto&& [store, indices] : *groups) {
+    MultiPutRequest sub_req{};
+    sub_req.ttl_ms = req->ttl_ms;
+    for (auto&& i : indices) {
+      sub_req.keys.push_back(req->keys[i]);
+      sub_req.values.push_back(req->values[i]);
+    }
+    MultiPutResponse sub_res{};
+    if (!store->MultiPut(&sub_req, &sub_res)) return false;
+  }
+  return true;
+}
+
+bool ShardedKvStore::CAS(const CasRequest* req, CasResponse* res) {
+  {
+    std::shared_lock lock(this->mtx);
+    SubStore* sub = this->route(req->key);
+    if (!sub) return false;
+    if (req->value.size() <= VALUE_CHUNK_SIZE && !sub->large.count(req->key)) {
+      return sub->store->CAS(req, res);
+    }
+  }
+
+  std::unique_lock lock(this->mtx);
+  SubStore* sub = this->route(req->key);
+  std::string current;
+  if (!sub || !this->get_value(*sub, req->key, &current)) return false;
+  res->swapped = current == req->expected;
+  if (!res->swapped) {
+    res->value = std::move(current);
+    return true;
+  }
+  if (!this->put_value(*sub, PutRequest{req->key, req->value})) return false;
+  res->value = req->value;
+  return true;
+}
+
+bool ShardedKvStore::Incr(const IncrRequest* req, IncrResponse* res) {
+  std::shared_lock lock(this->mtx);
+  SubStore* sub = this->route(req->key);
+  if (!sub) return false;
+  // A large value is never an integer
+  if (this->find_large(*sub, req->key)) return false;
+  return sub->store->Incr(req, res);
+}
+
+std::vector<std::string> ShardedKvStore::AllKeys() {
+  std::shared_lock lock(this->mtx);
+  std::vector<std::string> keys;
+  for (auto&& [lower, substore] : this->substores) {
+    auto sub_keys = substore.store->AllKeys();
+    keys.insert(keys.end(), std::make_move_iterator(sub_keys.begin()),
+                std::make_move_iterator(sub_keys.end()));
+    for (auto&& [key, large] : substore.large) {
+      if (this->find_large(substore, key)) keys.push_back(key);
+    }
+  }
+  return keys;
+}
+
+bool ShardedKvStore::Scan(const ScanRequest* req, ScanResponse* res) {
+  std::shared_lock lock(this->mtx);
+  // The cursor holds the lower bound of the shard being scanned, then where
+  // in it: "s" and the sub-store's cursor, or "l" and the last large value
+  // returned (large values come after the sub-store's)
+  auto it = this->substores.begin();
+  std::string position;
+  if (!req->cursor.empty()) {
+    std::string lower;
+    if (!split_cursor(req->cursor, &lower, &position) || position.empty()) {
+      return false;
+    }
+    it = this->substores.lower_bound(lower);
+    // If the shard has gone since, carry on from the next one
+    if (it == this->substores.end() || it->first != lower) position.clear();
+  }
+
+  res->keys.clear();
+  res->values.clear();
+  res->ttl_ms.clear();
+  res->cursor.clear();
+  for (; it != this->substores.end(); ++it, position.clear()) {
+    SubStore& sub = it->second;
+    if (position.empty() || position[0] == 's') {
+      ScanRequest sub_req{position.empty() ? "" : position.substr(1), 0};
+      do {
+        if (res->keys.size() >= req->count) {
+          res->cursor = join_cursor(it->first, "s" + sub_req.cursor);
+          return true;
+        }
+        sub_req.count = req->count - res->keys.size();
+        ScanResponse sub_res{};
+        if (!sub.store->Scan(&sub_req, &sub_res)) return false;
+        sub_res.ttl_ms.resize(sub_res.keys.size());
+        std::move(sub_res.keys.begin(), sub_res.keys.end(),
+                  std::back_inserter(res->keys));
+        std::move(sub_res.values.begin(), sub_res.values.end(),
+                  std::back_inserter(res->values));
+        res->ttl_ms.insert(res->ttl_ms.end(), sub_res.ttl_ms.begin(),
+                           sub_res.ttl_ms.end());
+        sub_req.cursor = std::move(sub_res.cursor);
+      } while (!sub_req.cursor.empty());
+      position = "l";
+    }
+
+    std::string after = position.substr(1);
+    auto large =
+        after.empty() ? sub.large.begin() : sub.large.upper_bound(after);
+    for (; large != sub.large.end(); ++large) {
+      if (!this->find_large(sub, large->first)) continue;
+      if (res->keys.size() >= req->count) {
+        res->cursor = join_cursor(it->first, "l" + after);
+        return true;
+      }
+      res->keys.push_back(large->first);
+      res->values.push_back(large->second.value.to_string());
+      res->ttl_ms.push_back(DbItem::ttl_from_expiry(large->second.expiry));
+      after = large->first;
+    }
+  }
+  return true;
+}
+
+bool ShardedKvStore::PutChunked(const std::string& key, ChunkedValue value,
+                                bool append, uint64_t ttl_ms) {
+  std::unique_lock lock(this->mtx);
+  SubStore* sub = this->route(key);
+  if (!sub) return false;
+
+  if (append) {
+    if (LargeValue* large = this->find_large(*sub, key)) {
+      large->value.append(value);
+      large->version = this->next_version++;
+      return true;
+    }
+    this->erase_large(*sub, key);
+
+    // Join the sub-store's value onto the front of the new chunks
+    GetRequest get_req{key};
+    GetResponse get_res{};
+    if (sub->store->Get(&get_req, &get_res)) {
+      ChunkedValue joined(get_res.value);
+      joined.append(value);
+      value = std::move(joined);
+    }
+    ttl_ms = 0;
+  }
+
+  if (value.size() <= VALUE_CHUNK_SIZE) {
+    return this->put_value(*sub, PutRequest{key, value.to_string(), ttl_ms});
+  }
+  this->put_large(*sub, key, std::move(value), DbItem::expiry_from_ttl(ttl_ms));
+  return true;
+}
+
+bool ShardedKvStore::GetChunk(const GetChunkRequest* req,
+                              GetChunkResponse* res) {
+  std::shared_lock lock(this->mtx);
+  SubStore* sub = this->route(req->key);
+  if (!sub) return false;
+
+  if (LargeValue* large = this->find_large(*sub, req->key)) {
+    if (req->offset > large->value.size()) return false;
+    res->chunk = large->value.read(req->offset, VALUE_CHUNK_SIZE);
+    res->size = large->value.size();
+    res->version = large->version;
+    return true;
+  }
+
+  GetRequest get_req{req->key};
+  GetResponse get_res{};
+  if (!sub->store->Get(&get_req, &get_res)) return false;
+  if (req->offset > get_res.value.size()) return false;
+  res->size = get_res.value.size();
+  res->version = 0;
+  if (req->offset == 0 && res->size <= VALUE_CHUNK_SIZE) {
+    res->chunk = std::move(get_res.value);
+  } else {
+    res->chunk = get_res.value.substr(req->offset, VALUE_CHUNK_SIZE);
+  }
+  return true;
+}
+
+std::vector<Shard> ShardedKvStore::Shards() {
+  std::shared_lock lock(this->mtx);
+  std::vector<Shard> shards;
+  for (auto&& [lower, substore] : this->substores) {
+    shards.push_back(substore.shard);
+  }
+  return shards;
+}
+
+void ShardedKvStore::Attach(const Shard& shard,
+                            std::unique_ptr<KvStore> store) {
+  std::unique_lock lock(this->mtx);
+  for (auto&& [lower, substore] : this->substores) {
+    assert(get_overlap(shard, substore.shard) == OverlapStatus::NO_OVERLAP);
+  }
+  if (!store) store = this->make_store();
+  this->substores[shard.lower] = SubStore{shard, std::move(store), {}};
+}
+
+std::vector<std::pair<Shard, std::unique_ptr<KvStore>>> ShardedKvStore::Detach(
+    const Shard& range) {
+  std::unique_lock lock(this->mtx);
+
+  // Collect the overlapping shards first, as we modify the map as we go
+  std::vector<Shard> overlapping;
+  for (auto&& [lower, substore] : this->substores) {
+    if (get_overlap(substore.shard, range) != OverlapStatus::NO_OVERLAP) {
+      overlapping.push_back(substore.shard);
+    }
+  }
+
+  std::vector<std::pair<Shard, std::unique_ptr<KvStore>>> detached;
+  for (auto&& shard : overlapping) {
+    auto node = this->substores.extract(shard.lower);
+    std::unique_ptr<KvStore> store = std::move(node.mapped().store);
+    LargeValues large = std::move(node.mapped().large);
+
+    // Splitting a shard only makes sense at the same granularity
+    OverlapStatus status = get_overlap(shard, range);
+    assert(status == OverlapStatus::COMPLETELY_CONTAINED ||
+           shard.granularity() == range.granularity());
+    switch (status) {
+      case OverlapStatus::COMPLETELY_CONTAINED: {
+        // The whole shard moves; no keys need to be touched
+        this->materialize(std::move(large), *store);
+        detached.emplace_back(shard, std::move(store));
+        break;
+      }
+      case OverlapStatus::OVERLAP_START: {
+        // shard: [lower, ..., range.upper | range.upper + 1, ..., upper]
+        auto [gone, kept] = split_shard(shard, range.upper, true);
+        detached.emplace_back(gone, this->extract(*store, gone));
+        this->materialize(this->take_large(large, gone),
+                          *detached.back().second);
+        this->substores[kept.lower] =
+            SubStore{kept, std::move(store), std::move(large)};
+        break;
+      }
+      case OverlapStatus::OVERLAP_END: {
+        // shard: [lower, ..., range.lower - 1 | range.lower, ..., upper]
+        auto [kept, gone] = split_shard(shard, range.lower, false);
+        detached.emplace_back(gone, this->extract(*store, gone));
+        this->materialize(this->take_large(large, gone),
+                          *detached.back().second);
+        this->substores[kept.lower] =
+            SubStore{kept, std::move(store), std::move(large)};
+        break;
+      }
+      case OverlapStatus::COMPLETELY_CONTAINS: {
+        // shard: [lower, ... | range | ..., upper]
+        auto [left, rest] = split_shard(shard, range.lower, false);
+        auto [gone, right] = split_shard(rest, range.upper, true);
+        detached.emplace_back(gone, this->extract(*store, gone));
+        this->materialize(this->take_large(large, gone),
+                          *detached.back().second);
+        this->substores[right.lower] =
+            SubStore{right, this->extract(*store, right),
+                     this->take_large(large, right)};
+        this->substores[left.lower] =
+            SubStore{left, std::move(store), std::move(large)};
+        break;
+      }
+      case OverlapStatus::NO_OVERLAP:
+        break;
+    }
+  }
+  return detached;
+}
+
+std::string ShardedKvStore::MemoryReport() {
+  std::shared_lock lock(this->mtx);
+  std::stringstream ss;
+  for (auto&& [lower, substore] : this->substores) {
+    if (auto* store = dynamic_cast<ConcurrentKvStore*>(substore.store.get())) {
+      ss << "Shard " << substore.shard << ":\n" << store->MemoryReport();
+    }
+  }
+  std::string report = ss.str();
+  if (report.empty()) {
+    return "Memory reports are only available for the ConcurrentKvStore.\n";
+  }
+  return report;
+}
+
+ShardedKvStore::SubStore* ShardedKvStore::route(const std::string& key) {
+  // Shards are ranges of upper-cased keys (see
+  // ShardControllerConfig::get_server)
+  std::string shard_key = to_upper(key);
+  auto it = this->substores.upper_bound(shard_key);
+  if (it == this->substores.begin()) return nullptr;
+  --it;
+  return it->second.shard.contains(shard_key) ? &it->second : nullptr;
+}
+
+std::optional<std::map<KvStore*, std::vector<size_t>>> ShardedKvStore::group(
+    const std::vector<std::string>& keys) {
+  std::map<KvStore*, std::vector<size_t>> groups;
+  for (size_t i = 0; i < keys.size(); i++) {
+    SubStore* sub = this->route(keys[i]);
+    if (!sub) return std::nullopt;
+    groups[sub->store.get()].push_back(i);
+  }
+  return groups;
+}
+
+std::unique_ptr<KvStore> ShardedKvStore::extract(KvStore& from,
+                                                 const Shard& range) {
+  std::unique_ptr<KvStore> to = this->make_store();
+
+  // A page at a time, so that the keys are never all in memory at once
+  ScanRequest scan_req{"", MAX_SCAN_COUNT};
+  do {
+    ScanResponse scan_res{};
+    if (!from.Scan(&scan_req, &scan_res)) break;
+    scan_res.ttl_ms.resize(scan_res.keys.size());
+    for (size_t i = 0; i < scan_res.keys.size(); i++) {
+      if (!range.contains(to_upper(scan_res.keys[i]))) continue;
+      PutRequest put_req{scan_res.keys[i], std::move(scan_res.values[i]),
+                         scan_res.ttl_ms[i]};
+      PutResponse put_res{};
+      to->Put(&put_req, &put_res);
+      DeleteRequest del_req{scan_res.keys[i]};
+      DeleteResponse del_res{};
+      from.Delete(&del_req, &del_res);
+    }
+    scan_req.cursor = std::move(scan_res.cursor);
+  } while (!scan_req.cursor.empty());
+  return to;
+}
+
+ShardedKvStore::LargeValue* ShardedKvStore::find_large(
+    SubStore& sub, const std::string& key) {
+  auto it = sub.large.find(key);
+  if (it == sub.large.end()) return nullptr;
+  auto expiry = it->second.expiry;
+  if (expiry != DbItem::clock::time_point::max() &&
+      DbItem::clock::now() >= expiry) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+bool ShardedKvStore::get_value(SubStore& sub, const std::string& key,
+                               std::string* value) {
+  if (!sub.large.empty()) {
+    if (LargeValue* large = this->find_large(sub, key)) {
+      *value = large->value.to_string();
+      return true;
+    }
+  }
+  GetRequest get_req{key};
+  GetResponse get_res{};
+  if (!sub.store->Get(&get_req, &get_res)) return false;
+  *value = std::move(get_res.value);
+  return true;
+}
+
+bool ShardedKvStore::put_value(SubStore& sub, const PutRequest& req) {
+  if (req.value.size() > VALUE_CHUNK_SIZE) {
+    this->put_large(sub, req.key, ChunkedValue(req.value),
+                    DbItem::expiry_from_ttl(req.ttl_ms));
+    return true;
+  }
+  this->erase_large(sub, req.key);
+  PutResponse put_res{};
+  return sub.store->Put(&req, &put_res);
+}
+
+void ShardedKvStore::put_large(SubStore& sub, const std::string& key,
+                               ChunkedValue value,
+                               std::chrono::steady_clock::time_point expiry) {
+  DeleteRequest del_req{key};
+  DeleteResponse del_res{};
+  sub.store->Delete(&del_req, &del_res);
+
+  auto [it, inserted] = sub.large.try_emplace(key);
+  if (inserted) this->n_large++;
+  it->second = LargeValue{std::move(value), this->next_version++, expiry};
+}
+
+void ShardedKvStore::erase_large(SubStore& sub, const std::string& key) {
+  this->n_large -= sub.large.erase(key);
+}
+
+ShardedKvStore::LargeValues ShardedKvStore::take_large(LargeValues& from,
+                                                       const Shard& range) {
+  LargeValues taken;
+  for (auto it = from.begin(); it != from.end();) {
+    if (range.contains(to_upper(it->first))) {
+      taken.insert(from.extract(it++));
+    } else {
+      ++it;
+    }
+  }
+  return taken;
+}
+
+void ShardedKvStore::materialize(LargeValues large, KvStore& store) {
+  this->n_large -= large.size();
+  for (auto&& [key, value] : large) {
+    auto expiry = value.expiry;
+    if (expiry != DbItem::clock::time_point::max() &&
+        DbItem::clock::now() >= expiry) {
+      continue;
+    }
+    PutRequest put_req{key, value.value.to_string(),
+                       DbItem::ttl_from_expiry(expiry)};
+    PutResponse put_res{};
+    store.Put(&put_req, &put_res);
+  }
+}
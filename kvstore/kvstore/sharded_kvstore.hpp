@@ -0,0 +1,147 @@
+#ifndef SHARDED_KVSTORE_HPP
+#define SHARDED_KVSTORE_HPP
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "chunked_value.hpp"
+#include "common/shard.hpp"
+#include "kvstore.hpp"
+#include "net/server_commands.hpp"
+
+// A shard that contains every key (including keys outside of VALID_CHARS).
+// Used by servers that aren't managed by a shardcontroller.
+const Shard WHOLE_KEYSPACE{"", ""};
+
+/**
+ * A KvStore made up of one sub-store per owned shard.
+ *
+ * Each request is routed to the sub-store whose shard contains its key(s),
+ * upper-cased as ShardControllerConfig::get_server does; requests for keys
+ * that no owned shard contains fail. Handing a shard off to
+ * another server then doesn't touch any other shard's keys: Detach() unlinks
+ * the shard's whole sub-store in O(1), to be streamed to its new owner and
+ * dropped in one go.
+ *
+ * Multi-key requests whose keys all fall into one shard are as atomic as the
+ * sub-store makes them. Requests spanning several shards briefly block every
+ * other request, to stay atomic across sub-stores.
+ *
+ * Values larger than VALUE_CHUNK_SIZE are kept out of the sub-stores, as chunk
+ * lists (ChunkedValues), so that they never need one contiguous allocation and
+ * can be read a chunk at a time. Writing them briefly blocks every other
+ * request, as does any multi-key request while large values are stored.
+ */
+class ShardedKvStore : public KvStore {
+ public:
+  using StoreFactory = std::function<std::unique_ptr<KvStore>()>;
+
+  explicit ShardedKvStore(StoreFactory make_store) : make_store(make_store) {
+  }
+  ~ShardedKvStore() = default;
+
+  bool Get(const GetRequest* req, GetResponse* res) override;
+  bool Put(const PutRequest* req, PutResponse*) override;
+  bool Append(const AppendRequest* req, AppendResponse*) override;
+  bool Delete(const DeleteRequest* req, DeleteResponse* res) override;
+  bool MultiGet(const MultiGetRequest* req, MultiGetResponse* res) override;
+  bool MultiPut(const MultiPutRequest* req, MultiPutResponse*) override;
+  bool CAS(const CasRequest* req, CasResponse* res) override;
+  bool Incr(const IncrRequest* req, IncrResponse* res) override;
+
+  std::vector<std::string> AllKeys() override;
+  bool Scan(const ScanRequest* req, ScanResponse* res) override;
+
+  // Stores `value` under `key` (or appends it to key's value, if `append`).
+  // Appending to a value kept in a sub-store drops its TTL.
+  bool PutChunked(const std::string& key, ChunkedValue value, bool append,
+                  uint64_t ttl_ms = 0);
+  // Reads up to VALUE_CHUNK_SIZE bytes of a value; see GetChunkRequest.
+  bool GetChunk(const GetChunkRequest* req, GetChunkResponse* res);
+
+  // The shards currently owned, in ascending order.
+  std::vector<Shard> Shards();
+
+  // Starts owning `shard`, backed by `store` (or a new, empty sub-store if
+  // null). `shard` must not overlap any owned shard.
+  void Attach(const Shard& shard, std::unique_ptr<KvStore> store = nullptr);
+
+  // Stops owning the keys in `range`, and returns the sub-stores that held
+  // them. Owned shards entirely within `range` are unlinked in O(1); a shard
+  // that straddles `range`'s bounds is split first, which moves the keys on
+  // either side of the split into new sub-stores (losing their TTLs). Large
+  // values in `range` are copied into the returned sub-stores whole.
+  std::vector<std::pair<Shard, std::unique_ptr<KvStore>>> Detach(
+      const Shard& range);
+
+  // Memory reports of every ConcurrentKvStore sub-store.
+  std::string MemoryReport();
+
+ private:
+  struct LargeValue {
+    ChunkedValue value;
+    uint64_t version;
+    // time_point::max() if the value never expires.
+    std::chrono::steady_clock::time_point expiry;
+  };
+  using LargeValues = std::map<std::string, LargeValue>;
+
+  struct SubStore {
+    Shard shard;
+    std::unique_ptr<KvStore> store;
+    // Values larger than VALUE_CHUNK_SIZE; their keys aren't in `store`.
+    // Expired values are left in place until overwritten, but never read.
+    LargeValues large;
+  };
+
+  StoreFactory make_store;
+
+  // Sub-stores, keyed by their shard's lower bound. Since owned shards never
+  // overlap, a key can only belong to the shard with the greatest lower bound
+  // not above it.
+  std::map<std::string, SubStore> substores;
+  // Requests take shared locks (or an exclusive one, if they span multiple
+  // sub-stores or write large values); Attach and Detach take exclusive locks.
+  std::shared_mutex mtx;
+
+  // Number of entries in every sub-store's `large`, and the version to give
+  // the next large value written. Only modified under an exclusive lock.
+  size_t n_large = 0;
+  uint64_t next_version = 1;
+
+  // Returns the sub-store owning `key`, or nullptr. Assumes mtx is held.
+  SubStore* route(const std::string& key);
+  // Groups the indices of `keys` by the sub-store owning them, or returns
+  // std::nullopt if some key isn't owned. Assumes mtx is held.
+  std::optional<std::map<KvStore*, std::vector<size_t>>> group(
+      const std::vector<std::string>& keys);
+
+  // Moves every key in `range` out of `from`, into a new sub-store.
+  std::unique_ptr<KvStore> extract(KvStore& from, const Shard& range);
+
+  // Large value helpers. The first two assume mtx is held; the others assume
+  // it's held exclusively.
+  // Returns `key`'s large value, or nullptr if it has none (or it expired).
+  LargeValue* find_large(SubStore& sub, const std::string& key);
+  // Reads `key`'s value, wherever it's kept.
+  bool get_value(SubStore& sub, const std::string& key, std::string* value);
+  // Stores `req`'s value, as a large value if it's large enough.
+  bool put_value(SubStore& sub, const PutRequest& req);
+  // Makes `value` key's value, taking the key out of the sub-store.
+  void put_large(SubStore& sub, const std::string& key, ChunkedValue value,
+                 std::chrono::steady_clock::time_point expiry);
+  void erase_large(SubStore& sub, const std::string& key);
+  // Removes and returns the large values in `range`.
+  LargeValues take_large(LargeValues& from, const Shard& range);
+  // Copies `large`'s unexpired values into `store` whole.
+  void materialize(LargeValues large, KvStore& store);
+};
+
+#endif /* end of include guard */
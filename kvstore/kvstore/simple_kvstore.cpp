@@ -37,8 +37,35 @@ bool SimpleKvStore::MultiPut(const MultiPutRequest* req, MultiPutResponse*) {
   return true;
 }
 
+bool SimpleKvStore::CAS(const CasRequest* req, CasResponse* res) {
+  // TODO (Part A, Step 1 and Step 2): Implement!
+  // Fail if the key doesn't exist. Otherwise, only overwrite the value if it
+  // equals req->expected; either way, report the resulting value.
+
+  return true;
+}
+
+bool SimpleKvStore::Incr(const IncrRequest* req, IncrResponse* res) {
+  // TODO (Part A, Step 1 and Step 2): Implement!
+  // A nonexistent key counts as 0; fail if the value isn't an integer (see
+  // parse_int64 in common/utils.hpp).
+
+  return true;
+}
+
 std::vector<std::string> SimpleKvStore::AllKeys() {
   // TODO (Part A, Step 1 and Step 2): Implement!
 
   return {};
 }
+
+bool SimpleKvStore::Scan(const ScanRequest* req, ScanResponse* res) {
+  // TODO (Part A, Step 1 and Step 2): Implement!
+  // Return the (up to) req->count smallest keys after the cursor, which can
+  // simply be the last key returned, their values, and the time each has
+  // left to live (see ScanResponse::ttl_ms). Going by key order means a page
+  // picks up in the right place however the store changed since the last one.
+  // Skip expired keys.
+
+  return true;
+}
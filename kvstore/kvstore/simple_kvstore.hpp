@@ -19,12 +19,17 @@ class SimpleKvStore : public KvStore {
   bool Delete(const DeleteRequest* req, DeleteResponse* res) override;
   bool MultiGet(const MultiGetRequest* req, MultiGetResponse* res) override;
   bool MultiPut(const MultiPutRequest* req, MultiPutResponse*) override;
+  bool CAS(const CasRequest* req, CasResponse* res) override;
+  bool Incr(const IncrRequest* req, IncrResponse* res) override;
 
   std::vector<std::string> AllKeys() override;
+  bool Scan(const ScanRequest* req, ScanResponse* res) override;
 
  private:
   // TODO (Part A, Step 1 and Step 2): Implement your internal key-value store
-  // here! You might need to add fields to synchronize access.
+  // here! You might need to add fields to synchronize access. To honor
+  // PutRequest::ttl_ms, you'll also need to remember each key's expiry and
+  // treat expired keys as nonexistent when reading them.
 };
 
 #endif /* end of include guard */
@@ -0,0 +1,132 @@
+#include "slab_allocator.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+size_t SlabAllocator::class_for(size_t n) {
+  auto it =
+      std::lower_bound(SLAB_CHUNK_SIZES.begin(), SLAB_CHUNK_SIZES.end(), n);
+  return it - SLAB_CHUNK_SIZES.begin();
+}
+
+void* SlabAllocator::allocate(size_t n) {
+  size_t c = class_for(n);
+  if (c == N_SLAB_CLASSES) {
+    std::unique_lock lock(this->large_mtx);
+    this->n_large++;
+    this->large_bytes += n;
+    return ::operator new(n);
+  }
+
+  SizeClass& cls = this->classes[c];
+  std::unique_lock lock(cls.mtx);
+  cls.n_used++;
+  cls.requested_bytes += n;
+
+  // Prefer reusing a freed chunk...
+  if (cls.free_list) {
+    void* chunk = cls.free_list;
+    cls.free_list = *static_cast<void**>(chunk);
+    cls.n_free--;
+    return chunk;
+  }
+
+  // ... otherwise, carve a new chunk off the newest slab.
+  size_t chunk_size = SLAB_CHUNK_SIZES[c];
+  if (cls.slab_used + chunk_size > SLAB_SIZE) {
+    // Default-initialize, so that untouched chunks don't count towards RSS
+    cls.slabs.emplace_back(new std::byte[SLAB_SIZE]);
+    cls.slab_used = 0;
+  }
+  void* chunk = cls.slabs.back().get() + cls.slab_used;
+  cls.slab_used += chunk_size;
+  return chunk;
+}
+
+void SlabAllocator::deallocate(void* p, size_t n) {
+  size_t c = class_for(n);
+  if (c == N_SLAB_CLASSES) {
+    std::unique_lock lock(this->large_mtx);
+    this->n_large--;
+    this->large_bytes -= n;
+    ::operator delete(p);
+    return;
+  }
+
+  SizeClass& cls = this->classes[c];
+  std::unique_lock lock(cls.mtx);
+  cls.n_used--;
+  cls.requested_bytes -= n;
+  *static_cast<void**>(p) = cls.free_list;
+  cls.free_list = p;
+  cls.n_free++;
+}
+
+bool SlabAllocator::resize_in_place(size_t old_n, size_t new_n) {
+  size_t c = class_for(old_n);
+  if (c == N_SLAB_CLASSES || c != class_for(new_n)) return false;
+
+  SizeClass& cls = this->classes[c];
+  std::unique_lock lock(cls.mtx);
+  cls.requested_bytes = cls.requested_bytes - old_n + new_n;
+  return true;
+}
+
+std::vector<SlabAllocator::ClassStats> SlabAllocator::stats() {
+  std::vector<ClassStats> res;
+  for (size_t c = 0; c < N_SLAB_CLASSES; c++) {
+    SizeClass& cls = this->classes[c];
+    std::unique_lock lock(cls.mtx);
+    if (cls.slabs.empty()) continue;
+    res.push_back(ClassStats{SLAB_CHUNK_SIZES[c], cls.slabs.size(),
+                             cls.n_used, cls.n_free, cls.requested_bytes});
+  }
+  return res;
+}
+
+std::string SlabAllocator::report() {
+  auto mib = [](size_t bytes) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2)
+       << static_cast<double>(bytes) / (1 << 20) << " MiB";
+    return ss.str();
+  };
+  auto percent = [](size_t part, size_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * part / whole;
+  };
+
+  size_t reserved = 0, in_chunks = 0, requested = 0;
+  std::stringstream classes_ss;
+  for (auto&& s : this->stats()) {
+    size_t class_reserved = s.n_slabs * SLAB_SIZE;
+    size_t class_in_chunks = s.n_used * s.chunk_size;
+    reserved += class_reserved;
+    in_chunks += class_in_chunks;
+    requested += s.requested_bytes;
+    classes_ss << "- " << s.chunk_size << "B chunks: " << s.n_slabs
+               << " slab(s), " << s.n_used << " used, " << s.n_free
+               << " free, " << std::fixed << std::setprecision(1)
+               << percent(class_in_chunks - s.requested_bytes, class_in_chunks)
+               << "% internal fragmentation\n";
+  }
+
+  size_t n_large, large_bytes;
+  {
+    std::unique_lock lock(this->large_mtx);
+    n_large = this->n_large;
+    large_bytes = this->large_bytes;
+  }
+
+  std::stringstream ss;
+  ss << "Slab allocator: " << mib(reserved) << " reserved in slabs, "
+     << mib(in_chunks) << " in use, " << mib(requested) << " requested\n";
+  ss << std::fixed << std::setprecision(1)
+     << "Internal fragmentation: " << percent(in_chunks - requested, in_chunks)
+     << "%, external fragmentation: " << percent(reserved - in_chunks, reserved)
+     << "%\n";
+  ss << "Large allocations: " << n_large << " (" << mib(large_bytes) << ")\n";
+  ss << classes_ss.str();
+  return ss.str();
+}
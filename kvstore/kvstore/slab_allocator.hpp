@@ -0,0 +1,112 @@
+#ifndef SLAB_ALLOCATOR_HPP
+#define SLAB_ALLOCATOR_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Size of each slab; also the largest request served from slabs.
+constexpr size_t SLAB_SIZE = 1 << 20;
+// Smallest chunk size handed out.
+constexpr size_t SLAB_MIN_CHUNK_SIZE = 64;
+constexpr size_t SLAB_ALIGNMENT = alignof(std::max_align_t);
+
+// Next size class after `size`: ~1.25x larger, rounded up to SLAB_ALIGNMENT.
+constexpr size_t next_chunk_size(size_t size) {
+  size_t next = size + size / 4;
+  return (next + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT * SLAB_ALIGNMENT;
+}
+
+constexpr size_t N_SLAB_CLASSES = [] {
+  size_t n = 1;
+  for (size_t s = SLAB_MIN_CHUNK_SIZE; s < SLAB_SIZE; s = next_chunk_size(s)) {
+    n++;
+  }
+  return n;
+}();
+
+// Chunk size of each size class; the last class is a whole slab.
+constexpr std::array<size_t, N_SLAB_CLASSES> SLAB_CHUNK_SIZES = [] {
+  std::array<size_t, N_SLAB_CLASSES> sizes{};
+  size_t s = SLAB_MIN_CHUNK_SIZE;
+  for (size_t i = 0; i + 1 < N_SLAB_CLASSES; i++, s = next_chunk_size(s)) {
+    sizes[i] = s;
+  }
+  sizes[N_SLAB_CLASSES - 1] = SLAB_SIZE;
+  return sizes;
+}();
+
+/**
+ * Size-class slab allocator for DbMap items (in the style of memcached).
+ *
+ * Memory is carved out of SLAB_SIZE slabs, each dedicated to one size class.
+ * Size classes grow geometrically (by ~1.25x) from SLAB_MIN_CHUNK_SIZE up
+ * to SLAB_SIZE; a request is served from the smallest class that fits it, and
+ * freed chunks go onto their class's free list to be reused by the next
+ * allocation of that class. Requests larger than SLAB_SIZE fall back to
+ * ::operator new.
+ *
+ * Slabs are never returned to the OS, so memory stays put under churn instead
+ * of fragmenting the heap. Each size class has its own mutex, so threads
+ * working on different buckets rarely contend.
+ */
+class SlabAllocator {
+ public:
+  SlabAllocator() = default;
+  ~SlabAllocator() = default;
+  SlabAllocator(const SlabAllocator&) = delete;
+  SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+  // Allocates at least `n` bytes, aligned to SLAB_ALIGNMENT.
+  void* allocate(size_t n);
+  // Frees `p`, which must have been allocated with a request of `n` bytes.
+  void deallocate(void* p, size_t n);
+  // Whether a chunk allocated for `old_n` bytes can hold `new_n` bytes. If so,
+  // updates the allocator's accounting as if it had been reallocated.
+  bool resize_in_place(size_t old_n, size_t new_n);
+
+  // Size class index for a request of `n` bytes; N_SLAB_CLASSES if too large.
+  static size_t class_for(size_t n);
+
+  // Per-size-class usage statistics.
+  struct ClassStats {
+    size_t chunk_size;
+    size_t n_slabs;
+    // Chunks handed out, and chunks sitting on the free list.
+    size_t n_used;
+    size_t n_free;
+    // Sum of the sizes requested by live allocations in this class.
+    size_t requested_bytes;
+  };
+  std::vector<ClassStats> stats();
+
+  // Human-readable fragmentation report: reserved vs. requested memory, and
+  // how much is lost to rounding up to a chunk size (internal fragmentation)
+  // or sits unused on free lists and slab tails (external fragmentation).
+  std::string report();
+
+ private:
+  struct SizeClass {
+    std::mutex mtx;
+    // Singly-linked list threaded through the freed chunks themselves.
+    void* free_list = nullptr;
+    std::vector<std::unique_ptr<std::byte[]>> slabs;
+    // Bytes of the newest slab that have been carved into chunks.
+    size_t slab_used = SLAB_SIZE;
+    size_t n_used = 0;
+    size_t n_free = 0;
+    size_t requested_bytes = 0;
+  };
+
+  std::array<SizeClass, N_SLAB_CLASSES> classes;
+
+  // Allocations too large for any size class.
+  std::mutex large_mtx;
+  size_t n_large = 0;
+  size_t large_bytes = 0;
+};
+
+#endif /* end of include guard */
@@ -0,0 +1,83 @@
+#include "timer_wheel.hpp"
+
+void TimerWheel::schedule(const std::string& key, clock::time_point deadline) {
+  std::unique_lock lock(this->mtx);
+
+  // Round up, so a timer never fires before its deadline
+  auto delta = deadline - this->start;
+  uint64_t tick = delta <= 0ms ? 0 : (delta + TICK - 1ns) / TICK;
+  this->place(Timer{key, tick});
+  this->n_timers++;
+}
+
+std::vector<std::string> TimerWheel::advance(clock::time_point now,
+                                             size_t max_keys) {
+  std::unique_lock lock(this->mtx);
+
+  uint64_t target_tick = (now - this->start) / TICK;
+  while (this->current_tick < target_tick && this->ready.size() < max_keys) {
+    this->current_tick++;
+
+    // Find the highest level whose slot boundary we just crossed, then cascade
+    // from that level down so timers land in the (finer) slots due next.
+    size_t top = 0;
+    while (top + 1 < N_LEVELS &&
+           (this->current_tick &
+            ((uint64_t(1) << (LEVEL_BITS * (top + 1))) - 1)) == 0) {
+      top++;
+    }
+    for (size_t level = top + 1; level-- > 0;) {
+      size_t slot = (this->current_tick >> (LEVEL_BITS * level)) &
+                    (SLOTS_PER_LEVEL - 1);
+      this->cascade(level, slot);
+    }
+  }
+
+  std::vector<std::string> expired;
+  size_t n = std::min(max_keys, this->ready.size());
+  expired.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    expired.push_back(std::move(this->ready.front()));
+    this->ready.pop_front();
+  }
+  this->n_timers -= n;
+  return expired;
+}
+
+size_t TimerWheel::size() {
+  std::unique_lock lock(this->mtx);
+  return this->n_timers;
+}
+
+void TimerWheel::place(Timer timer) {
+  if (timer.expiry_tick <= this->current_tick) {
+    this->ready.push_back(std::move(timer.key));
+    return;
+  }
+
+  uint64_t delta = timer.expiry_tick - this->current_tick;
+  for (size_t level = 0; level < N_LEVELS; level++) {
+    if (delta < (uint64_t(1) << (LEVEL_BITS * (level + 1)))) {
+      size_t slot = (timer.expiry_tick >> (LEVEL_BITS * level)) &
+                    (SLOTS_PER_LEVEL - 1);
+      this->levels[level][slot].push_back(std::move(timer));
+      return;
+    }
+  }
+
+  // Beyond the wheel's span: park the timer in the furthest slot of the last
+  // level; it gets re-placed (with its real expiry) once that slot comes due.
+  size_t level = N_LEVELS - 1;
+  uint64_t furthest =
+      this->current_tick + (uint64_t(1) << (LEVEL_BITS * N_LEVELS)) - 1;
+  size_t slot = (furthest >> (LEVEL_BITS * level)) & (SLOTS_PER_LEVEL - 1);
+  this->levels[level][slot].push_back(std::move(timer));
+}
+
+void TimerWheel::cascade(size_t level, size_t slot) {
+  std::vector<Timer> timers;
+  std::swap(timers, this->levels[level][slot]);
+  for (auto&& timer : timers) {
+    this->place(std::move(timer));
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+/**
+ * Hierarchical timer wheel used to reap expired keys in the background.
+ *
+ * Level 0 has one slot per TICK; each higher level has slots that are
+ * SLOTS_PER_LEVEL times coarser. When a slot comes due, its timers are either
+ * handed out as expired or cascaded down into a finer level. Scheduling is
+ * O(1), and advance() hands out at most `max_keys` keys per call, so the reaper
+ * only ever does a small, bounded amount of work at a time.
+ *
+ * A timer only records that a key *might* have expired; the key may have been
+ * overwritten (or deleted) since, so callers must re-check the key's actual
+ * expiry before removing it.
+ */
+class TimerWheel {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr auto TICK = 10ms;
+  static constexpr size_t LEVEL_BITS = 6;
+  static constexpr size_t SLOTS_PER_LEVEL = 1 << LEVEL_BITS;
+  // With 4 levels of 64 slots and 10ms ticks, the wheel spans ~46 hours;
+  // timers further out are parked in the last level and re-cascaded.
+  static constexpr size_t N_LEVELS = 4;
+
+  explicit TimerWheel(clock::time_point start = clock::now()) : start(start) {
+  }
+
+  // Schedules `key` to be handed out by advance() once `deadline` passes.
+  void schedule(const std::string& key, clock::time_point deadline);
+
+  // Advances the wheel to `now`, and returns up to `max_keys` keys whose
+  // deadlines have passed. Any remaining expired keys are kept for the next
+  // call.
+  std::vector<std::string> advance(clock::time_point now, size_t max_keys);
+
+  // Number of timers currently scheduled (including expired, unreturned ones).
+  size_t size();
+
+ private:
+  struct Timer {
+    std::string key;
+    uint64_t expiry_tick;
+  };
+
+  std::mutex mtx;
+  clock::time_point start;
+  uint64_t current_tick = 0;
+  size_t n_timers = 0;
+
+  std::array<std::array<std::vector<Timer>, SLOTS_PER_LEVEL>, N_LEVELS> levels;
+  // Timers whose deadline has passed, but that haven't been handed out yet.
+  std::deque<std::string> ready;
+
+  // Places a timer into the slot matching its distance from current_tick.
+  // Assumes mtx is held.
+  void place(Timer timer);
+  // Re-places every timer in the given slot. Assumes mtx is held.
+  void cascade(size_t level, size_t slot);
+};
+
+#endif /* end of include guard */
@@ -21,14 +21,25 @@ bool ClientConn::shutdown() {
   return true;
 }
 
-std::optional<Request> ClientConn::recv_request() {
-  Message msg{};
-
-  {
-    std::unique_lock lock(this->recv_mtx);
-    if (!recv_message(fd, &msg)) {
-      return std::nullopt;
-    }
+std::optional<Request> ClientConn::recv_request(size_t* n_bytes,
+                                                milliseconds* budget,
+                                                TraceContext* trace) {
+  std::unique_lock lock(this->recv_mtx);
+  Message& msg = this->recv_msg;
+  if (this->shm ? !this->shm->recv_message(fd, &msg)
+                : !recv_message(fd, &msg)) {
+    return std::nullopt;
+  }
+  if (n_bytes) *n_bytes = msg.size();
+  if (budget) *budget = milliseconds(msg.budget_ms);
+  if (!detach_trace(&msg)) {
+    cerr_color(RED, "Error reading request's trace context.");
+    return std::nullopt;
+  }
+  if (trace) *trace = msg.trace;
+  if (!decompress_message(&msg)) {
+    cerr_color(RED, "Error decompressing request.");
+    return std::nullopt;
   }
 
   auto req = deserialize_request(msg);
@@ -38,15 +49,27 @@ std::optional<Request> ClientConn::recv_request() {
   return req;
 }
 
-bool ClientConn::send_response(Response response) {
-  std::optional<Message> msg = serialize_response(response);
-  if (!msg) {
+bool ClientConn::send_response(const Response& response, size_t* n_bytes) {
+  std::unique_lock lock(this->send_mtx);
+  Message& msg = this->send_msg;
+  if (!serialize_response(response, &msg)) {
     perror_color(RED, "Error serializing response.");
     return false;
   }
+  msg.budget_ms = 0;
+  if (this->compress) compress_message(&msg);
+  if (n_bytes) *n_bytes = msg.size();
+
+  if (this->shm) return this->shm->send_message(fd, &msg);
+  if (!send_message(fd, &msg)) return false;
+  if (this->next_shm) this->shm = std::move(this->next_shm);
+  return true;
+}
 
+bool ClientConn::attach_shm(const std::string& name) {
   std::unique_lock lock(this->send_mtx);
-  return send_message(fd, &*msg);
+  this->next_shm = ShmChannel::open(name);
+  return this->next_shm != nullptr;
 }
 
 bool ServerConn::close() {
@@ -59,25 +82,70 @@ bool ServerConn::shutdown() {
   return true;
 }
 
-bool ServerConn::send_request(Request req) {
-  std::optional<Message> msg = serialize_request(req);
-  if (!msg) {
+bool ServerConn::negotiate(uint32_t features) {
+  std::unique_ptr<ShmChannel> channel;
+  if (features & FEATURE_SHARED_MEMORY) {
+    channel = ShmChannel::create();
+    if (!channel) features &= ~FEATURE_SHARED_MEMORY;
+  }
+  std::string shm_name = channel ? channel->name() : "";
+  if (!this->send_request(HelloRequest{features, shm_name})) return false;
+  std::optional<Response> res = this->recv_response();
+  // The server has opened the channel by now, if it's going to
+  if (channel) channel->unlink();
+  if (!res) return false;
+  auto* hello_res = std::get_if<HelloResponse>(&*res);
+  if (!hello_res) return false;
+  this->compress = hello_res->features & FEATURE_COMPRESSION;
+  if (hello_res->features & FEATURE_SHARED_MEMORY) {
+    this->shm = std::move(channel);
+  }
+  return true;
+}
+
+bool ServerConn::send_request(const Request& req, milliseconds budget) {
+  std::unique_lock lock(this->send_mtx);
+  Message& msg = this->send_msg;
+  if (!serialize_request(req, &msg)) {
     perror_color(RED, "Error serializing request.");
     return false;
   }
+  msg.budget_ms = budget.count();
+  if (this->compress) compress_message(&msg);
+  msg.trace = current_trace();
+  attach_trace(&msg);
 
-  std::unique_lock lock(this->send_mtx);
-  return send_message(fd, &*msg);
+  if (this->shm) return this->shm->send_message(fd, &msg);
+  return send_message(fd, &msg);
 }
 
-std::optional<Response> ServerConn::recv_response() {
-  Message msg{};
+bool ServerConn::send_chunked(const std::string& key, const std::string& value,
+                              bool append, uint64_t ttl_ms) {
+  size_t offset = 0;
+  do {
+    PutChunkRequest req{key, value.substr(offset, VALUE_CHUNK_SIZE), append,
+                        false, ttl_ms};
+    offset += req.chunk.size();
+    req.last = offset >= value.size();
+    if (!this->send_request(std::move(req))) return false;
+  } while (offset < value.size());
+  return true;
+}
 
-  {
-    std::unique_lock lock(this->recv_mtx);
-    if (!recv_message(fd, &msg)) {
-      return std::nullopt;
-    }
+std::optional<Response> ServerConn::recv_response() {
+  std::unique_lock lock(this->recv_mtx);
+  Message& msg = this->recv_msg;
+  if (this->shm ? !this->shm->recv_message(fd, &msg)
+                : !recv_message(fd, &msg)) {
+    return std::nullopt;
+  }
+  if (!detach_trace(&msg)) {
+    cerr_color(RED, "Error reading response's trace context.");
+    return std::nullopt;
+  }
+  if (!decompress_message(&msg)) {
+    cerr_color(RED, "Error decompressing response.");
+    return std::nullopt;
   }
 
   auto res = deserialize_response(msg);
@@ -88,9 +156,9 @@ std::optional<Response> ServerConn::recv_response() {
 }
 
 std::shared_ptr<ClientConn> accept_client(int listener_fd) {
-  // NOTE: ideally, we should use a sockaddr_storage and handle INET vs INET6,
-  // but since we're only supporting IPv4 here, this should be fine.
-  struct sockaddr_in client_addr;
+  // NOTE: ideally, we should handle INET6 too, but since we're only supporting
+  // IPv4 (and Unix domain sockets) here, this should be fine.
+  struct sockaddr_storage client_addr;
   socklen_t sin_size = sizeof(client_addr);
   int cfd = accept(listener_fd, (struct sockaddr*)&client_addr, &sin_size);
   if (cfd < 0) {
@@ -98,6 +166,12 @@ std::shared_ptr<ClientConn> accept_client(int listener_fd) {
     return nullptr;
   }
 
+  // Clients of a Unix domain socket are nameless, so go by their socket
+  if (client_addr.ss_family == AF_UNIX) {
+    return std::make_shared<ClientConn>(
+        cfd, std::string(UNIX_ADDRESS_PREFIX) + "#" + std::to_string(cfd));
+  }
+
   // get hostname:port for presentability.
   char hostbuf[NI_MAXHOST], servbuf[NI_MAXSERV];
   if (getnameinfo((struct sockaddr*)&client_addr, sin_size, hostbuf,
@@ -113,6 +187,13 @@ std::shared_ptr<ClientConn> accept_client(int listener_fd) {
 }
 
 std::shared_ptr<ServerConn> connect_to_server(const std::string& server_addr) {
+  // Connect to the first of a list of addresses that's up
+  if (size_t comma = server_addr.find(','); comma != std::string::npos) {
+    std::shared_ptr<ServerConn> conn =
+        connect_to_server(server_addr.substr(0, comma));
+    return conn ? conn : connect_to_server(server_addr.substr(comma + 1));
+  }
+
   int sfd = connect_to_address(server_addr);
   if (sfd < 0) {
     return nullptr;
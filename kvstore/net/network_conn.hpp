@@ -6,6 +6,7 @@
 
 #include "net/network_messages.hpp"
 #include "net/server_commands.hpp"
+#include "net/shm_channel.hpp"
 #include "net/shardcontroller_commands.hpp"
 
 /*
@@ -34,6 +35,14 @@ struct ClientConn {
   // Whether the client is still connected
   std::atomic<bool> is_connected = true;
 
+  // When the connection was accepted, and handed to a worker's queue
+  const steady_clock::time_point accepted_at = steady_clock::now();
+  steady_clock::time_point queued_at = accepted_at;
+
+  // Whether to compress large responses; set once the client has asked for
+  // FEATURE_COMPRESSION
+  std::atomic<bool> compress = false;
+
   /*
    * Shuts down communication over the socket associated with the connection and
    * destroys it.
@@ -48,17 +57,42 @@ struct ClientConn {
    * Receives a request from the client, if one has been sent. Otherwise, if the
    * client has disconnected, no request has been sent, or an error occurs, the
    * std::optional returned contains no value.
+   *
+   * If `n_bytes` is non-null, it's set to the size of the received message.
+   * If `budget` is non-null, it's set to how long the client will wait for a
+   * response (0ms if it will wait indefinitely). If `trace` is non-null, it's
+   * set to the request's trace context (empty if it isn't sampled).
    */
-  std::optional<Request> recv_request();
+  std::optional<Request> recv_request(size_t* n_bytes = nullptr,
+                                      milliseconds* budget = nullptr,
+                                      TraceContext* trace = nullptr);
   /*
    * Sends a given response to the client, returning true on success.
+   *
+   * If `n_bytes` is non-null, it's set to the size of the sent message.
+   */
+  bool send_response(const Response& response, size_t* n_bytes = nullptr);
+
+  /*
+   * Maps the client's shared-memory channel (see FEATURE_SHARED_MEMORY),
+   * returning false if it can't. The connection switches over to it once the
+   * next response (the HelloResponse) has been sent.
    */
-  bool send_response(Response response);
+  bool attach_shm(const std::string& name);
 
  private:
   // Mutexes to prevent sending/receiving from multiple threads at once
   std::mutex send_mtx;
   std::mutex recv_mtx;
+  // Every response is serialized into `send_msg`, and every request received
+  // into `recv_msg`, so that their buffers are reused rather than allocated
+  // per message. Guarded by `send_mtx` and `recv_mtx`, respectively.
+  Message send_msg{};
+  Message recv_msg{};
+  // The shared-memory channel messages go through instead of the socket, if
+  // any, and the one to switch to after the next response.
+  std::unique_ptr<ShmChannel> shm;
+  std::unique_ptr<ShmChannel> next_shm;
 };
 
 /*
@@ -79,6 +113,14 @@ struct ServerConn {
   // The address (hostname:port) server-client communication occurs over
   std::string address;
 
+  // Whether to compress large requests; set by negotiate()
+  std::atomic<bool> compress = false;
+
+  // Whether messages go through shared memory; set by negotiate()
+  bool uses_shm() const {
+    return this->shm != nullptr;
+  }
+
   /*
    * Shuts down communication over the socket associated with the connection and
    * destroys it.
@@ -90,9 +132,27 @@ struct ServerConn {
   bool shutdown();
 
   /*
-   * Sends a given request to the server, returning true on success.
+   * Asks the server for `features` (FEATURE_*s) on this connection, and turns
+   * on the ones it agrees to. Must be called before any other request; returns
+   * false if the server didn't answer. With FEATURE_SHARED_MEMORY, this
+   * creates the ShmChannel to offer the server; if the server can't open it
+   * (say, because it's on another host), the socket is used as usual.
+   */
+  bool negotiate(uint32_t features);
+  /*
+   * Sends a given request to the server, returning true on success. If
+   * `budget` is non-zero, the server drops the request if it can't start on it
+   * within `budget`. The request carries the calling thread's trace context,
+   * if it has one (see Tracer).
+   */
+  bool send_request(const Request& request, milliseconds budget = 0ms);
+  /*
+   * Sends a Put (or Append, if `append`) of `value` as a series of
+   * PutChunkRequests of at most VALUE_CHUNK_SIZE bytes each, returning true on
+   * success. The server answers once, after the last chunk.
    */
-  bool send_request(Request request);
+  bool send_chunked(const std::string& key, const std::string& value,
+                    bool append, uint64_t ttl_ms = 0);
   /*
    * Receives a response from the server, if one has been sent. Otherwise, if
    * the server has disconnected, no request has been sent, or an error occurs,
@@ -104,6 +164,12 @@ struct ServerConn {
   // Mutexes to prevent sending/receiving from multiple threads at once
   std::mutex send_mtx;
   std::mutex recv_mtx;
+  // Reused for every request sent and response received, as in ClientConn.
+  Message send_msg{};
+  Message recv_msg{};
+  // The shared-memory channel messages go through instead of the socket, if
+  // the server agreed to one.
+  std::unique_ptr<ShmChannel> shm;
 };
 
 /*
@@ -114,9 +180,11 @@ struct ServerConn {
 std::shared_ptr<ClientConn> accept_client(int listener_fd);
 
 /*
- * Establishes a connection to a server at the specified address.
- * On success, returns a shared pointer to a ServerConn wrapper of the server
- * connection, and a null pointer otherwise.
+ * Establishes a connection to a server at the specified address, or to the
+ * first server that's up of a comma-separated list of addresses (say, the
+ * nodes of a replicated shardcontroller). On success, returns a shared pointer
+ * to a ServerConn wrapper of the server connection, and a null pointer
+ * otherwise.
  */
 std::shared_ptr<ServerConn> connect_to_server(const std::string& server_addr);
 
@@ -1,5 +1,62 @@
 #include "net/network_helpers.hpp"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/un.h>
+
+bool is_unix_address(std::string_view address) {
+  return address.starts_with(UNIX_ADDRESS_PREFIX);
+}
+
+// Fills in `addr` with the path of the unix:path `address`. Returns false if
+// the path doesn't fit.
+static bool to_sockaddr_un(const std::string& address, sockaddr_un* addr) {
+  std::string path = address.substr(UNIX_ADDRESS_PREFIX.size());
+  if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+    cerr_color(RED, "Invalid address: ", address);
+    return false;
+  }
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+static int open_unix_listener_socket(const std::string& address) {
+  sockaddr_un addr;
+  if (!to_sockaddr_un(address, &addr)) return -1;
+  int listener_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener_fd == -1) {
+    perror_color(RED, "socket");
+    return -1;
+  }
+  // As SO_REUSEADDR does for ports, take over the path of a socket left
+  // behind
+  unlink(addr.sun_path);
+  if (bind(listener_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+    close(listener_fd);
+    perror_color(RED, "bind");
+    return -1;
+  }
+  if (listen(listener_fd, BACKLOG) < 0) {
+    close(listener_fd);
+    perror_color(RED, "listen");
+    return -1;
+  }
+  return listener_fd;
+}
+
+// Waits until `fd` is ready for `events`, for up to `timeout`. Returns false if
+// it timed out.
+static bool wait_until_ready(int fd, short events, milliseconds timeout) {
+  struct pollfd pfd = {fd, events, 0};
+  int ret;
+  do {
+    ret = poll(&pfd, 1, std::max(timeout.count(), milliseconds::rep(1)));
+  } while (ret == -1 && errno == EINTR);
+  return ret != 0;
+}
+
 int sendall(int fd, void* buf, size_t len, int flags, milliseconds timeout) {
   size_t n_sent = 0, n_to_send = len;
   char* data = (char*)buf;
@@ -17,10 +74,54 @@ int sendall(int fd, void* buf, size_t len, int flags, milliseconds timeout) {
     }
 
     // update bytes sent; if not completed, network is likely saturated, so
-    // wait
+    // wait until the socket can take more (or we run out of time)
     n_sent += curr;
-    if (n_sent < n_to_send) {
-      if (timeout > 0ms) std::this_thread::sleep_for(timeout / 10);
+    if (n_sent < n_to_send && timeout > 0ms) {
+      auto left = timeout - duration_cast<milliseconds>(system_clock::now() -
+                                                        begin);
+      if (!wait_until_ready(fd, POLLOUT, left)) return ETIMEOUT;
+    }
+  }
+  return n_sent;
+}
+
+int sendallv(int fd, struct iovec* iov, int iovcnt, int flags,
+             milliseconds timeout) {
+  size_t n_sent = 0;
+  auto begin = system_clock::now();
+  while (true) {
+    // Skip over the buffers already sent
+    while (iovcnt > 0 && iov->iov_len == 0) {
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt == 0) break;
+    if (timeout > 0ms &&
+        duration_cast<milliseconds>(system_clock::now() - begin) > timeout) {
+      return ETIMEOUT;
+    }
+
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    ssize_t curr = sendmsg(fd, &msg, flags);
+    if (curr <= 0) {
+      return curr;
+    }
+    n_sent += curr;
+    for (size_t left = curr; left > 0; iov++, iovcnt--) {
+      size_t n = std::min(left, iov->iov_len);
+      iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+      iov->iov_len -= n;
+      left -= n;
+      if (iov->iov_len > 0) break;
+    }
+
+    // As in sendall, wait until the socket can take more
+    if (iovcnt > 0 && timeout > 0ms) {
+      auto left = timeout - duration_cast<milliseconds>(system_clock::now() -
+                                                        begin);
+      if (!wait_until_ready(fd, POLLOUT, left)) return ETIMEOUT;
     }
   }
   return n_sent;
@@ -42,17 +143,21 @@ int recvall(int fd, void* buf, size_t len, int flags, milliseconds timeout) {
       return curr;
     }
 
-    // update bytes sent; if not completed, network is likely saturated, so
-    // wait
+    // update bytes received; if not completed, the rest is still in flight,
+    // so wait until more arrives (or we run out of time)
     n_recvd += curr;
-    if (n_recvd < n_to_recv) {
-      if (timeout > 0ms) std::this_thread::sleep_for(timeout / 10);
+    if (n_recvd < n_to_recv && timeout > 0ms) {
+      auto left = timeout - duration_cast<milliseconds>(system_clock::now() -
+                                                        begin);
+      if (!wait_until_ready(fd, POLLIN, left)) return ETIMEOUT;
     }
   }
   return n_recvd;
 }
 
-int open_listener_socket(const std::string& address) {
+int open_listener_socket(const std::string& address, bool reuse_port) {
+  if (is_unix_address(address)) return open_unix_listener_socket(address);
+
   size_t splitIdx = address.find(':');
   if (splitIdx == std::string::npos) {
     cerr_color(RED, "Invalid address: ", address);
@@ -97,6 +202,13 @@ int open_listener_socket(const std::string& address) {
       perror_color(YELLOW, "setsockopt");
       continue;
     }
+    // SO_REUSEPORT lets several sockets listen on the same port at once
+    if (reuse_port && setsockopt(listener_fd, SOL_SOCKET, SO_REUSEPORT, &yes,
+                                 sizeof(yes)) == -1) {
+      close(listener_fd);
+      perror_color(YELLOW, "setsockopt");
+      continue;
+    }
 
     // assign name to the desired socket
     if ((ret = bind(listener_fd, cur->ai_addr, cur->ai_addrlen)) == -1) {
@@ -125,7 +237,61 @@ int open_listener_socket(const std::string& address) {
   return listener_fd;
 };
 
-int connect_to_address(const std::string& address) {
+std::vector<int> open_listener_sockets(const std::string& address, size_t n) {
+  std::vector<int> listener_fds;
+  if (is_unix_address(address)) {
+    int listener_fd = open_unix_listener_socket(address);
+    if (listener_fd < 0) return {};
+    listener_fds.push_back(listener_fd);
+    while (listener_fds.size() < n) {
+      int dup_fd = dup(listener_fd);
+      if (dup_fd < 0) {
+        for (int fd : listener_fds) close(fd);
+        return {};
+      }
+      listener_fds.push_back(dup_fd);
+    }
+    return listener_fds;
+  }
+  for (size_t i = 0; i < n; i++) {
+    int listener_fd = open_listener_socket(address, n > 1);
+    if (listener_fd < 0) {
+      for (int fd : listener_fds) close(fd);
+      return {};
+    }
+    listener_fds.push_back(listener_fd);
+  }
+  return listener_fds;
+}
+
+// Connects `cfd` to `addr`, first making it non-blocking if `nonblocking`, in
+// which case a connection that's still under way counts as a success.
+static int start_connect(int cfd, const sockaddr* addr, socklen_t addrlen,
+                         bool nonblocking) {
+  if (nonblocking) fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+  int ret = connect(cfd, addr, addrlen);
+  if (ret == -1 && nonblocking && errno == EINPROGRESS) return 0;
+  return ret;
+}
+
+int connect_to_address(const std::string& address, bool nonblocking) {
+  if (is_unix_address(address)) {
+    sockaddr_un addr;
+    if (!to_sockaddr_un(address, &addr)) return -1;
+    int cfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (cfd == -1) {
+      perror_color(YELLOW, "socket");
+      return -1;
+    }
+    if (start_connect(cfd, (struct sockaddr*)&addr, sizeof(addr),
+                      nonblocking) == -1) {
+      close(cfd);
+      perror_color(YELLOW, "connect");
+      return -1;
+    }
+    return cfd;
+  }
+
   size_t splitIdx = address.find(':');
   if (splitIdx == std::string::npos) {
     cerr_color(RED, "Invalid address: ", address);
@@ -153,7 +319,8 @@ int connect_to_address(const std::string& address) {
       continue;
     }
 
-    if ((ret = connect(cfd, cur->ai_addr, cur->ai_addrlen)) == -1) {
+    if ((ret = start_connect(cfd, cur->ai_addr, cur->ai_addrlen,
+                             nonblocking)) == -1) {
       close(cfd);
       perror_color(YELLOW, "connect");
       continue;
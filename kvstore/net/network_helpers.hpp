@@ -7,11 +7,13 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <chrono>
 #include <iostream>
 #include <optional>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -23,6 +25,14 @@ using namespace std::chrono;
 
 #define ETIMEOUT -2
 
+// Addresses starting with this are paths of Unix domain sockets (say,
+// "unix:/tmp/kvstore.sock"), for clients on the same host as their server;
+// any other address is hostname:port, over TCP.
+constexpr std::string_view UNIX_ADDRESS_PREFIX = "unix:";
+
+// Whether `address` is a Unix domain socket's, rather than hostname:port.
+bool is_unix_address(std::string_view address);
+
 /*
  * Sends/receives all of the bytes in buf, according to len. Times out after the
  * specified amount if timeout > 0 (in this case, returns ETIMEOUT. Otherwise,
@@ -32,20 +42,45 @@ int sendall(int fd, void* buf, size_t len, int flags,
             milliseconds timeout = 0ms);
 int recvall(int fd, void* buf, size_t len, int flags,
             milliseconds timeout = 0ms);
+/*
+ * Like sendall, but sends the `iovcnt` buffers in `iov` back to back, in as
+ * few syscalls as it can. `iov` is used up as it's sent.
+ */
+int sendallv(int fd, struct iovec* iov, int iovcnt, int flags,
+             milliseconds timeout = 0ms);
 
 /*
- * Opens a listener socket on the specified address (hostname:port).
- * On success, a file descriptor for the new socket is returned.  On error, -1
- * is returned.
+ * Opens a listener socket on the specified address (hostname:port, or
+ * unix:path). On success, a file descriptor for the new socket is returned.
+ * On error, -1 is returned.
+ *
+ * If `reuse_port`, the socket is opened with SO_REUSEPORT, so that other
+ * sockets opened that way can listen on the same port; the kernel then spreads
+ * incoming connections across them. A Unix domain socket's path replaces
+ * whatever was there before (say, the socket of a server that crashed).
+ */
+int open_listener_socket(const std::string& address, bool reuse_port = false);
+
+/*
+ * Opens `n` listener sockets on the specified address, sharing its port with
+ * SO_REUSEPORT if `n` is more than 1. Each has its own accept queue (of
+ * BACKLOG connections), so they can be accepted from in parallel. Unix domain
+ * sockets can't share a path, so for those, all `n` share one socket (and
+ * queue). On error, closes the sockets it opened and returns an empty vector.
  */
-int open_listener_socket(const std::string& address);
+std::vector<int> open_listener_sockets(const std::string& address, size_t n);
 
 /*
- * Establishes a connection to the specified address.
+ * Establishes a connection to the specified address (hostname:port, or
+ * unix:path).
  * On success, a file descriptor for the new socket is returned.  On error, -1
  * is returned.
+ *
+ * If `nonblocking`, the socket is non-blocking, and the connection may still
+ * be under way when it's returned: the socket becomes writable once it's set
+ * up, and SO_ERROR then says whether that failed.
  */
-int connect_to_address(const std::string& address);
+int connect_to_address(const std::string& address, bool nonblocking = false);
 
 /*
  * Creates an address string of hostname:port, from the current host and given
@@ -1,17 +1,55 @@
 #include "net/network_messages.hpp"
 
+#include <array>
 #include <cassert>
 #include <chrono>
+#include <optional>
+#include <utility>
 
+#include "common/compression.hpp"
 #include "net/network_helpers.hpp"
 
+// Every message starts with its type, its size (in network order, as a
+// size_t), and its budget (in network order), then its payload.
+void encode_header(const Message& msg, std::byte* header) {
+  size_t size_nbo = htonl(msg.sz);
+  uint32_t budget_nbo = htonl(msg.budget_ms);
+  memcpy(header, &msg.type, sizeof(msg.type));
+  memcpy(header + sizeof(msg.type), &size_nbo, sizeof(size_nbo));
+  memcpy(header + sizeof(msg.type) + sizeof(size_nbo), &budget_nbo,
+         sizeof(budget_nbo));
+}
+
+void decode_header(const std::byte* header, Message* msg) {
+  size_t size_nbo;
+  uint32_t budget_nbo;
+  memcpy(&msg->type, header, sizeof(msg->type));
+  memcpy(&size_nbo, header + sizeof(msg->type), sizeof(size_nbo));
+  memcpy(&budget_nbo, header + sizeof(msg->type) + sizeof(size_nbo),
+         sizeof(budget_nbo));
+  msg->sz = ntohl(size_nbo);
+  msg->budget_ms = ntohl(budget_nbo);
+}
+
+void reserve_buffer(std::vector<std::byte>* buf, size_t size) {
+  if (size > buf->capacity()) {
+    buf->reserve(std::max(size, 2 * buf->capacity()));
+  }
+}
+
 bool send_message(int fd, Message* msg, milliseconds timeout) {
   // must specify non-zero timeout
   assert(timeout > 0ms);
   assert(msg->sz == msg->buf.size());
 
-  // First, send message type
-  int curr = sendall(fd, &msg->type, sizeof(msg->type), MSG_NOSIGNAL);
+  // The header and payload go in one syscall (and, if small, one packet):
+  // sent separately, Nagle's algorithm would hold the payload back until the
+  // header was acknowledged
+  std::byte header[MESSAGE_HEADER_SIZE];
+  encode_header(*msg, header);
+  struct iovec iov[2] = {{header, MESSAGE_HEADER_SIZE},
+                         {msg->buf.data(), msg->buf.size()}};
+  int curr = sendallv(fd, iov, 2, MSG_NOSIGNAL, timeout);
   if (curr < 0) {
     if (curr == ETIMEOUT) {
       // Print if timed out
@@ -22,34 +60,7 @@ bool send_message(int fd, Message* msg, milliseconds timeout) {
     }
     return false;
   }
-  assert(curr == sizeof(msg->type));
-
-  // Convert size to network order, then send
-  size_t size_nbo = htonl(msg->sz);
-  curr = sendall(fd, &size_nbo, sizeof(size_nbo), MSG_NOSIGNAL);
-  if (curr < 0) {
-    if (curr == ETIMEOUT) {
-      cerr_color(RED, "Send on ", fd, " timed out.");
-    } else if (errno != EBADF && errno != EPIPE) {
-      perror_color(RED, "send");
-    }
-    return false;
-  }
-  assert(curr == sizeof(size_nbo));
-
-  if (msg->sz > 0) {
-    std::byte* data = &msg->buf[0];
-    curr = sendall(fd, data, msg->sz, 0, timeout);
-    if (curr < 0) {
-      if (curr == ETIMEOUT) {
-        cerr_color(RED, "Send on ", fd, " timed out.");
-      } else if (errno != EBADF && errno != EPIPE) {
-        perror_color(RED, "send");
-      }
-      return false;
-    }
-    assert(size_t(curr) == msg->sz);
-  }
+  assert(size_t(curr) == MESSAGE_HEADER_SIZE + msg->sz);
 
   return true;
 }
@@ -58,8 +69,9 @@ bool recv_message(int fd, Message* msg, milliseconds timeout) {
   // must specify non-zero timeout
   assert(timeout > 0ms);
 
-  // get message type
-  int curr = recvall(fd, &msg->type, sizeof(msg->type), 0);
+  // get the header, which says how much to read into the buffer
+  std::byte header[MESSAGE_HEADER_SIZE];
+  int curr = recvall(fd, header, MESSAGE_HEADER_SIZE, 0);
   if (curr == 0) {
     // In this case, recv got an EOF, so other end closed the connection.
     return false;
@@ -73,26 +85,13 @@ bool recv_message(int fd, Message* msg, milliseconds timeout) {
     }
     return false;
   }
-  assert(curr == sizeof(msg->type));
-
-  // get size; need this to inform how much to read into the vector
-  curr = recvall(fd, &msg->sz, sizeof(msg->sz), 0);
-  if (curr == 0) {
-    return false;
-  } else if (curr < 0) {
-    if (curr == ETIMEOUT) {
-      cerr_color(RED, "Recv on ", fd, " timed out.");
-    } else if (errno != EBADF) {
-      perror_color(RED, "recv");
-    }
-    return false;
-  }
-  // Convert to host order
-  msg->sz = ntohl(msg->sz);
-  assert(curr == sizeof(msg->sz));
+  assert(curr == MESSAGE_HEADER_SIZE);
+  decode_header(header, msg);
 
+  // A reused buffer keeps its capacity, so only grows for larger messages
+  reserve_buffer(&msg->buf, msg->sz);
+  msg->buf.resize(msg->sz);
   if (msg->sz > 0) {
-    msg->buf.resize(msg->sz);
     std::byte* data = &msg->buf[0];
     curr = recvall(fd, data, msg->sz, 0, timeout);
     if (curr == 0) {
@@ -111,56 +110,223 @@ bool recv_message(int fd, Message* msg, milliseconds timeout) {
   return true;
 }
 
+void encode_message(const Message& msg, std::vector<std::byte>* out) {
+  assert(msg.sz == msg.buf.size());
+  // Same layout as send_message
+  size_t offset = out->size();
+  reserve_buffer(out, offset + MESSAGE_HEADER_SIZE + msg.buf.size());
+  out->resize(offset + MESSAGE_HEADER_SIZE);
+  encode_header(msg, out->data() + offset);
+  out->insert(out->end(), msg.buf.begin(), msg.buf.end());
+}
+
+size_t decode_message(const std::byte* data, size_t len, Message* msg) {
+  if (len < MESSAGE_HEADER_SIZE) return 0;
+  Message header{};
+  decode_header(data, &header);
+  if (len < MESSAGE_HEADER_SIZE + header.sz) return 0;
+
+  msg->type = header.type;
+  msg->sz = header.sz;
+  msg->budget_ms = header.budget_ms;
+  const std::byte* payload = data + MESSAGE_HEADER_SIZE;
+  msg->buf.assign(payload, payload + header.sz);
+  return MESSAGE_HEADER_SIZE + header.sz;
+}
+
+// Set in the type of a message whose payload is compressed. Types are sent as
+// ints, and every MessageType is far below it.
+constexpr int COMPRESSED_MESSAGE = 1 << 30;
+
+void compress_message(Message* msg) {
+  if (msg->buf.size() < WIRE_COMPRESSION_MIN) return;
+  std::string compressed = lz_compress(std::string_view(
+      reinterpret_cast<const char*>(msg->buf.data()), msg->buf.size()));
+  if (compressed.size() > msg->buf.size() - msg->buf.size() / 8) return;
+
+  auto* bytes = reinterpret_cast<const std::byte*>(compressed.data());
+  msg->buf.assign(bytes, bytes + compressed.size());
+  msg->sz = msg->buf.size();
+  msg->type = MessageType(int(msg->type) | COMPRESSED_MESSAGE);
+}
+
+bool decompress_message(Message* msg) {
+  if (!(int(msg->type) & COMPRESSED_MESSAGE)) return true;
+  std::optional<std::string> payload = lz_decompress(std::string_view(
+      reinterpret_cast<const char*>(msg->buf.data()), msg->buf.size()));
+  if (!payload) return false;
+
+  auto* bytes = reinterpret_cast<const std::byte*>(payload->data());
+  msg->buf.assign(bytes, bytes + payload->size());
+  msg->sz = msg->buf.size();
+  msg->type = MessageType(int(msg->type) & ~COMPRESSED_MESSAGE);
+  return true;
+}
+
+// Set in the type of a message with a trace context after its payload.
+constexpr int TRACED_MESSAGE = 1 << 29;
+
+void attach_trace(Message* msg) {
+  if (!msg->trace) return;
+  uint64_t ids[2] = {msg->trace.trace_id, msg->trace.span_id};
+  auto* bytes = reinterpret_cast<const std::byte*>(ids);
+  msg->buf.insert(msg->buf.end(), bytes, bytes + sizeof(ids));
+  msg->sz = msg->buf.size();
+  msg->type = MessageType(int(msg->type) | TRACED_MESSAGE);
+}
+
+bool detach_trace(Message* msg) {
+  msg->trace = {};
+  if (!(int(msg->type) & TRACED_MESSAGE)) return true;
+  uint64_t ids[2];
+  if (msg->buf.size() < sizeof(ids)) return false;
+  memcpy(ids, msg->buf.data() + msg->buf.size() - sizeof(ids), sizeof(ids));
+  msg->buf.resize(msg->buf.size() - sizeof(ids));
+  msg->sz = msg->buf.size();
+  msg->trace = TraceContext{ids[0], ids[1]};
+  msg->type = MessageType(int(msg->type) & ~TRACED_MESSAGE);
+  return true;
+}
+
 #include "common/zpp_bits.hpp"
 
-std::optional<Message> serialize_request(Request request) {
-  Message msg{};
+namespace {
+
+template <typename T>
+constexpr bool is_optional = false;
+template <typename T>
+constexpr bool is_optional<std::optional<T>> = true;
+
+template <typename T>
+constexpr bool is_pair = false;
+template <typename T, typename U>
+constexpr bool is_pair<std::pair<T, U>> = true;
+
+template <typename T>
+constexpr bool is_array = false;
+template <typename T, size_t N>
+constexpr bool is_array<std::array<T, N>> = true;
+
+// The exact number of bytes zpp::bits serializes `item` into (with its
+// default options: sizes of strings and containers as 4-byte prefixes).
+template <typename T>
+size_t wire_size(const T& item) {
+  if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T> ||
+                std::is_same_v<T, std::byte>) {
+    return sizeof(T);
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return sizeof(uint32_t) + item.size();
+  } else if constexpr (is_optional<T>) {
+    return sizeof(std::byte) + (item ? wire_size(*item) : 0);
+  } else if constexpr (is_pair<T>) {
+    return wire_size(item.first) + wire_size(item.second);
+  } else if constexpr (is_array<T>) {
+    size_t size = 0;
+    for (auto&& element : item) size += wire_size(element);
+    return size;
+  } else if constexpr (requires { item.begin(), item.size(); }) {
+    using Element = std::remove_cvref_t<decltype(*item.begin())>;
+    if constexpr (std::is_arithmetic_v<Element> ||
+                  std::is_same_v<Element, std::byte>) {
+      return sizeof(uint32_t) + item.size() * sizeof(Element);
+    } else {
+      size_t size = sizeof(uint32_t);
+      for (auto&& element : item) size += wire_size(element);
+      return size;
+    }
+  } else {
+    return zpp::bits::access::visit_members(
+        item, [](const auto&... members) {
+          return (size_t(0) + ... + wire_size(members));
+        });
+  }
+}
+
+// Serializes `payload` as the body of `msg`, straight into its buffer, which
+// is sized for it up front (and only reallocated if it's too small).
+template <typename T>
+bool write_payload(MessageType type, const T& payload, Message* msg) {
+  size_t size = wire_size(payload);
+  reserve_buffer(&msg->buf, size);
+  msg->buf.resize(size);
+  msg->type = type;
+
+  zpp::bits::out out(msg->buf);
+  if (!success(out(payload))) return false;
+  assert(out.position() == size);
+  // Set size, for easier network parsing
+  msg->sz = msg->buf.size();
+  return true;
+}
 
+}  // namespace
+
+bool serialize_request(const Request& request, Message* msg) {
   // Serialize into message, depending on type
-  auto out = zpp::bits::output(msg.buf);
   if (auto* req = std::get_if<JoinRequest>(&request)) {
-    msg.type = MessageType::JOIN;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::JOIN, *req, msg);
   } else if (auto* req = std::get_if<LeaveRequest>(&request)) {
-    msg.type = MessageType::LEAVE;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::LEAVE, *req, msg);
   } else if (auto* req = std::get_if<MoveRequest>(&request)) {
-    msg.type = MessageType::MOVE;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::MOVE, *req, msg);
   } else if (auto* req = std::get_if<QueryRequest>(&request)) {
-    msg.type = MessageType::QUERY;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::QUERY, *req, msg);
   } else if (auto* req = std::get_if<GetRequest>(&request)) {
-    msg.type = MessageType::GET;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::GET, *req, msg);
   } else if (auto* req = std::get_if<PutRequest>(&request)) {
-    msg.type = MessageType::PUT;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::PUT, *req, msg);
   } else if (auto* req = std::get_if<AppendRequest>(&request)) {
-    msg.type = MessageType::APPEND;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::APPEND, *req, msg);
   } else if (auto* req = std::get_if<DeleteRequest>(&request)) {
-    msg.type = MessageType::DELETE;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::DELETE, *req, msg);
   } else if (auto* req = std::get_if<MultiGetRequest>(&request)) {
-    msg.type = MessageType::MULTI_GET;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::MULTI_GET, *req, msg);
   } else if (auto* req = std::get_if<MultiPutRequest>(&request)) {
-    msg.type = MessageType::MULTI_PUT;
-    if (!success(out(*req))) return std::nullopt;
+    return write_payload(MessageType::MULTI_PUT, *req, msg);
+  } else if (auto* req = std::get_if<CasRequest>(&request)) {
+    return write_payload(MessageType::CAS, *req, msg);
+  } else if (auto* req = std::get_if<IncrRequest>(&request)) {
+    return write_payload(MessageType::INCR, *req, msg);
+  } else if (auto* req = std::get_if<StatsRequest>(&request)) {
+    return write_payload(MessageType::STATS, *req, msg);
+  } else if (auto* req = std::get_if<PutChunkRequest>(&request)) {
+    return write_payload(MessageType::PUT_CHUNK, *req, msg);
+  } else if (auto* req = std::get_if<GetChunkRequest>(&request)) {
+    return write_payload(MessageType::GET_CHUNK, *req, msg);
+  } else if (auto* req = std::get_if<HelloRequest>(&request)) {
+    return write_payload(MessageType::HELLO, *req, msg);
+  } else if (auto* req = std::get_if<TxnReadRequest>(&request)) {
+    return write_payload(MessageType::TXN_READ, *req, msg);
+  } else if (auto* req = std::get_if<TxnPrepareRequest>(&request)) {
+    return write_payload(MessageType::TXN_PREPARE, *req, msg);
+  } else if (auto* req = std::get_if<TxnFinishRequest>(&request)) {
+    return write_payload(MessageType::TXN_FINISH, *req, msg);
+  } else if (auto* req = std::get_if<TxnStatusRequest>(&request)) {
+    return write_payload(MessageType::TXN_STATUS, *req, msg);
+  } else if (auto* req = std::get_if<RaftVoteRequest>(&request)) {
+    return write_payload(MessageType::RAFT_VOTE, *req, msg);
+  } else if (auto* req = std::get_if<RaftAppendRequest>(&request)) {
+    return write_payload(MessageType::RAFT_APPEND, *req, msg);
+  } else if (auto* req = std::get_if<ScanRequest>(&request)) {
+    return write_payload(MessageType::SCAN, *req, msg);
+  } else if (auto* req = std::get_if<WatchRequest>(&request)) {
+    return write_payload(MessageType::WATCH, *req, msg);
+  } else if (auto* req = std::get_if<GetLeaseRequest>(&request)) {
+    return write_payload(MessageType::GET_LEASE, *req, msg);
   } else {
     throw std::logic_error{
         "Invalid request variant! Please post privately on Edstem if this "
         "occurs."};
   }
+}
 
-  // Set size, for easier network parsing
-  msg.sz = msg.buf.size();
-
+std::optional<Message> serialize_request(const Request& request) {
+  Message msg{};
+  if (!serialize_request(request, &msg)) return std::nullopt;
   return msg;
 }
 
-std::optional<Request> deserialize_request(Message message) {
+std::optional<Request> deserialize_request(const Message& message) {
   Request request;
   // Deserialize from message, depending on type
   auto in = zpp::bits::input(message.buf);
@@ -168,61 +334,151 @@ std::optional<Request> deserialize_request(Message message) {
     case MessageType::JOIN: {
       JoinRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::LEAVE: {
       LeaveRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::MOVE: {
       MoveRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::QUERY: {
       QueryRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::GET: {
       GetRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::PUT: {
       PutRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::APPEND: {
       AppendRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::DELETE: {
       DeleteRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::MULTI_GET: {
       MultiGetRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
       break;
     }
     case MessageType::MULTI_PUT: {
       MultiPutRequest req{};
       if (!success(in(req))) return std::nullopt;
-      request = req;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::CAS: {
+      CasRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::INCR: {
+      IncrRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::STATS: {
+      StatsRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::PUT_CHUNK: {
+      PutChunkRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::GET_CHUNK: {
+      GetChunkRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::HELLO: {
+      HelloRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::TXN_READ: {
+      TxnReadRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::TXN_PREPARE: {
+      TxnPrepareRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::TXN_FINISH: {
+      TxnFinishRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::TXN_STATUS: {
+      TxnStatusRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::RAFT_VOTE: {
+      RaftVoteRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::RAFT_APPEND: {
+      RaftAppendRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::SCAN: {
+      ScanRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::WATCH: {
+      WatchRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
+      break;
+    }
+    case MessageType::GET_LEASE: {
+      GetLeaseRequest req{};
+      if (!success(in(req))) return std::nullopt;
+      request = std::move(req);
       break;
     }
     default:
@@ -235,57 +491,72 @@ std::optional<Request> deserialize_request(Message message) {
   return request;
 }
 
-std::optional<Message> serialize_response(Response response) {
-  Message msg{};
-
+bool serialize_response(const Response& response, Message* msg) {
   // Serialize into message, depending on type
-  auto out = zpp::bits::output(msg.buf);
   if (auto* res = std::get_if<JoinResponse>(&response)) {
-    msg.type = MessageType::JOIN;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::JOIN, *res, msg);
   } else if (auto* res = std::get_if<LeaveResponse>(&response)) {
-    msg.type = MessageType::LEAVE;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::LEAVE, *res, msg);
   } else if (auto* res = std::get_if<MoveResponse>(&response)) {
-    msg.type = MessageType::MOVE;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::MOVE, *res, msg);
   } else if (auto* res = std::get_if<QueryResponse>(&response)) {
-    msg.type = MessageType::QUERY;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::QUERY, *res, msg);
   } else if (auto* res = std::get_if<GetResponse>(&response)) {
-    msg.type = MessageType::GET;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::GET, *res, msg);
   } else if (auto* res = std::get_if<PutResponse>(&response)) {
-    msg.type = MessageType::PUT;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::PUT, *res, msg);
   } else if (auto* res = std::get_if<AppendResponse>(&response)) {
-    msg.type = MessageType::APPEND;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::APPEND, *res, msg);
   } else if (auto* res = std::get_if<DeleteResponse>(&response)) {
-    msg.type = MessageType::DELETE;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::DELETE, *res, msg);
   } else if (auto* res = std::get_if<MultiGetResponse>(&response)) {
-    msg.type = MessageType::MULTI_GET;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::MULTI_GET, *res, msg);
   } else if (auto* res = std::get_if<MultiPutResponse>(&response)) {
-    msg.type = MessageType::MULTI_PUT;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::MULTI_PUT, *res, msg);
+  } else if (auto* res = std::get_if<CasResponse>(&response)) {
+    return write_payload(MessageType::CAS, *res, msg);
+  } else if (auto* res = std::get_if<IncrResponse>(&response)) {
+    return write_payload(MessageType::INCR, *res, msg);
+  } else if (auto* res = std::get_if<StatsResponse>(&response)) {
+    return write_payload(MessageType::STATS, *res, msg);
+  } else if (auto* res = std::get_if<GetChunkResponse>(&response)) {
+    return write_payload(MessageType::GET_CHUNK, *res, msg);
+  } else if (auto* res = std::get_if<HelloResponse>(&response)) {
+    return write_payload(MessageType::HELLO, *res, msg);
+  } else if (auto* res = std::get_if<TxnReadResponse>(&response)) {
+    return write_payload(MessageType::TXN_READ, *res, msg);
+  } else if (auto* res = std::get_if<TxnPrepareResponse>(&response)) {
+    return write_payload(MessageType::TXN_PREPARE, *res, msg);
+  } else if (auto* res = std::get_if<TxnFinishResponse>(&response)) {
+    return write_payload(MessageType::TXN_FINISH, *res, msg);
+  } else if (auto* res = std::get_if<TxnStatusResponse>(&response)) {
+    return write_payload(MessageType::TXN_STATUS, *res, msg);
+  } else if (auto* res = std::get_if<RaftVoteResponse>(&response)) {
+    return write_payload(MessageType::RAFT_VOTE, *res, msg);
+  } else if (auto* res = std::get_if<RaftAppendResponse>(&response)) {
+    return write_payload(MessageType::RAFT_APPEND, *res, msg);
+  } else if (auto* res = std::get_if<ScanResponse>(&response)) {
+    return write_payload(MessageType::SCAN, *res, msg);
+  } else if (auto* res = std::get_if<WatchResponse>(&response)) {
+    return write_payload(MessageType::WATCH, *res, msg);
+  } else if (auto* res = std::get_if<GetLeaseResponse>(&response)) {
+    return write_payload(MessageType::GET_LEASE, *res, msg);
   } else if (auto* res = std::get_if<ErrorResponse>(&response)) {
-    msg.type = MessageType::ERROR;
-    if (!success(out(*res))) return std::nullopt;
+    return write_payload(MessageType::ERROR, *res, msg);
   } else {
     throw std::logic_error{
         "Invalid response variant! Please post privately on Edstem if this "
         "occurs."};
   }
+}
 
-  // Set size, for easier network parsing
-  msg.sz = msg.buf.size();
-
+std::optional<Message> serialize_response(const Response& response) {
+  Message msg{};
+  if (!serialize_response(response, &msg)) return std::nullopt;
   return msg;
 }
 
-std::optional<Response> deserialize_response(Message message) {
+std::optional<Response> deserialize_response(const Message& message) {
   Response response;
   // Deserialize from message, depending on type
   auto in = zpp::bits::input(message.buf);
@@ -293,67 +564,151 @@ std::optional<Response> deserialize_response(Message message) {
     case MessageType::JOIN: {
       JoinResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::LEAVE: {
       LeaveResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::MOVE: {
       MoveResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::QUERY: {
       QueryResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::GET: {
       GetResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::PUT: {
       PutResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::APPEND: {
       AppendResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::DELETE: {
       DeleteResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::MULTI_GET: {
       MultiGetResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     case MessageType::MULTI_PUT: {
       MultiPutResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::CAS: {
+      CasResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::INCR: {
+      IncrResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::STATS: {
+      StatsResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::GET_CHUNK: {
+      GetChunkResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::HELLO: {
+      HelloResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::TXN_READ: {
+      TxnReadResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::TXN_PREPARE: {
+      TxnPrepareResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::TXN_FINISH: {
+      TxnFinishResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::TXN_STATUS: {
+      TxnStatusResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::RAFT_VOTE: {
+      RaftVoteResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::RAFT_APPEND: {
+      RaftAppendResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::SCAN: {
+      ScanResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::WATCH: {
+      WatchResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
+      break;
+    }
+    case MessageType::GET_LEASE: {
+      GetLeaseResponse res{};
+      if (!success(in(res))) return std::nullopt;
+      response = std::move(res);
       break;
     }
     case MessageType::ERROR: {
       ErrorResponse res{};
       if (!success(in(res))) return std::nullopt;
-      response = res;
+      response = std::move(res);
       break;
     }
     default:
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "common/color.hpp"
+#include "common/trace.hpp"
 #include "net/network_helpers.hpp"
 #include "net/server_commands.hpp"
 #include "net/shardcontroller_commands.hpp"
@@ -23,11 +24,26 @@ enum class MessageType {
   DELETE,
   MULTI_GET,
   MULTI_PUT,
+  CAS,
+  INCR,
+  STATS,
+  PUT_CHUNK,
+  GET_CHUNK,
+  HELLO,
+  TXN_READ,
+  TXN_PREPARE,
+  TXN_FINISH,
+  TXN_STATUS,
+  SCAN,
+  WATCH,
+  GET_LEASE,
   // Shardcontroller messages
   JOIN,
   LEAVE,
   MOVE,
   QUERY,
+  RAFT_VOTE,
+  RAFT_APPEND,
   // Error
   ERROR
 };
@@ -35,41 +51,105 @@ enum class MessageType {
 struct Message {
   MessageType type;
   size_t sz = 0;
+  // How long the sender will wait for a reply to this message, in
+  // milliseconds, or 0 for no limit. Servers drop requests that have already
+  // waited longer than this, rather than doing work nobody will read.
+  uint32_t budget_ms = 0;
+  // The sampled trace the message was sent on behalf of, if any (see
+  // Tracer). Sent after the payload, and only when set, by attach_trace().
+  TraceContext trace{};
   std::vector<std::byte> buf;
 
   size_t size() {
-    return sizeof(type) + sizeof(sz) + buf.size();
+    return sizeof(type) + sizeof(sz) + sizeof(budget_ms) + buf.size();
   }
 };
 
-// Generic send/receive message helper functions.
+// Generic send/receive message helper functions. recv_message reuses `msg`'s
+// buffer, so receiving into the same Message each time only allocates when a
+// message is larger than any before it.
 bool send_message(int fd, Message* msg, milliseconds timeout = 400ms);
 bool recv_message(int fd, Message* msg, milliseconds timeout = 400ms);
 
+// Makes room for `size` bytes in `buf`, growing it geometrically if it needs
+// to grow at all.
+void reserve_buffer(std::vector<std::byte>* buf, size_t size);
+
+// Size of the header that frames every message (see network_messages.cpp).
+constexpr size_t MESSAGE_HEADER_SIZE =
+    sizeof(MessageType) + sizeof(size_t) + sizeof(uint32_t);
+// Writes `msg`'s header (MESSAGE_HEADER_SIZE bytes) to `header`, and reads one
+// back into `msg`'s type, size and budget, for transports that frame messages
+// themselves.
+void encode_header(const Message& msg, std::byte* header);
+void decode_header(const std::byte* header, Message* msg);
+
+// Helpers for non-blocking sockets, which can't use send/recv_message.
+// Appends `msg`, framed exactly as send_message sends it, to `out`.
+void encode_message(const Message& msg, std::vector<std::byte>* out);
+// Decodes the framed message at the front of the `len` bytes at `data` into
+// `msg`. Returns the number of bytes it took up, or 0 if the whole message
+// hasn't arrived yet.
+size_t decode_message(const std::byte* data, size_t len, Message* msg);
+
+// Appends `msg`'s trace context, if it has one, to its payload, marking its
+// type as traced; detach_trace() takes it back off into `msg->trace`. Done
+// outside of compression, so that the receiver can read it first. Returns
+// false if a traced payload is too short to hold the context.
+void attach_trace(Message* msg);
+bool detach_trace(Message* msg);
+
+// Payloads at least this large are sent compressed on connections that turned
+// on FEATURE_COMPRESSION, if they compress well.
+constexpr size_t WIRE_COMPRESSION_MIN = 1024;
+
+// Compresses `msg`'s payload in place (with lz_compress), marking its type as
+// compressed, if that shrinks it by at least an eighth.
+void compress_message(Message* msg);
+// Undoes compress_message, if `msg` was compressed. Returns false if its
+// payload is corrupt.
+bool decompress_message(Message* msg);
+
 // define a generic Error response message.
 struct ErrorResponse {
   std::string msg;
+  // If non-zero, the server is overloaded, and the request may be retried
+  // after this many milliseconds.
+  uint32_t retry_after_ms = 0;
 };
 
 using Request = std::variant<
     // Shardcontroller requests
-    JoinRequest, LeaveRequest, MoveRequest, QueryRequest,
+    JoinRequest, LeaveRequest, MoveRequest, QueryRequest, RaftVoteRequest,
+    RaftAppendRequest,
     // KvServer requests
     GetRequest, PutRequest, AppendRequest, DeleteRequest, MultiGetRequest,
-    MultiPutRequest>;
+    MultiPutRequest, CasRequest, IncrRequest, StatsRequest, PutChunkRequest,
+    GetChunkRequest, HelloRequest, TxnReadRequest, TxnPrepareRequest,
+    TxnFinishRequest, TxnStatusRequest, ScanRequest, WatchRequest,
+    GetLeaseRequest>;
 using Response = std::variant<
     // Shardcontroller responses
-    JoinResponse, LeaveResponse, MoveResponse, QueryResponse,
+    JoinResponse, LeaveResponse, MoveResponse, QueryResponse, RaftVoteResponse,
+    RaftAppendResponse,
     // KvServer responses
     GetResponse, PutResponse, AppendResponse, DeleteResponse, MultiGetResponse,
-    MultiPutResponse,
+    MultiPutResponse, CasResponse, IncrResponse, StatsResponse,
+    GetChunkResponse, HelloResponse, TxnReadResponse, TxnPrepareResponse,
+    TxnFinishResponse, TxnStatusResponse, ScanResponse, WatchResponse,
+    GetLeaseResponse,
     // Error response
     ErrorResponse>;
 
-std::optional<Message> serialize_request(Request request);
-std::optional<Request> deserialize_request(Message message);
+// Serialize into `msg`, reusing its buffer: it's sized to fit exactly, and
+// only reallocated if it has less capacity than that.
+bool serialize_request(const Request& request, Message* msg);
+bool serialize_response(const Response& response, Message* msg);
+
+std::optional<Message> serialize_request(const Request& request);
+std::optional<Request> deserialize_request(const Message& message);
 
-std::optional<Message> serialize_response(Response response);
-std::optional<Response> deserialize_response(Message message);
+std::optional<Message> serialize_response(const Response& response);
+std::optional<Response> deserialize_response(const Message& message);
 
 #endif /* end of include guard */
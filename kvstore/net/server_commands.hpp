@@ -1,10 +1,20 @@
 #ifndef NET_SERVER_COMMANDS_HPP
 #define NET_SERVER_COMMANDS_HPP
 
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <variant>
 #include <vector>
 
+// Values larger than this are sent (and stored) in chunks of at most this
+// size, so that no single message or allocation has to hold a whole large
+// value.
+constexpr size_t VALUE_CHUNK_SIZE = 1 << 20;
+// Largest value a chunked Put or Append may upload; servers fail larger
+// uploads (rather than stage them in memory without bound).
+constexpr size_t MAX_VALUE_SIZE = size_t(1) << 30;
+
 // Requests
 struct GetRequest {
   std::string key;
@@ -13,6 +23,8 @@ struct GetRequest {
 struct PutRequest {
   std::string key;
   std::string value;
+  // Time-to-live in milliseconds; 0 means the key never expires.
+  uint64_t ttl_ms = 0;
 };
 
 struct AppendRequest {
@@ -31,6 +43,129 @@ struct MultiGetRequest {
 struct MultiPutRequest {
   std::vector<std::string> keys;
   std::vector<std::string> values;
+  // Time-to-live (in milliseconds) applied to every key; 0 means no expiry.
+  uint64_t ttl_ms = 0;
+};
+
+// Atomically sets `key` to `value` if its current value equals `expected`.
+struct CasRequest {
+  std::string key;
+  std::string expected;
+  std::string value;
+};
+
+// Atomically adds `delta` to the integer value of `key`; a nonexistent key
+// counts as 0.
+struct IncrRequest {
+  std::string key;
+  int64_t delta;
+};
+
+// Requests the server's operation counters and latencies.
+struct StatsRequest {};
+
+// One chunk of a Put (or Append, if `append`) of a value larger than
+// VALUE_CHUNK_SIZE. Clients send every chunk of the value, in order, on one
+// connection. The server stages the chunks, and only answers the `last` one,
+// with a PutResponse (or AppendResponse) once the whole value is stored.
+struct PutChunkRequest {
+  std::string key;
+  std::string chunk;
+  bool append;
+  bool last;
+  // As in PutRequest; only read from the last chunk.
+  uint64_t ttl_ms = 0;
+};
+
+// Reads up to VALUE_CHUNK_SIZE bytes of `key`'s value, starting at `offset`.
+// Gets of values larger than VALUE_CHUNK_SIZE are answered with just the first
+// chunk (as a GetChunkResponse); clients read the rest with GetChunkRequests.
+struct GetChunkRequest {
+  std::string key;
+  uint64_t offset;
+};
+
+// Optional protocol features, which a client turns on for its connection by
+// sending a HelloRequest before any other request.
+// Messages on the connection may be sent compressed (see compress_message).
+constexpr uint32_t FEATURE_COMPRESSION = 1 << 0;
+// Messages after the HelloResponse go through the shared-memory segment named
+// in the HelloRequest, instead of the socket (see net/shm_channel.hpp).
+constexpr uint32_t FEATURE_SHARED_MEMORY = 1 << 1;
+
+// Asks for `features` (a bitmask of FEATURE_*s) on this connection.
+struct HelloRequest {
+  uint32_t features;
+  // The client's ShmChannel, if it asks for FEATURE_SHARED_MEMORY.
+  std::string shm_name;
+};
+
+// Cross-shard transactions (see client/transaction.hpp). Every key a server
+// stores is covered by a versioned lock; transactions read versions along
+// with values, and commit with two-phase commit over the servers involved.
+
+// Reads `keys`' values (std::nullopt for keys that don't exist) and versions.
+struct TxnReadRequest {
+  std::vector<std::string> keys;
+};
+
+// Phase one of committing transaction `txn_id` on one of its servers: locks
+// `write_keys` until the transaction finishes, and checks that `read_keys` are
+// still at `read_versions` (keys the transaction has locked itself, here or in
+// an earlier TxnPrepareRequest, count as unchanged if they're at them). A
+// request with no writes takes no locks, so needs no TxnFinishRequest.
+// `primary` is the address of the server whose TxnFinishRequest decides whether
+// the transaction commits (empty on the primary itself).
+struct TxnPrepareRequest {
+  uint64_t txn_id;
+  std::string primary;
+  std::vector<std::string> read_keys;
+  std::vector<uint64_t> read_versions;
+  std::vector<std::string> write_keys;
+  std::vector<std::string> write_values;
+};
+
+// Phase two: applies (if `commit`) and unlocks a prepared transaction's
+// writes. On the primary, a commit fails if the transaction was aborted in
+// the meantime (see TxnStatusRequest).
+struct TxnFinishRequest {
+  uint64_t txn_id;
+  bool commit;
+};
+
+// Asks a transaction's primary whether it committed, aborting it if it hasn't
+// yet. Servers send this for transactions that have held locks for too long.
+struct TxnStatusRequest {
+  uint64_t txn_id;
+};
+
+// Most keys a ScanRequest returns at once.
+constexpr uint32_t MAX_SCAN_COUNT = 1000;
+
+// Pages through the keys, and values, a server stores. Start with an empty
+// `cursor`, then pass each response's cursor to the next request, until it
+// comes back empty. Every key stored for the whole scan is returned (once,
+// unless the server's shards change mid-scan); keys written or deleted during
+// the scan may or may not be. Pages hold at most `count` (and at most
+// MAX_SCAN_COUNT) keys, and may hold fewer, even none, before the end.
+struct ScanRequest {
+  std::string cursor;
+  uint32_t count;
+};
+
+// Streams changes to the keys starting with `prefix` (to every key, if it's
+// empty). The connection is given over to the watch: the server answers with
+// an empty WatchResponse once the watch is in place, then with a WatchResponse
+// per batch of changes, until the client closes the connection.
+struct WatchRequest {
+  std::string prefix;
+};
+
+// A Get that also asks for a read lease on `key`: until it runs out, the
+// server holds back writes to the key, so the client may answer Gets of it
+// from its own copy of the value.
+struct GetLeaseRequest {
+  std::string key;
 };
 
 // Responses
@@ -47,5 +182,113 @@ struct MultiGetResponse {
   std::vector<std::string> values;
 };
 struct MultiPutResponse {};
+struct CasResponse {
+  // Whether the swap happened, and the key's value after the request (so a
+  // failed CAS can be retried without a separate Get).
+  bool swapped;
+  std::string value;
+};
+struct IncrResponse {
+  int64_t value;
+};
+struct GetChunkResponse {
+  std::string chunk;
+  // Size of the whole value.
+  uint64_t size;
+  // Changes whenever the value does, so that a reader can tell if the value
+  // was overwritten between two of its chunks. 0 for values that aren't
+  // stored in chunks.
+  uint64_t version;
+};
+
+struct TxnReadResponse {
+  std::vector<std::optional<std::string>> values;
+  std::vector<uint64_t> versions;
+};
+struct TxnPrepareResponse {
+  // False if a read was stale, or a write's key was locked.
+  bool prepared;
+};
+struct TxnFinishResponse {
+  bool committed;
+};
+struct TxnStatusResponse {
+  bool committed;
+};
+struct ScanResponse {
+  std::vector<std::string> keys;
+  std::vector<std::string> values;
+  // Time each key has left to live, in milliseconds; 0 if it never expires.
+  std::vector<uint64_t> ttl_ms;
+  // Indices of values larger than VALUE_CHUNK_SIZE, which are cut short to
+  // their first chunk (read them whole with a Get).
+  std::vector<uint32_t> large;
+  // Where the next page starts; empty once the scan is over.
+  std::string cursor;
+};
+
+enum class WatchEventType : uint8_t { PUT, APPEND, DELETE };
+
+// A change to `key`: its new value (PUT), what was appended to it (APPEND),
+// or its removal (DELETE).
+struct WatchEvent {
+  WatchEventType type;
+  std::string key;
+  std::string value;
+};
+
+// Changes since the last WatchResponse, in the order they were made to each
+// key. A watcher that falls behind gets each key's changes merged into one
+// event; one that falls further behind than the server will queue for it has
+// changes to new keys dropped, and `lost` set: it should re-read the keys it
+// watches to catch up.
+struct WatchResponse {
+  std::vector<WatchEvent> events;
+  bool lost;
+};
+
+// `lease_ms` is how long the lease lasts, counted from when the request was
+// sent; 0 if the server granted none (say, because a write to the key is
+// waiting). Values too large for one message come as a GetChunkResponse
+// instead, without a lease.
+struct GetLeaseResponse {
+  std::string value;
+  uint32_t lease_ms;
+};
+
+// The features the server turned on: those requested that it supports.
+struct HelloResponse {
+  uint32_t features;
+};
+
+// Summary of a latency histogram; all latencies are in nanoseconds.
+struct LatencySummary {
+  uint64_t count;
+  uint64_t mean_ns;
+  uint64_t p50_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t p999_ns;
+  uint64_t max_ns;
+};
+struct OpStats {
+  std::string op;
+  // Requests that resulted in an ErrorResponse (also counted in `latency`).
+  uint64_t errors;
+  LatencySummary latency;
+};
+struct StatsResponse {
+  std::vector<OpStats> ops;
+  // Number of client connections waiting in each worker's queue.
+  std::vector<uint64_t> queue_depths;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  // Connections turned away because every worker's queue was full.
+  uint64_t shed;
+  // Requests dropped because they'd waited longer than their budget.
+  uint64_t expired;
+  // Time taken by each query of the shardcontroller (process_config).
+  LatencySummary config_refreshes;
+};
 
 #endif /* end of include guard */
@@ -1,6 +1,8 @@
 #ifndef NET_SHARDCONTROLLER_COMMANDS_HPP
 #define NET_SHARDCONTROLLER_COMMANDS_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <vector>
@@ -21,12 +23,54 @@ struct MoveRequest {
 };
 struct QueryRequest {};
 
+// Replication between the nodes of a ReplicatedShardController, which keep a
+// log of config changes in agreement using Raft.
+struct RaftEntry {
+  // Term of the leader that added this entry.
+  uint64_t term;
+  // The config change (a Join, Leave, or Move request), as a serialized
+  // message's type and body. Empty entries are no-ops.
+  int32_t type;
+  std::vector<std::byte> body;
+};
+struct RaftVoteRequest {
+  uint64_t term;
+  std::string candidate;
+  uint64_t last_log_index;
+  uint64_t last_log_term;
+};
+struct RaftAppendRequest {
+  uint64_t term;
+  std::string leader;
+  // Index and term of the entry just before `entries`.
+  uint64_t prev_log_index;
+  uint64_t prev_log_term;
+  std::vector<RaftEntry> entries;
+  uint64_t leader_commit;
+};
+
 // Responses
 struct JoinResponse {};
 struct LeaveResponse {};
 struct MoveResponse {};
 struct QueryResponse {
   ShardControllerConfig config;
+  // Changes every time the shardcontroller restarts, so that servers can tell
+  // when it did.
+  uint64_t epoch;
+  // Number of config changes (Joins, Leaves, and Moves) made so far.
+  uint64_t version;
+};
+struct RaftVoteResponse {
+  uint64_t term;
+  bool granted;
+};
+struct RaftAppendResponse {
+  uint64_t term;
+  bool success;
+  // On success, the index of the follower's last entry that matches the
+  // leader's; otherwise, the highest index worth trying next.
+  uint64_t match_index;
 };
 
 #endif /* end of include guard */
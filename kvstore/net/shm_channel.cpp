@@ -0,0 +1,280 @@
+#include "net/shm_channel.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "common/color.hpp"
+
+namespace {
+
+// Bytes in each direction's ring. Larger messages stream through it, as the
+// other side drains it.
+constexpr size_t RING_SIZE = 1 << 16;
+// Start of every segment's name, so that servers only open our segments.
+constexpr std::string_view NAME_PREFIX = "/kvstore-";
+// Marks a segment laid out as below.
+constexpr uint64_t SEGMENT_MAGIC = 0x6b7673686d303031;
+// How many times to check for data (or room) before going to sleep.
+constexpr int N_SPINS = 1000;
+// How long a side sleeps at a time, before checking the socket again.
+constexpr milliseconds LIVENESS_INTERVAL = 50ms;
+
+// Sleeps until woken, or for up to `timeout`, if `word` is still `expected`.
+// Returns false if it timed out.
+bool futex_wait(std::atomic<uint32_t>* word, uint32_t expected,
+                milliseconds timeout) {
+  struct timespec ts = {timeout.count() / 1000,
+                        (timeout.count() % 1000) * 1'000'000};
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT,
+                 expected, &ts, nullptr, 0) == 0 ||
+         errno != ETIMEDOUT;
+}
+
+void futex_wake(std::atomic<uint32_t>* word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1,
+          nullptr, nullptr, 0);
+}
+
+// Nothing is sent on the socket once the channel is in use, so if it's
+// readable (or broken), the other side has closed it.
+bool peer_closed(int fd) {
+  struct pollfd pfd = {fd, POLLIN, 0};
+  return poll(&pfd, 1, 0) != 0;
+}
+
+// Bumps `word`, waking whoever is asleep on it, if anyone.
+void notify(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting) {
+  word.fetch_add(1);
+  if (waiting.load()) futex_wake(&word);
+}
+
+// Waits until `ready()`, spinning briefly, then sleeping on `word` (which is
+// bumped whenever `ready()` may have become true) with `waiting` set. Fails if
+// the socket closes, or if `timeout` is non-zero and passes.
+template <typename Ready>
+bool wait_until(Ready ready, std::atomic<uint32_t>& word,
+                std::atomic<uint32_t>& waiting, int fd, milliseconds timeout) {
+  // Spinning only helps if the other side can run meanwhile
+  static const int n_spins =
+      std::thread::hardware_concurrency() > 1 ? N_SPINS : 0;
+  for (int i = 0; i < n_spins; i++) {
+    if (ready()) return true;
+  }
+  auto start = steady_clock::now();
+  while (!ready()) {
+    milliseconds sleep = LIVENESS_INTERVAL;
+    if (timeout > 0ms) {
+      auto left = timeout - duration_cast<milliseconds>(steady_clock::now() -
+                                                        start);
+      if (left <= 0ms) {
+        cerr_color(RED, "Shared-memory channel on ", fd, " timed out.");
+        return false;
+      }
+      sleep = std::min(sleep, left);
+    }
+    // Say we're asleep, then check again: a side that changed things since
+    // has bumped `word` already (so the futex won't wait), or will see
+    // `waiting` and wake us
+    waiting.store(1);
+    uint32_t seen = word.load();
+    bool woken = ready() || futex_wait(&word, seen, sleep);
+    waiting.store(0);
+    if (!woken && peer_closed(fd)) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+// One direction of the channel. `head` and `tail` count every byte ever
+// written and read, so the ring holds the `head - tail` bytes starting at
+// `tail % RING_SIZE`. Each side keeps to its own cache lines.
+struct ShmChannel::Ring {
+  // Written by the producer; `n_writes` is bumped after writes, for the
+  // consumer to sleep on.
+  alignas(64) std::atomic<uint64_t> head;
+  std::atomic<uint32_t> n_writes;
+  std::atomic<uint32_t> consumer_waiting;
+  // Written by the consumer; `n_reads` is bumped after reads, for the
+  // producer to sleep on.
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> n_reads;
+  std::atomic<uint32_t> producer_waiting;
+  alignas(64) std::byte data[RING_SIZE];
+};
+
+// Both processes operate on these atomics, so they can't be using locks.
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+struct ShmChannel::Segment {
+  uint64_t magic;
+  // Requests, then responses
+  Ring rings[2];
+};
+
+namespace {
+
+// Copies `len` bytes into `ring` (making each part visible as it's copied),
+// waiting for room as needed.
+template <typename Ring>
+bool write_bytes(Ring* ring, const std::byte* data, size_t len, int fd,
+                 milliseconds timeout) {
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  auto room = [&] { return RING_SIZE - (head - ring->tail.load()); };
+  while (len > 0) {
+    if (room() == 0) {
+      // Make sure the consumer is draining what's there, then wait for it
+      notify(ring->n_writes, ring->consumer_waiting);
+      if (!wait_until([&] { return room() > 0; }, ring->n_reads,
+                      ring->producer_waiting, fd, timeout)) {
+        return false;
+      }
+    }
+    size_t offset = head % RING_SIZE;
+    size_t n = std::min({len, room(), RING_SIZE - offset});
+    memcpy(ring->data + offset, data, n);
+    head += n;
+    data += n;
+    len -= n;
+    ring->head.store(head);
+  }
+  return true;
+}
+
+// Copies `len` bytes out of `ring` (freeing each part as it's copied), waiting
+// for them to arrive as needed.
+template <typename Ring>
+bool read_bytes(Ring* ring, std::byte* data, size_t len, int fd,
+                milliseconds timeout) {
+  uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+  auto available = [&] { return ring->head.load() - tail; };
+  while (len > 0) {
+    if (available() == 0) {
+      // Make sure the producer is filling the room there is, then wait for it
+      notify(ring->n_reads, ring->producer_waiting);
+      if (!wait_until([&] { return available() > 0; }, ring->n_writes,
+                      ring->consumer_waiting, fd, timeout)) {
+        return false;
+      }
+    }
+    size_t offset = tail % RING_SIZE;
+    size_t n = std::min({len, size_t(available()), RING_SIZE - offset});
+    memcpy(data, ring->data + offset, n);
+    tail += n;
+    data += n;
+    len -= n;
+    ring->tail.store(tail);
+  }
+  return true;
+}
+
+}  // namespace
+
+ShmChannel::ShmChannel(std::string name, Segment* segment, bool is_client)
+    : shm_name(std::move(name)),
+      is_client(is_client),
+      segment(segment),
+      out(&segment->rings[is_client ? 0 : 1]),
+      in(&segment->rings[is_client ? 1 : 0]) {
+}
+
+ShmChannel::~ShmChannel() {
+  if (this->is_client) this->unlink();
+  munmap(this->segment, sizeof(Segment));
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::create() {
+  // Unique on this host: no two live processes share a pid
+  static std::atomic<uint64_t> n_created{0};
+  std::string name = std::string(NAME_PREFIX) + std::to_string(getpid()) +
+                     "-" + std::to_string(n_created++);
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    perror_color(RED, "shm_open");
+    return nullptr;
+  }
+  void* addr = MAP_FAILED;
+  if (ftruncate(fd, sizeof(Segment)) == 0) {
+    addr = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+  }
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    perror_color(RED, "mmap");
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  auto* segment = new (addr) Segment{};
+  segment->magic = SEGMENT_MAGIC;
+  return std::unique_ptr<ShmChannel>(
+      new ShmChannel(std::move(name), segment, true));
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::open(const std::string& name) {
+  if (!name.starts_with(NAME_PREFIX)) return nullptr;
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  void* addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && size_t(st.st_size) == sizeof(Segment)) {
+    addr = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+  }
+  ::close(fd);
+  if (addr == MAP_FAILED) return nullptr;
+
+  auto* segment = static_cast<Segment*>(addr);
+  if (segment->magic != SEGMENT_MAGIC) {
+    munmap(addr, sizeof(Segment));
+    return nullptr;
+  }
+  return std::unique_ptr<ShmChannel>(new ShmChannel(name, segment, false));
+}
+
+void ShmChannel::unlink() {
+  if (!this->shm_name.empty()) shm_unlink(this->shm_name.c_str());
+  this->shm_name.clear();
+}
+
+bool ShmChannel::send_message(int fd, Message* msg, milliseconds timeout) {
+  assert(msg->sz == msg->buf.size());
+  std::byte header[MESSAGE_HEADER_SIZE];
+  encode_header(*msg, header);
+  if (!write_bytes(this->out, header, MESSAGE_HEADER_SIZE, fd, timeout) ||
+      !write_bytes(this->out, msg->buf.data(), msg->sz, fd, timeout)) {
+    return false;
+  }
+  notify(this->out->n_writes, this->out->consumer_waiting);
+  return true;
+}
+
+bool ShmChannel::recv_message(int fd, Message* msg, milliseconds timeout) {
+  // As with sockets, wait as long as it takes for a message to start
+  std::byte header[MESSAGE_HEADER_SIZE];
+  if (!read_bytes(this->in, header, MESSAGE_HEADER_SIZE, fd, 0ms)) {
+    return false;
+  }
+  decode_header(header, msg);
+  reserve_buffer(&msg->buf, msg->sz);
+  msg->buf.resize(msg->sz);
+  if (!read_bytes(this->in, msg->buf.data(), msg->sz, fd, timeout)) {
+    return false;
+  }
+  notify(this->in->n_reads, this->in->producer_waiting);
+  return true;
+}
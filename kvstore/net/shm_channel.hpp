@@ -0,0 +1,68 @@
+#ifndef NET_SHM_CHANNEL_HPP
+#define NET_SHM_CHANNEL_HPP
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "net/network_messages.hpp"
+
+using namespace std::chrono;
+
+/*
+ * A shared-memory transport, for a client on the same host as its server.
+ *
+ * The client creates a segment holding two single-producer, single-consumer
+ * byte rings (one for requests, one for responses), and offers its name in its
+ * HelloRequest (see FEATURE_SHARED_MEMORY). If the server can map it too,
+ * both sides send messages, framed as on a socket, through the rings from then
+ * on. Copying into the ring is all a send costs, unless the other side is
+ * asleep waiting for data, in which case it's woken with a futex.
+ *
+ * The connection's socket stays open, with nothing sent over it, so that each
+ * side notices when the other goes away: while waiting on a ring, the socket
+ * is checked every so often, and if it's been closed, the wait fails.
+ */
+class ShmChannel {
+ public:
+  // Creates a new segment, as the client's end of it; nullptr on error.
+  static std::unique_ptr<ShmChannel> create();
+  // Maps the segment called `name`, as the server's end of it; nullptr if
+  // there's no such segment (say, because the client is on another host).
+  static std::unique_ptr<ShmChannel> open(const std::string& name);
+  ~ShmChannel();
+
+  // The segment's name, for the server to open.
+  const std::string& name() const {
+    return this->shm_name;
+  }
+  // Removes the segment's name, once the server has (or hasn't) opened it.
+  // The segment itself goes away once both sides have unmapped it. The
+  // client's end does this when destroyed, if it hasn't already.
+  void unlink();
+
+  /*
+   * As send_message and recv_message, but through the ring. `fd` is the
+   * connection's socket, checked for the other side having gone away.
+   */
+  bool send_message(int fd, Message* msg, milliseconds timeout = 400ms);
+  bool recv_message(int fd, Message* msg, milliseconds timeout = 400ms);
+
+  ShmChannel(const ShmChannel&) = delete;
+  ShmChannel& operator=(const ShmChannel&) = delete;
+
+ private:
+  struct Ring;
+  struct Segment;
+
+  ShmChannel(std::string name, Segment* segment, bool is_client);
+
+  std::string shm_name;
+  bool is_client;
+  Segment* segment;
+  // The rings this end writes to and reads from.
+  Ring* out;
+  Ring* in;
+};
+
+#endif /* end of include guard */
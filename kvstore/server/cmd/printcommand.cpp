@@ -14,8 +14,12 @@ void PrintCommand::handle(const std::string& s) {
   } else if (to_lower(tokens[0]) == "config") {
     auto res = this->server->get_config();
     std::cout << res.print();
+  } else if (to_lower(tokens[0]) == "memory") {
+    std::cout << this->server->memory_report();
   } else {
-    cerr_color(RED, "Print type must be either \"store\" or \"config\".");
+    cerr_color(RED,
+               "Print type must be either \"store\", \"config\" or "
+               "\"memory\".");
   }
 }
 
@@ -24,10 +28,10 @@ std::string PrintCommand::name() const {
 }
 
 std::string PrintCommand::params() const {
-  return "<store|config>";
+  return "<store|config|memory>";
 }
 
 std::string PrintCommand::description() const {
-  return "Prints either the internal store contents, or the shardcontroller "
-         "configuration.";
+  return "Prints either the internal store contents, the shardcontroller "
+         "configuration, or the store's memory usage.";
 }
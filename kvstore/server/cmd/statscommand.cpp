@@ -0,0 +1,18 @@
+#include "statscommand.hpp"
+
+void StatsCommand::handle(const std::string&) {
+  std::cout << format_stats(this->server->get_stats());
+}
+
+std::string StatsCommand::name() const {
+  return "stats";
+}
+
+std::string StatsCommand::params() const {
+  return "";
+}
+
+std::string StatsCommand::description() const {
+  return "Prints per-operation request counts and latencies, bytes "
+         "transferred, and worker queue depths.";
+}
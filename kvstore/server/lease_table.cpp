@@ -0,0 +1,68 @@
+#include "lease_table.hpp"
+
+#include <algorithm>
+#include <thread>
+
+milliseconds LeaseTable::grant(const std::string& key,
+                               const std::function<bool()>& read) {
+  Stripe& stripe = this->stripes[stripe_for(key)];
+  std::unique_lock lock(stripe.mtx);
+  if (stripe.n_writers > 0) {
+    lock.unlock();
+    read();
+    return 0ms;
+  }
+  // Read while holding the stripe, so that no write starts between the read
+  // and the lease
+  if (!read()) return 0ms;
+
+  auto now = steady_clock::now();
+  if (stripe.expiries.size() >= stripe.sweep_at) {
+    std::erase_if(stripe.expiries,
+                  [&](const auto& entry) { return entry.second <= now; });
+    stripe.sweep_at = std::max(MIN_SWEEP_AT, 2 * stripe.expiries.size());
+  }
+  stripe.expiries[key] = now + this->duration;
+  return this->duration;
+}
+
+LeaseTable::WriteGuard LeaseTable::revoke(
+    const std::vector<std::string>& keys) {
+  WriteGuard::StripeSet stripe_ids{};
+  for (auto&& key : keys) {
+    size_t id = stripe_for(key);
+    stripe_ids[id / 64] |= uint64_t(1) << (id % 64);
+  }
+  for_each_stripe(stripe_ids, [&](Stripe& stripe) {
+    std::unique_lock lock(stripe.mtx);
+    stripe.n_writers++;
+  });
+
+  // Only now that no new leases can be granted on them are the keys' leases
+  // final
+  steady_clock::time_point last_expiry{};
+  for (auto&& key : keys) {
+    Stripe& stripe = this->stripes[stripe_for(key)];
+    std::unique_lock lock(stripe.mtx);
+    auto it = stripe.expiries.find(key);
+    if (it == stripe.expiries.end()) continue;
+    last_expiry = std::max(last_expiry, it->second);
+    stripe.expiries.erase(it);
+  }
+  if (last_expiry > steady_clock::now()) {
+    std::this_thread::sleep_until(last_expiry);
+  }
+  return WriteGuard(this, stripe_ids);
+}
+
+LeaseTable::WriteGuard::~WriteGuard() {
+  if (!this->table) return;
+  this->table->for_each_stripe(this->stripes, [](Stripe& stripe) {
+    std::unique_lock lock(stripe.mtx);
+    stripe.n_writers--;
+  });
+}
+
+size_t LeaseTable::stripe_for(const std::string& key) {
+  return std::hash<std::string>()(key) % N_STRIPES;
+}
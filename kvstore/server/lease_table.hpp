@@ -0,0 +1,93 @@
+#ifndef LEASE_TABLE_HPP
+#define LEASE_TABLE_HPP
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono;
+
+/*
+ * Read leases on keys (see GetLeaseRequest).
+ *
+ * A client holding a lease on a key answers Gets of it from its own copy, so
+ * for reads to stay linearizable, a write to a leased key waits for the lease
+ * to run out before it's applied (and acknowledged). While a write waits, or
+ * is being applied, no new leases are granted on its key, nor on the others
+ * in its stripe, so a steady stream of leased reads can't hold it back for
+ * longer than one lease.
+ */
+class LeaseTable {
+ public:
+  static constexpr size_t N_STRIPES = 256;
+
+  explicit LeaseTable(milliseconds duration) : duration(duration) {
+  }
+  LeaseTable(const LeaseTable&) = delete;
+  LeaseTable& operator=(const LeaseTable&) = delete;
+
+  // Calls `read` to read `key`, then leases the key if `read` returned true
+  // and no write to its stripe is under way. Returns how long the lease
+  // lasts, or 0ms if none was granted.
+  milliseconds grant(const std::string& key, const std::function<bool()>& read);
+
+  // Keeps new leases off the stripes of keys being written until it's
+  // destroyed, once the write has been applied.
+  class WriteGuard {
+   public:
+    // A set of stripes, one bit each, so that taking a guard doesn't
+    // allocate.
+    using StripeSet = std::array<uint64_t, N_STRIPES / 64>;
+
+    WriteGuard(LeaseTable* table, StripeSet stripes)
+        : table(table), stripes(stripes) {
+    }
+    WriteGuard(WriteGuard&& other) noexcept
+        : table(other.table), stripes(other.stripes) {
+      other.table = nullptr;
+    }
+    WriteGuard(const WriteGuard&) = delete;
+    WriteGuard& operator=(const WriteGuard&) = delete;
+    ~WriteGuard();
+
+   private:
+    LeaseTable* table;
+    StripeSet stripes;
+  };
+  // Waits for the leases on `keys` to run out, and returns a guard to hold
+  // while writing them.
+  WriteGuard revoke(const std::vector<std::string>& keys);
+
+ private:
+  struct Stripe {
+    std::mutex mtx;
+    // Writes to the stripe's keys under way (or waiting to be).
+    size_t n_writers = 0;
+    // When each leased key's lease runs out. Expired leases are swept once
+    // there are `sweep_at` of them.
+    std::unordered_map<std::string, steady_clock::time_point> expiries;
+    size_t sweep_at = MIN_SWEEP_AT;
+  };
+  static constexpr size_t MIN_SWEEP_AT = 64;
+
+  const milliseconds duration;
+  std::array<Stripe, N_STRIPES> stripes;
+
+  static size_t stripe_for(const std::string& key);
+  template <typename Fn>
+  void for_each_stripe(const WriteGuard::StripeSet& stripe_ids, Fn fn) {
+    for (size_t word = 0; word < stripe_ids.size(); word++) {
+      for (uint64_t bits = stripe_ids[word]; bits != 0; bits &= bits - 1) {
+        fn(this->stripes[word * 64 + std::countr_zero(bits)]);
+      }
+    }
+  }
+};
+
+#endif /* end of include guard */
@@ -1,20 +1,55 @@
 #include "server.hpp"
 
+#include <poll.h>
+
+namespace {
+
+// The keys a (non-transactional) request writes to.
+std::vector<std::string> written_keys(const Request& req) {
+  if (auto* put_req = std::get_if<PutRequest>(&req)) return {put_req->key};
+  if (auto* append_req = std::get_if<AppendRequest>(&req)) {
+    return {append_req->key};
+  }
+  if (auto* delete_req = std::get_if<DeleteRequest>(&req)) {
+    return {delete_req->key};
+  }
+  if (auto* multiput_req = std::get_if<MultiPutRequest>(&req)) {
+    return multiput_req->keys;
+  }
+  if (auto* cas_req = std::get_if<CasRequest>(&req)) return {cas_req->key};
+  if (auto* incr_req = std::get_if<IncrRequest>(&req)) return {incr_req->key};
+  return {};
+}
+
+}  // namespace
+
 int KvServer::start() {
   this->is_stopped = false;
 
-  // Initialize KvStore
+  // Initialize KvStore, which keeps a separate sub-store for each shard
   // TODO (Part B, Step 2): Change your underlying KvStore to the
   // ConcurrentKvStore!
-  this->store = std::make_unique<SimpleKvStore>();
+  this->store = std::make_unique<ShardedKvStore>(
+      [] { return std::make_unique<SimpleKvStore>(); });
+  // Without a shardcontroller, this server is responsible for every key
+  if (this->shardcontroller_address.empty()) {
+    this->store->Attach(WHOLE_KEYSPACE);
+  }
 
-  // Create listener socket, and start client listener
-  this->listener_fd = open_listener_socket(address);
-  if (this->listener_fd < 0) {
+  // Create listener sockets
+  CpuTopology topology = CpuTopology::detect();
+  this->listener_fds = open_listener_sockets(
+      address, ThreadLayout::listeners_for(topology, this->placement,
+                                           this->n_listeners));
+  if (this->listener_fds.empty()) {
     return -1;
   }
-  this->client_listener = std::thread(&KvServer::accept_clients_loop, this);
-  cout_color(BLUE, "Listening on: ", this->address);
+  this->layout = ThreadLayout(topology, this->placement, this->n_workers,
+                              this->listener_fds.size());
+  if (this->placement.pin_workers || this->placement.numa) {
+    cout_color(BLUE, "Placing threads (", topology.nodes.size(),
+               " NUMA node(s)):\n", this->layout.describe());
+  }
 
   // Initialize worker threads
   this->workers.resize(this->n_workers);
@@ -25,6 +60,15 @@ int KvServer::start() {
     worker = std::thread(&KvServer::work_loop, this, i);
     i++;
   }
+  this->watch_thread = std::thread(&KvServer::watch_loop, this);
+
+  // Start client listeners, once there are queues to pass connections to
+  this->shed_conns.resize(this->listener_fds.size());
+  for (size_t i = 0; i < this->listener_fds.size(); i++) {
+    this->client_listeners.emplace_back(&KvServer::accept_clients_loop, this,
+                                        i);
+  }
+  cout_color(BLUE, "Listening on: ", this->address);
 
   // If shardcontroller address not empty, connect to shardcontroller,
   // tell the shardcontroller that the server has joined, and start query
@@ -33,14 +77,14 @@ int KvServer::start() {
     this->shardcontroller_conn =
         connect_to_server(this->shardcontroller_address);
     if (!this->shardcontroller_conn) {
-      close(this->listener_fd);
+      for (int fd : this->listener_fds) close(fd);
       return -1;
     }
 
     this->shardcontroller_querier_conn =
         connect_to_server(this->shardcontroller_address);
     if (!this->shardcontroller_querier_conn) {
-      close(this->listener_fd);
+      for (int fd : this->listener_fds) close(fd);
       return -1;
     }
 
@@ -59,10 +103,10 @@ int KvServer::start() {
 void KvServer::stop() {
   this->is_stopped = true;
 
-  // Close client listener
-  shutdown(this->listener_fd, SHUT_RDWR);
-  cout_color(BLUE, "Joining client listener thread...");
-  this->client_listener.join();
+  // Close client listeners
+  for (int fd : this->listener_fds) shutdown(fd, SHUT_RDWR);
+  cout_color(BLUE, "Joining client listener threads...");
+  for (auto&& thr : this->client_listeners) thr.join();
 
   // Stop connection queue, and close & join workers
   for (size_t i = 0; i < this->n_workers; i++) {
@@ -75,6 +119,7 @@ void KvServer::stop() {
     this->conn_queue_mtxs[i].unlock();
   }
   for (auto&& thr : this->workers) thr.join();
+  if (this->watch_thread.joinable()) this->watch_thread.join();
 
   // If shardcontroller exists, tell shardcontroller the server is leaving,
   // join shardcontroller querier thread, and close shardcontroller connection
@@ -119,11 +164,16 @@ std::optional<QueryResponse> KvServer::query_shardcontroller(
     std::shared_ptr<ServerConn> conn) {
   QueryRequest req{};
 
-  if (!conn->send_request(req)) {
-    return std::nullopt;
+  std::optional<Response> res;
+  if (conn->send_request(req)) res = conn->recv_response();
+  // The shardcontroller may have restarted, closing the connection; if so,
+  // reconnect (to another node, if it's replicated) and try again
+  if (!res && conn == this->shardcontroller_querier_conn) {
+    conn = connect_to_server(this->shardcontroller_address);
+    if (!conn) return std::nullopt;
+    this->shardcontroller_querier_conn = conn;
+    if (conn->send_request(req)) res = conn->recv_response();
   }
-
-  auto res = conn->recv_response();
   if (!res) {
     return std::nullopt;
   }
@@ -131,6 +181,23 @@ std::optional<QueryResponse> KvServer::query_shardcontroller(
   if (!query_res) {
     return std::nullopt;
   }
+
+  // A new epoch means the shardcontroller restarted (or, if replicated, elected
+  // a new leader). One that persists its config still knows this server; one
+  // that doesn't needs it to join again.
+  uint64_t last_epoch = this->shardcontroller_epoch.exchange(query_res->epoch);
+  if (last_epoch != 0 && last_epoch != query_res->epoch) {
+    cout_color(YELLOW, "Shardcontroller restarted (now in epoch ",
+               query_res->epoch, ")");
+    if (!query_res->config.server_to_shards.count(this->address)) {
+      std::shared_ptr<ServerConn> join_conn =
+          connect_to_server(this->shardcontroller_address);
+      if (!join_conn || !join_conn->send_request(JoinRequest{this->address}) ||
+          !join_conn->recv_response()) {
+        cerr_color(RED, "Failed to rejoin the shardcontroller.");
+      }
+    }
+  }
   return *query_res;
 }
 
@@ -148,41 +215,18 @@ bool KvServer::process_config() {
   // TODO: Update this->config to reflect the result from querying the
   // shardcontroller
 
-  // to_transfer maps server --> [<vector of keys to transfer to server>,
-  // <vector of values to transfer to server>]
-  // You're free to use a different data structure if you'd
-  // like, although note you'll have to change our transferring code if you do
-  std::map<std::string, std::array<std::vector<std::string>, 2>> to_transfer;
-
   // TODO:
-  //  1. Get all of the server's key-value pairs (which KvStore functions
-  //  might help you with this?)
-  //  2. For each pair, check if the server is still responsible for it.
-  //  If the server is no longer responsible for the pair,
-  //  add the pair to_transfer under the key of the newly-responsible (i.e.,
-  //  destination) server and delete the pair from this server's store.
-
-  // NOTE: Comment this in to transfer the keys!
-  // // for each server responsible for moved keys:
-  // for (auto&& [s, responsible_pairs] : to_transfer) {
-  //     while (true) {
-  //         // connect to server
-  //         std::shared_ptr<ServerConn> conn = connect_to_server(s);
-  //         if (!conn) {
-  //             cerr_color(RED, "Failed to connect to server ", s);
-  //             continue;
-  //         }
-  //         // make MultiPut request
-  //         MultiPutRequest req{responsible_pairs[0], responsible_pairs[1]};
-  //         if (!conn->send_request(req)) continue;
-
-  //         // receive response, and check for success
-  //         std::optional<Response> res = conn->recv_response();
-  //         if (!res) continue;
-  //         if (std::get_if<ErrorResponse>(&*res)) continue;
-  //         break;
-  //     }
-  // }
+  //  1. For each shard this server currently owns (this->store->Shards()),
+  //  check which server is responsible for it in the new config. Detach the
+  //  parts of it that another server is now responsible for (which
+  //  ShardedKvStore function helps with this?), and transfer each detached
+  //  sub-store to its new owner using transfer_store.
+  //  2. Attach every shard that this server is newly responsible for, so that
+  //  it can accept requests (and transfers from other servers) for its keys.
+  //
+  // Detaching a whole shard is O(1), and dropping a detached sub-store frees
+  // all of its memory at once, so there's no need to Delete moved keys one by
+  // one.
 
   return true;
 }
@@ -191,25 +235,88 @@ bool KvServer::process_config() {
 /* === INTERNALS: DO NOT MODIFY BELOW THIS LINE ===  */
 /* ==================================================*/
 
-void KvServer::accept_clients_loop() {
+void KvServer::accept_clients_loop(size_t listener_id) {
+  if (!ThreadLayout::apply(this->layout.listener(listener_id))) {
+    cerr_color(YELLOW, "Couldn't place listener ", listener_id);
+  }
+
+  // This listener's own workers; with more listeners than workers, some have
+  // none, and share everyone's
+  size_t n_listeners = this->listener_fds.size();
+  std::vector<size_t> own_workers;
+  for (size_t w = listener_id; w < this->n_workers; w += n_listeners) {
+    own_workers.push_back(w);
+  }
   size_t next_worker = 0;
   // While the server is not stopped, accept clients from the listener socket,
   // then add them to the work queue.
   while (!this->is_stopped.load()) {
-    std::shared_ptr<ClientConn> client = accept_client(this->listener_fd);
+    std::shared_ptr<ClientConn> client =
+        accept_client(this->listener_fds[listener_id]);
     if (!client) {
+      this->shed_conns[listener_id].clear();
       return;
     }
     cout_color(BLUE, "Received client connection from ", client->address,
                " on socket ", client->fd);
-    this->conn_queue_mtxs[next_worker].lock();
-    this->conn_queues[next_worker].push_back(client);
-    this->conn_queue_mtxs[next_worker].unlock();
-    next_worker = (next_worker + 1) % this->n_workers;
+
+    // Go round-robin over this listener's workers, skipping over those whose
+    // queues are full, then fall back on any worker with room
+    bool queued = false;
+    client->queued_at = steady_clock::now();
+    for (size_t i = 0; i < own_workers.size() && !queued; i++) {
+      queued = this->enqueue(own_workers[next_worker], client);
+      next_worker = (next_worker + 1) % own_workers.size();
+    }
+    for (size_t w = 0; w < this->n_workers && !queued; w++) {
+      queued = this->enqueue(w, client);
+    }
+    if (!queued) this->shed(listener_id, client);
   }
 }
 
+bool KvServer::enqueue(size_t worker_id,
+                       const std::shared_ptr<ClientConn>& client) {
+  std::unique_lock lock(this->conn_queue_mtxs[worker_id]);
+  auto& queue = this->conn_queues[worker_id];
+  if (queue.size() >= this->limits.max_queued_conns) return false;
+  queue.push_back(client);
+  return true;
+}
+
+void KvServer::shed(size_t listener_id, std::shared_ptr<ClientConn> client) {
+  // How long to keep a shed connection open for the client to read its reply
+  constexpr auto SHED_LINGER = 1s;
+
+  auto& shed_conns = this->shed_conns[listener_id];
+  this->stats.record_shed();
+  auto now = steady_clock::now();
+  while (!shed_conns.empty() &&
+         now - shed_conns.front().first > SHED_LINGER) {
+    shed_conns.pop_front();
+  }
+
+  // Reply in a single non-blocking send, so that a slow client can't stall the
+  // listener. The request is never read, and closing a socket with unread data
+  // resets the connection (which can discard the reply before the client reads
+  // it), so half-close for now and close once the client has had time.
+  ErrorResponse busy{"server busy",
+                     static_cast<uint32_t>(this->limits.retry_after.count())};
+  std::optional<Message> msg = serialize_response(busy);
+  if (msg) {
+    std::vector<std::byte> frame;
+    encode_message(*msg, &frame);
+    send(client->fd, frame.data(), frame.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+  }
+  ::shutdown(client->fd, SHUT_WR);
+  shed_conns.emplace_back(now, std::move(client));
+}
+
 void KvServer::work_loop(size_t worker_id) {
+  if (!ThreadLayout::apply(this->layout.worker(worker_id))) {
+    cerr_color(YELLOW, "Couldn't place worker ", worker_id);
+  }
+
   // Each worker thread will run this function. While the server is not
   // stopped, pop an accepted connection off of the work queue, and process
   // client requests until the client closes the connection.
@@ -225,22 +332,94 @@ void KvServer::work_loop(size_t worker_id) {
       this->conn_queue_mtxs[worker_id].unlock();
       continue;
     }
+    auto dequeued_at = steady_clock::now();
 
+    // When the client's next request could have been sent, at the earliest
+    auto waiting_since = client->accepted_at;
+    bool first_request = true;
+    // The chunked Put/Append the client is in the middle of, if any
+    std::optional<ChunkedUpload> upload;
     while (true) {
-      std::optional<Request> req = client->recv_request();
+      size_t bytes_in = 0, bytes_out = 0;
+      milliseconds budget = 0ms;
+      TraceContext trace;
+      std::optional<Request> req =
+          client->recv_request(&bytes_in, &budget, &trace);
       if (!req) {
         client->close();
         break;
       }
-      Response res = this->process_request(*req);
-      if (auto* error_res = std::get_if<ErrorResponse>(&res)) {
+      auto start = steady_clock::now();
+      // The connection's time in the listener and in this worker's queue
+      // delayed its first request
+      if (trace && first_request) {
+        Tracer::global().record("accept", trace, client->accepted_at,
+                                client->queued_at);
+        Tracer::global().record("queue wait", trace, client->queued_at,
+                                dequeued_at);
+      }
+      first_request = false;
+      Span process_span("process_request", trace);
+
+      // Don't spend time on a request whose client has already given up on it
+      // (chunks of an upload are only answered as a whole, so aren't dropped)
+      bool is_chunk = std::holds_alternative<PutChunkRequest>(*req);
+      if (budget > 0ms && !is_chunk && start - waiting_since > budget) {
+        this->stats.record_expired(worker_id);
+        if (!client->send_response(ErrorResponse{"deadline exceeded"},
+                                   &bytes_out)) {
+          client->close();
+          break;
+        }
+        this->stats.record_bytes(worker_id, bytes_in, bytes_out);
+        waiting_since = steady_clock::now();
+        continue;
+      }
+
+      std::optional<Response> res;
+      if (is_chunk) {
+        res = this->process_chunk(std::get<PutChunkRequest>(std::move(*req)),
+                                  &upload);
+      } else if (auto* watch_req = std::get_if<WatchRequest>(&*req)) {
+        // The connection is the watch's from now on
+        if (!this->start_watch(client, watch_req->prefix)) client->close();
+        break;
+      } else if (auto* hello_req = std::get_if<HelloRequest>(&*req)) {
+        // Turn on the features that both sides support for this connection
+        uint32_t features = hello_req->features & FEATURES;
+        client->compress = features & FEATURE_COMPRESSION;
+        if ((features & FEATURE_SHARED_MEMORY) &&
+            !client->attach_shm(hello_req->shm_name)) {
+          features &= ~FEATURE_SHARED_MEMORY;
+        }
+        res = HelloResponse{features};
+      } else {
+        res = this->process_request(*req);
+      }
+      auto latency = steady_clock::now() - start;
+      auto* error_res = res ? std::get_if<ErrorResponse>(&*res) : nullptr;
+      if (error_res) {
         cerr_color(RED, "Request on server ", this->address,
                    " failed: ", error_res->msg);
       }
-      if (!client->send_response(res)) {
+      if (auto op = stats_op_for(*req)) {
+        this->stats.record_request(worker_id, *op, latency, error_res);
+      }
+      process_span.end();
+      if (!res) {
+        // A chunk in the middle of an upload; nothing to send back yet
+        this->stats.record_bytes(worker_id, bytes_in, 0);
+        waiting_since = steady_clock::now();
+        continue;
+      }
+      Span send_span("send", trace);
+      if (!client->send_response(*res, &bytes_out)) {
         client->close();
         break;
       }
+      send_span.end();
+      this->stats.record_bytes(worker_id, bytes_in, bytes_out);
+      waiting_since = steady_clock::now();
     }
   }
 }
@@ -269,17 +448,55 @@ bool KvServer::responsible_for(const std::vector<std::string>& keys) {
 }
 
 Response KvServer::process_request(Request req) {
+  // Writes wait out leases on their keys, then wait for transactions
+  // committing to the same keys, and make sure transactions that read the
+  // keys before them don't commit
+  std::vector<std::string> keys = written_keys(req);
+  LeaseTable::WriteGuard lease_guard = this->leases.revoke(keys);
+  TxnTable::WriteLock write_lock = this->txns.lock_for_write(keys);
+  if (!write_lock) {
+    return ErrorResponse{"key locked by an unresolved transaction"};
+  }
+
   Response res;
   if (auto* get_req = std::get_if<GetRequest>(&req)) {
     bool responsible = this->responsible_for(get_req->key);
-    GetResponse get_res;
-    if (responsible && this->store->Get(get_req, &get_res)) {
-      res = get_res;
+    // Read the first chunk; a value that doesn't fit in one is sent as a
+    // GetChunkResponse, for the client to read the rest of with
+    // GetChunkRequests
+    GetChunkRequest chunk_req{get_req->key, 0};
+    GetChunkResponse chunk_res;
+    if (responsible && this->store->GetChunk(&chunk_req, &chunk_res)) {
+      if (chunk_res.size > chunk_res.chunk.size()) {
+        res = std::move(chunk_res);
+      } else {
+        res = GetResponse{std::move(chunk_res.chunk)};
+      }
     } else {
       res = ErrorResponse{
           !responsible ? std::string("server not responsible for key")
                        : std::string("key does not exist in the KVStore")};
     }
+  } else if (auto* lease_req = std::get_if<GetLeaseRequest>(&req)) {
+    bool responsible = this->responsible_for(lease_req->key);
+    GetChunkRequest chunk_req{lease_req->key, 0};
+    GetChunkResponse chunk_res;
+    bool found = false;
+    // Large values aren't leased: the client reads them in several requests
+    milliseconds lease = this->leases.grant(lease_req->key, [&] {
+      found = responsible && this->store->GetChunk(&chunk_req, &chunk_res);
+      return found && chunk_res.size <= chunk_res.chunk.size();
+    });
+    if (!found) {
+      res = ErrorResponse{
+          !responsible ? std::string("server not responsible for key")
+                       : std::string("key does not exist in the KVStore")};
+    } else if (chunk_res.size > chunk_res.chunk.size()) {
+      res = std::move(chunk_res);
+    } else {
+      res = GetLeaseResponse{std::move(chunk_res.chunk),
+                             static_cast<uint32_t>(lease.count())};
+    }
   } else if (auto* put_req = std::get_if<PutRequest>(&req)) {
     bool responsible = this->responsible_for(put_req->key);
     PutResponse put_res;
@@ -331,16 +548,326 @@ Response KvServer::process_request(Request req) {
                               ? std::string("server not responsible for key(s)")
                               : std::string("internal KVStore error")};
     }
+  } else if (auto* cas_req = std::get_if<CasRequest>(&req)) {
+    bool responsible = this->responsible_for(cas_req->key);
+    CasResponse cas_res;
+    if (responsible && this->store->CAS(cas_req, &cas_res)) {
+      res = cas_res;
+    } else {
+      res = ErrorResponse{
+          !responsible ? std::string("server not responsible for key")
+                       : std::string("key does not exist in the KVStore")};
+    }
+  } else if (auto* incr_req = std::get_if<IncrRequest>(&req)) {
+    bool responsible = this->responsible_for(incr_req->key);
+    IncrResponse incr_res;
+    if (responsible && this->store->Incr(incr_req, &incr_res)) {
+      res = incr_res;
+    } else {
+      res = ErrorResponse{
+          !responsible ? std::string("server not responsible for key")
+                       : std::string("key's value is not an integer")};
+    }
+  } else if (auto* chunk_req = std::get_if<GetChunkRequest>(&req)) {
+    bool responsible = this->responsible_for(chunk_req->key);
+    GetChunkResponse chunk_res;
+    if (responsible && this->store->GetChunk(chunk_req, &chunk_res)) {
+      res = std::move(chunk_res);
+    } else {
+      res = ErrorResponse{
+          !responsible ? std::string("server not responsible for key")
+                       : std::string("key does not exist in the KVStore")};
+    }
+  } else if (auto* scan_req = std::get_if<ScanRequest>(&req)) {
+    ScanRequest page_req{std::move(scan_req->cursor),
+                         std::clamp<uint32_t>(scan_req->count, 1,
+                                              MAX_SCAN_COUNT)};
+    ScanResponse scan_res;
+    if (this->store->Scan(&page_req, &scan_res)) {
+      // Large values go whole in Gets of their own, not in the page
+      for (size_t i = 0; i < scan_res.values.size(); i++) {
+        if (scan_res.values[i].size() > VALUE_CHUNK_SIZE) {
+          scan_res.values[i].resize(VALUE_CHUNK_SIZE);
+          scan_res.large.push_back(i);
+        }
+      }
+      res = std::move(scan_res);
+    } else {
+      res = ErrorResponse{"invalid scan cursor"};
+    }
+  } else if (std::get_if<StatsRequest>(&req)) {
+    res = this->get_stats();
+  } else if (std::holds_alternative<TxnReadRequest>(req) ||
+             std::holds_alternative<TxnPrepareRequest>(req) ||
+             std::holds_alternative<TxnFinishRequest>(req) ||
+             std::holds_alternative<TxnStatusRequest>(req)) {
+    res = this->process_txn_request(std::move(req));
   } else {
     throw std::logic_error{"invalid variant!"};
   }
+  // While the keys are still locked, so that watchers see each key's changes
+  // in the order they were made
+  this->publish_writes(req, res);
   return res;
 }
 
+void KvServer::publish_writes(const Request& req, const Response& res) {
+  if (std::holds_alternative<ErrorResponse>(res)) return;
+  if (auto* put_req = std::get_if<PutRequest>(&req)) {
+    this->watches.publish(WatchEventType::PUT, put_req->key, put_req->value);
+  } else if (auto* append_req = std::get_if<AppendRequest>(&req)) {
+    this->watches.publish(WatchEventType::APPEND, append_req->key,
+                          append_req->value);
+  } else if (auto* delete_req = std::get_if<DeleteRequest>(&req)) {
+    this->watches.publish(WatchEventType::DELETE, delete_req->key);
+  } else if (auto* multiput_req = std::get_if<MultiPutRequest>(&req)) {
+    for (size_t i = 0; i < multiput_req->keys.size(); i++) {
+      this->watches.publish(WatchEventType::PUT, multiput_req->keys[i],
+                            multiput_req->values[i]);
+    }
+  } else if (auto* cas_req = std::get_if<CasRequest>(&req)) {
+    if (std::get<CasResponse>(res).swapped) {
+      this->watches.publish(WatchEventType::PUT, cas_req->key,
+                            cas_req->value);
+    }
+  } else if (auto* incr_req = std::get_if<IncrRequest>(&req)) {
+    this->watches.publish(WatchEventType::PUT, incr_req->key,
+                          std::to_string(std::get<IncrResponse>(res).value));
+  }
+}
+
+bool KvServer::start_watch(const std::shared_ptr<ClientConn>& client,
+                           const std::string& prefix) {
+  // How long a send may block on a watcher that has stopped reading, before
+  // the server gives up on it (rather than hold up every other watch)
+  constexpr auto WATCH_SEND_TIMEOUT = 400ms;
+
+  struct timeval timeout = {0, duration_cast<microseconds>(WATCH_SEND_TIMEOUT)
+                                   .count()};
+  if (setsockopt(client->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                 sizeof(timeout)) < 0) {
+    perror_color(YELLOW, "setsockopt");
+    return false;
+  }
+  std::shared_ptr<WatchHub::Subscription> subscription =
+      this->watches.subscribe(prefix);
+  // Let the client know changes from now on will reach it
+  if (!client->send_response(WatchResponse{})) {
+    this->watches.unsubscribe(subscription);
+    return false;
+  }
+  std::unique_lock lock(this->open_watches_mtx);
+  this->open_watches.push_back(OpenWatch{client, std::move(subscription)});
+  return true;
+}
+
+void KvServer::watch_loop() {
+  // How often to check whether clients are done, while nothing changes
+  constexpr auto WATCH_POLL_INTERVAL = 100ms;
+
+  auto finish = [this](OpenWatch& watch) {
+    this->watches.unsubscribe(watch.subscription);
+    watch.client->close();
+    return true;
+  };
+  while (!this->is_stopped) {
+    this->watches.wait_for_changes(WATCH_POLL_INTERVAL);
+    std::unique_lock lock(this->open_watches_mtx);
+    std::erase_if(this->open_watches, [&](OpenWatch& watch) {
+      // The client sends nothing once watching, so if its socket is readable,
+      // it has closed it
+      struct pollfd pfd = {watch.client->fd, POLLIN | POLLOUT, 0};
+      if (poll(&pfd, 1, 0) < 0 || (pfd.revents & ~POLLOUT)) {
+        return finish(watch);
+      }
+      // Skip a client that hasn't kept up, rather than wait on it; its
+      // changes stay queued (and merged) until it's ready for them
+      if (!(pfd.revents & POLLOUT)) return false;
+      std::optional<WatchResponse> changes = watch.subscription->take(0ms);
+      if (changes && !watch.client->send_response(*changes)) {
+        return finish(watch);
+      }
+      return false;
+    });
+  }
+
+  std::unique_lock lock(this->open_watches_mtx);
+  for (auto&& watch : this->open_watches) finish(watch);
+  this->open_watches.clear();
+}
+
+std::optional<Response> KvServer::process_chunk(
+    PutChunkRequest req, std::optional<ChunkedUpload>* upload) {
+  if (!*upload) *upload = ChunkedUpload{req.key, req.append, {}, {}};
+  ChunkedUpload& staged = **upload;
+  // Chunks of different uploads can't be interleaved on one connection
+  if (staged.error.empty() &&
+      (staged.key != req.key || staged.append != req.append)) {
+    staged.error = "interleaved chunked uploads";
+    staged.value = ChunkedValue();
+  }
+  if (staged.error.empty() &&
+      staged.value.size() + req.chunk.size() > MAX_VALUE_SIZE) {
+    staged.error = "value too large";
+    staged.value = ChunkedValue();
+  }
+  if (staged.error.empty()) staged.value.append(req.chunk);
+  if (!req.last) return std::nullopt;
+
+  ChunkedUpload done = std::move(staged);
+  upload->reset();
+  if (!done.error.empty()) return ErrorResponse{done.error};
+  if (!this->responsible_for(done.key)) {
+    return ErrorResponse{"server not responsible for key"};
+  }
+  LeaseTable::WriteGuard lease_guard = this->leases.revoke({done.key});
+  TxnTable::WriteLock write_lock = this->txns.lock_for_write({done.key});
+  if (!write_lock) {
+    return ErrorResponse{"key locked by an unresolved transaction"};
+  }
+  // Copying a ChunkedValue shares its chunks, so keep one to publish
+  if (!this->store->PutChunked(done.key, done.value, done.append,
+                               req.ttl_ms)) {
+    return ErrorResponse{"internal KVStore error"};
+  }
+  this->watches.publish(
+      done.append ? WatchEventType::APPEND : WatchEventType::PUT, done.key,
+      this->watches.empty() ? std::string() : done.value.to_string());
+  if (done.append) return AppendResponse{};
+  return PutResponse{};
+}
+
+Response KvServer::process_txn_request(Request req) {
+  if (auto* read_req = std::get_if<TxnReadRequest>(&req)) {
+    if (!this->responsible_for(read_req->keys)) {
+      return ErrorResponse{"server not responsible for key(s)"};
+    }
+    TxnReadResponse read_res;
+    auto read_values = [&] {
+      read_res.values.clear();
+      for (auto&& key : read_req->keys) {
+        GetRequest get_req{key};
+        GetResponse get_res;
+        if (this->store->Get(&get_req, &get_res)) {
+          read_res.values.push_back(std::move(get_res.value));
+        } else {
+          read_res.values.push_back(std::nullopt);
+        }
+      }
+    };
+    if (!this->txns.read(read_req->keys, read_values, &read_res.versions)) {
+      return ErrorResponse{"key locked by a transaction"};
+    }
+    return read_res;
+  }
+  if (auto* prepare_req = std::get_if<TxnPrepareRequest>(&req)) {
+    if (!this->responsible_for(prepare_req->read_keys) ||
+        !this->responsible_for(prepare_req->write_keys)) {
+      return ErrorResponse{"server not responsible for key(s)"};
+    }
+    return TxnPrepareResponse{this->txns.prepare(*prepare_req)};
+  }
+  if (auto* finish_req = std::get_if<TxnFinishRequest>(&req)) {
+    return TxnFinishResponse{
+        this->txns.finish(finish_req->txn_id, finish_req->commit)};
+  }
+  if (auto* status_req = std::get_if<TxnStatusRequest>(&req)) {
+    return TxnStatusResponse{this->txns.status(status_req->txn_id)};
+  }
+  throw std::logic_error{"invalid variant!"};
+}
+
+void KvServer::apply_txn_writes(const std::vector<std::string>& keys,
+                                const std::vector<std::string>& values) {
+  // The transaction already holds its keys' stripes, so plain writes to them
+  // can't get ahead of it while it waits
+  LeaseTable::WriteGuard lease_guard = this->leases.revoke(keys);
+  MultiPutRequest req{keys, values};
+  MultiPutResponse res;
+  if (!this->store->MultiPut(&req, &res)) {
+    cerr_color(RED, "Failed to apply a committed transaction's writes");
+    return;
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    this->watches.publish(WatchEventType::PUT, keys[i], values[i]);
+  }
+}
+
+std::optional<bool> KvServer::ask_txn_primary(const std::string& primary,
+                                              uint64_t txn_id) {
+  std::shared_ptr<ServerConn> conn = connect_to_server(primary);
+  if (!conn || !conn->send_request(TxnStatusRequest{txn_id})) {
+    return std::nullopt;
+  }
+  std::optional<Response> res = conn->recv_response();
+  if (!res) return std::nullopt;
+  auto* status_res = std::get_if<TxnStatusResponse>(&*res);
+  if (!status_res) return std::nullopt;
+  return status_res->committed;
+}
+
+void KvServer::transfer_store(const std::string& dest, KvStore& store) {
+  constexpr auto TRANSFER_RETRY_DELAY = 100ms;
+
+  // Sends a write with `send`, on a new connection to `dest`, until `dest`
+  // acknowledges it, or this server stops
+  auto deliver = [&](auto send) {
+    while (!this->is_stopped) {
+      std::shared_ptr<ServerConn> conn = connect_to_server(dest);
+      if (!conn) {
+        cerr_color(RED, "Failed to connect to server ", dest);
+      } else if (send(*conn)) {
+        std::optional<Response> res = conn->recv_response();
+        if (res && !std::get_if<ErrorResponse>(&*res)) return;
+      }
+      std::this_thread::sleep_for(TRANSFER_RETRY_DELAY);
+    }
+  };
+
+  // A page of keys at a time, so that they're never all in memory at once
+  ScanRequest scan_req{"", MAX_SCAN_COUNT};
+  do {
+    ScanResponse page{};
+    if (!store.Scan(&scan_req, &page)) {
+      cerr_color(RED, "Failed to read keys to transfer to ", dest);
+      break;
+    }
+    scan_req.cursor = std::move(page.cursor);
+    page.ttl_ms.resize(page.keys.size());
+
+    // Large values are streamed on their own, so that the MultiPut (and each
+    // message) stays small. Keys with a TTL go in Puts of their own too, since
+    // a MultiPut's keys all get the same one.
+    MultiPutRequest req{};
+    for (size_t i = 0; i < page.keys.size() && !this->is_stopped; i++) {
+      const std::string& key = page.keys[i];
+      std::string& value = page.values[i];
+      uint64_t ttl_ms = page.ttl_ms[i];
+      if (value.size() > VALUE_CHUNK_SIZE) {
+        deliver([&](ServerConn& conn) {
+          return conn.send_chunked(key, value, false, ttl_ms);
+        });
+      } else if (ttl_ms != 0) {
+        deliver([&](ServerConn& conn) {
+          return conn.send_request(PutRequest{key, value, ttl_ms});
+        });
+      } else {
+        req.keys.push_back(std::move(page.keys[i]));
+        req.values.push_back(std::move(value));
+      }
+    }
+    if (req.keys.empty()) continue;
+    deliver([&](ServerConn& conn) { return conn.send_request(req); });
+  } while (!scan_req.cursor.empty() && !this->is_stopped);
+}
+
 void KvServer::process_config_loop() {
   int failure_count = 0;
   while (!this->is_stopped) {
-    if (this->process_config()) {
+    auto start = steady_clock::now();
+    bool refreshed = this->process_config();
+    this->stats.record_config_refresh(steady_clock::now() - start);
+    if (refreshed) {
       failure_count = 0;
     } else {
       failure_count += 1;
@@ -360,16 +887,30 @@ ShardControllerConfig KvServer::get_config() {
 }
 
 std::map<std::string, std::string> KvServer::all_kvpairs() {
-  auto keys = this->store->AllKeys();
   std::map<std::string, std::string> map;
-  for (auto&& k : keys) {
-    auto req = GetRequest{k};
-    auto res = GetResponse{};
-    // Only add if key still exists
-    if (this->store->Get(&req, &res)) {
-      map[k] = res.value;
+  ScanRequest req{"", MAX_SCAN_COUNT};
+  do {
+    ScanResponse res{};
+    if (!this->store->Scan(&req, &res)) break;
+    for (size_t i = 0; i < res.keys.size(); i++) {
+      map[std::move(res.keys[i])] = std::move(res.values[i]);
     }
-  }
+    req.cursor = std::move(res.cursor);
+  } while (!req.cursor.empty());
 
   return map;
 }
+
+std::string KvServer::memory_report() {
+  return this->store->MemoryReport();
+}
+
+StatsResponse KvServer::get_stats() {
+  // Queues only exist once the server has started
+  std::vector<uint64_t> queue_depths(this->conn_queues.size());
+  for (size_t i = 0; i < queue_depths.size(); i++) {
+    std::unique_lock lock(this->conn_queue_mtxs[i]);
+    queue_depths[i] = this->conn_queues[i].size();
+  }
+  return this->stats.snapshot(std::move(queue_depths));
+}
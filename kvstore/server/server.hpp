@@ -15,25 +15,63 @@
 
 #include "kvstore/concurrent_kvstore.hpp"
 #include "kvstore/kvstore.hpp"
+#include "kvstore/sharded_kvstore.hpp"
 #include "kvstore/simple_kvstore.hpp"
 #include "net/network_conn.hpp"
 #include "net/network_helpers.hpp"
 #include "net/network_messages.hpp"
+#include "server/lease_table.hpp"
+#include "server/server_stats.hpp"
+#include "server/txn_table.hpp"
+#include "server/watch_hub.hpp"
+#include "server/worker_placement.hpp"
 
 #define N_WORKERS 5
 
 using namespace std::chrono;
 
+// Bounds on the work a KvServer takes on, so that it sheds excess load quickly
+// instead of letting every request's latency grow without bound.
+struct AdmissionLimits {
+  // Most client connections waiting in each worker's queue. Connections that
+  // arrive when every queue is full are answered with a "server busy"
+  // ErrorResponse right away.
+  size_t max_queued_conns = 128;
+  // How long turned-away clients are told to wait before retrying.
+  milliseconds retry_after = 100ms;
+};
+
 class KvServer {
  public:
-  explicit KvServer(const std::string& address, uint64_t n_workers)
-      : address(address), shardcontroller_address(), n_workers(n_workers) {
+  // Optional protocol features (see HelloRequest) the server supports.
+  static constexpr uint32_t FEATURES =
+      FEATURE_COMPRESSION | FEATURE_SHARED_MEMORY;
+  // How long read leases (see GetLeaseRequest) last: how stale a client's
+  // copy of a value may look to a writer, which waits it out.
+  static constexpr milliseconds LEASE_DURATION = 50ms;
+
+  explicit KvServer(const std::string& address, uint64_t n_workers,
+                    AdmissionLimits limits = {},
+                    WorkerPlacement placement = {}, size_t n_listeners = 1)
+      : address(address),
+        shardcontroller_address(),
+        n_workers(n_workers),
+        limits(limits),
+        placement(placement),
+        n_listeners(n_listeners),
+        stats(n_workers) {
   }
   explicit KvServer(const std::string& address,
-                    const std::string& shardcontroller_addr, uint64_t n_workers)
+                    const std::string& shardcontroller_addr, uint64_t n_workers,
+                    AdmissionLimits limits = {},
+                    WorkerPlacement placement = {}, size_t n_listeners = 1)
       : address(address),
         shardcontroller_address(shardcontroller_addr),
-        n_workers(n_workers) {
+        n_workers(n_workers),
+        limits(limits),
+        placement(placement),
+        n_listeners(n_listeners),
+        stats(n_workers) {
   }
   ~KvServer() {
     if (!this->is_stopped) {
@@ -58,6 +96,12 @@ class KvServer {
   // For debugging purposes, get the shardcontroller config from the server.
   ShardControllerConfig get_config();
 
+  // For debugging purposes, get a fragmentation report of the store's memory.
+  std::string memory_report();
+
+  // Get the server's request counters, latencies, and worker queue depths.
+  StatsResponse get_stats();
+
   // For testing purposes, make ServerTest a friend of KvServer
   // so that ServerTest can access KvServer's private fields
   friend class ServerTest;
@@ -75,8 +119,8 @@ class KvServer {
   // The address on which the server is listening.
   std::string address;
 
-  // Internal key-value store.
-  std::unique_ptr<KvStore> store;
+  // Internal key-value store, with one sub-store per shard this server owns.
+  std::unique_ptr<ShardedKvStore> store;
 
   // Persistent shardcontroller connection.
   std::shared_ptr<ServerConn> shardcontroller_conn;
@@ -93,15 +137,18 @@ class KvServer {
   // stopped.
   std::atomic<bool> is_stopped;
 
-  // Listener socket for incoming client connections.
-  int listener_fd;
-  // Thread that listens for client connections and accepts them.
-  std::thread client_listener;
+  // Listener sockets for incoming client connections.
+  std::vector<int> listener_fds;
+  // Threads that listen for client connections and accept them, one per
+  // listener socket.
+  std::vector<std::thread> client_listeners;
 
   // Thread that periodically queries the shardcontroller for the current
   // configuration.
   std::thread shardcontroller_querier;  // bro this name goofy
   std::shared_ptr<ServerConn> shardcontroller_querier_conn;
+  // The shardcontroller's epoch as of the last query (see QueryResponse).
+  std::atomic<uint64_t> shardcontroller_epoch{0};
 
   // Vector of worker threads.
   std::vector<std::thread> workers;
@@ -116,13 +163,74 @@ class KvServer {
   // Number of worker threads.
   uint64_t n_workers;
 
+  // Limits on queued work.
+  AdmissionLimits limits;
+
+  // Where workers and listeners run, and the CPUs and node each was given.
+  WorkerPlacement placement;
+  ThreadLayout layout;
+
+  // Listener sockets to accept connections on, each on its own thread. With
+  // more than one, they share the port with SO_REUSEPORT, and the kernel
+  // spreads new connections across them, so that a storm of reconnecting
+  // clients isn't admitted one accept() at a time. (With `placement.numa`,
+  // rounded up to a multiple of the number of NUMA nodes.)
+  size_t n_listeners;
+
+  // Per listener: connections that have been sent a "server busy" response,
+  // with when they were, kept open until the client has had time to read it.
+  // Only used by that listener's thread.
+  std::vector<std::deque<
+      std::pair<steady_clock::time_point, std::shared_ptr<ClientConn>>>>
+      shed_conns;
+
+  // Per-worker request statistics.
+  ServerStats stats;
+
+  // Watches on the keys in the store (see WatchRequest).
+  WatchHub watches;
+  // Connections given over to a watch, and the watch each streams. They're
+  // all served by `watch_thread`, so that an open watch doesn't keep a worker
+  // from other clients.
+  struct OpenWatch {
+    std::shared_ptr<ClientConn> client;
+    std::shared_ptr<WatchHub::Subscription> subscription;
+  };
+  std::vector<OpenWatch> open_watches;
+  std::mutex open_watches_mtx;
+  std::thread watch_thread;
+
+  // Read leases on keys in the store.
+  LeaseTable leases{LEASE_DURATION};
+
+  // Locks and versions of the keys in the store, and the transactions
+  // prepared on this server.
+  TxnTable txns{
+      [this](const std::vector<std::string>& keys,
+             const std::vector<std::string>& values) {
+        this->apply_txn_writes(keys, values);
+      },
+      &KvServer::ask_txn_primary};
+
   /**
-   * In a loop, accept client connections, then pass each connection into the
-   * work queue of client connections to process.
+   * In a loop, accept client connections on listener `listener_id`, then pass
+   * each connection into the work queue of client connections to process.
+   * Each listener has its own workers (those whose ID is congruent to its own
+   * modulo the number of listeners), and only hands connections to others
+   * when all of its own are full.
    *
    * Exits when the server has been stopped.
    */
-  void accept_clients_loop();
+  void accept_clients_loop(size_t listener_id);
+
+  // Adds a client connection to worker `worker_id`'s queue, unless it's full.
+  bool enqueue(size_t worker_id, const std::shared_ptr<ClientConn>& client);
+
+  /**
+   * Turns a client connection away with a "server busy" ErrorResponse, without
+   * blocking. Only called by listener `listener_id`'s thread.
+   */
+  void shed(size_t listener_id, std::shared_ptr<ClientConn> client);
 
   /**
    * In a loop, pop a client connection from the work queue and process a
@@ -161,11 +269,68 @@ class KvServer {
    */
   Response process_request(Request req);
 
+  // A chunked Put or Append being received on a connection.
+  struct ChunkedUpload {
+    std::string key;
+    bool append;
+    ChunkedValue value;
+    // Why the upload failed, if it did: a chunk of some other upload came in
+    // part way through, or the value grew past MAX_VALUE_SIZE. The rest of a
+    // failed upload's chunks are dropped as they come in.
+    std::string error;
+  };
+
+  /**
+   * Stages a chunk of an upload in `upload`. Returns std::nullopt until the
+   * last chunk arrives; then, stores the whole value and returns the response.
+   */
+  std::optional<Response> process_chunk(PutChunkRequest req,
+                                        std::optional<ChunkedUpload>* upload);
+
+  // Publishes the changes `req` made, if it succeeded, to the watches on
+  // their keys.
+  void publish_writes(const Request& req, const Response& res);
+
+  /**
+   * Starts serving a WatchRequest: puts the watch in place, and hands
+   * `client` over to watch_loop. Returns false if the client has gone.
+   */
+  bool start_watch(const std::shared_ptr<ClientConn>& client,
+                   const std::string& prefix);
+
+  /**
+   * Streams changes to every open watch's client, until it goes away (or the
+   * server stops).
+   */
+  void watch_loop();
+
+  /**
+   * Handles the requests of cross-shard transactions (TxnReadRequest, etc.).
+   */
+  Response process_txn_request(Request req);
+
+  // Writes a committed transaction's writes to the store.
+  void apply_txn_writes(const std::vector<std::string>& keys,
+                        const std::vector<std::string>& values);
+
+  // Asks the server at `primary` whether transaction `txn_id` committed, or
+  // std::nullopt if it couldn't.
+  static std::optional<bool> ask_txn_primary(const std::string& primary,
+                                             uint64_t txn_id);
+
   // Extracts a query response from the shardcontroller, or an std::nullopt if
-  // one doesn't exist. You might need this when implementing process_config!
+  // one doesn't exist. Reconnects the querier connection if the
+  // shardcontroller restarted, rejoining it if it forgot this server. You
+  // might need this when implementing process_config!
   std::optional<QueryResponse> query_shardcontroller(
       std::shared_ptr<ServerConn> conn);
 
+  // Streams every key-value pair in `store` (e.g., a sub-store detached from
+  // this->store) to the server at `dest`, mostly in MultiPut batches, keeping
+  // each key's remaining TTL. Retries until `dest` accepts every write, or
+  // this server stops. You might need this when implementing process_config!
+  void transfer_store(const std::string& dest, KvStore& store);
+
   // Wrapper function that calls process_config periodically.
   void process_config_loop();
 };
@@ -0,0 +1,129 @@
+#include "server_stats.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// Single-writer increment; see Histogram::record.
+void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+  counter.store(counter.load(std::memory_order_relaxed) + by,
+                std::memory_order_relaxed);
+}
+
+LatencySummary summarize(const Histogram& hist) {
+  return LatencySummary{hist.count(),
+                        static_cast<uint64_t>(hist.mean()),
+                        hist.percentile(50),
+                        hist.percentile(90),
+                        hist.percentile(99),
+                        hist.percentile(99.9),
+                        hist.max()};
+}
+
+}  // namespace
+
+std::optional<StatsOp> stats_op_for(const Request& req) {
+  if (std::holds_alternative<GetRequest>(req) ||
+      std::holds_alternative<GetLeaseRequest>(req)) {
+    return StatsOp::GET;
+  }
+  if (std::holds_alternative<PutRequest>(req)) return StatsOp::PUT;
+  if (std::holds_alternative<AppendRequest>(req)) return StatsOp::APPEND;
+  if (std::holds_alternative<DeleteRequest>(req)) return StatsOp::DELETE;
+  if (std::holds_alternative<MultiGetRequest>(req)) return StatsOp::MULTI_GET;
+  if (std::holds_alternative<MultiPutRequest>(req)) return StatsOp::MULTI_PUT;
+  if (std::holds_alternative<CasRequest>(req)) return StatsOp::CAS;
+  if (std::holds_alternative<IncrRequest>(req)) return StatsOp::INCR;
+  if (std::holds_alternative<PutChunkRequest>(req)) return StatsOp::PUT_CHUNK;
+  if (std::holds_alternative<GetChunkRequest>(req)) return StatsOp::GET_CHUNK;
+  if (std::holds_alternative<ScanRequest>(req)) return StatsOp::SCAN;
+  return std::nullopt;
+}
+
+void ServerStats::record_request(size_t worker_id, StatsOp op,
+                                 std::chrono::nanoseconds latency,
+                                 bool failed) {
+  WorkerStats& worker = this->workers[worker_id];
+  auto i = static_cast<size_t>(op);
+  worker.latencies[i].record(latency.count());
+  if (failed) bump(worker.errors[i], 1);
+}
+
+void ServerStats::record_bytes(size_t worker_id, size_t bytes_in,
+                               size_t bytes_out) {
+  WorkerStats& worker = this->workers[worker_id];
+  bump(worker.bytes_in, bytes_in);
+  bump(worker.bytes_out, bytes_out);
+}
+
+void ServerStats::record_expired(size_t worker_id) {
+  bump(this->workers[worker_id].expired, 1);
+}
+
+void ServerStats::record_shed() {
+  // There may be several listeners shedding at once
+  this->shed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerStats::record_config_refresh(std::chrono::nanoseconds duration) {
+  this->config_refreshes.record(duration.count());
+}
+
+StatsResponse ServerStats::snapshot(std::vector<uint64_t> queue_depths) const {
+  StatsResponse res{};
+  for (size_t i = 0; i < N_STATS_OPS; i++) {
+    Histogram latencies;
+    uint64_t errors = 0;
+    for (auto&& worker : this->workers) {
+      latencies.merge(worker.latencies[i]);
+      errors += worker.errors[i].load(std::memory_order_relaxed);
+    }
+    res.ops.push_back(OpStats{STATS_OP_NAMES[i], errors, summarize(latencies)});
+  }
+  for (auto&& worker : this->workers) {
+    res.bytes_in += worker.bytes_in.load(std::memory_order_relaxed);
+    res.bytes_out += worker.bytes_out.load(std::memory_order_relaxed);
+    res.expired += worker.expired.load(std::memory_order_relaxed);
+  }
+  res.shed = this->shed.load(std::memory_order_relaxed);
+  res.queue_depths = std::move(queue_depths);
+  res.config_refreshes = summarize(this->config_refreshes);
+  return res;
+}
+
+std::string format_stats(const StatsResponse& stats) {
+  auto us = [](uint64_t ns) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << ns / 1000.0;
+    return ss.str();
+  };
+  auto row = [&](std::stringstream& ss, const std::string& name,
+                 uint64_t errors, const LatencySummary& l) {
+    ss << std::left << std::setw(10) << name << std::right << std::setw(10)
+       << l.count << std::setw(8) << errors << std::setw(10) << us(l.mean_ns)
+       << std::setw(10) << us(l.p50_ns) << std::setw(10) << us(l.p90_ns)
+       << std::setw(10) << us(l.p99_ns) << std::setw(10) << us(l.p999_ns)
+       << std::setw(10) << us(l.max_ns) << "\n";
+  };
+
+  std::stringstream ss;
+  ss << std::left << std::setw(10) << "op" << std::right << std::setw(10)
+     << "count" << std::setw(8) << "errors" << std::setw(10) << "mean"
+     << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10)
+     << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max"
+     << "  (us)\n";
+  for (auto&& op : stats.ops) {
+    row(ss, op.op, op.errors, op.latency);
+  }
+  row(ss, "config", 0, stats.config_refreshes);
+
+  ss << "Bytes in: " << stats.bytes_in << ", bytes out: " << stats.bytes_out
+     << "\n";
+  ss << "Connections shed: " << stats.shed
+     << ", requests expired: " << stats.expired << "\n";
+  ss << "Worker queue depths:";
+  for (auto&& depth : stats.queue_depths) ss << " " << depth;
+  ss << "\n";
+  return ss.str();
+}
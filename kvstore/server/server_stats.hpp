@@ -0,0 +1,87 @@
+#ifndef SERVER_STATS_HPP
+#define SERVER_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common/histogram.hpp"
+#include "net/network_messages.hpp"
+
+// KvServer operations that statistics are kept for.
+enum class StatsOp {
+  GET,
+  PUT,
+  APPEND,
+  DELETE,
+  MULTI_GET,
+  MULTI_PUT,
+  CAS,
+  INCR,
+  PUT_CHUNK,
+  GET_CHUNK,
+  SCAN,
+};
+constexpr size_t N_STATS_OPS = 11;
+constexpr std::array<const char*, N_STATS_OPS> STATS_OP_NAMES = {
+    "Get", "Put",  "Append",   "Delete",   "MultiGet", "MultiPut",
+    "CAS", "Incr", "PutChunk", "GetChunk", "Scan"};
+
+// The operation a request counts towards, or std::nullopt if it isn't a
+// KvServer operation (e.g. a StatsRequest).
+std::optional<StatsOp> stats_op_for(const Request& req);
+
+/**
+ * Request counters and latency histograms for a KvServer.
+ *
+ * Every worker thread records into its own (cache-line aligned) slot, so
+ * recording never contends or bounces cache lines between workers; the slots
+ * are only aggregated when the statistics are read.
+ */
+class ServerStats {
+ public:
+  explicit ServerStats(size_t n_workers) : workers(n_workers) {
+  }
+
+  // Records a request handled by worker `worker_id`. Must only be called from
+  // that worker's thread.
+  void record_request(size_t worker_id, StatsOp op,
+                      std::chrono::nanoseconds latency, bool failed);
+  // Records the size of a request received and a response sent by worker
+  // `worker_id`. Must only be called from that worker's thread.
+  void record_bytes(size_t worker_id, size_t bytes_in, size_t bytes_out);
+  // Records a request that worker `worker_id` dropped for having waited past
+  // its budget. Must only be called from that worker's thread.
+  void record_expired(size_t worker_id);
+  // Records a connection turned away for overload, from any client listener
+  // thread.
+  void record_shed();
+  // Records the duration of a config refresh. Must only be called from the
+  // shardcontroller querier thread.
+  void record_config_refresh(std::chrono::nanoseconds duration);
+
+  // Aggregates every worker's statistics. `queue_depths` is filled in as is.
+  StatsResponse snapshot(std::vector<uint64_t> queue_depths) const;
+
+ private:
+  struct alignas(64) WorkerStats {
+    std::array<Histogram, N_STATS_OPS> latencies;
+    std::array<std::atomic<uint64_t>, N_STATS_OPS> errors{};
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> bytes_out{0};
+    std::atomic<uint64_t> expired{0};
+  };
+
+  std::deque<WorkerStats> workers;
+  std::atomic<uint64_t> shed{0};
+  Histogram config_refreshes;
+};
+
+// Human-readable table of a server's statistics, for the REPL.
+std::string format_stats(const StatsResponse& stats);
+
+#endif /* end of include guard */
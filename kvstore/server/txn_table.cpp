@@ -0,0 +1,237 @@
+#include "txn_table.hpp"
+
+#include <algorithm>
+#include <thread>
+
+bool TxnTable::read(const std::vector<std::string>& keys,
+                    const std::function<void()>& read_values,
+                    std::vector<uint64_t>* versions) {
+  std::vector<size_t> key_stripes;
+  key_stripes.reserve(keys.size());
+  for (auto&& key : keys) key_stripes.push_back(stripe_for(key));
+
+  // Like a seqlock: read the versions, then the values, then check that the
+  // versions didn't change in between
+  auto deadline = std::chrono::steady_clock::now() + LOCK_WAIT;
+  while (std::chrono::steady_clock::now() < deadline) {
+    versions->clear();
+    for (size_t stripe : key_stripes) {
+      std::optional<uint64_t> version = this->wait_unlocked(stripe, deadline);
+      if (!version) return false;
+      versions->push_back(*version);
+    }
+    read_values();
+
+    bool unchanged = true;
+    for (size_t i = 0; i < key_stripes.size() && unchanged; i++) {
+      unchanged = this->stripes[key_stripes[i]].load() == (*versions)[i] << 1;
+    }
+    if (unchanged) return true;
+  }
+  return false;
+}
+
+bool TxnTable::prepare(const TxnPrepareRequest& req) {
+  if (req.read_keys.size() != req.read_versions.size() ||
+      req.write_keys.size() != req.write_values.size()) {
+    return false;
+  }
+
+  // Lock the writes first, so that reads of the same stripes validate against
+  // versions that can no longer change. (The client locks the writes on
+  // every server before it has any reads checked, so that's true across
+  // servers too.)
+  std::vector<size_t> locked = stripes_for(req.write_keys);
+  for (size_t i = 0; i < locked.size(); i++) {
+    if (this->try_lock(locked[i], req.txn_id)) continue;
+    // A transaction that has held the lock for too long may just be gone
+    this->resolve_if_stale(this->owners[locked[i]].load());
+    if (this->try_lock(locked[i], req.txn_id)) continue;
+    for (size_t j = 0; j < i; j++) this->unlock(locked[j], false);
+    return false;
+  }
+
+  bool valid = true;
+  for (size_t i = 0; i < req.read_keys.size() && valid; i++) {
+    size_t stripe = stripe_for(req.read_keys[i]);
+    uint64_t word = this->stripes[stripe].load();
+    // Locked by this transaction, here or when it prepared its writes
+    bool locked_by_us = this->owners[stripe].load() == req.txn_id;
+    valid = word >> 1 == req.read_versions[i] &&
+            (!(word & 1) || locked_by_us);
+  }
+
+  std::unique_lock lock(this->mtx);
+  // The primary may have been asked about the transaction before it got here,
+  // and aborted it
+  if (req.primary.empty() && this->decisions.count(req.txn_id)) valid = false;
+  if (!valid || req.write_keys.empty()) {
+    lock.unlock();
+    for (size_t stripe : locked) this->unlock(stripe, false);
+    return valid;
+  }
+  this->prepared[req.txn_id] =
+      PreparedTxn{req.primary, req.write_keys, req.write_values,
+                  std::move(locked), std::chrono::steady_clock::now()};
+  return true;
+}
+
+bool TxnTable::finish(uint64_t txn_id, bool commit) {
+  std::unique_lock lock(this->mtx);
+  auto it = this->prepared.find(txn_id);
+  if (it == this->prepared.end()) {
+    // Already resolved. On the primary, that can only have been an abort,
+    // unless this is a retry of the commit; elsewhere, the outcome was
+    // whatever the primary decided, which is what the client is passing on
+    auto decision = this->decisions.find(txn_id);
+    if (decision != this->decisions.end()) return decision->second;
+    return commit;
+  }
+
+  PreparedTxn txn = std::move(it->second);
+  this->prepared.erase(it);
+  if (txn.primary.empty()) this->decide(txn_id, commit);
+  lock.unlock();
+  this->complete(std::move(txn), commit);
+  return commit;
+}
+
+bool TxnTable::status(uint64_t txn_id) {
+  std::unique_lock lock(this->mtx);
+  auto decision = this->decisions.find(txn_id);
+  if (decision != this->decisions.end()) return decision->second;
+
+  // Undecided, so abort it. If it hasn't prepared here yet, the decision
+  // makes sure it never will.
+  this->decide(txn_id, false);
+  auto it = this->prepared.find(txn_id);
+  if (it == this->prepared.end()) return false;
+  PreparedTxn txn = std::move(it->second);
+  this->prepared.erase(it);
+  lock.unlock();
+  this->complete(std::move(txn), false);
+  return false;
+}
+
+TxnTable::WriteLock::~WriteLock() {
+  if (!this->table) return;
+  for (size_t stripe : this->stripes) this->table->unlock(stripe, true);
+}
+
+TxnTable::WriteLock TxnTable::lock_for_write(
+    const std::vector<std::string>& keys) {
+  std::vector<size_t> locked = stripes_for(keys);
+  // Plain writes all lock stripes in ascending order, so can't deadlock
+  // waiting on each other, and transactions never wait for locks, so neither
+  // can a plain write waiting on one. Other plain writes only hold stripes
+  // while they write, and transactions for at most LOCK_TIMEOUT (after which
+  // they're resolved), so this only fails if a transaction can't be resolved.
+  auto spin_until = std::chrono::steady_clock::now() + LOCK_WAIT;
+  for (size_t i = 0; i < locked.size(); i++) {
+    while (!this->try_lock(locked[i], 0)) {
+      uint64_t owner = this->owners[locked[i]].load();
+      if (owner && this->resolve_if_stale(owner)) {
+        for (size_t j = 0; j < i; j++) this->unlock(locked[j], false);
+        return WriteLock(nullptr, {});
+      }
+      // Stripes are usually held briefly; don't keep a core busy waiting out
+      // the ones that aren't
+      if (std::chrono::steady_clock::now() < spin_until) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(1ms);
+      }
+    }
+  }
+  return WriteLock(this, std::move(locked));
+}
+
+size_t TxnTable::stripe_for(const std::string& key) {
+  return std::hash<std::string>()(key) % N_STRIPES;
+}
+
+std::vector<size_t> TxnTable::stripes_for(
+    const std::vector<std::string>& keys) {
+  std::vector<size_t> stripes;
+  stripes.reserve(keys.size());
+  for (auto&& key : keys) stripes.push_back(stripe_for(key));
+  std::sort(stripes.begin(), stripes.end());
+  stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+  return stripes;
+}
+
+bool TxnTable::try_lock(size_t stripe, uint64_t owner) {
+  uint64_t word = this->stripes[stripe].load();
+  if ((word & 1) ||
+      !this->stripes[stripe].compare_exchange_strong(word, word | 1)) {
+    return false;
+  }
+  this->owners[stripe].store(owner);
+  return true;
+}
+
+void TxnTable::unlock(size_t stripe, bool written) {
+  uint64_t word = this->stripes[stripe].load();
+  this->owners[stripe].store(0);
+  this->stripes[stripe].store(written ? ((word >> 1) + 1) << 1 : word & ~1ull);
+}
+
+std::optional<uint64_t> TxnTable::wait_unlocked(
+    size_t stripe, std::chrono::steady_clock::time_point deadline) {
+  while (true) {
+    uint64_t word = this->stripes[stripe].load();
+    if (!(word & 1)) return word >> 1;
+    if (std::chrono::steady_clock::now() >= deadline) return std::nullopt;
+    if (uint64_t owner = this->owners[stripe].load()) {
+      this->resolve_if_stale(owner);
+    }
+    std::this_thread::yield();
+  }
+}
+
+bool TxnTable::resolve_if_stale(uint64_t txn_id) {
+  std::unique_lock lock(this->mtx);
+  auto it = this->prepared.find(txn_id);
+  if (it == this->prepared.end() ||
+      std::chrono::steady_clock::now() - it->second.prepared_at <
+          LOCK_TIMEOUT) {
+    return false;
+  }
+
+  bool committed = false;
+  if (!it->second.primary.empty()) {
+    // Only the primary knows whether the transaction committed; don't hold up
+    // other transactions while asking it
+    std::string primary = it->second.primary;
+    lock.unlock();
+    std::optional<bool> outcome = this->ask_primary(primary, txn_id);
+    if (!outcome) return true;
+    committed = *outcome;
+    lock.lock();
+    it = this->prepared.find(txn_id);
+    // The client may have finished it in the meantime
+    if (it == this->prepared.end()) return false;
+  } else {
+    this->decide(txn_id, false);
+  }
+
+  PreparedTxn txn = std::move(it->second);
+  this->prepared.erase(it);
+  lock.unlock();
+  this->complete(std::move(txn), committed);
+  return false;
+}
+
+void TxnTable::decide(uint64_t txn_id, bool committed) {
+  if (!this->decisions.emplace(txn_id, committed).second) return;
+  this->decision_order.push_back(txn_id);
+  if (this->decision_order.size() > MAX_DECISIONS) {
+    this->decisions.erase(this->decision_order.front());
+    this->decision_order.pop_front();
+  }
+}
+
+void TxnTable::complete(PreparedTxn txn, bool commit) {
+  if (commit) this->apply(txn.write_keys, txn.write_values);
+  for (size_t stripe : txn.stripes) this->unlock(stripe, commit);
+}
@@ -0,0 +1,161 @@
+#ifndef TXN_TABLE_HPP
+#define TXN_TABLE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "net/server_commands.hpp"
+
+using namespace std::chrono_literals;
+
+/**
+ * Concurrency control for the transactions a KvServer takes part in.
+ *
+ * Every key hashes to one of N_STRIPES stripes, each a versioned lock: a
+ * version, bumped by every write to any of the stripe's keys, and a lock bit.
+ * Transactions read versions along with values (read()), then commit in two
+ * phases: prepare() locks the stripes of their writes, and checks that their
+ * reads' versions haven't changed (the client has the writes locked on every
+ * server before any reads are checked); finish() applies the writes (or not)
+ * and unlocks them. Plain writes lock their keys' stripes while they write
+ * (lock_for_write()), so that they bump versions too, and wait for each other
+ * and for transactions that are committing to the same stripes.
+ *
+ * prepare() never waits for a lock, so transactions can't deadlock: one that
+ * finds a stripe locked fails to prepare, and aborts. A transaction whose
+ * client disappears between the two phases would hold its locks forever, so
+ * once it has held them for LOCK_TIMEOUT, whoever runs into them resolves it:
+ * its primary aborts it (unless it already committed), and other servers ask
+ * the primary what became of it.
+ */
+class TxnTable {
+ public:
+  static constexpr size_t N_STRIPES = 4096;
+  static constexpr std::chrono::milliseconds LOCK_TIMEOUT = 1s;
+  // How long transactions' reads wait for a locked stripe before failing.
+  static constexpr std::chrono::milliseconds LOCK_WAIT = 20ms;
+  // Number of outcomes the primary remembers, for TxnStatusRequests.
+  static constexpr size_t MAX_DECISIONS = 1 << 16;
+
+  // Applies a committed transaction's writes to the store.
+  using ApplyFn = std::function<void(const std::vector<std::string>& keys,
+                                     const std::vector<std::string>& values)>;
+  // Asks `primary` whether transaction `txn_id` committed (see
+  // TxnStatusRequest); std::nullopt if it couldn't be reached.
+  using AskPrimaryFn = std::function<std::optional<bool>(
+      const std::string& primary, uint64_t txn_id)>;
+
+  TxnTable(ApplyFn apply, AskPrimaryFn ask_primary)
+      : apply(std::move(apply)), ask_primary(std::move(ask_primary)) {
+  }
+  TxnTable(const TxnTable&) = delete;
+  TxnTable& operator=(const TxnTable&) = delete;
+
+  // Reads the versions of `keys` into `versions`, calling `read_values` to
+  // read their values while none of them change. Returns false if some key
+  // stayed locked, or kept changing.
+  bool read(const std::vector<std::string>& keys,
+            const std::function<void()>& read_values,
+            std::vector<uint64_t>* versions);
+
+  // Phase one; see TxnPrepareRequest. Returns whether the transaction
+  // prepared (in which case it holds its locks until finish()).
+  bool prepare(const TxnPrepareRequest& req);
+  // Phase two; see TxnFinishRequest. Returns whether the transaction
+  // committed.
+  bool finish(uint64_t txn_id, bool commit);
+  // Answers a TxnStatusRequest: whether `txn_id` committed, aborting it if it
+  // hasn't been decided yet.
+  bool status(uint64_t txn_id);
+
+  // The locks on the stripes of keys being written outside of a transaction,
+  // held until it's destroyed (which bumps the stripes' versions).
+  class WriteLock {
+   public:
+    WriteLock(TxnTable* table, std::vector<size_t> stripes)
+        : table(table), stripes(std::move(stripes)) {
+    }
+    WriteLock(WriteLock&& other) noexcept
+        : table(other.table), stripes(std::move(other.stripes)) {
+      other.table = nullptr;
+    }
+    WriteLock(const WriteLock&) = delete;
+    WriteLock& operator=(const WriteLock&) = delete;
+    ~WriteLock();
+
+    // False if the locks couldn't be taken, because a transaction held one
+    // for longer than LOCK_TIMEOUT and couldn't be resolved.
+    explicit operator bool() const {
+      return this->table != nullptr;
+    }
+
+   private:
+    TxnTable* table;
+    std::vector<size_t> stripes;
+  };
+  // Waits for as long as other writes and committing transactions hold the
+  // stripes of `keys`, then locks them.
+  WriteLock lock_for_write(const std::vector<std::string>& keys);
+
+ private:
+  struct PreparedTxn {
+    // Empty if this server is the transaction's primary
+    std::string primary;
+    std::vector<std::string> write_keys;
+    std::vector<std::string> write_values;
+    // Stripes locked by the transaction, ascending
+    std::vector<size_t> stripes;
+    std::chrono::steady_clock::time_point prepared_at;
+  };
+
+  ApplyFn apply;
+  AskPrimaryFn ask_primary;
+
+  // Each stripe's version, shifted left by one, with its lowest bit set while
+  // it's locked.
+  std::array<std::atomic<uint64_t>, N_STRIPES> stripes{};
+  // The transaction holding each locked stripe (0 for plain writes).
+  std::array<std::atomic<uint64_t>, N_STRIPES> owners{};
+
+  // Protects everything below.
+  std::mutex mtx;
+  std::unordered_map<uint64_t, PreparedTxn> prepared;
+  // Outcomes of recent transactions this server was the primary of, and the
+  // order they were decided in (oldest first).
+  std::unordered_map<uint64_t, bool> decisions;
+  std::deque<uint64_t> decision_order;
+
+  static size_t stripe_for(const std::string& key);
+  // Distinct stripes of `keys`, ascending (the order they're locked in).
+  static std::vector<size_t> stripes_for(const std::vector<std::string>& keys);
+
+  bool try_lock(size_t stripe, uint64_t owner);
+  // Unlocks `stripe`, bumping its version if it was written.
+  void unlock(size_t stripe, bool written);
+  // Waits (up to `deadline`) for `stripe` to be unlocked, and returns its
+  // version; std::nullopt if it stayed locked.
+  std::optional<uint64_t> wait_unlocked(
+      size_t stripe, std::chrono::steady_clock::time_point deadline);
+
+  // Resolves transaction `txn_id` if it has held its locks for longer than
+  // LOCK_TIMEOUT. Returns true if it has, but couldn't be resolved (because
+  // its primary couldn't be reached).
+  bool resolve_if_stale(uint64_t txn_id);
+  // Records the outcome of a transaction this server is the primary of.
+  // Assumes mtx is held.
+  void decide(uint64_t txn_id, bool committed);
+  // Applies (if `commit`) a transaction taken out of `prepared`, and releases
+  // its locks.
+  void complete(PreparedTxn txn, bool commit);
+};
+
+#endif /* end of include guard */
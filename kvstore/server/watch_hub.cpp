@@ -0,0 +1,87 @@
+#include "watch_hub.hpp"
+
+std::optional<WatchResponse> WatchHub::Subscription::take(
+    milliseconds timeout) {
+  std::unique_lock lock(this->mtx);
+  if (!this->cv.wait_for(lock, timeout, [this] {
+        return !this->pending.empty() || this->lost;
+      })) {
+    return std::nullopt;
+  }
+  WatchResponse res{std::move(this->pending), this->lost};
+  this->pending.clear();
+  this->index.clear();
+  this->lost = false;
+  return res;
+}
+
+void WatchHub::Subscription::add(WatchEventType type, const std::string& key,
+                                 std::string_view value) {
+  std::unique_lock lock(this->mtx);
+  auto it = this->index.find(key);
+  if (it == this->index.end()) {
+    if (this->pending.size() >= this->max_pending) {
+      this->lost = true;
+    } else {
+      this->index.emplace(key, this->pending.size());
+      this->pending.push_back(WatchEvent{type, key, std::string(value)});
+    }
+    this->cv.notify_one();
+    return;
+  }
+
+  // The watcher hasn't seen the key's last change yet, so send the two as one
+  WatchEvent& queued = this->pending[it->second];
+  if (type == WatchEventType::APPEND) {
+    // Appending to a deleted key starts it over
+    if (queued.type == WatchEventType::DELETE) {
+      queued.type = WatchEventType::PUT;
+    }
+    queued.value.append(value);
+  } else {
+    queued.type = type;
+    queued.value.assign(value);
+  }
+}
+
+std::shared_ptr<WatchHub::Subscription> WatchHub::subscribe(
+    std::string prefix) {
+  auto subscription =
+      std::make_shared<Subscription>(std::move(prefix), this->max_pending);
+  std::unique_lock lock(this->mtx);
+  this->subscriptions.push_back(subscription);
+  this->n_subscriptions = this->subscriptions.size();
+  return subscription;
+}
+
+void WatchHub::unsubscribe(const std::shared_ptr<Subscription>& subscription) {
+  std::unique_lock lock(this->mtx);
+  std::erase(this->subscriptions, subscription);
+  this->n_subscriptions = this->subscriptions.size();
+}
+
+void WatchHub::publish(WatchEventType type, const std::string& key,
+                       std::string_view value) {
+  if (this->empty()) return;
+  bool queued = false;
+  {
+    std::shared_lock lock(this->mtx);
+    for (auto&& subscription : this->subscriptions) {
+      if (key.starts_with(subscription->prefix)) {
+        subscription->add(type, key, value);
+        queued = true;
+      }
+    }
+  }
+  if (queued) {
+    std::unique_lock lock(this->changed_mtx);
+    this->changed = true;
+    this->changed_cv.notify_one();
+  }
+}
+
+void WatchHub::wait_for_changes(milliseconds timeout) {
+  std::unique_lock lock(this->changed_mtx);
+  this->changed_cv.wait_for(lock, timeout, [this] { return this->changed; });
+  this->changed = false;
+}
@@ -0,0 +1,105 @@
+#ifndef WATCH_HUB_HPP
+#define WATCH_HUB_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "net/server_commands.hpp"
+
+using namespace std::chrono;
+
+/*
+ * Fans out changes to keys to the watches on them (see WatchRequest).
+ *
+ * Each watch has its own bounded queue of changes not yet sent. Publishing a
+ * change only ever adds it to those queues, so writers never wait on a
+ * watcher, however slow: while a watcher's queue holds a change to a key,
+ * later changes to the key are merged into it, and once it holds
+ * `max_pending` keys, changes to other keys are dropped (and the watcher told
+ * so).
+ */
+class WatchHub {
+ public:
+  // One watch's queue of changes.
+  class Subscription {
+   public:
+    explicit Subscription(std::string prefix, size_t max_pending)
+        : prefix(std::move(prefix)), max_pending(max_pending) {
+    }
+
+    // Waits up to `timeout` for changes, then takes every one queued, or
+    // returns std::nullopt if none came.
+    std::optional<WatchResponse> take(milliseconds timeout);
+
+   private:
+    friend class WatchHub;
+
+    // Queues `event`, merging it into the key's queued change if there is
+    // one.
+    void add(WatchEventType type, const std::string& key,
+             std::string_view value);
+
+    const std::string prefix;
+    const size_t max_pending;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    // Queued changes, at most one per key, in the order their keys were first
+    // changed, and where each key's change is in `pending`.
+    std::vector<WatchEvent> pending;
+    std::unordered_map<std::string, size_t> index;
+    // Whether changes were dropped since the last take().
+    bool lost = false;
+  };
+
+  // Most keys a watch's queue holds.
+  static constexpr size_t DEFAULT_MAX_PENDING = 4096;
+
+  explicit WatchHub(size_t max_pending = DEFAULT_MAX_PENDING)
+      : max_pending(max_pending) {
+  }
+
+  // Starts a watch on the keys starting with `prefix`.
+  std::shared_ptr<Subscription> subscribe(std::string prefix);
+  void unsubscribe(const std::shared_ptr<Subscription>& subscription);
+
+  // Queues a change to `key` for every watch on it. `value` is the key's new
+  // value for a PUT, and what was appended for an APPEND. Costs next to
+  // nothing while nobody is watching.
+  void publish(WatchEventType type, const std::string& key,
+               std::string_view value = {});
+
+  // Whether nobody is watching, so changes needn't be published.
+  bool empty() const {
+    return this->n_subscriptions == 0;
+  }
+
+  // Waits up to `timeout` for a change to be queued for any watch since the
+  // last call.
+  void wait_for_changes(milliseconds timeout);
+
+ private:
+  const size_t max_pending;
+
+  // Checked before taking `mtx`, so that writes don't contend on it while
+  // there are no watches.
+  std::atomic<size_t> n_subscriptions = 0;
+  std::shared_mutex mtx;
+  std::vector<std::shared_ptr<Subscription>> subscriptions;
+
+  // Set (and signaled) when a change is queued, for wait_for_changes().
+  std::mutex changed_mtx;
+  std::condition_variable changed_cv;
+  bool changed = false;
+};
+
+#endif /* end of include guard */
@@ -0,0 +1,171 @@
+#include "worker_placement.hpp"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr std::string_view NODE_DIR = "/sys/devices/system/node";
+
+// The CPUs this process may run on.
+std::vector<int> allowed_cpus() {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  std::vector<int> cpus;
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+}  // namespace
+
+std::vector<int> parse_cpu_list(std::string_view list) {
+  std::vector<int> cpus;
+  std::stringstream ss{std::string(list)};
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    int first, last;
+    if (range.find('-') != std::string::npos) {
+      if (std::sscanf(range.c_str(), "%d-%d", &first, &last) != 2) continue;
+    } else if (std::sscanf(range.c_str(), "%d", &first) == 1) {
+      last = first;
+    } else {
+      continue;
+    }
+    for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+CpuTopology CpuTopology::detect() {
+  std::vector<int> allowed = allowed_cpus();
+  CpuTopology topology;
+
+  std::error_code ec;
+  for (auto&& entry :
+       std::filesystem::directory_iterator(std::string(NODE_DIR), ec)) {
+    std::string name = entry.path().filename();
+    if (name.rfind("node", 0) != 0 ||
+        name.find_first_not_of("0123456789", 4) != std::string::npos ||
+        name.size() == 4) {
+      continue;
+    }
+    std::ifstream file(entry.path() / "cpulist");
+    std::string list;
+    std::getline(file, list);
+
+    Node node{std::stoi(name.substr(4)), {}};
+    for (int cpu : parse_cpu_list(list)) {
+      if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+        node.cpus.push_back(cpu);
+      }
+    }
+    if (!node.cpus.empty()) topology.nodes.push_back(std::move(node));
+  }
+  std::sort(topology.nodes.begin(), topology.nodes.end(),
+            [](const Node& a, const Node& b) { return a.id < b.id; });
+
+  if (topology.nodes.empty()) topology.nodes.push_back(Node{0, allowed});
+  return topology;
+}
+
+ThreadLayout::ThreadLayout(const CpuTopology& topology,
+                           WorkerPlacement placement, size_t n_workers,
+                           size_t n_listeners)
+    : workers(n_workers), listeners(n_listeners) {
+  // Without `numa`, the whole machine is one group of CPUs to place on
+  std::vector<CpuTopology::Node> groups = topology.nodes;
+  if (!placement.numa) {
+    CpuTopology::Node all{-1, {}};
+    for (auto&& node : groups) {
+      all.cpus.insert(all.cpus.end(), node.cpus.begin(), node.cpus.end());
+    }
+    std::sort(all.cpus.begin(), all.cpus.end());
+    groups = {all};
+  }
+
+  if (placement.numa) {
+    for (size_t l = 0; l < n_listeners; l++) {
+      const auto& group = groups[l % groups.size()];
+      this->listeners[l] = Slot{group.cpus, group.id};
+    }
+  }
+
+  // Workers placed on each group so far
+  std::vector<size_t> n_placed(groups.size());
+  for (size_t w = 0; w < n_workers; w++) {
+    size_t g = placement.numa ? (w % n_listeners) % groups.size() : 0;
+    const auto& group = groups[g];
+    Slot& slot = this->workers[w];
+    if (placement.pin_workers && !group.cpus.empty()) {
+      slot.cpus = {group.cpus[n_placed[g] % group.cpus.size()]};
+    } else if (placement.numa) {
+      slot.cpus = group.cpus;
+    }
+    slot.node = group.id;
+    n_placed[g]++;
+  }
+}
+
+size_t ThreadLayout::listeners_for(const CpuTopology& topology,
+                                   WorkerPlacement placement,
+                                   size_t n_listeners) {
+  n_listeners = std::max<size_t>(1, n_listeners);
+  if (!placement.numa) return n_listeners;
+  size_t n_nodes = topology.nodes.size();
+  return (n_listeners + n_nodes - 1) / n_nodes * n_nodes;
+}
+
+bool ThreadLayout::apply(const Slot& slot) {
+  bool ok = true;
+  if (!slot.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : slot.cpus) CPU_SET(cpu, &set);
+    ok &= pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+  }
+  if (slot.node >= 0) {
+    // Prefer (rather than require) the node's memory, so that allocations
+    // fall back on other nodes' when it runs out. There's no glibc wrapper
+    // for set_mempolicy, and libnuma may not be installed.
+    constexpr size_t WORD_BITS = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(slot.node / WORD_BITS + 1);
+    mask[slot.node / WORD_BITS] |= 1UL << (slot.node % WORD_BITS);
+    ok &= syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(),
+                  mask.size() * WORD_BITS + 1) == 0;
+  }
+  return ok;
+}
+
+std::string ThreadLayout::describe() const {
+  std::stringstream ss;
+  auto describe_slot = [&](const char* kind, size_t id, const Slot& slot) {
+    if (slot.cpus.empty() && slot.node < 0) return;
+    ss << kind << ' ' << id << ':';
+    if (slot.cpus.size() == 1) {
+      ss << " CPU " << slot.cpus[0];
+    } else if (!slot.cpus.empty()) {
+      ss << ' ' << slot.cpus.size() << " CPUs";
+    }
+    if (slot.node >= 0) ss << " on node " << slot.node;
+    ss << '\n';
+  };
+  for (size_t l = 0; l < this->listeners.size(); l++) {
+    describe_slot("listener", l, this->listeners[l]);
+  }
+  for (size_t w = 0; w < this->workers.size(); w++) {
+    describe_slot("worker", w, this->workers[w]);
+  }
+  return ss.str();
+}
@@ -0,0 +1,83 @@
+#ifndef WORKER_PLACEMENT_HPP
+#define WORKER_PLACEMENT_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Where a KvServer runs its threads. By default, wherever the scheduler likes.
+struct WorkerPlacement {
+  // Pin each worker thread to one CPU, going round-robin over the CPUs the
+  // server may run on (over its node's, with `numa`), so that workers don't
+  // migrate away from the caches holding their connections' and buckets' data.
+  bool pin_workers = false;
+  // Spread workers evenly over the machine's NUMA nodes, and keep each on its
+  // node: it only runs on the node's CPUs, and prefers the node's memory for
+  // its allocations. So do listeners, and each hands connections to workers on
+  // its own node, so a connection is set up and served on one node (the
+  // number of listeners is rounded up to a multiple of the number of nodes).
+  bool numa = false;
+};
+
+// The CPUs this process may run on, grouped by NUMA node.
+struct CpuTopology {
+  struct Node {
+    int id;
+    std::vector<int> cpus;
+  };
+  // Nodes with at least one such CPU, in order of ID
+  std::vector<Node> nodes;
+
+  // Reads the topology from sysfs. Without NUMA information, every CPU is
+  // taken to be on node 0.
+  static CpuTopology detect();
+};
+
+// Parses a sysfs CPU list, e.g. "0-3,8,10-11".
+std::vector<int> parse_cpu_list(std::string_view list);
+
+/*
+ * The CPUs and NUMA node each of a KvServer's workers and listeners is
+ * placed on, under a WorkerPlacement.
+ *
+ * With `numa`, listener l is on node l mod (number of nodes), and worker w on
+ * listener (w mod n_listeners)'s node, since a listener hands its connections
+ * to those workers first (see KvServer::accept_clients_loop).
+ */
+class ThreadLayout {
+ public:
+  // Where a thread runs: on any of `cpus` (anywhere, if empty), preferring
+  // `node`'s memory (any node's, if -1).
+  struct Slot {
+    std::vector<int> cpus;
+    int node = -1;
+  };
+
+  ThreadLayout() = default;
+  ThreadLayout(const CpuTopology& topology, WorkerPlacement placement,
+               size_t n_workers, size_t n_listeners);
+
+  // How many listeners to open when `n_listeners` were asked for.
+  static size_t listeners_for(const CpuTopology& topology,
+                              WorkerPlacement placement, size_t n_listeners);
+
+  const Slot& worker(size_t worker_id) const {
+    return this->workers[worker_id];
+  }
+  const Slot& listener(size_t listener_id) const {
+    return this->listeners[listener_id];
+  }
+
+  // Places the calling thread in `slot`, returning false if it can't.
+  static bool apply(const Slot& slot);
+
+  // One line per thread that's placed anywhere in particular.
+  std::string describe() const;
+
+ private:
+  std::vector<Slot> workers;
+  std::vector<Slot> listeners;
+};
+
+#endif /* end of include guard */
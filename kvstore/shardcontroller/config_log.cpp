@@ -0,0 +1,314 @@
+#include "config_log.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "common/color.hpp"
+#include "common/zpp_bits.hpp"
+
+namespace {
+
+// Each log record is a header followed by its payload: for a ConfigLog, the
+// config version, and the request's message type and body; for a RaftLog,
+// the entry's index, term, type, and body.
+struct RecordHeader {
+  uint32_t size;
+  uint64_t checksum;
+};
+
+// FNV-1a.
+uint64_t checksum(const std::byte* data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ uint64_t(data[i])) * 1099511628211ull;
+  }
+  return hash;
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+  auto* p = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Reads the whole file at `path`; an empty vector if it doesn't exist.
+std::optional<std::vector<std::byte>> read_file(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT) return std::vector<std::byte>();
+    perror_color(RED, "open");
+    return std::nullopt;
+  }
+  std::vector<std::byte> data;
+  std::byte buf[1 << 16];
+  while (true) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      perror_color(RED, "read");
+      close(fd);
+      return std::nullopt;
+    }
+    if (n == 0) break;
+    data.insert(data.end(), buf, buf + n);
+  }
+  close(fd);
+  return data;
+}
+
+// Adds a record holding `payload` to the end of `records`.
+void add_record(std::vector<std::byte>& records,
+                const std::vector<std::byte>& payload) {
+  RecordHeader header{uint32_t(payload.size()),
+                      checksum(payload.data(), payload.size())};
+  size_t pos = records.size();
+  records.resize(pos + sizeof(header));
+  std::memcpy(records.data() + pos, &header, sizeof(header));
+  records.insert(records.end(), payload.begin(), payload.end());
+}
+
+// Appends `records` to the log open as `fd`, and syncs them.
+bool write_records(int fd, const std::vector<std::byte>& records) {
+  if (fd < 0) return false;
+  if (!write_all(fd, records.data(), records.size()) || fdatasync(fd) < 0) {
+    perror_color(RED, "write");
+    return false;
+  }
+  return true;
+}
+
+// Calls `f` on the payload of each record of the log at `path`, in order,
+// until it returns false. Then drops whatever follows the last record `f`
+// accepted, so that new records come right after it.
+template <typename F>
+bool read_records(const std::string& path, F f) {
+  std::optional<std::vector<std::byte>> log = read_file(path);
+  if (!log) return false;
+  size_t pos = 0;
+  while (pos + sizeof(RecordHeader) <= log->size()) {
+    RecordHeader header;
+    std::memcpy(&header, log->data() + pos, sizeof(header));
+    size_t end = pos + sizeof(header) + header.size;
+    // A record cut short (or garbled) by a crash ends the log
+    if (end > log->size() ||
+        checksum(log->data() + pos + sizeof(header), header.size) !=
+            header.checksum) {
+      break;
+    }
+
+    std::vector<std::byte> payload(log->begin() + pos + sizeof(header),
+                                   log->begin() + end);
+    if (!f(payload)) break;
+    pos = end;
+  }
+
+  if (pos < log->size() && truncate(path.c_str(), pos) < 0) {
+    perror_color(RED, "truncate");
+    return false;
+  }
+  return true;
+}
+
+// Opens the log at `path` for appending, truncating it if `truncate`.
+// Returns -1 on failure.
+int open_log_file(const std::string& path, bool truncate) {
+  int flags = O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0);
+  int fd = open(path.c_str(), flags, 0644);
+  if (fd < 0) perror_color(RED, "open");
+  return fd;
+}
+
+// Durably replaces the file at `path`, in the directory `dir`, with `data`.
+bool replace_file(const std::string& dir, const std::string& path,
+                  const std::vector<std::byte>& data) {
+  // Write the new file next to the old one, then swap it in, so that a crash
+  // leaves one or the other
+  std::string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror_color(RED, "open");
+    return false;
+  }
+  bool written = write_all(fd, data.data(), data.size()) && fsync(fd) == 0;
+  close(fd);
+  if (!written || rename(tmp_path.c_str(), path.c_str()) < 0) {
+    perror_color(RED, "rename");
+    return false;
+  }
+  int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  return true;
+}
+
+void make_dir(const std::string& dir) {
+  if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+    perror_color(RED, "mkdir");
+  }
+}
+
+}  // namespace
+
+ConfigLog::ConfigLog(std::string dir) : dir(std::move(dir)) {
+  make_dir(this->dir);
+}
+
+ConfigLog::~ConfigLog() {
+  if (this->log_fd >= 0) close(this->log_fd);
+}
+
+std::optional<ConfigLog::Recovered> ConfigLog::recover() {
+  Recovered recovered;
+
+  std::optional<std::vector<std::byte>> snapshot =
+      read_file(this->snapshot_path());
+  if (!snapshot) return std::nullopt;
+  if (!snapshot->empty()) {
+    auto in = zpp::bits::input(*snapshot);
+    if (!success(in(recovered.epoch, recovered.version,
+                    recovered.config.server_to_shards))) {
+      cerr_color(RED, "Corrupt shardcontroller snapshot in ", this->dir);
+      return std::nullopt;
+    }
+  }
+
+  bool read = read_records(this->log_path(), [&](const auto& payload) {
+    uint64_t version;
+    Message msg{};
+    auto in = zpp::bits::input(payload);
+    if (!success(in(version, msg.type, msg.buf))) return false;
+    msg.sz = msg.buf.size();
+    std::optional<Request> req = deserialize_request(msg);
+    if (!req) return false;
+    // Records from before the snapshot were already applied to it
+    if (version > recovered.version) {
+      recovered.requests.push_back(std::move(*req));
+      recovered.versions.push_back(version);
+    }
+    return true;
+  });
+  if (!read || !this->open_log(false)) return std::nullopt;
+  this->n_records = recovered.requests.size();
+  return recovered;
+}
+
+bool ConfigLog::append(uint64_t version, const Request& req) {
+  std::optional<Message> msg = serialize_request(req);
+  if (!msg) return false;
+
+  std::vector<std::byte> payload;
+  auto out = zpp::bits::output(payload);
+  if (!success(out(version, msg->type, msg->buf))) return false;
+  std::vector<std::byte> record;
+  add_record(record, payload);
+  if (!write_records(this->log_fd, record)) return false;
+  this->n_records++;
+  return true;
+}
+
+bool ConfigLog::snapshot(uint64_t epoch, uint64_t version,
+                         const ShardControllerConfig& config) {
+  std::vector<std::byte> data;
+  auto out = zpp::bits::output(data);
+  if (!success(out(epoch, version, config.server_to_shards))) return false;
+  if (!replace_file(this->dir, this->snapshot_path(), data)) return false;
+
+  // The log's records are all in the snapshot now. If the log isn't emptied
+  // (say, because of a crash right here), recovery skips them by version.
+  if (!this->open_log(true)) return false;
+  this->n_records = 0;
+  return true;
+}
+
+std::string ConfigLog::log_path() const {
+  return this->dir + "/config.log";
+}
+
+std::string ConfigLog::snapshot_path() const {
+  return this->dir + "/config.snapshot";
+}
+
+bool ConfigLog::open_log(bool truncate) {
+  if (this->log_fd >= 0) close(this->log_fd);
+  this->log_fd = open_log_file(this->log_path(), truncate);
+  return this->log_fd >= 0;
+}
+
+RaftLog::RaftLog(std::string dir) : dir(std::move(dir)) {
+  make_dir(this->dir);
+}
+
+RaftLog::~RaftLog() {
+  if (this->log_fd >= 0) close(this->log_fd);
+}
+
+std::optional<RaftLog::Recovered> RaftLog::recover() {
+  Recovered recovered;
+
+  std::optional<std::vector<std::byte>> state = read_file(this->state_path());
+  if (!state) return std::nullopt;
+  if (!state->empty()) {
+    auto in = zpp::bits::input(*state);
+    if (!success(in(recovered.term, recovered.voted_for))) {
+      cerr_color(RED, "Corrupt Raft state in ", this->dir);
+      return std::nullopt;
+    }
+  }
+
+  bool read = read_records(this->log_path(), [&](const auto& payload) {
+    uint64_t index;
+    RaftEntry entry;
+    auto in = zpp::bits::input(payload);
+    if (!success(in(index, entry.term, entry.type, entry.body))) return false;
+    // Each record follows on from, or replaces part of, the ones before it
+    if (index == 0 || index > recovered.entries.size() + 1) return false;
+    recovered.entries.resize(index - 1);
+    recovered.entries.push_back(std::move(entry));
+    return true;
+  });
+  if (!read) return std::nullopt;
+  this->log_fd = open_log_file(this->log_path(), false);
+  if (this->log_fd < 0) return std::nullopt;
+  return recovered;
+}
+
+bool RaftLog::save_state(uint64_t term, const std::string& voted_for) {
+  std::vector<std::byte> data;
+  auto out = zpp::bits::output(data);
+  if (!success(out(term, voted_for))) return false;
+  return replace_file(this->dir, this->state_path(), data);
+}
+
+bool RaftLog::append(uint64_t index, const std::vector<RaftEntry>& entries) {
+  if (entries.empty()) return true;
+  std::vector<std::byte> records;
+  for (auto&& entry : entries) {
+    std::vector<std::byte> payload;
+    auto out = zpp::bits::output(payload);
+    if (!success(out(index++, entry.term, entry.type, entry.body))) {
+      return false;
+    }
+    add_record(records, payload);
+  }
+  return write_records(this->log_fd, records);
+}
+
+std::string RaftLog::log_path() const {
+  return this->dir + "/raft.log";
+}
+
+std::string RaftLog::state_path() const {
+  return this->dir + "/raft.state";
+}
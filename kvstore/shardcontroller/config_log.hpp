@@ -0,0 +1,119 @@
+#ifndef CONFIG_LOG_HPP
+#define CONFIG_LOG_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common/config.hpp"
+#include "net/network_messages.hpp"
+
+/**
+ * Durable history of a shardcontroller's configuration, kept in a directory:
+ * a snapshot of the config as of some version, and an append-only log of the
+ * config-changing requests (Join, Leave, Move) applied since. Replaying the
+ * log's requests on top of the snapshot gives back the latest config.
+ *
+ * Every change is fsync'ed before append() returns, so that it's never lost
+ * once acknowledged. Log records carry a checksum, so a record torn by a crash
+ * part way through writing it is recognized and dropped on recovery. Taking a
+ * snapshot empties the log, which keeps recovery (and so restarts) fast.
+ *
+ * Not thread-safe.
+ */
+class ConfigLog {
+ public:
+  // Start a new snapshot once the log has this many records.
+  static constexpr size_t SNAPSHOT_EVERY = 1024;
+
+  // Uses (and creates, if need be) the directory `dir`.
+  explicit ConfigLog(std::string dir);
+  ~ConfigLog();
+  ConfigLog(const ConfigLog&) = delete;
+  ConfigLog& operator=(const ConfigLog&) = delete;
+
+  struct Recovered {
+    // Epoch and version as of the snapshot (0 if there was none)
+    uint64_t epoch = 0;
+    uint64_t version = 0;
+    ShardControllerConfig config;
+    // Requests to apply on top of the snapshot, in order, and the version
+    // after each
+    std::vector<Request> requests;
+    std::vector<uint64_t> versions;
+  };
+  // Reads back the snapshot and log, and opens the log for appending. Returns
+  // std::nullopt if they couldn't be read.
+  std::optional<Recovered> recover();
+
+  // Durably appends a request that makes the config version `version`.
+  bool append(uint64_t version, const Request& req);
+
+  // Durably replaces the snapshot with `config`, and empties the log.
+  bool snapshot(uint64_t epoch, uint64_t version,
+                const ShardControllerConfig& config);
+
+  // Number of records in the log.
+  size_t size() const {
+    return this->n_records;
+  }
+
+ private:
+  std::string dir;
+  int log_fd = -1;
+  size_t n_records = 0;
+
+  std::string log_path() const;
+  std::string snapshot_path() const;
+  // (Re)opens the log for appending, truncating it if `truncate`.
+  bool open_log(bool truncate);
+};
+
+/**
+ * Durable state of one node of a ReplicatedShardController, kept in a
+ * directory: its current term and vote, which are replaced as a whole on
+ * every change, and an append-only log of its Raft entries.
+ *
+ * Raft's safety depends on a node never forgetting a vote it gave or an entry
+ * it acknowledged, so both are fsync'ed before save_state() and append()
+ * return. Entries that replace ones already in the log (uncommitted entries
+ * from an old leader) are appended too, and override the old ones on
+ * recovery.
+ *
+ * Not thread-safe.
+ */
+class RaftLog {
+ public:
+  // Uses (and creates, if need be) the directory `dir`.
+  explicit RaftLog(std::string dir);
+  ~RaftLog();
+  RaftLog(const RaftLog&) = delete;
+  RaftLog& operator=(const RaftLog&) = delete;
+
+  struct Recovered {
+    uint64_t term = 0;
+    std::string voted_for;
+    // The log's entries, starting from index 1
+    std::vector<RaftEntry> entries;
+  };
+  // Reads back the state and log, and opens the log for appending. Returns
+  // std::nullopt if they couldn't be read.
+  std::optional<Recovered> recover();
+
+  // Durably replaces the current term and vote.
+  bool save_state(uint64_t term, const std::string& voted_for);
+
+  // Durably writes `entries` to the log at indices `index` on, replacing
+  // whatever was there from `index` on.
+  bool append(uint64_t index, const std::vector<RaftEntry>& entries);
+
+ private:
+  std::string dir;
+  int log_fd = -1;
+
+  std::string log_path() const;
+  std::string state_path() const;
+};
+
+#endif /* end of include guard */
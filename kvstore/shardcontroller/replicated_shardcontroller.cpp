@@ -0,0 +1,564 @@
+#include "replicated_shardcontroller.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+// The change an entry holds, or std::nullopt for a no-op.
+std::optional<Request> entry_request(const RaftEntry& entry) {
+  if (entry.body.empty()) return std::nullopt;
+  Message msg{};
+  msg.type = MessageType(entry.type);
+  msg.buf = entry.body;
+  msg.sz = msg.buf.size();
+  return deserialize_request(msg);
+}
+
+// Sends `req` over `conn`, connecting to `addr` first if need be. Drops the
+// connection if it fails.
+std::optional<Response> call(std::shared_ptr<ServerConn>& conn,
+                             const std::string& addr, const Request& req) {
+  if (!conn) conn = connect_to_server(addr);
+  if (!conn) return std::nullopt;
+  std::optional<Response> res;
+  if (conn->send_request(req)) res = conn->recv_response();
+  if (!res) conn.reset();
+  return res;
+}
+
+}  // namespace
+
+ReplicatedShardController::ReplicatedShardController(
+    const std::string& addr, std::vector<std::string> nodes,
+    const std::string& state_dir)
+    : address(addr),
+      nodes(std::move(nodes)),
+      state_dir(state_dir),
+      machine(addr) {
+  this->log.push_back(RaftEntry{0, 0, {}});
+}
+
+bool ReplicatedShardController::Query(const QueryRequest* req,
+                                      QueryResponse* res) {
+  if (!this->machine.Query(req, res)) return false;
+  std::unique_lock lock(this->mtx);
+  // Every leader starts a new term, which servers take as a restart
+  res->epoch = this->current_term;
+  res->version = this->last_applied;
+  return true;
+}
+
+bool ReplicatedShardController::Join(const JoinRequest* req, JoinResponse*) {
+  Response res = this->is_leader() ? this->propose(*req) : this->forward(*req);
+  return std::holds_alternative<JoinResponse>(res);
+}
+
+bool ReplicatedShardController::Leave(const LeaveRequest* req,
+                                      LeaveResponse*) {
+  Response res = this->is_leader() ? this->propose(*req) : this->forward(*req);
+  return std::holds_alternative<LeaveResponse>(res);
+}
+
+bool ReplicatedShardController::Move(const MoveRequest* req, MoveResponse*) {
+  Response res = this->is_leader() ? this->propose(*req) : this->forward(*req);
+  return std::holds_alternative<MoveResponse>(res);
+}
+
+bool ReplicatedShardController::is_leader() {
+  std::unique_lock lock(this->mtx);
+  return this->role == Role::LEADER;
+}
+
+std::optional<std::string> ReplicatedShardController::leader() {
+  std::unique_lock lock(this->mtx);
+  return this->leader_address;
+}
+
+uint64_t ReplicatedShardController::term() {
+  std::unique_lock lock(this->mtx);
+  return this->current_term;
+}
+
+int ReplicatedShardController::start() {
+  // Pick up the term, vote, and log from the last run. The config is rebuilt
+  // from the log as the leader says which entries are committed.
+  this->raft_log = std::make_unique<RaftLog>(this->state_dir);
+  std::optional<RaftLog::Recovered> recovered = this->raft_log->recover();
+  if (!recovered) {
+    cerr_color(RED, "Failed to recover Raft state from ", this->state_dir);
+    return -1;
+  }
+  {
+    std::unique_lock lock(this->mtx);
+    this->current_term = recovered->term;
+    this->voted_for = std::move(recovered->voted_for);
+    this->log.resize(1);
+    for (auto&& entry : recovered->entries) {
+      this->log.push_back(std::move(entry));
+    }
+  }
+
+  this->is_stopped = false;
+
+  this->listener_fd = open_listener_socket(this->address);
+  if (this->listener_fd < 0) {
+    return -1;
+  }
+  this->client_listener =
+      std::thread(&ReplicatedShardController::accept_clients_loop, this);
+
+  {
+    std::unique_lock lock(this->mtx);
+    this->reset_election_deadline();
+  }
+  this->election_thread =
+      std::thread(&ReplicatedShardController::election_loop, this);
+  for (auto&& node : this->nodes) {
+    if (node == this->address) continue;
+    this->peer_threads.emplace_back(&ReplicatedShardController::peer_loop,
+                                    this, node);
+  }
+
+  cout_color(BLUE, "Listening on ", this->address, " (one of ",
+             this->nodes.size(), " shardcontroller nodes)");
+  return 0;
+}
+
+void ReplicatedShardController::stop() {
+  this->is_stopped = true;
+  {
+    std::unique_lock lock(this->mtx);
+    this->cv.notify_all();
+    this->applied_cv.notify_all();
+  }
+
+  // Shutdown listener, and stop accepting clients
+  shutdown(this->listener_fd, SHUT_RDWR);
+  this->client_listener.join();
+  this->election_thread.join();
+  for (auto&& thread : this->peer_threads) thread.join();
+  this->peer_threads.clear();
+
+  // Close all connections, and wait for them to close
+  std::unique_lock lock(this->conns_mtx);
+  for (auto&& c : this->current_conns) c->shutdown();
+  this->conns_cv.wait(lock, [this] { return this->current_conns.empty(); });
+}
+
+void ReplicatedShardController::accept_clients_loop() {
+  while (!this->is_stopped) {
+    std::shared_ptr<ClientConn> conn = accept_client(this->listener_fd);
+    if (!conn) {
+      return;
+    }
+
+    std::unique_lock lock(this->conns_mtx);
+    std::thread conn_thread(&ReplicatedShardController::handle_client, this,
+                            conn);
+    conn_thread.detach();
+    this->current_conns.push_back(conn);
+  }
+}
+
+void ReplicatedShardController::handle_client(
+    std::shared_ptr<ClientConn> client) {
+  while (!this->is_stopped && client->is_connected) {
+    TraceContext trace;
+    std::optional<Request> req = client->recv_request(nullptr, nullptr, &trace);
+    if (!req) {
+      break;
+    }
+
+    Span span("shardcontroller", trace);
+    Response res = this->process_request(std::move(*req));
+    if (!client->send_response(res)) {
+      break;
+    }
+  }
+  client->shutdown();
+
+  std::unique_lock lock(this->conns_mtx);
+  if (auto it = std::find(this->current_conns.begin(),
+                          this->current_conns.end(), client);
+      it != this->current_conns.end()) {
+    this->current_conns.erase(it);
+  }
+  if (this->current_conns.empty()) {
+    this->conns_cv.notify_all();
+  }
+}
+
+Response ReplicatedShardController::process_request(Request req) {
+  if (auto* vote_req = std::get_if<RaftVoteRequest>(&req)) {
+    return this->handle_vote(*vote_req);
+  } else if (auto* append_req = std::get_if<RaftAppendRequest>(&req)) {
+    return this->handle_append(*append_req);
+  } else if (auto* query_req = std::get_if<QueryRequest>(&req)) {
+    QueryResponse query_res{};
+    if (this->Query(query_req, &query_res)) return query_res;
+    return ErrorResponse{"Failed to process Query request."};
+  } else if (std::holds_alternative<JoinRequest>(req) ||
+             std::holds_alternative<LeaveRequest>(req) ||
+             std::holds_alternative<MoveRequest>(req)) {
+    return this->is_leader() ? this->propose(req) : this->forward(req);
+  }
+  throw std::logic_error{"invalid request variant!"};
+}
+
+Response ReplicatedShardController::propose(const Request& req) {
+  std::optional<Message> msg = serialize_request(req);
+  if (!msg) return ErrorResponse{"Failed to serialize config change."};
+
+  std::unique_lock lock(this->mtx);
+  if (this->role != Role::LEADER) {
+    return ErrorResponse{"Not the shardcontroller leader.",
+                         uint32_t(HEARTBEAT_INTERVAL.count())};
+  }
+  uint64_t term = this->current_term;
+  this->log.push_back(RaftEntry{term, int32_t(msg->type), msg->buf});
+  uint64_t index = this->last_log_index();
+  if (!this->persist_log(index)) {
+    this->log.pop_back();
+    return ErrorResponse{"Failed to log config change."};
+  }
+  this->proposed[index] = Proposal{term, std::nullopt};
+  this->match_index[this->address] = index;
+  this->advance_commit();
+  this->cv.notify_all();
+
+  this->applied_cv.wait_for(lock, COMMIT_TIMEOUT, [&] {
+    return this->is_stopped || this->last_applied >= index ||
+           this->current_term != term;
+  });
+  std::optional<Response> res = std::move(this->proposed[index].res);
+  this->proposed.erase(index);
+  if (res) return std::move(*res);
+  // A new leader may still commit it, or may not; the caller can't tell
+  return ErrorResponse{"Config change was not committed.",
+                       uint32_t(HEARTBEAT_INTERVAL.count())};
+}
+
+Response ReplicatedShardController::forward(const Request& req) {
+  std::optional<std::string> leader = this->leader();
+  if (!leader || *leader == this->address) {
+    return ErrorResponse{"No shardcontroller leader.",
+                         uint32_t(HEARTBEAT_INTERVAL.count())};
+  }
+  std::shared_ptr<ServerConn> conn;
+  std::optional<Response> res = call(conn, *leader, req);
+  if (!res) {
+    return ErrorResponse{"Failed to reach the shardcontroller leader.",
+                         uint32_t(HEARTBEAT_INTERVAL.count())};
+  }
+  return std::move(*res);
+}
+
+RaftVoteResponse ReplicatedShardController::handle_vote(
+    const RaftVoteRequest& req) {
+  std::unique_lock lock(this->mtx);
+  // A newer term alone doesn't put off this node's own election: only a vote
+  // granted does, so that a candidate that can't win (say, because its log is
+  // behind) can't keep holding up the ones that can
+  if (req.term > this->current_term) this->step_down(req.term);
+
+  // Only vote for candidates whose log has everything this node's has, so
+  // that the leader always has every committed entry
+  uint64_t last_index = this->last_log_index();
+  uint64_t last_term = this->log.back().term;
+  bool up_to_date =
+      req.last_log_term > last_term ||
+      (req.last_log_term == last_term && req.last_log_index >= last_index);
+  bool granted =
+      req.term == this->current_term && up_to_date &&
+      (this->voted_for.empty() || this->voted_for == req.candidate);
+  if (granted) {
+    this->voted_for = req.candidate;
+    if (this->persist_state()) {
+      this->reset_election_deadline();
+    } else {
+      this->voted_for.clear();
+      granted = false;
+    }
+  }
+  return RaftVoteResponse{this->current_term, granted};
+}
+
+RaftAppendResponse ReplicatedShardController::handle_append(
+    const RaftAppendRequest& req) {
+  std::unique_lock lock(this->mtx);
+  if (req.term < this->current_term) {
+    return RaftAppendResponse{this->current_term, false, 0};
+  }
+  if (req.term > this->current_term || this->role != Role::FOLLOWER) {
+    this->step_down(req.term);
+  }
+  if (this->leader_address != req.leader) {
+    cout_color(BLUE, "Following shardcontroller leader ", req.leader,
+               " in term ", req.term);
+    this->leader_address = req.leader;
+  }
+  this->reset_election_deadline();
+
+  // The entries must follow on from this node's log; if they don't, the
+  // leader backs up and tries again
+  if (req.prev_log_index > this->last_log_index() ||
+      this->log[req.prev_log_index].term != req.prev_log_term) {
+    uint64_t retry = std::min(this->last_log_index(), req.prev_log_index - 1);
+    return RaftAppendResponse{this->current_term, false, retry};
+  }
+
+  uint64_t index = req.prev_log_index;
+  uint64_t first_new = 0;
+  for (auto&& entry : req.entries) {
+    index++;
+    if (index <= this->last_log_index()) {
+      if (this->log[index].term == entry.term) continue;
+      // Uncommitted entries from an old leader, which the new one overrides
+      this->log.resize(index);
+    }
+    if (first_new == 0) first_new = index;
+    this->log.push_back(entry);
+  }
+  // The leader counts the entries as replicated here once this succeeds, so
+  // they must be on disk first
+  if (first_new != 0 && !this->persist_log(first_new)) {
+    this->log.resize(first_new);
+    return RaftAppendResponse{this->current_term, false, first_new - 1};
+  }
+
+  if (req.leader_commit > this->commit_index) {
+    this->commit_index = std::min(req.leader_commit, index);
+    this->apply_committed();
+  }
+  return RaftAppendResponse{this->current_term, true, index};
+}
+
+void ReplicatedShardController::election_loop() {
+  std::unique_lock lock(this->mtx);
+  while (!this->is_stopped) {
+    this->cv.wait_for(lock, 10ms);
+    if (this->role != Role::LEADER &&
+        steady_clock::now() >= this->election_deadline) {
+      this->start_election();
+    }
+  }
+}
+
+void ReplicatedShardController::peer_loop(const std::string& peer) {
+  std::shared_ptr<ServerConn> conn;
+  std::unique_lock lock(this->mtx);
+  while (!this->is_stopped) {
+    uint64_t term = this->current_term;
+
+    if (this->role == Role::LEADER) {
+      uint64_t next = this->next_index[peer];
+      uint64_t end =
+          std::min<uint64_t>(this->log.size(), next + MAX_APPEND_ENTRIES);
+      RaftAppendRequest req{
+          term,
+          this->address,
+          next - 1,
+          this->log[next - 1].term,
+          {this->log.begin() + next, this->log.begin() + end},
+          this->commit_index};
+
+      lock.unlock();
+      std::optional<Response> res = call(conn, peer, req);
+      lock.lock();
+
+      auto* append_res =
+          res ? std::get_if<RaftAppendResponse>(&*res) : nullptr;
+      if (append_res && append_res->term > this->current_term) {
+        // This leader's own deadline ran out long ago; give whoever is in the
+        // newer term a chance to be heard from before running against it
+        this->step_down(append_res->term);
+        this->reset_election_deadline();
+      } else if (append_res && this->role == Role::LEADER &&
+                 this->current_term == term) {
+        if (append_res->success) {
+          this->match_index[peer] =
+              std::max(this->match_index[peer], append_res->match_index);
+          this->next_index[peer] = this->match_index[peer] + 1;
+          this->advance_commit();
+        } else {
+          this->next_index[peer] = std::max<uint64_t>(
+              1, std::min(next - 1, append_res->match_index + 1));
+        }
+      }
+
+      // Carry on right away if the peer is behind; otherwise, wait for the
+      // next heartbeat, or new entries
+      if (append_res && this->role == Role::LEADER &&
+          this->next_index[peer] <= this->last_log_index()) {
+        continue;
+      }
+      this->cv.wait_for(lock, HEARTBEAT_INTERVAL, [&] {
+        return this->is_stopped || this->role != Role::LEADER ||
+               this->next_index[peer] <= this->last_log_index();
+      });
+    } else if (this->role == Role::CANDIDATE &&
+               this->vote_asked[peer] != term) {
+      this->vote_asked[peer] = term;
+      RaftVoteRequest req{term, this->address, this->last_log_index(),
+                          this->log.back().term};
+
+      lock.unlock();
+      std::optional<Response> res = call(conn, peer, req);
+      lock.lock();
+
+      auto* vote_res = res ? std::get_if<RaftVoteResponse>(&*res) : nullptr;
+      if (!vote_res) {
+        // Try again in a bit, if the election's still on
+        this->vote_asked[peer] = 0;
+        this->cv.wait_for(lock, HEARTBEAT_INTERVAL);
+      } else if (vote_res->term > this->current_term) {
+        this->step_down(vote_res->term);
+        this->reset_election_deadline();
+      } else if (vote_res->granted && this->role == Role::CANDIDATE &&
+                 this->current_term == term) {
+        this->votes++;
+        if (this->votes > this->nodes.size() / 2) this->become_leader();
+      }
+    } else {
+      this->cv.wait_for(lock, HEARTBEAT_INTERVAL);
+    }
+  }
+}
+
+void ReplicatedShardController::reset_election_deadline() {
+  thread_local std::mt19937 rng(std::random_device{}());
+  std::uniform_int_distribution<int64_t> timeout(
+      MIN_ELECTION_TIMEOUT.count(), MAX_ELECTION_TIMEOUT.count());
+  this->election_deadline = steady_clock::now() + milliseconds(timeout(rng));
+}
+
+void ReplicatedShardController::start_election() {
+  this->current_term++;
+  this->voted_for = this->address;
+  this->leader_address.reset();
+  this->reset_election_deadline();
+  // A node that can't record its own vote mustn't run, since it could then
+  // vote for another candidate in the same term after restarting
+  if (!this->persist_state()) {
+    this->role = Role::FOLLOWER;
+    return;
+  }
+  this->role = Role::CANDIDATE;
+  this->votes = 1;
+  if (this->votes > this->nodes.size() / 2) {
+    this->become_leader();
+    return;
+  }
+  this->cv.notify_all();
+}
+
+void ReplicatedShardController::become_leader() {
+  this->role = Role::LEADER;
+  this->leader_address = this->address;
+  for (auto&& node : this->nodes) {
+    this->next_index[node] = this->log.size();
+    this->match_index[node] = 0;
+  }
+  // Entries from earlier terms only count as committed once one from this
+  // term is, so start the term with a no-op
+  this->log.push_back(RaftEntry{this->current_term, 0, {}});
+  if (!this->persist_log(this->last_log_index())) {
+    this->log.pop_back();
+    this->step_down(this->current_term);
+    return;
+  }
+  this->match_index[this->address] = this->last_log_index();
+  this->advance_commit();
+  cout_color(GREEN, "Became shardcontroller leader in term ",
+             this->current_term);
+  this->cv.notify_all();
+}
+
+void ReplicatedShardController::step_down(uint64_t term) {
+  if (term > this->current_term) {
+    this->current_term = term;
+    this->voted_for.clear();
+    this->leader_address.reset();
+    this->persist_state();
+  }
+  this->role = Role::FOLLOWER;
+  // Proposers waiting on this node as leader give up
+  this->applied_cv.notify_all();
+}
+
+bool ReplicatedShardController::persist_state() {
+  if (!this->raft_log->save_state(this->current_term, this->voted_for)) {
+    cerr_color(RED, "Failed to save Raft state to ", this->state_dir);
+    return false;
+  }
+  return true;
+}
+
+bool ReplicatedShardController::persist_log(uint64_t index) {
+  std::vector<RaftEntry> entries(this->log.begin() + index, this->log.end());
+  if (!this->raft_log->append(index, entries)) {
+    cerr_color(RED, "Failed to append to Raft log in ", this->state_dir);
+    return false;
+  }
+  return true;
+}
+
+uint64_t ReplicatedShardController::last_log_index() const {
+  return this->log.size() - 1;
+}
+
+void ReplicatedShardController::advance_commit() {
+  for (uint64_t index = this->last_log_index(); index > this->commit_index;
+       index--) {
+    if (this->log[index].term != this->current_term) break;
+    size_t replicas = 0;
+    for (auto&& [node, match] : this->match_index) {
+      if (match >= index) replicas++;
+    }
+    if (replicas > this->nodes.size() / 2) {
+      this->commit_index = index;
+      this->apply_committed();
+      return;
+    }
+  }
+}
+
+void ReplicatedShardController::apply_committed() {
+  while (this->last_applied < this->commit_index) {
+    uint64_t index = ++this->last_applied;
+    std::optional<Request> req = entry_request(this->log[index]);
+    if (!req) continue;
+
+    Response res;
+    if (auto* join_req = std::get_if<JoinRequest>(&*req)) {
+      JoinResponse join_res{};
+      if (this->machine.Join(join_req, &join_res)) {
+        res = join_res;
+      } else {
+        res = ErrorResponse{"Failed to process Join request."};
+      }
+    } else if (auto* leave_req = std::get_if<LeaveRequest>(&*req)) {
+      LeaveResponse leave_res{};
+      if (this->machine.Leave(leave_req, &leave_res)) {
+        res = leave_res;
+      } else {
+        res = ErrorResponse{"Failed to process Leave request."};
+      }
+    } else if (auto* move_req = std::get_if<MoveRequest>(&*req)) {
+      MoveResponse move_res{};
+      if (this->machine.Move(move_req, &move_res)) {
+        res = move_res;
+      } else {
+        res = ErrorResponse{"Failed to process Move request."};
+      }
+    }
+    // Unless a later leader replaced it, the entry is the one proposed
+    if (auto it = this->proposed.find(index);
+        it != this->proposed.end() &&
+        it->second.term == this->log[index].term) {
+      it->second.res = std::move(res);
+    }
+  }
+  this->applied_cv.notify_all();
+}
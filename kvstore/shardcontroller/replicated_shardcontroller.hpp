@@ -0,0 +1,179 @@
+#ifndef REPLICATED_SHARDCONTROLLER_HPP
+#define REPLICATED_SHARDCONTROLLER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "net/network_conn.hpp"
+#include "net/network_helpers.hpp"
+#include "net/network_messages.hpp"
+#include "shardcontroller.hpp"
+#include "shardcontroller/static_shardcontroller.hpp"
+
+/**
+ * One node of a shardcontroller replicated over several (3 or 5, usually)
+ * nodes, so that it keeps working when some of them fail.
+ *
+ * The nodes keep a log of config changes in agreement with Raft: one node is
+ * elected leader, adds each change to its log, and copies the log to the
+ * others. A change is made (applied to every node's config, in log order)
+ * once a majority of nodes have it. If the leader fails, the others stop
+ * hearing from it, and elect a new one within about MAX_ELECTION_TIMEOUT.
+ *
+ * Any node answers Query from its own copy of the config, which may lag the
+ * leader's slightly. Join, Leave, and Move sent to a follower are forwarded
+ * to the leader; while there is none, they fail with a retry_after_ms hint.
+ *
+ * Each node keeps its term, vote, and log in a state directory (see RaftLog),
+ * and writes them there before answering any request that depends on them,
+ * so that a node that restarts never takes back a vote or an entry it
+ * acknowledged. It then catches up on whatever it missed from the leader.
+ */
+class ReplicatedShardController : public Shardcontroller {
+ public:
+  // How often the leader contacts each follower, even with nothing new.
+  static constexpr milliseconds HEARTBEAT_INTERVAL = 50ms;
+  // A follower that hasn't heard from a leader for a random time between
+  // these stands for election.
+  static constexpr milliseconds MIN_ELECTION_TIMEOUT = 300ms;
+  static constexpr milliseconds MAX_ELECTION_TIMEOUT = 600ms;
+  // How long the leader waits for a change to be committed before giving up
+  // on it.
+  static constexpr milliseconds COMMIT_TIMEOUT = 2s;
+  // Most log entries sent to a follower at once.
+  static constexpr size_t MAX_APPEND_ENTRIES = 256;
+
+  // `nodes` are the addresses of all the controller's nodes, including this
+  // one (`addr`). This node's Raft state is kept in `state_dir`, and recovered
+  // from it on start().
+  ReplicatedShardController(const std::string& addr,
+                            std::vector<std::string> nodes,
+                            const std::string& state_dir);
+  ~ReplicatedShardController() {
+    if (!this->is_stopped) {
+      this->stop();
+    }
+  }
+
+  // Reads this node's copy of the config.
+  bool Query(const QueryRequest* req, QueryResponse* res) override;
+  // Make a change through the replicated log, so they only succeed on the
+  // leader.
+  bool Join(const JoinRequest* req, JoinResponse* res) override;
+  bool Leave(const LeaveRequest* req, LeaveResponse* res) override;
+  bool Move(const MoveRequest* req, MoveResponse* res) override;
+
+  int start() override;
+  void stop() override;
+
+  bool is_leader();
+  // Address of the current leader, if this node knows of one.
+  std::optional<std::string> leader();
+  uint64_t term();
+
+ private:
+  enum class Role { FOLLOWER, CANDIDATE, LEADER };
+
+  std::string address;
+  std::vector<std::string> nodes;
+  std::string state_dir;
+
+  // The config, as of the last applied log entry. Never started; it's only
+  // used for its Join/Leave/Move/Query.
+  StaticShardController machine;
+
+  // Raft state, all guarded by `mtx`.
+  std::mutex mtx;
+  // Signaled when there's new work for the peer threads: a new entry, a new
+  // role, or stopping.
+  std::condition_variable cv;
+  // Signaled when entries are applied, or leadership is lost.
+  std::condition_variable applied_cv;
+  Role role = Role::FOLLOWER;
+  uint64_t current_term = 0;
+  std::string voted_for;
+  std::optional<std::string> leader_address;
+  size_t votes = 0;
+  // The log; entry 0 is a placeholder, so real entries start at index 1.
+  std::vector<RaftEntry> log;
+  uint64_t commit_index = 0;
+  uint64_t last_applied = 0;
+  steady_clock::time_point election_deadline;
+  // Leader only: the next entry to send each peer, and the last known to
+  // match.
+  std::map<std::string, uint64_t> next_index;
+  std::map<std::string, uint64_t> match_index;
+  // Candidate only: the term in which each peer was last asked for its
+  // vote.
+  std::map<std::string, uint64_t> vote_asked;
+  // Entries this node added as leader, by index, and the results of applying
+  // them, for their proposers.
+  struct Proposal {
+    uint64_t term;
+    std::optional<Response> res;
+  };
+  std::map<uint64_t, Proposal> proposed;
+  // Durable copy of the term, vote, and log.
+  std::unique_ptr<RaftLog> raft_log;
+
+  // An atomic, thread-safe boolean to denote whether the shardcontroller has
+  // been stopped.
+  std::atomic<bool> is_stopped = true;
+
+  // Listener socket for incoming client connections.
+  int listener_fd;
+  // Thread that listens for client connections and accepts them.
+  std::thread client_listener;
+  // Thread that starts elections, and a thread per peer that sends it votes
+  // and log entries.
+  std::thread election_thread;
+  std::vector<std::thread> peer_threads;
+
+  // Collection of current client connections.
+  std::vector<std::shared_ptr<ClientConn>> current_conns;
+  // Synchronization primitives for client connections.
+  std::mutex conns_mtx;
+  std::condition_variable conns_cv;
+
+  void accept_clients_loop();
+  void handle_client(std::shared_ptr<ClientConn> client);
+  Response process_request(Request req);
+
+  // Adds a config change to the log (on the leader), and waits for it to be
+  // applied.
+  Response propose(const Request& req);
+  // Sends a config change to the leader, and relays its response.
+  Response forward(const Request& req);
+
+  RaftVoteResponse handle_vote(const RaftVoteRequest& req);
+  RaftAppendResponse handle_append(const RaftAppendRequest& req);
+
+  // Starts an election if the leader hasn't been heard from in time.
+  void election_loop();
+  // Asks `peer` for its vote, or sends it log entries, depending on role.
+  void peer_loop(const std::string& peer);
+
+  // The following expect `mtx` to be held.
+  void reset_election_deadline();
+  void start_election();
+  void become_leader();
+  // Becomes a follower, in `term` if it's newer. Leaves the election deadline
+  // as it was.
+  void step_down(uint64_t term);
+  // Durably saves the term and vote, or the log from `index` on; on failure,
+  // the caller must not answer as if they were saved.
+  bool persist_state();
+  bool persist_log(uint64_t index);
+  uint64_t last_log_index() const;
+  // Commits the latest entry (of the current term) on a majority of nodes.
+  void advance_commit();
+  // Applies committed entries to the config.
+  void apply_committed();
+};
+
+#endif /* end of include guard */
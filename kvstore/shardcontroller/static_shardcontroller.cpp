@@ -87,6 +87,19 @@ bool StaticShardController::Move(const MoveRequest* req, MoveResponse*) {
 int StaticShardController::start() {
   this->is_stopped = false;
 
+  // Pick up where the last run left off, if the config is persisted
+  if (!this->state_dir.empty()) {
+    if (!this->recover()) {
+      cerr_color(RED, "Failed to recover config from ", this->state_dir);
+      return -1;
+    }
+  } else {
+    // Any number that differs across restarts will do
+    this->epoch = duration_cast<milliseconds>(
+                      system_clock::now().time_since_epoch())
+                      .count();
+  }
+
   // Create listener socket, and start client listener
   this->listener_fd = open_listener_socket(address);
   if (this->listener_fd < 0) {
@@ -141,11 +154,13 @@ void StaticShardController::accept_clients_loop() {
 
 void StaticShardController::handle_client(std::shared_ptr<ClientConn> client) {
   while (!is_stopped && client->is_connected) {
-    std::optional<Request> req = client->recv_request();
+    TraceContext trace;
+    std::optional<Request> req = client->recv_request(nullptr, nullptr, &trace);
     if (!req) {
       break;
     }
 
+    Span span("shardcontroller", trace);
     Response res = this->process_request(*req);
     if (!client->send_response(res)) {
       break;
@@ -177,6 +192,47 @@ void StaticShardController::handle_client(std::shared_ptr<ClientConn> client) {
 }
 
 Response StaticShardController::process_request(Request req) {
+  Response res;
+  if (std::holds_alternative<JoinRequest>(req) ||
+      std::holds_alternative<LeaveRequest>(req) ||
+      std::holds_alternative<MoveRequest>(req)) {
+    res = this->process_change(req);
+  } else if (auto* query_req = std::get_if<QueryRequest>(&req)) {
+    QueryResponse query_res{};
+    if (this->Query(query_req, &query_res)) {
+      query_res.epoch = this->epoch;
+      query_res.version = this->version;
+      res = query_res;
+    } else {
+      res = ErrorResponse{"Failed to process Query request."};
+    }
+  } else {
+    throw std::logic_error{"invalid request variant!"};
+  }
+  return res;
+}
+
+Response StaticShardController::process_change(const Request& req) {
+  std::unique_lock lock(this->change_mtx);
+  // Log the change before making it, so that it's never acknowledged without
+  // having been persisted. A change that then fails will fail again when
+  // replayed, so can stay in the log.
+  if (this->log && !this->log->append(this->version + 1, req)) {
+    return ErrorResponse{"Failed to persist config change."};
+  }
+  this->version++;
+  Response res = this->apply(req);
+
+  if (this->log && this->log->size() >= ConfigLog::SNAPSHOT_EVERY) {
+    std::shared_lock config_lock(this->config_mtx);
+    if (!this->log->snapshot(this->epoch, this->version, this->config)) {
+      cerr_color(RED, "Failed to snapshot config to ", this->state_dir);
+    }
+  }
+  return res;
+}
+
+Response StaticShardController::apply(const Request& req) {
   Response res;
   if (auto* join_req = std::get_if<JoinRequest>(&req)) {
     JoinResponse join_res{};
@@ -199,15 +255,38 @@ Response StaticShardController::process_request(Request req) {
     } else {
       res = ErrorResponse{"Failed to process Move request."};
     }
-  } else if (auto* query_req = std::get_if<QueryRequest>(&req)) {
-    QueryResponse query_res{};
-    if (this->Query(query_req, &query_res)) {
-      res = query_res;
-    } else {
-      res = ErrorResponse{"Failed to process Query request."};
-    }
   } else {
     throw std::logic_error{"invalid request variant!"};
   }
   return res;
 }
+
+bool StaticShardController::recover() {
+  auto start = steady_clock::now();
+  this->log = std::make_unique<ConfigLog>(this->state_dir);
+  std::optional<ConfigLog::Recovered> recovered = this->log->recover();
+  if (!recovered) return false;
+
+  {
+    std::unique_lock lock(this->config_mtx);
+    this->config = std::move(recovered->config);
+  }
+  for (auto&& req : recovered->requests) this->apply(req);
+  this->version = recovered->versions.empty() ? recovered->version
+                                              : recovered->versions.back();
+  this->epoch = recovered->epoch + 1;
+
+  // Start the new epoch from a snapshot, so that the next restart doesn't
+  // replay the same log again
+  {
+    std::shared_lock lock(this->config_mtx);
+    if (!this->log->snapshot(this->epoch, this->version, this->config)) {
+      return false;
+    }
+  }
+  auto elapsed = duration_cast<microseconds>(steady_clock::now() - start);
+  cout_color(BLUE, "Recovered config version ", this->version.load(), " (",
+             recovered->requests.size(), " changes replayed) in ",
+             elapsed.count(), " us; now in epoch ", this->epoch.load());
+  return true;
+}
@@ -1,9 +1,11 @@
 #ifndef STATIC_SHARDCONTROLLER_HPP
 #define STATIC_SHARDCONTROLLER_HPP
 
+#include <atomic>
 #include <condition_variable>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <thread>
 
@@ -13,10 +15,16 @@
 #include "net/network_helpers.hpp"
 #include "net/network_messages.hpp"
 #include "shardcontroller.hpp"
+#include "shardcontroller/config_log.hpp"
 
 class StaticShardController : public Shardcontroller {
  public:
-  explicit StaticShardController(const std::string& addr) : address(addr) {
+  // If `state_dir` is given, config changes made over the network are logged
+  // there (see ConfigLog), and recovered from it on start(); otherwise, the
+  // config only lives in memory.
+  explicit StaticShardController(const std::string& addr,
+                                 const std::string& state_dir = "")
+      : address(addr), state_dir(state_dir) {
   }
   ~StaticShardController() {
     if (!this->is_stopped) {
@@ -42,7 +50,7 @@ class StaticShardController : public Shardcontroller {
   /* ==================================================*/
   // An atomic, thread-safe boolean to denote whether the shardcontroller has
   // been stopped.
-  std::atomic<bool> is_stopped;
+  std::atomic<bool> is_stopped = true;
 
   // Address on which the shardcontroller is listening.
   std::string address;
@@ -52,6 +60,15 @@ class StaticShardController : public Shardcontroller {
   // Thread that listens for client connections and accepts them.
   std::thread client_listener;
 
+  // Directory the config is persisted in, and its log (if it is).
+  std::string state_dir;
+  std::unique_ptr<ConfigLog> log;
+  // Serializes config changes, so that they're logged in the order they're
+  // made.
+  std::mutex change_mtx;
+  std::atomic<uint64_t> epoch = 0;
+  std::atomic<uint64_t> version = 0;
+
   // Collection of current client connections.
   std::vector<std::shared_ptr<ClientConn>> current_conns;
   // Synchronization primitives for client connections.
@@ -76,6 +93,21 @@ class StaticShardController : public Shardcontroller {
    * handler (Join, Leave, ...), then get a response.
    */
   Response process_request(Request req);
+
+  /**
+   * Logs a config change (a Join, Leave, or Move request), then makes it.
+   */
+  Response process_change(const Request& req);
+
+  /**
+   * Makes a config change, without logging it.
+   */
+  Response apply(const Request& req);
+
+  /**
+   * Restores the config from the state directory, and starts a new epoch.
+   */
+  bool recover();
 };
 
 #endif /* end of include guard */
@@ -0,0 +1,81 @@
+#include <fstream>
+#include <future>
+
+#include "client/async_client.hpp"
+#include "client/simple_client.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_SERVER_WORKERS = 8;
+static constexpr size_t N_THREADS = 32;
+static constexpr size_t N_REQUESTS = 1024;
+static constexpr size_t N_ASYNC_CONNS = 4;
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test Puts N_REQUESTS keys into a KvServer twice. First, N_THREADS
+    threads each send their share of the requests one at a time through a
+    SimpleClient, so at most N_THREADS requests are in flight. Then a single
+    thread sends every request through one AsyncClient, keeping all of them in
+    flight over N_ASYNC_CONNS pipelined connections.
+  */
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t>(
+          addr, uint64_t(N_SERVER_WORKERS));
+  auto keys = make_rand_strs(N_REQUESTS, 10, std::string(VALID_CHARS));
+  auto vals = make_rand_strs(N_REQUESTS, 10);
+
+  // Thread-per-request
+  auto start = std::chrono::high_resolution_clock::now();
+  {
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < N_THREADS; t++) {
+      threads.emplace_back([&, t] {
+        SimpleClient client(addr);
+        for (size_t i = t; i < N_REQUESTS; i += N_THREADS) {
+          ASSERT(client.Put(keys[i], vals[i]));
+        }
+      });
+    }
+    for (auto& thr : threads) {
+      thr.join();
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  auto sync_time =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  output_file << "sync_client_put," << sync_time.count() << ","
+              << to_throughput(sync_time, 1, N_REQUESTS) << "\n";
+
+  // One thread, every request in flight at once
+  start = std::chrono::high_resolution_clock::now();
+  {
+    AsyncClient client(addr, N_ASYNC_CONNS);
+    std::vector<std::future<bool>> futures;
+    futures.reserve(N_REQUESTS);
+    for (size_t i = 0; i < N_REQUESTS; i++) {
+      futures.push_back(client.Put(keys[i], vals[i]));
+    }
+    for (auto& future : futures) {
+      ASSERT(future.get());
+    }
+  }
+  end = std::chrono::high_resolution_clock::now();
+  auto async_time =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  output_file << "async_client_put," << async_time.count() << ","
+              << to_throughput(async_time, 1, N_REQUESTS) << "\n";
+
+  std::cout << "SimpleClient (" << N_THREADS << " threads): "
+            << sync_time.count() << "ms, AsyncClient (1 thread): "
+            << async_time.count() << "ms\n";
+
+  // The AsyncClient's connections are closed, so the server can stop
+  server->stop();
+  cout_color(GREEN, "Test passed!");
+}
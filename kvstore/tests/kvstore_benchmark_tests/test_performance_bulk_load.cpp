@@ -0,0 +1,85 @@
+#include <fstream>
+
+#include "client/bulk_loader.hpp"
+#include "client/simple_client.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_SERVERS = 2;
+static constexpr size_t N_SERVER_WORKERS = 8;
+static constexpr size_t N_RECORDS = 20'000;
+// Records Put one at a time, with a connection each, for comparison.
+static constexpr size_t N_BASELINE_RECORDS = 100;
+static constexpr size_t N_CHECKED = 100;
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test loads N_RECORDS `put` commands (plus a few lines that aren't)
+    into two KvServers with a BulkLoader, routing keys by their first
+    character, and checks that every record got to its server. For
+    comparison, it also Puts N_BASELINE_RECORDS of them one at a time through
+    a SimpleClient, the way feeding the file to the REPL would.
+  */
+  auto addrs = make_server_addresses(N_SERVERS);
+  std::vector<std::shared_ptr<KvServer>> servers;
+  for (auto&& addr : addrs) {
+    servers.push_back(start_server<KvServer, const std::string&, uint64_t>(
+        addr, uint64_t(N_SERVER_WORKERS)));
+  }
+  auto route = [&](const std::string& key) -> std::optional<std::string> {
+    return addrs[key[0] % N_SERVERS];
+  };
+
+  auto keys = make_rand_strs(N_RECORDS, 16, std::string(VALID_CHARS));
+  auto vals = make_rand_strs(N_RECORDS, 32, std::string(VALID_CHARS));
+  // As in the REPL, a value's words are joined by single spaces
+  std::string commands = "\n# not a command\nget key\nput SPACED  a   b \n";
+  for (size_t i = 0; i < N_RECORDS; i++) {
+    commands += "put " + keys[i] + " " + vals[i] + "\n";
+  }
+
+  // The baseline's row goes first: like the A5 pairs, the rows read as
+  // (baseline, improved)
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < N_BASELINE_RECORDS; i++) {
+    ASSERT(SimpleClient(*route(keys[i])).Put(keys[i], vals[i]));
+  }
+  auto baseline = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+  output_file << "put_per_record," << baseline.count() << ","
+              << to_throughput(baseline, 1, N_BASELINE_RECORDS) << "\n";
+  std::cout << "One Put per record: "
+            << N_BASELINE_RECORDS * 1000.0 /
+                   std::max<int64_t>(baseline.count(), 1)
+            << " records/second\n";
+
+  BulkLoadConfig config;
+  config.n_threads = 4;
+  BulkLoadReport report;
+  {
+    // Closes its connections once done, so the servers can stop
+    BulkLoader loader(config, route);
+    report = loader.load(commands);
+  }
+  std::cout << format_bulk_report(report);
+  ASSERT_EQ(report.n_records, uint64_t(N_RECORDS + 1));
+  ASSERT_EQ(report.n_errors, uint64_t(0));
+  ASSERT_EQ(report.n_skipped, uint64_t(2));
+  output_file << "bulk_load," << report.elapsed.count() << ","
+              << to_throughput(report.elapsed, 1, N_RECORDS) << "\n";
+
+  ASSERT(SimpleClient(*route("SPACED")).Get("SPACED") ==
+         std::optional<std::string>("a b"));
+  for (size_t i = 0; i < N_RECORDS; i += N_RECORDS / N_CHECKED) {
+    std::optional<std::string> value =
+        SimpleClient(*route(keys[i])).Get(keys[i]);
+    ASSERT(value && *value == vals[i]);
+  }
+
+  for (auto&& server : servers) server->stop();
+  cout_color(GREEN, "Test passed!");
+}
@@ -0,0 +1,93 @@
+#include <fstream>
+
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_THREADS = 8;
+// 10M keys are Put over the course of the test, but each thread only keeps its
+// N_LIVE_KEYS_PER_THREAD most recent keys around.
+static constexpr size_t N_CHURN_KEYS = 10'000'000;
+static constexpr size_t N_LIVE_KEYS_PER_THREAD = 128;
+static constexpr size_t MAX_CHURN_VALUE_SIZE = 1024;
+
+// Resident set size of this process, in bytes.
+static size_t rss_bytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0, resident = 0;
+  statm >> pages >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char* argv[]) {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test churns N_CHURN_KEYS keys through a ConcurrentKvStore: each Put of
+    a new key (with a randomly-sized value) is followed by a Delete of an old
+    one, so the live set stays small while the allocator sees millions of
+    allocations and frees of varying sizes. We time the churn with one thread,
+    then with N_THREADS threads, and report the process's RSS after each, along
+    with the store's fragmentation report.
+  */
+  auto churn = [](KvStore& store, size_t thread_id, size_t n_keys) {
+    std::mt19937 gen(thread_id);
+    std::uniform_int_distribution<size_t> value_size(1, MAX_CHURN_VALUE_SIZE);
+    std::string prefix = "t" + std::to_string(thread_id) + "_";
+
+    auto put_req = PutRequest{};
+    auto put_res = PutResponse{};
+    auto del_req = DeleteRequest{};
+    auto del_res = DeleteResponse{};
+    for (size_t i = 0; i < n_keys; i++) {
+      put_req.key = prefix + std::to_string(i);
+      put_req.value.assign(value_size(gen), 'v');
+      ASSERT(store.Put(&put_req, &put_res));
+      if (i >= N_LIVE_KEYS_PER_THREAD) {
+        del_req.key = prefix + std::to_string(i - N_LIVE_KEYS_PER_THREAD);
+        ASSERT(store.Delete(&del_req, &del_res));
+      }
+    }
+  };
+
+  // Single-threaded churn
+  auto single_threaded_store = std::make_unique<ConcurrentKvStore>();
+  auto start = std::chrono::high_resolution_clock::now();
+  churn(*single_threaded_store, 0, N_CHURN_KEYS / N_THREADS);
+  auto end = std::chrono::high_resolution_clock::now();
+  auto single_threaded_time =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  output_file << "single_thread_churn," << single_threaded_time.count() << ","
+              << to_throughput(single_threaded_time, 1,
+                               N_CHURN_KEYS / N_THREADS)
+              << "\n";
+  std::cout << "RSS after single-threaded churn: " << (rss_bytes() >> 20)
+            << " MiB\n";
+
+  // Multithreaded churn, over N_THREADS times as many keys
+  auto multi_threaded_store = std::make_unique<ConcurrentKvStore>();
+  start = std::chrono::high_resolution_clock::now();
+  {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < N_THREADS; i++) {
+      threads.emplace_back(churn, std::ref(*multi_threaded_store), i,
+                           N_CHURN_KEYS / N_THREADS);
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  end = std::chrono::high_resolution_clock::now();
+  auto multi_threaded_time =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  output_file << "multi_thread_churn," << multi_threaded_time.count() << ","
+              << to_throughput(multi_threaded_time, N_THREADS,
+                               N_CHURN_KEYS / N_THREADS)
+              << "\n";
+  std::cout << "RSS after multithreaded churn: " << (rss_bytes() >> 20)
+            << " MiB\n";
+  std::cout << multi_threaded_store->MemoryReport();
+
+  ASSERT_EQ(multi_threaded_store->AllKeys().size(),
+            N_THREADS * N_LIVE_KEYS_PER_THREAD);
+}
@@ -0,0 +1,152 @@
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "client/simple_client.hpp"
+#include "kvstore/concurrent_kvstore.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_DOCS = 4096;
+static constexpr size_t MIN_DOC_SIZE = 256;
+static constexpr size_t MAX_DOC_SIZE = 8192;
+static constexpr size_t N_WIRE_DOCS = 256;
+
+// Words of the posts in gdpr/database.txt, for text that compresses like
+// users' posts do.
+static const std::vector<std::string> WORDS = {
+    "quarantine", "til", "july", "sounds", "like", "a", "bunch", "of", "i'm",
+    "sorry", "it's", "virus", "get", "it", "respect", "but", "at", "the",
+    "same", "time", "even", "if", "everybody", "gets", "yeah", "people", "are",
+    "going", "to", "die", "we", "need", "open", "up", "economy", "again", "my",
+    "friends", "and", "family", "can't", "wait", "for", "this", "be", "over",
+    "so", "tired", "staying", "home", "all", "day", "just", "want", "go",
+    "outside", "with", "you", "today", "love"};
+
+// A JSON-like post document of roughly `size` bytes, with a body and replies
+// made of WORDS.
+std::string make_doc(size_t id, size_t size, std::mt19937& rng) {
+  auto sentence = [&] {
+    std::string s;
+    size_t n_words = 6 + rng() % 14;
+    for (size_t i = 0; i < n_words; i++) {
+      if (i > 0) s += ' ';
+      s += WORDS[rng() % WORDS.size()];
+    }
+    return s + '.';
+  };
+
+  std::stringstream ss;
+  ss << "{\"id\":\"post_" << id << "\",\"author\":\"user_" << rng() % 100
+     << "\",\"created_at\":\"2020-0" << 1 + rng() % 9 << "-1" << rng() % 10
+     << "T" << 10 + rng() % 14 << ":" << 10 + rng() % 50
+     << ":00Z\",\"likes\":" << rng() % 5000 << ",\"body\":\"";
+  for (size_t i = 0; i < 3; i++) ss << sentence() << ' ';
+  ss << "\",\"replies\":[";
+  for (size_t i = 0; ss.tellp() < std::streamoff(size); i++) {
+    if (i > 0) ss << ',';
+    ss << "{\"author\":\"user_" << rng() % 100 << "\",\"likes\":" << rng() % 500
+       << ",\"body\":\"" << sentence() << "\"}";
+  }
+  ss << "]}";
+  return ss.str();
+}
+
+// Memory the map's items take up in their slab chunks.
+size_t memory_in_use(DbMap<>& map) {
+  size_t bytes = 0;
+  for (auto&& s : map.allocator.stats()) bytes += s.n_used * s.chunk_size;
+  return bytes;
+}
+
+// Puts then Gets every document, checking each comes back intact. Returns how
+// long that took.
+std::chrono::nanoseconds put_get(DbMap<>& map,
+                                 const std::vector<std::string>& keys,
+                                 const std::vector<std::string>& docs) {
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < keys.size(); i++) {
+    map.insertItem(map.bucket(keys[i]), keys[i], docs[i]);
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    auto item = map.getIfExists(map.bucket(keys[i]), keys[i]);
+    ASSERT(item && item->value == docs[i]);
+  }
+  return std::chrono::high_resolution_clock::now() - start;
+}
+
+// Bytes the server received for Puts of `docs`.
+uint64_t wire_bytes(const std::string& addr, KvServer& server,
+                    const std::vector<std::string>& keys,
+                    const std::vector<std::string>& docs, bool compress) {
+  SimpleClient client(addr, 0ms, compress);
+  uint64_t before = server.get_stats().bytes_in;
+  for (size_t i = 0; i < N_WIRE_DOCS; i++) {
+    ASSERT(client.Put(keys[i], docs[i]));
+  }
+  return server.get_stats().bytes_in - before;
+}
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test stores N_DOCS JSON-like documents (MIN_DOC_SIZE to MAX_DOC_SIZE
+    bytes each, made of post text) in a DbMap, and reads them all back: first
+    with value compression turned off, then on. It reports how much memory the
+    items take up either way, and what compression costs per value. Then it
+    Puts some of the documents to a KvServer with and without wire compression,
+    comparing the bytes the server received.
+  */
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<size_t> doc_size(MIN_DOC_SIZE, MAX_DOC_SIZE);
+  auto keys = make_rand_strs(N_DOCS, 10, std::string(VALID_CHARS));
+  std::vector<std::string> docs;
+  size_t corpus_bytes = 0;
+  for (size_t i = 0; i < N_DOCS; i++) {
+    docs.push_back(make_doc(i, doc_size(rng), rng));
+    corpus_bytes += docs.back().size();
+  }
+
+  DbMap<> plain(KeyHash(), CompressionOptions{.enabled = false});
+  auto plain_time = put_get(plain, keys, docs);
+  auto plain_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      plain_time);
+  size_t plain_memory = memory_in_use(plain);
+  output_file << "uncompressed_put_get," << plain_ms.count() << ","
+              << to_throughput(plain_ms, 1, 2 * N_DOCS) << "\n";
+
+  DbMap<> compressed;
+  auto compressed_time = put_get(compressed, keys, docs);
+  auto compressed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      compressed_time);
+  size_t compressed_memory = memory_in_use(compressed);
+  output_file << "compressed_put_get," << compressed_ms.count() << ","
+              << to_throughput(compressed_ms, 1, 2 * N_DOCS) << "\n";
+
+  Compressor::Stats stats = compressed.compressor.stats();
+  std::cout << N_DOCS << " documents, " << corpus_bytes << " bytes\n";
+  std::cout << "Memory in use: " << plain_memory << " bytes uncompressed, "
+            << compressed_memory << " bytes compressed ("
+            << 100 - 100 * compressed_memory / plain_memory << "% saved)\n";
+  std::cout << compressed.compressor.report();
+  std::cout << "CPU per op: " << plain_time.count() / (2 * N_DOCS)
+            << " ns uncompressed, " << compressed_time.count() / (2 * N_DOCS)
+            << " ns compressed\n";
+  ASSERT(stats.kept > 0);
+  ASSERT(compressed_memory < plain_memory);
+
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t>(addr, uint64_t(2));
+  uint64_t plain_wire = wire_bytes(addr, *server, keys, docs, false);
+  uint64_t compressed_wire = wire_bytes(addr, *server, keys, docs, true);
+  std::cout << "Wire: " << plain_wire << " bytes uncompressed, "
+            << compressed_wire << " bytes compressed (including handshakes)\n";
+  ASSERT(compressed_wire < plain_wire);
+  server->stop();
+
+  cout_color(GREEN, "Test passed!");
+}
@@ -0,0 +1,82 @@
+#include <atomic>
+#include <fstream>
+
+#include "net/network_conn.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_SERVER_WORKERS = 4;
+static constexpr size_t N_CLIENT_THREADS = 32;
+static constexpr size_t CONNS_PER_THREAD = 50;
+
+struct StormResult {
+  milliseconds time;
+  size_t n_admitted;
+  uint64_t n_shed;
+};
+
+// Starts a server with `n_listeners` listeners on `addr`, then has
+// N_CLIENT_THREADS threads each open CONNS_PER_THREAD connections back to
+// back, as reconnecting clients do, sending one Get on each.
+StormResult run_storm(const std::string& addr, size_t n_listeners) {
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t, AdmissionLimits,
+                   WorkerPlacement, size_t>(
+          addr, uint64_t(N_SERVER_WORKERS), AdmissionLimits{},
+          WorkerPlacement{}, size_t(n_listeners));
+
+  std::atomic<size_t> n_admitted = 0;
+  std::vector<std::thread> threads;
+  auto start = steady_clock::now();
+  for (size_t t = 0; t < N_CLIENT_THREADS; t++) {
+    threads.emplace_back([&] {
+      for (size_t i = 0; i < CONNS_PER_THREAD; i++) {
+        std::shared_ptr<ServerConn> conn = connect_to_server(addr);
+        if (!conn || !conn->send_request(GetRequest{"key"})) continue;
+        std::optional<Response> res = conn->recv_response();
+        if (!res) continue;
+        auto* error_res = std::get_if<ErrorResponse>(&*res);
+        if (!error_res || error_res->msg != "server busy") n_admitted++;
+      }
+    });
+  }
+  for (auto&& thread : threads) thread.join();
+  auto time = duration_cast<milliseconds>(steady_clock::now() - start);
+
+  uint64_t n_shed = server->get_stats().shed;
+  server->stop();
+  return StormResult{time, n_admitted.load(), n_shed};
+}
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test measures how fast a KvServer admits a storm of new connections
+    (like every client reconnecting at once after a deploy), first with a
+    single listener thread accepting them all, then with one SO_REUSEPORT
+    listener per worker. It reports the accept rate: connections admitted and
+    answered per second.
+  */
+  std::vector<std::string> addrs = make_server_addresses(2);
+  size_t n_conns = N_CLIENT_THREADS * CONNS_PER_THREAD;
+  for (auto [name, addr, n_listeners] :
+       {std::tuple("connection_storm_1_listener", addrs[0], size_t(1)),
+        std::tuple("connection_storm_n_listeners", addrs[1],
+                   N_SERVER_WORKERS)}) {
+    StormResult result = run_storm(addr, n_listeners);
+    output_file << name << "," << result.time.count() << ","
+                << to_throughput(result.time, N_CLIENT_THREADS,
+                                 CONNS_PER_THREAD)
+                << "\n";
+    std::cout << name << ": " << result.n_admitted << " of " << n_conns
+              << " connections admitted in " << result.time.count() << " ms ("
+              << 1000 * result.n_admitted / std::max<int64_t>(
+                                                1, result.time.count())
+              << " accepts/s, " << result.n_shed << " shed)\n";
+  }
+
+  cout_color(GREEN, "Test passed!");
+}
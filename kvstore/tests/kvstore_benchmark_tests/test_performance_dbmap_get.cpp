@@ -0,0 +1,93 @@
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#include "kvstore/concurrent_kvstore.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_KEYS = 10'000;
+static constexpr size_t N_GETS = 1'000'000;
+static constexpr size_t KEY_SIZE = 32;
+static constexpr size_t VALUE_SIZE = 64;
+
+// Every heap allocation the program makes, counted.
+static std::atomic<uint64_t> n_allocations{0};
+
+void* operator new(size_t size) {
+  n_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+struct Result {
+  std::chrono::nanoseconds time;
+  uint64_t allocations;
+};
+
+// Runs N_GETS of `get` over `keys`, counting the allocations they make.
+template <typename Get>
+Result run_gets(const std::vector<std::string>& keys, Get get) {
+  uint64_t allocations = n_allocations;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < N_GETS; i++) {
+    ASSERT(get(keys[i % keys.size()]));
+  }
+  auto time = std::chrono::high_resolution_clock::now() - start;
+  return Result{time, n_allocations - allocations};
+}
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test Gets N_GETS keys from a DbMap of N_KEYS items, on one thread,
+    two ways: through a type-erased std::function<size_t(std::string)> hasher
+    and getIfExists (which copies the key to hash it, and the key and value
+    into a DbItem), and through the default, transparent KeyHash and readValue
+    into a reused string. It reports the time and heap allocations per Get;
+    the second way must make none.
+  */
+  auto keys = make_rand_strs(N_KEYS, KEY_SIZE, std::string(VALID_CHARS));
+  std::string value(VALUE_SIZE, 'v');
+
+  DbMap<std::function<size_t(std::string)>> type_erased(
+      std::hash<std::string>(), CompressionOptions{.enabled = false});
+  DbMap<> transparent(KeyHash(), CompressionOptions{.enabled = false});
+  for (auto&& key : keys) {
+    type_erased.insertItem(type_erased.bucket(key), key, value);
+    transparent.insertItem(transparent.bucket(key), key, value);
+  }
+
+  Result type_erased_result = run_gets(keys, [&](const std::string& key) {
+    return type_erased.getIfExists(type_erased.bucket(key), key).has_value();
+  });
+  std::string out;
+  out.reserve(VALUE_SIZE);
+  Result transparent_result = run_gets(keys, [&](std::string_view key) {
+    return transparent.readValue(transparent.bucket(key), key, &out);
+  });
+
+  for (auto [name, result] :
+       {std::pair("dbmap_get_type_erased", type_erased_result),
+        std::pair("dbmap_get_transparent", transparent_result)}) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        result.time);
+    output_file << name << "," << ms.count() << ","
+                << to_throughput(ms, 1, N_GETS) << "\n";
+    std::cout << name << ": " << result.time.count() / N_GETS
+              << " ns and " << double(result.allocations) / N_GETS
+              << " allocations per Get\n";
+  }
+
+  ASSERT_EQ(transparent_result.allocations, uint64_t(0));
+  cout_color(GREEN, "Test passed!");
+}
@@ -0,0 +1,109 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "net/network_conn.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_WARMUP = 500;
+static constexpr size_t N_REQUESTS = 10'000;
+static constexpr size_t KEY_SIZE = 16;
+static constexpr size_t VALUE_SIZE = 64;
+// Bigger than a shared-memory ring, so it has to stream through
+static constexpr size_t LARGE_MESSAGE_SIZE = 1 << 20;
+
+// Puts N_REQUESTS small values one at a time over `conn`, and reports their
+// round-trip latencies.
+void measure(const std::string& name, ServerConn& conn,
+             std::ofstream& output_file) {
+  auto keys = make_rand_strs(N_REQUESTS, KEY_SIZE, std::string(VALID_CHARS));
+  std::string value(VALUE_SIZE, 'v');
+  auto put = [&](const std::string& key) {
+    ASSERT(conn.send_request(PutRequest{key, value, 0}));
+    std::optional<Response> res = conn.recv_response();
+    ASSERT(res && std::holds_alternative<PutResponse>(*res));
+  };
+
+  for (size_t i = 0; i < N_WARMUP; i++) put(keys[i]);
+  std::vector<nanoseconds> latencies;
+  latencies.reserve(N_REQUESTS);
+  auto start = steady_clock::now();
+  for (auto&& key : keys) {
+    auto sent = steady_clock::now();
+    put(key);
+    latencies.push_back(steady_clock::now() - sent);
+  }
+  auto ms = duration_cast<milliseconds>(steady_clock::now() - start);
+
+  std::sort(latencies.begin(), latencies.end());
+  auto us = [](nanoseconds ns) { return ns.count() / 1000.0; };
+  std::cout << name << ": " << us(latencies[N_REQUESTS / 2]) << "us p50, "
+            << us(latencies[N_REQUESTS * 99 / 100]) << "us p99, "
+            << N_REQUESTS * 1000.0 / std::max<int64_t>(ms.count(), 1)
+            << " requests/second\n";
+  output_file << name << "," << ms.count() << ","
+              << to_throughput(ms, 1, N_REQUESTS) << "\n";
+}
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test Puts small values to KvServers on this host one at a time, and
+    compares their round-trip latency over TCP loopback, over a Unix domain
+    socket, and over a shared-memory channel negotiated on the Unix domain
+    socket's connection. It also checks that messages larger than the
+    channel's rings get through whole, and that the server notices when a
+    client using the channel goes away.
+  */
+  std::string tcp_addr = make_server_addresses(1)[0];
+  std::string unix_addr =
+      "unix:/tmp/kvstore-test-" + std::to_string(getpid()) + ".sock";
+  std::shared_ptr<KvServer> tcp_server =
+      start_server<KvServer, const std::string&, uint64_t>(tcp_addr,
+                                                           uint64_t(1));
+  std::shared_ptr<KvServer> unix_server =
+      start_server<KvServer, const std::string&, uint64_t>(unix_addr,
+                                                           uint64_t(1));
+
+  std::shared_ptr<ServerConn> tcp_conn = connect_to_server(tcp_addr);
+  ASSERT(tcp_conn);
+  measure("tcp_loopback", *tcp_conn, output_file);
+  tcp_conn.reset();
+
+  std::shared_ptr<ServerConn> unix_conn = connect_to_server(unix_addr);
+  ASSERT(unix_conn);
+  ASSERT(unix_conn->negotiate(0));
+  ASSERT(!unix_conn->uses_shm());
+  measure("unix_socket", *unix_conn, output_file);
+  unix_conn.reset();
+
+  std::shared_ptr<ServerConn> shm_conn = connect_to_server(unix_addr);
+  ASSERT(shm_conn);
+  ASSERT(shm_conn->negotiate(FEATURE_SHARED_MEMORY));
+  ASSERT(shm_conn->uses_shm());
+  measure("shared_memory", *shm_conn, output_file);
+
+  // The server's only worker only moves on to the next connection once it
+  // notices that this one's client has gone away
+  shm_conn.reset();
+  std::shared_ptr<ServerConn> big_conn = connect_to_server(unix_addr);
+  ASSERT(big_conn);
+  ASSERT(big_conn->negotiate(FEATURE_SHARED_MEMORY | FEATURE_COMPRESSION));
+  ASSERT(big_conn->uses_shm());
+  // Much larger than the rings (random, so it stays that way compressed)
+  std::string large;
+  for (auto&& s : make_rand_strs(LARGE_MESSAGE_SIZE / 32, 32)) large += s;
+  ASSERT(big_conn->send_request(PutRequest{"key", large, 0}));
+  std::optional<Response> res = big_conn->recv_response();
+  ASSERT(res && std::holds_alternative<PutResponse>(*res));
+  big_conn.reset();
+
+  unix_server->stop();
+  tcp_server->stop();
+  cout_color(GREEN, "Test passed!");
+}
@@ -0,0 +1,77 @@
+#include "client/load_generator.hpp"
+#include "client/near_cache.hpp"
+#include "client/simple_client.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_SERVER_WORKERS = 2;
+static constexpr size_t N_THREADS = 2;
+static constexpr size_t N_KEYS = 10'000;
+static constexpr size_t VALUE_SIZE = 64;
+static constexpr double READ_FRACTION = 0.95;
+static constexpr milliseconds RUN_DURATION = 3s;
+static constexpr size_t N_WRITES = 20;
+static constexpr size_t N_READS_PER_WRITE = 5;
+
+// Runs the Zipf workload against `addr`, with clients sharing `cache` (if
+// any), and records it in the CSV as `title`.
+LoadReport run_workload(const std::string& addr, const std::string& title,
+                        const std::shared_ptr<NearCache>& cache) {
+  LoadConfig config;
+  config.n_threads = N_THREADS;
+  config.duration = RUN_DURATION;
+  config.n_keys = N_KEYS;
+  config.value_size = VALUE_SIZE;
+  config.distribution = KeyDistribution::ZIPF;
+  config.read_fraction = READ_FRACTION;
+  LoadGenerator generator(config, [&] {
+    return std::make_shared<SimpleClient>(addr, 0ms, false, cache);
+  });
+  ASSERT(generator.preload());
+
+  LoadReport report = generator.run();
+  std::cout << title << ":\n" << format_report(report);
+  ASSERT_EQ(report.n_errors, uint64_t(0));
+  if (!append_csv("benchmark-runtime.csv", title, report)) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  return report;
+}
+
+int main() {
+  /*
+    This test runs a read-heavy workload, with Zipf-distributed keys, against
+    a KvServer, first with plain SimpleClients, then with SimpleClients that
+    share a NearCache, and reports their throughput and the cache's hit rate.
+    It also checks that a write isn't acknowledged until reads from the cache
+    can't return the value it overwrote.
+  */
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t>(
+          addr, uint64_t(N_SERVER_WORKERS));
+
+  LoadReport uncached = run_workload(addr, "near_cache_off", nullptr);
+  auto cache = std::make_shared<NearCache>();
+  LoadReport cached = run_workload(addr, "near_cache_on", cache);
+  uint64_t n_gets = cache->hits() + cache->misses();
+  ASSERT(cache->hits() > 0);
+  std::cout << "Near-cache hit rate: " << 100.0 * cache->hits() / n_gets
+            << "%, speedup: " << cached.throughput / uncached.throughput
+            << "x\n";
+
+  SimpleClient reader(addr, 0ms, false, cache);
+  SimpleClient writer(addr);
+  for (size_t i = 0; i < N_WRITES; i++) {
+    // Waits out the lease the reader got on the last value
+    ASSERT(writer.Put("key", std::to_string(i)));
+    // The first Get leases the value; the others are answered from the cache
+    // (unless the lease runs out first)
+    for (size_t j = 0; j < N_READS_PER_WRITE; j++) {
+      ASSERT(reader.Get("key") == std::to_string(i));
+    }
+  }
+
+  server->stop();
+  cout_color(GREEN, "Test passed!");
+}
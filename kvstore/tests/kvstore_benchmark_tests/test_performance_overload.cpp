@@ -0,0 +1,84 @@
+#include <atomic>
+#include <fstream>
+
+#include "client/simple_client.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_SERVER_WORKERS = 2;
+static constexpr size_t N_NOMINAL_THREADS = 2;
+static constexpr size_t N_OVERLOAD_THREADS = 64;
+static constexpr auto PHASE_DURATION = 3s;
+static constexpr auto REQUEST_BUDGET = 500ms;
+static constexpr AdmissionLimits LIMITS{.max_queued_conns = 2,
+                                        .retry_after = 20ms};
+
+// Puts from `n_threads` threads for PHASE_DURATION, backing off for
+// LIMITS.retry_after after each failure. Returns the number of successes.
+static size_t run_phase(const std::string& addr, size_t n_threads,
+                        std::atomic<size_t>* n_failures) {
+  std::atomic<size_t> n_successes = 0;
+  auto end = steady_clock::now() + PHASE_DURATION;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < n_threads; t++) {
+    threads.emplace_back([&, t] {
+      SimpleClient client(addr, REQUEST_BUDGET);
+      std::string key = "key" + std::to_string(t);
+      while (steady_clock::now() < end) {
+        if (client.Put(key, "value")) {
+          n_successes++;
+        } else {
+          (*n_failures)++;
+          std::this_thread::sleep_for(LIMITS.retry_after);
+        }
+      }
+    });
+  }
+  for (auto& thr : threads) {
+    thr.join();
+  }
+  return n_successes;
+}
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test measures a KvServer's goodput (successful requests per second)
+    first at a load its workers can keep up with, then with N_OVERLOAD_THREADS
+    clients, far more than its queues admit. With admission control, the
+    excess connections are turned away quickly, so the server keeps doing
+    useful work at about the same rate instead of queueing requests past their
+    budgets.
+  */
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t, AdmissionLimits>(
+          addr, uint64_t(N_SERVER_WORKERS), AdmissionLimits(LIMITS));
+  auto phase_ms = duration_cast<milliseconds>(PHASE_DURATION);
+
+  std::atomic<size_t> nominal_failures = 0;
+  size_t nominal = run_phase(addr, N_NOMINAL_THREADS, &nominal_failures);
+  output_file << "nominal_goodput," << phase_ms.count() << ","
+              << to_throughput(phase_ms, 1, nominal) << "\n";
+
+  std::atomic<size_t> overload_failures = 0;
+  size_t overload = run_phase(addr, N_OVERLOAD_THREADS, &overload_failures);
+  output_file << "overload_goodput," << phase_ms.count() << ","
+              << to_throughput(phase_ms, 1, overload) << "\n";
+
+  StatsResponse stats = server->get_stats();
+  std::cout << "Nominal: " << nominal << " ok, " << nominal_failures
+            << " failed. Overload: " << overload << " ok, "
+            << overload_failures << " failed (" << stats.shed << " shed, "
+            << stats.expired << " expired)\n";
+
+  // Goodput holds up under overload, because the excess load was shed
+  ASSERT(stats.shed > 0);
+  ASSERT(overload * 2 >= nominal);
+
+  server->stop();
+  cout_color(GREEN, "Test passed!");
+}
@@ -0,0 +1,76 @@
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#include "net/network_conn.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_WARMUP = 1'000;
+static constexpr size_t N_REQUESTS = 20'000;
+static constexpr size_t KEY_SIZE = 12;
+static constexpr size_t VALUE_SIZE = 12;
+
+// Every heap allocation the program (client and server both) makes, counted.
+static std::atomic<uint64_t> n_allocations{0};
+
+void* operator new(size_t size) {
+  n_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test sends N_REQUESTS Puts of small keys and values (short enough not
+    to need heap allocations of their own) to a KvServer, one at a time over a
+    single connection, and reports their throughput, and the heap allocations
+    per request on both ends (serializing, framing, sending, receiving and
+    deserializing the request and its response). Connections reuse their
+    message buffers, so once they have grown to fit, messages this size need
+    no allocations; what's left is the store, and the request itself.
+  */
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t>(addr, uint64_t(1));
+  std::shared_ptr<ServerConn> conn = connect_to_server(addr);
+  ASSERT(conn);
+
+  auto keys = make_rand_strs(N_REQUESTS, KEY_SIZE, std::string(VALID_CHARS));
+  std::string value(VALUE_SIZE, 'v');
+  auto put = [&](const std::string& key) {
+    ASSERT(conn->send_request(PutRequest{key, value, 0}));
+    std::optional<Response> res = conn->recv_response();
+    ASSERT(res && std::holds_alternative<PutResponse>(*res));
+  };
+
+  for (size_t i = 0; i < N_WARMUP; i++) put(keys[i]);
+  uint64_t allocations = n_allocations;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (auto&& key : keys) put(key);
+  auto end = std::chrono::high_resolution_clock::now();
+  double per_request = double(n_allocations - allocations) / N_REQUESTS;
+
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  output_file << "small_requests," << ms.count() << ","
+              << to_throughput(ms, 1, N_REQUESTS) << "\n";
+  std::cout << "Small Puts: "
+            << N_REQUESTS * 1000.0 / std::max<int64_t>(ms.count(), 1)
+            << " requests/second, " << per_request
+            << " allocations per request\n";
+
+  conn.reset();
+  server->stop();
+  cout_color(GREEN, "Test passed!");
+}
@@ -0,0 +1,94 @@
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include "client/transaction.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_SERVERS = 3;
+static constexpr size_t N_THREADS = 4;
+static constexpr size_t TXNS_PER_THREAD = 100;
+static constexpr size_t LOW_CONTENTION_ACCOUNTS = 10000;
+static constexpr size_t HIGH_CONTENTION_ACCOUNTS = 4;
+
+struct Result {
+  std::chrono::milliseconds time;
+  uint64_t aborts;
+};
+
+// Runs TXNS_PER_THREAD transfers between random pairs of `n_accounts` accounts
+// (spread over the servers) on each of N_THREADS threads, retrying each until
+// it commits.
+Result run_transfers(const std::vector<std::string>& addrs,
+                     size_t n_accounts) {
+  auto router = [&addrs](const std::string& key) -> std::optional<std::string> {
+    return addrs[std::hash<std::string>()(key) % addrs.size()];
+  };
+
+  std::atomic<uint64_t> aborts{0};
+  std::vector<std::thread> threads;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t t = 0; t < N_THREADS; t++) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      for (size_t i = 0; i < TXNS_PER_THREAD; i++) {
+        std::string from = "account_" + std::to_string(rng() % n_accounts);
+        std::string to = "account_" + std::to_string(rng() % n_accounts);
+        while (true) {
+          Transaction txn(router);
+          std::optional<std::string> from_balance = txn.Read(from);
+          std::optional<std::string> to_balance = txn.Read(to);
+          txn.Write(from, std::to_string(std::atoi(
+                              from_balance.value_or("0").c_str()) - 1));
+          txn.Write(to, std::to_string(std::atoi(
+                            to_balance.value_or("0").c_str()) + 1));
+          if (txn.Commit()) break;
+          aborts++;
+        }
+      }
+    });
+  }
+  for (auto&& thread : threads) thread.join();
+  auto time = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+  return Result{time, aborts.load()};
+}
+
+int main() {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test runs transfer transactions (read two accounts, write both) on
+    N_SERVERS local servers, with N_THREADS clients, first over many accounts
+    (so transactions rarely conflict), then over only a few. It reports the
+    throughput of committed transactions, and how many attempts aborted.
+  */
+  std::vector<std::string> addrs = make_server_addresses(N_SERVERS);
+  std::vector<std::shared_ptr<KvServer>> servers;
+  for (auto&& addr : addrs) {
+    servers.push_back(start_server<KvServer, const std::string&, uint64_t>(
+        addr, uint64_t(2)));
+  }
+
+  size_t n_txns = N_THREADS * TXNS_PER_THREAD;
+  for (auto [name, n_accounts] :
+       {std::pair("low_contention_txns", LOW_CONTENTION_ACCOUNTS),
+        std::pair("high_contention_txns", HIGH_CONTENTION_ACCOUNTS)}) {
+    Result result = run_transfers(addrs, n_accounts);
+    output_file << name << "," << result.time.count() << ","
+                << to_throughput(result.time, N_THREADS, TXNS_PER_THREAD)
+                << "\n";
+    std::cout << name << ": " << n_txns << " transactions in "
+              << result.time.count() << " ms, " << result.aborts
+              << " aborted attempts ("
+              << 100 * result.aborts / (n_txns + result.aborts)
+              << "% abort rate)\n";
+  }
+
+  for (auto&& server : servers) server->stop();
+  cout_color(GREEN, "Test passed!");
+}
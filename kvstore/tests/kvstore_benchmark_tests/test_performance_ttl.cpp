@@ -0,0 +1,62 @@
+#include <fstream>
+
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_THREADS = 8;
+static constexpr size_t N_KEYS_PER_THREAD = 10'000;
+
+int main(int argc, char* argv[]) {
+  std::ofstream output_file("benchmark-runtime.csv", std::ios::app);
+  if (!output_file.is_open()) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  /*
+    This test measures the overhead of key expiration. N_THREADS threads Put
+    the same keys into two ConcurrentKvStores, once without TTLs and once with
+    a TTL on every key (which also schedules a timer for the reaper). We then
+    check that the TTL'd keys disappear once their TTL elapses.
+  */
+  auto ttl_free_store = std::make_unique<ConcurrentKvStore>();
+  auto ttl_store = std::make_unique<ConcurrentKvStore>();
+
+  std::vector<std::vector<std::string>> keys(N_THREADS);
+  for (size_t i = 0; i < N_THREADS; i++) {
+    keys[i] = make_pseudo_rand_str(N_KEYS_PER_THREAD, 32, i);
+  }
+
+  auto time_puts = [&](KvStore& store, uint64_t ttl_ms) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < N_THREADS; i++) {
+      threads.emplace_back([&, i] {
+        auto put_req =
+            PutRequest{.key = "", .value = "value", .ttl_ms = ttl_ms};
+        auto put_res = PutResponse{};
+        for (auto&& key : keys[i]) {
+          put_req.key = key;
+          ASSERT(store.Put(&put_req, &put_res));
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  };
+
+  auto ttl_free_time = time_puts(*ttl_free_store, 0);
+  output_file << "ttl_free_put," << ttl_free_time.count() << ","
+              << to_throughput(ttl_free_time, N_THREADS, N_KEYS_PER_THREAD)
+              << "\n";
+
+  auto ttl_time = time_puts(*ttl_store, 500);
+  output_file << "ttl_put," << ttl_time.count() << ","
+              << to_throughput(ttl_time, N_THREADS, N_KEYS_PER_THREAD) << "\n";
+
+  // TTL-free keys should all still be there, and the TTL'd keys should be
+  // gone (whether lazily or by the reaper) once the TTL has passed.
+  std::this_thread::sleep_for(1s);
+  ASSERT_EQ(ttl_free_store->AllKeys().size(), N_THREADS * N_KEYS_PER_THREAD);
+  ASSERT(ttl_store->AllKeys().empty());
+}
@@ -0,0 +1,106 @@
+#include <set>
+#include <thread>
+
+#include "client/load_generator.hpp"
+#include "client/simple_client.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t MIN_THREADS = 32;
+static constexpr size_t N_KEYS = 1000;
+static constexpr size_t VALUE_SIZE = 64;
+static constexpr milliseconds RUN_DURATION = 2s;
+
+// Checks the layouts of 8 workers on two nodes of 4 CPUs each.
+void check_layouts() {
+  ASSERT(parse_cpu_list("0-3,8,10-11\n") ==
+         std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+
+  CpuTopology topology{{{0, {0, 1, 2, 3}}, {1, {4, 5, 6, 7}}}};
+  WorkerPlacement pinned_numa{.pin_workers = true, .numa = true};
+  size_t n_listeners = ThreadLayout::listeners_for(topology, pinned_numa, 1);
+  ASSERT_EQ(n_listeners, size_t(2));
+  ThreadLayout layout(topology, pinned_numa, 8, n_listeners);
+  std::set<int> cpus;
+  for (size_t w = 0; w < 8; w++) {
+    // On its listener's node, alone on one of the node's CPUs
+    const ThreadLayout::Slot& slot = layout.worker(w);
+    ASSERT_EQ(slot.node, layout.listener(w % n_listeners).node);
+    ASSERT_EQ(slot.cpus.size(), size_t(1));
+    ASSERT_EQ(size_t(slot.cpus[0] / 4), size_t(slot.node));
+    cpus.insert(slot.cpus[0]);
+  }
+  ASSERT_EQ(cpus.size(), size_t(8));
+  ASSERT(layout.listener(1).cpus == std::vector<int>({4, 5, 6, 7}));
+
+  ThreadLayout numa(topology, WorkerPlacement{.numa = true}, 8, 2);
+  ASSERT(numa.worker(3).cpus == std::vector<int>({4, 5, 6, 7}));
+  ThreadLayout pinned(topology, WorkerPlacement{.pin_workers = true}, 8, 1);
+  ASSERT(pinned.worker(5).cpus == std::vector<int>({5}));
+  ASSERT_EQ(pinned.worker(5).node, -1);
+  ThreadLayout unplaced(topology, WorkerPlacement{}, 8, 1);
+  ASSERT(unplaced.worker(0).cpus.empty() && unplaced.worker(0).node == -1);
+  ASSERT(unplaced.describe().empty());
+}
+
+// Runs a closed-loop workload of `n_threads` clients against a KvServer with
+// as many workers, placed according to `placement`, and records it in the
+// CSV as `title`.
+LoadReport run_layout(const std::string& title, WorkerPlacement placement,
+                      size_t n_threads) {
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t, AdmissionLimits,
+                   WorkerPlacement>(addr, uint64_t(n_threads),
+                                    AdmissionLimits{}, std::move(placement));
+
+  LoadConfig config;
+  config.n_threads = n_threads;
+  config.duration = RUN_DURATION;
+  config.n_keys = N_KEYS;
+  config.value_size = VALUE_SIZE;
+  LoadGenerator generator(config,
+                          [&] { return std::make_shared<SimpleClient>(addr); });
+  ASSERT(generator.preload());
+
+  LoadReport report = generator.run();
+  std::cout << title << ":\n" << format_report(report);
+  ASSERT_EQ(report.n_errors, uint64_t(0));
+  if (!append_csv("benchmark-runtime.csv", title, report)) {
+    std::cerr << "Failed to open output file." << std::endl;
+  }
+  server->stop();
+  return report;
+}
+
+int main() {
+  /*
+    This test checks how KvServer lays its threads out over CPUs and NUMA
+    nodes under each WorkerPlacement. Then, with at least MIN_THREADS workers
+    (and as many client threads), it compares the server's throughput with
+    unpinned workers, with workers pinned to CPUs, and with workers pinned
+    within NUMA nodes. On a single-node host, the last two differ only in
+    memory policy.
+  */
+  check_layouts();
+
+  size_t n_threads =
+      std::max<size_t>(MIN_THREADS, std::thread::hardware_concurrency());
+  CpuTopology topology = CpuTopology::detect();
+  size_t n_cpus = 0;
+  for (auto&& node : topology.nodes) n_cpus += node.cpus.size();
+  std::cout << n_threads << " threads over " << n_cpus << " CPUs on "
+            << topology.nodes.size() << " NUMA node(s)\n";
+
+  LoadReport unpinned = run_layout("placement_unpinned", {}, n_threads);
+  LoadReport pinned = run_layout(
+      "placement_pinned", WorkerPlacement{.pin_workers = true}, n_threads);
+  LoadReport numa = run_layout(
+      "placement_pinned_numa",
+      WorkerPlacement{.pin_workers = true, .numa = true}, n_threads);
+  std::cout << "Speedup over unpinned: pinned "
+            << pinned.throughput / unpinned.throughput << "x, pinned by node "
+            << numa.throughput / unpinned.throughput << "x\n";
+
+  cout_color(GREEN, "Test passed!");
+}
@@ -0,0 +1,60 @@
+#include <future>
+
+#include "test_utils/test_utils.hpp"
+
+static constexpr std::size_t kNumThreads = 8;
+static constexpr std::size_t kNumKeys = 100;
+static constexpr std::size_t kNumOps = 1'000;
+
+int main(int argc, char* argv[]) {
+  auto store = make_kvstore(argc, argv);
+
+  auto keys = make_rand_strs(kNumKeys, 16);
+
+  // Half of the threads Incr every key; the other half increment it with a
+  // CAS retry loop. If both are atomic, no update is lost.
+  auto threads = std::vector<std::future<bool>>{};
+  for (std::size_t t = 0; t < kNumThreads; t++) {
+    threads.push_back(std::async(std::launch::async, [&, t]() {
+      for (std::size_t i = 0; i < kNumOps; i++) {
+        auto& key = keys[i % kNumKeys];
+        if (t % 2 == 0) {
+          auto incr_req = IncrRequest{.key = key, .delta = 1};
+          auto incr_res = IncrResponse{};
+          ASSERT(store->Incr(&incr_req, &incr_res));
+          continue;
+        }
+
+        // Make sure the key exists before CASing it
+        auto incr_req = IncrRequest{.key = key, .delta = 0};
+        auto incr_res = IncrResponse{};
+        ASSERT(store->Incr(&incr_req, &incr_res));
+        auto cas_req = CasRequest{.key = key,
+                                  .expected = std::to_string(incr_res.value),
+                                  .value = ""};
+        auto cas_res = CasResponse{};
+        while (true) {
+          cas_req.value = std::to_string(std::stoll(cas_req.expected) + 1);
+          ASSERT(store->CAS(&cas_req, &cas_res));
+          if (cas_res.swapped) break;
+          cas_req.expected = cas_res.value;
+        }
+      }
+      return true;
+    }));
+  }
+
+  auto passed = true;
+  for (auto& t : threads) {
+    passed &= t.get();
+  }
+  ASSERT(passed);
+
+  for (auto&& key : keys) {
+    auto get_req = GetRequest{.key = key};
+    auto get_res = GetResponse{};
+    ASSERT(store->Get(&get_req, &get_res));
+    ASSERT_EQ(get_res.value,
+              std::to_string(kNumThreads * kNumOps / kNumKeys));
+  }
+}
@@ -0,0 +1,51 @@
+#include "test_utils/test_utils.hpp"
+
+int main(int argc, char* argv[]) {
+  auto store = make_kvstore(argc, argv);
+
+  // CAS on a nonexistent key should fail
+  auto cas_req = CasRequest{.key = "k", .expected = "a", .value = "b"};
+  auto cas_res = CasResponse{};
+  ASSERT(!store->CAS(&cas_req, &cas_res));
+
+  auto put_req = PutRequest{.key = "k", .value = "a"};
+  auto put_res = PutResponse{};
+  ASSERT(store->Put(&put_req, &put_res));
+
+  // Matching CAS swaps...
+  ASSERT(store->CAS(&cas_req, &cas_res));
+  ASSERT(cas_res.swapped);
+  ASSERT_EQ(cas_res.value, "b");
+
+  // ... and a stale one doesn't, but reports the current value.
+  cas_req.value = "c";
+  ASSERT(store->CAS(&cas_req, &cas_res));
+  ASSERT(!cas_res.swapped);
+  ASSERT_EQ(cas_res.value, "b");
+
+  auto get_req = GetRequest{.key = "k"};
+  auto get_res = GetResponse{};
+  ASSERT(store->Get(&get_req, &get_res));
+  ASSERT_EQ(get_res.value, "b");
+
+  // Incr on a nonexistent key starts from 0
+  auto incr_req = IncrRequest{.key = "counter", .delta = 5};
+  auto incr_res = IncrResponse{};
+  ASSERT(store->Incr(&incr_req, &incr_res));
+  ASSERT_EQ(incr_res.value, 5);
+
+  incr_req.delta = -7;
+  ASSERT(store->Incr(&incr_req, &incr_res));
+  ASSERT_EQ(incr_res.value, -2);
+
+  get_req.key = "counter";
+  ASSERT(store->Get(&get_req, &get_res));
+  ASSERT_EQ(get_res.value, "-2");
+
+  // Incr on a non-integer value should fail, and leave the value alone
+  incr_req.key = "k";
+  ASSERT(!store->Incr(&incr_req, &incr_res));
+  get_req.key = "k";
+  ASSERT(store->Get(&get_req, &get_res));
+  ASSERT_EQ(get_res.value, "b");
+}
@@ -0,0 +1,46 @@
+#include "test_utils/test_utils.hpp"
+
+int main(int argc, char* argv[]) {
+  auto store = make_kvstore(argc, argv);
+
+  std::string key = "session";
+  std::string val = "token";
+
+  // A key with a TTL should be readable until it expires...
+  auto put_req = PutRequest{.key = key, .value = val, .ttl_ms = 100};
+  auto put_res = PutResponse{};
+  ASSERT(store->Put(&put_req, &put_res));
+
+  auto get_req = GetRequest{.key = key};
+  auto get_res = GetResponse{};
+  ASSERT(store->Get(&get_req, &get_res));
+  ASSERT_EQ(get_res.value, val);
+
+  // ... and should be gone afterwards.
+  std::this_thread::sleep_for(200ms);
+  ASSERT(!store->Get(&get_req, &get_res));
+  auto del_req = DeleteRequest{.key = key};
+  auto del_res = DeleteResponse{};
+  ASSERT(!store->Delete(&del_req, &del_res));
+
+  // Overwriting a key without a TTL should clear its previous TTL.
+  ASSERT(store->Put(&put_req, &put_res));
+  put_req.ttl_ms = 0;
+  ASSERT(store->Put(&put_req, &put_res));
+  std::this_thread::sleep_for(200ms);
+  ASSERT(store->Get(&get_req, &get_res));
+  ASSERT_EQ(get_res.value, val);
+
+  // MultiPut applies its TTL to every key.
+  auto multiput_req = MultiPutRequest{
+      .keys = {"a", "b"}, .values = {"1", "2"}, .ttl_ms = 100};
+  auto multiput_res = MultiPutResponse{};
+  ASSERT(store->MultiPut(&multiput_req, &multiput_res));
+  std::this_thread::sleep_for(200ms);
+  auto multiget_req = MultiGetRequest{.keys = {"a", "b"}};
+  auto multiget_res = MultiGetResponse{};
+  ASSERT(!store->MultiGet(&multiget_req, &multiget_res));
+
+  // Expired keys should not show up in AllKeys.
+  ASSERT_EQ_VECS(store->AllKeys(), std::vector<std::string>{key});
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "common/utils.hpp"
+#include "kvstore/sharded_kvstore.hpp"
+#include "test_utils/test_utils.hpp"
+
+constexpr std::size_t kRandStringLength = 8;
+constexpr std::size_t kNumKVPairs = 1 << 10;
+constexpr std::size_t kNumShards = 4;
+constexpr uint32_t kPageSize = 37;
+
+// Scans all of `store`, a page of `count` at a time, checking that no key
+// comes up twice.
+std::map<std::string, std::string> scan_all(KvStore& store, uint32_t count) {
+  std::map<std::string, std::string> pairs;
+  ScanRequest req{"", count};
+  do {
+    ScanResponse res{};
+    ASSERT(store.Scan(&req, &res));
+    ASSERT(res.keys.size() <= count);
+    ASSERT_EQ(res.keys.size(), res.values.size());
+    ASSERT(res.cursor.empty() || res.keys.size() == count);
+    for (std::size_t i = 0; i < res.keys.size(); i++) {
+      ASSERT(pairs.emplace(res.keys[i], res.values[i]).second);
+    }
+    req.cursor = res.cursor;
+  } while (!req.cursor.empty());
+  return pairs;
+}
+
+// The cursor and DbMap helpers are provided, so this doesn't depend on your
+// KvStore implementation.
+void test_helpers() {
+  std::string head, tail;
+  ASSERT(split_cursor(join_cursor("a:b", "1:c"), &head, &tail));
+  ASSERT_EQ(head, "a:b");
+  ASSERT_EQ(tail, "1:c");
+  ASSERT(split_cursor(join_cursor("", ""), &head, &tail));
+  ASSERT(head.empty() && tail.empty());
+  ASSERT(!split_cursor("garbage", &head, &tail));
+  ASSERT(!split_cursor("9:short", &head, &tail));
+
+  // Every key in one bucket, which is paged through while it changes: keys
+  // there throughout come up exactly once, in order
+  DbMap<std::function<size_t(std::string_view)>> map(
+      [](std::string_view) { return size_t(0); });
+  auto stable = make_rand_strs(kNumKVPairs / 2, kRandStringLength,
+                               std::string(VALID_CHARS));
+  auto churn = make_rand_strs(kNumKVPairs / 2, kRandStringLength + 1,
+                              std::string(VALID_CHARS));
+  for (auto&& key : stable) map.insertItem(0, key, key + "!");
+  for (auto&& key : churn) map.insertItem(0, key, key + "!");
+
+  std::vector<std::string> keys, values;
+  std::vector<uint64_t> ttls;
+  std::optional<std::string> after;
+  std::size_t i = 0;
+  bool more = true;
+  while (more) {
+    std::size_t from = keys.size();
+    more = map.scanBucket(0, after, kPageSize, keys, values, ttls);
+    ASSERT(keys.size() - from <= kPageSize);
+    if (keys.size() > from) after = keys.back();
+    // Between pages, delete one key and add another
+    if (i < churn.size()) {
+      map.removeItem(0, churn[i]);
+      map.insertItem(0, churn[i] + "+", "");
+      i++;
+    }
+  }
+  ASSERT(std::is_sorted(keys.begin(), keys.end()));
+  ASSERT(std::adjacent_find(keys.begin(), keys.end()) == keys.end());
+  std::set<std::string> scanned(keys.begin(), keys.end());
+  for (auto&& key : stable) ASSERT(scanned.count(key));
+  for (std::size_t j = 0; j < keys.size(); j++) {
+    if (scanned.count(keys[j]) && keys[j].back() != '+') {
+      ASSERT_EQ(values[j], keys[j] + "!");
+    }
+  }
+  ASSERT_EQ(ttls.size(), keys.size());
+  for (auto&& ttl : ttls) ASSERT_EQ(ttl, uint64_t(0));
+
+  // Each key comes with the time it has left to live
+  map.insertItem(0, "expiring", "", DbItem::expiry_from_ttl(60'000));
+  keys.clear();
+  values.clear();
+  ttls.clear();
+  map.scanBucket(0, std::nullopt, kNumKVPairs * 2, keys, values, ttls);
+  auto it = std::find(keys.begin(), keys.end(), "expiring");
+  ASSERT(it != keys.end());
+  uint64_t ttl = ttls[it - keys.begin()];
+  ASSERT(ttl > 0 && ttl <= 60'000);
+}
+
+void test_scan(std::function<std::unique_ptr<KvStore>()> make_store) {
+  auto keys = make_rand_strs(kNumKVPairs, kRandStringLength,
+                             std::string(VALID_CHARS));
+  auto vals = make_rand_strs(kNumKVPairs, kRandStringLength);
+  std::map<std::string, std::string> expected;
+  for (std::size_t i = 0; i < keys.size(); i++) expected[keys[i]] = vals[i];
+
+  // A plain store, a page at a time, returns every key once
+  auto store = make_store();
+  auto multiput_req = MultiPutRequest{.keys = keys, .values = vals};
+  auto multiput_res = MultiPutResponse{};
+  ASSERT(store->MultiPut(&multiput_req, &multiput_res));
+  ASSERT(scan_all(*store, kPageSize) == expected);
+  ASSERT(scan_all(*store, kNumKVPairs * 2) == expected);
+
+  // So does a sharded one, across its shards and their large values
+  ShardedKvStore sharded(make_store);
+  for (auto&& shard : split_into(kNumShards)) sharded.Attach(shard);
+  ASSERT(sharded.MultiPut(&multiput_req, &multiput_res));
+  for (std::size_t i = 0; i < keys.size(); i += kNumKVPairs / 8) {
+    std::string large(VALUE_CHUNK_SIZE + 1, 'x');
+    ASSERT(sharded.PutChunked(keys[i], ChunkedValue(large), false, 0));
+    expected[keys[i]] = large;
+  }
+  ASSERT(scan_all(sharded, kPageSize) == expected);
+  ASSERT(scan_all(sharded, 1) == expected);
+
+  auto scan_req = ScanRequest{.cursor = "garbage", .count = kPageSize};
+  auto scan_res = ScanResponse{};
+  ASSERT(!sharded.Scan(&scan_req, &scan_res));
+}
+
+int main(int argc, char* argv[]) {
+  test_helpers();
+  TEST(test_scan, [=] { return make_kvstore(argc, argv); });
+  return 0;
+}
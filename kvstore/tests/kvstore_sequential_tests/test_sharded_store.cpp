@@ -0,0 +1,90 @@
+#include "kvstore/sharded_kvstore.hpp"
+#include "test_utils/test_utils.hpp"
+
+constexpr std::size_t kRandStringLength = 8;
+constexpr std::size_t kNumKVPairs = 1 << 10;
+constexpr std::size_t kNumShards = 4;
+
+// Checks that exactly the keys contained in `shard` are in `store`.
+void check_contents(KvStore& store, const Shard& shard,
+                    const std::vector<std::string>& keys,
+                    const std::vector<std::string>& vals) {
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    auto req = GetRequest{.key = keys[i]};
+    auto res = GetResponse{};
+    if (shard.contains(keys[i])) {
+      ASSERT(store.Get(&req, &res));
+      ASSERT_EQ(res.value, vals[i]);
+    } else {
+      ASSERT(!store.Get(&req, &res));
+    }
+  }
+}
+
+void test_sharded_store(ShardedKvStore::StoreFactory make_store) {
+  ShardedKvStore store(make_store);
+  auto shards = split_into(kNumShards);
+  for (auto&& shard : shards) store.Attach(shard);
+  ASSERT_EQ(store.Shards().size(), kNumShards);
+
+  // Keys are routed by their upper-cased form, as the shardcontroller routes
+  // them, so lowercase keys are accepted too
+  auto put_req = PutRequest{.key = "lowercase", .value = "value"};
+  auto put_res = PutResponse{};
+  ASSERT(store.Put(&put_req, &put_res));
+  auto del_req = DeleteRequest{.key = "lowercase"};
+  auto del_res = DeleteResponse{};
+  ASSERT(store.Delete(&del_req, &del_res));
+
+  auto keys = make_rand_strs(kNumKVPairs, kRandStringLength,
+                             std::string(VALID_CHARS));
+  auto vals = make_rand_strs(kNumKVPairs, kRandStringLength);
+  auto multiput_req = MultiPutRequest{.keys = keys, .values = vals};
+  auto multiput_res = MultiPutResponse{};
+  ASSERT(store.MultiPut(&multiput_req, &multiput_res));
+
+  // MultiGets span every shard
+  auto multiget_req = MultiGetRequest{.keys = keys};
+  auto multiget_res = MultiGetResponse{};
+  ASSERT(store.MultiGet(&multiget_req, &multiget_res));
+  ASSERT_EQ_VECS(multiget_res.values, vals);
+  ASSERT_EQ(store.AllKeys().size(), kNumKVPairs);
+
+  // Detaching a whole shard hands over its sub-store as is
+  auto detached = store.Detach(shards[1]);
+  ASSERT_EQ(detached.size(), std::size_t(1));
+  ASSERT(detached[0].first == shards[1]);
+  check_contents(*detached[0].second, shards[1], keys, vals);
+  ASSERT_EQ(store.Shards().size(), kNumShards - 1);
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    auto req = GetRequest{.key = keys[i]};
+    auto res = GetResponse{};
+    ASSERT_EQ(store.Get(&req, &res), !shards[1].contains(keys[i]));
+  }
+
+  // Detaching the middle of a shard splits it in three
+  Shard middle{std::string(1, VALID_CHARS[2]), std::string(1, VALID_CHARS[4])};
+  ASSERT(get_overlap(shards[0], middle) == OverlapStatus::COMPLETELY_CONTAINS);
+  detached = store.Detach(middle);
+  ASSERT_EQ(detached.size(), std::size_t(1));
+  ASSERT(detached[0].first == middle);
+  check_contents(*detached[0].second, middle, keys, vals);
+  ASSERT_EQ(store.Shards().size(), kNumShards);
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    auto req = GetRequest{.key = keys[i]};
+    auto res = GetResponse{};
+    bool owned = !shards[1].contains(keys[i]) && !middle.contains(keys[i]);
+    ASSERT_EQ(store.Get(&req, &res), owned);
+    if (owned) ASSERT_EQ(res.value, vals[i]);
+  }
+
+  // A detached sub-store can be attached elsewhere
+  ShardedKvStore other(make_store);
+  other.Attach(middle, std::move(detached[0].second));
+  check_contents(other, middle, keys, vals);
+}
+
+int main(int argc, char* argv[]) {
+  TEST(test_sharded_store, [=] { return make_kvstore(argc, argv); });
+  return 0;
+}
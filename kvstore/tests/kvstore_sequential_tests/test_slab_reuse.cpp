@@ -0,0 +1,51 @@
+#include "test_utils/test_utils.hpp"
+
+int main() {
+  // The slab allocator and DbMap helpers are provided, so this test doesn't
+  // depend on your KvStore implementation.
+  SlabAllocator allocator;
+
+  // Requests are rounded up to their size class...
+  size_t c = SlabAllocator::class_for(100);
+  ASSERT(c < N_SLAB_CLASSES);
+  ASSERT(SLAB_CHUNK_SIZES[c] >= 100);
+  ASSERT(c == 0 || SLAB_CHUNK_SIZES[c - 1] < 100);
+
+  // ... and freed chunks are reused by the next allocation of that class.
+  void* first = allocator.allocate(100);
+  allocator.deallocate(first, 100);
+  void* second = allocator.allocate(SLAB_CHUNK_SIZES[c]);
+  ASSERT(first == second);
+  allocator.deallocate(second, SLAB_CHUNK_SIZES[c]);
+
+  // Oversized requests bypass the slabs.
+  void* large = allocator.allocate(2 * SLAB_SIZE);
+  allocator.deallocate(large, 2 * SLAB_SIZE);
+
+  // Churning a DbMap's keys should not grow its slabs past what the live items
+  // need, since deleted items' chunks get reused.
+  DbMap<> map;
+  auto keys = make_rand_strs(1000, 16);
+  for (size_t round = 0; round < 10; round++) {
+    for (auto&& key : keys) {
+      map.insertItem(map.bucket(key), key, std::string(round * 10, 'x'));
+    }
+    for (auto&& key : keys) {
+      auto item = map.getIfExists(map.bucket(key), key);
+      ASSERT(item.has_value());
+      ASSERT_EQ(item->value, std::string(round * 10, 'x'));
+    }
+    for (size_t i = 0; i < keys.size() / 2; i++) {
+      ASSERT(map.removeItem(map.bucket(keys[i]), keys[i]));
+    }
+  }
+
+  size_t n_used = 0, n_slabs = 0;
+  for (auto&& s : map.allocator.stats()) {
+    n_used += s.n_used;
+    n_slabs += s.n_slabs;
+  }
+  ASSERT_EQ(n_used, keys.size() / 2);
+  ASSERT(n_slabs <= 10);
+  std::cout << map.allocator.report();
+}
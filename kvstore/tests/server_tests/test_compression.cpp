@@ -0,0 +1,126 @@
+#include <random>
+#include <string>
+
+#include "client/simple_client.hpp"
+#include "common/compression.hpp"
+#include "kvstore/concurrent_kvstore.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+// Text that repeats itself (like JSON documents do), `size` bytes long.
+std::string make_text(size_t size) {
+  std::string text;
+  for (size_t i = 0; text.size() < size; i++) {
+    text += "{\"user\":\"user_" + std::to_string(i % 97) +
+            "\",\"post\":\"staying home all day, again\"},";
+  }
+  text.resize(size);
+  return text;
+}
+
+// Bytes that don't compress.
+std::string make_random(size_t size) {
+  static std::mt19937 rng(0);
+  std::string data(size, '\0');
+  for (auto& c : data) c = char(rng());
+  return data;
+}
+
+void test_codec() {
+  for (std::string data :
+       {std::string(), std::string("a"), std::string("abcd"),
+        std::string(1000, 'x'), make_text(100000), make_random(10000)}) {
+    std::string compressed = lz_compress(data);
+    std::optional<std::string> decompressed = lz_decompress(compressed);
+    ASSERT(decompressed);
+    ASSERT(*decompressed == data);
+  }
+  ASSERT(lz_compress(make_text(100000)).size() < 100000 / 4);
+
+  // Truncated input is rejected, rather than read past
+  std::string compressed = lz_compress(make_text(1000));
+  for (size_t len = 0; len < compressed.size(); len++) {
+    ASSERT(!lz_decompress(std::string_view(compressed).substr(0, len)));
+  }
+}
+
+void test_compressor() {
+  Compressor compressor(CompressionOptions{.min_size = 64});
+
+  // Small values aren't worth compressing
+  ASSERT(!compressor.compress(std::string(63, 'x')));
+  std::optional<std::string> compressed = compressor.compress(make_text(4096));
+  ASSERT(compressed);
+  ASSERT(compressor.decompress(*compressed) == make_text(4096));
+
+  // After enough values of a size that don't compress, it mostly stops trying
+  size_t n_random = 2 * Compressor::PROBE_INTERVAL;
+  for (size_t i = 0; i < n_random; i++) {
+    ASSERT(!compressor.compress(make_random(1000)));
+  }
+  Compressor::Stats stats = compressor.stats();
+  ASSERT_EQ(stats.rejected, uint64_t(Compressor::BACKOFF_AFTER + 2));
+  ASSERT_EQ(stats.skipped, n_random - stats.rejected);
+
+  // Values of other sizes are still compressed
+  ASSERT(compressor.compress(make_text(300)));
+}
+
+void test_db_map() {
+  DbMap<> map;
+  std::string key = "key";
+  size_t b = map.bucket(key);
+
+  // Reads only ever see the original value, however it's stored
+  for (std::string value : {make_text(5000), make_random(2000),
+                            std::string("short"), make_text(600),
+                            make_text(100000)}) {
+    map.insertItem(b, key, value);
+    auto item = map.getIfExists(b, key);
+    ASSERT(item);
+    ASSERT(item->value == value);
+  }
+  ASSERT(map.compressor.stats().kept >= 3);
+}
+
+void test_wire() {
+  // Messages only shrink if they're large and compress well
+  Message msg = *serialize_request(PutRequest{"key", make_text(10000)});
+  size_t size = msg.sz;
+  compress_message(&msg);
+  ASSERT(msg.sz < size / 4);
+  ASSERT(decompress_message(&msg));
+  auto req = deserialize_request(msg);
+  ASSERT(req && std::get<PutRequest>(*req).value == make_text(10000));
+
+  msg = *serialize_request(PutRequest{"key", make_random(10000)});
+  size = msg.sz;
+  compress_message(&msg);
+  ASSERT_EQ(msg.sz, size);
+
+  // A value large enough to be kept whole by the server makes it there and
+  // back over compressed connections
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t>(addr, uint64_t(2));
+  SimpleClient client(addr, 0ms, true);
+  std::string value = make_text(3 * VALUE_CHUNK_SIZE);
+  ASSERT(client.Put("large", value));
+  uint64_t bytes_in = server->get_stats().bytes_in;
+  ASSERT(bytes_in < value.size() / 4);
+  std::optional<std::string> got = client.Get("large");
+  ASSERT(got);
+  ASSERT(*got == value);
+  ASSERT(server->get_stats().bytes_out < value.size() / 4);
+  server->stop();
+}
+
+int main() {
+  test_codec();
+  test_compressor();
+  test_db_map();
+  test_wire();
+
+  cout_color(GREEN, "Test passed!");
+  return 0;
+}
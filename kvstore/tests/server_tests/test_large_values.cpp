@@ -0,0 +1,96 @@
+#include <string>
+
+#include "client/simple_client.hpp"
+#include "kvstore/chunked_value.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+constexpr size_t LARGE_VALUE_SIZE = 64 << 20;
+constexpr size_t APPEND_SIZE = 3 * VALUE_CHUNK_SIZE + 17;
+
+// A value whose bytes depend on their position, so misplaced chunks show.
+std::string make_value(size_t size, size_t seed) {
+  std::string value(size, '\0');
+  for (size_t i = 0; i < size; i++) {
+    value[i] = 'a' + (i / 4093 + i * 7 + seed) % 26;
+  }
+  return value;
+}
+
+void test_chunked_value() {
+  std::string expected = make_value(2 * VALUE_CHUNK_SIZE + 5, 0);
+  ChunkedValue value(expected);
+  ASSERT_EQ(value.size(), expected.size());
+  ASSERT(value.to_string() == expected);
+
+  // Appends top up the last chunk, then add new ones
+  std::string tail = make_value(VALUE_CHUNK_SIZE, 1);
+  value.append(tail);
+  expected += tail;
+  ASSERT_EQ(value.size(), expected.size());
+
+  // Reads can span chunk boundaries, and stop at the end of the value
+  for (size_t offset : {size_t(0), VALUE_CHUNK_SIZE - 3, 2 * VALUE_CHUNK_SIZE,
+                        expected.size() - 10}) {
+    ASSERT(value.read(offset, VALUE_CHUNK_SIZE) ==
+           expected.substr(offset, VALUE_CHUNK_SIZE));
+  }
+  ASSERT(value.read(expected.size(), 1).empty());
+
+  // Appending a ChunkedValue shares its chunks
+  ChunkedValue joined(value);
+  joined.append(value);
+  ASSERT(joined.to_string() == expected + expected);
+}
+
+int main() {
+  test_chunked_value();
+
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t>(addr, uint64_t(2));
+  SimpleClient client(addr);
+
+  // A 64MB value goes up and comes back in chunks, intact
+  std::string value = make_value(LARGE_VALUE_SIZE, 0);
+  ASSERT(client.Put("large", value));
+  std::optional<std::string> got = client.Get("large");
+  ASSERT(got);
+  ASSERT_EQ(got->size(), value.size());
+  ASSERT(*got == value);
+
+  // Appends to it are chunked too
+  std::string tail = make_value(APPEND_SIZE, 1);
+  ASSERT(client.Append("large", tail));
+  value += tail;
+  got = client.Get("large");
+  ASSERT(got);
+  ASSERT(*got == value);
+
+  // Small appends to a large value don't need chunking
+  ASSERT(client.Append("large", "!"));
+  value += "!";
+  got = client.Get("large");
+  ASSERT(got);
+  ASSERT(*got == value);
+
+  // Every chunk travelled in its own message
+  StatsResponse stats = server->get_stats();
+  size_t n_chunks = 0;
+  for (auto&& op : stats.ops) {
+    if (op.op == "PutChunk") n_chunks = op.latency.count;
+  }
+  ASSERT_EQ(n_chunks, LARGE_VALUE_SIZE / VALUE_CHUNK_SIZE +
+                          (APPEND_SIZE + VALUE_CHUNK_SIZE - 1) /
+                              VALUE_CHUNK_SIZE);
+
+  // Overwriting a large value with a small one drops the large value
+  ASSERT(client.Put("large", "small"));
+  got = client.Get("large");
+  ASSERT(!got || got->size() < VALUE_CHUNK_SIZE);
+
+  server->stop();
+
+  cout_color(GREEN, "Test passed!");
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include <string>
+
+#include "net/network_conn.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+constexpr AdmissionLimits LIMITS{.max_queued_conns = 1, .retry_after = 30ms};
+
+int main() {
+  // A single worker, which can only have one connection waiting for it
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t, AdmissionLimits>(
+          addr, uint64_t(1), AdmissionLimits(LIMITS));
+
+  // Occupy the worker
+  std::shared_ptr<ServerConn> busy_conn = connect_to_server(addr);
+  ASSERT(busy_conn);
+  ASSERT(busy_conn->send_request(PutRequest{"key", "value"}));
+  ASSERT(busy_conn->recv_response());
+
+  // This connection waits in the worker's queue, longer than its budget
+  std::shared_ptr<ServerConn> queued_conn = connect_to_server(addr);
+  ASSERT(queued_conn);
+  ASSERT(queued_conn->send_request(PutRequest{"key", "value"}, 50ms));
+  std::this_thread::sleep_for(50ms);
+
+  // The queue is full, so this connection is turned away right away
+  std::shared_ptr<ServerConn> shed_conn = connect_to_server(addr);
+  ASSERT(shed_conn);
+  ASSERT(shed_conn->send_request(PutRequest{"key", "value"}));
+  std::optional<Response> res = shed_conn->recv_response();
+  ASSERT(res);
+  auto* error_res = std::get_if<ErrorResponse>(&*res);
+  ASSERT(error_res);
+  ASSERT_EQ(error_res->msg, std::string("server busy"));
+  ASSERT_EQ(error_res->retry_after_ms, uint32_t(LIMITS.retry_after.count()));
+
+  // Once the worker is free, the queued request has expired, and is dropped
+  std::this_thread::sleep_for(50ms);
+  busy_conn->shutdown();
+  res = queued_conn->recv_response();
+  ASSERT(res);
+  error_res = std::get_if<ErrorResponse>(&*res);
+  ASSERT(error_res);
+  ASSERT_EQ(error_res->msg, std::string("deadline exceeded"));
+
+  // The connection still works for requests sent later
+  ASSERT(queued_conn->send_request(PutRequest{"key", "value"}, 50ms));
+  res = queued_conn->recv_response();
+  ASSERT(res);
+  ASSERT(std::holds_alternative<PutResponse>(*res));
+
+  StatsResponse stats = server->get_stats();
+  ASSERT_EQ(stats.shed, uint64_t(1));
+  ASSERT_EQ(stats.expired, uint64_t(1));
+
+  queued_conn->shutdown();
+  server->stop();
+
+  cout_color(GREEN, "Test passed!");
+  return 0;
+}
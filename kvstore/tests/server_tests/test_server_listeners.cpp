@@ -0,0 +1,50 @@
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "client/simple_client.hpp"
+#include "net/network_helpers.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static constexpr size_t N_LISTENERS = 4;
+static constexpr size_t N_CLIENTS = 8;
+static constexpr size_t CONNS_PER_CLIENT = 25;
+
+int main() {
+  std::vector<std::string> addrs = make_server_addresses(2);
+
+  // Sockets opened with SO_REUSEPORT share their port, which stays taken for
+  // everyone else
+  std::vector<int> fds = open_listener_sockets(addrs[0], N_LISTENERS);
+  ASSERT_EQ(fds.size(), N_LISTENERS);
+  ASSERT(open_listener_socket(addrs[0]) < 0);
+  for (int fd : fds) close(fd);
+
+  // A server with several listeners admits every connection of a storm of
+  // short-lived ones
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t, AdmissionLimits,
+                   WorkerPlacement, size_t>(
+          addrs[1], uint64_t(N_LISTENERS), AdmissionLimits{},
+          WorkerPlacement{}, size_t(N_LISTENERS));
+  std::atomic<size_t> n_successes = 0;
+  std::vector<std::thread> clients;
+  for (size_t t = 0; t < N_CLIENTS; t++) {
+    clients.emplace_back([&, t] {
+      // SimpleClient opens a new connection for every request
+      SimpleClient client(addrs[1]);
+      std::string key = "key" + std::to_string(t);
+      for (size_t i = 0; i < CONNS_PER_CLIENT; i++) {
+        if (client.Put(key, "value")) n_successes++;
+      }
+    });
+  }
+  for (auto&& client : clients) client.join();
+  ASSERT_EQ(n_successes.load(), N_CLIENTS * CONNS_PER_CLIENT);
+  ASSERT_EQ(server->get_stats().shed, uint64_t(0));
+  server->stop();
+
+  cout_color(GREEN, "Test passed!");
+  return 0;
+}
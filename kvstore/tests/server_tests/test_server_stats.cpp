@@ -0,0 +1,69 @@
+#include <string>
+
+#include "net/network_conn.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+constexpr size_t N_WORKERS_STATS = 3;
+constexpr size_t N_PUTS = 20;
+constexpr size_t N_GETS = 10;
+
+int main() {
+  // Histogram percentiles should be within bucket precision (~3%)
+  Histogram hist;
+  for (uint64_t v = 1; v <= 100000; v++) hist.record(v);
+  ASSERT_EQ(hist.count(), uint64_t(100000));
+  ASSERT_EQ(hist.max(), uint64_t(100000));
+  ASSERT(hist.percentile(50) >= 50000 && hist.percentile(50) <= 51600);
+  ASSERT(hist.percentile(99) >= 99000 && hist.percentile(99) <= 100000);
+  ASSERT_EQ(hist.percentile(100), uint64_t(100000));
+
+  std::string addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t>(
+          addr, uint64_t(N_WORKERS_STATS));
+  std::shared_ptr<ServerConn> conn = connect_to_server(addr);
+  ASSERT(conn);
+
+  // Requests are counted whether or not they succeed
+  std::vector<std::string> keys = make_rand_strs(N_PUTS, 10);
+  for (auto&& key : keys) {
+    ASSERT(conn->send_request(PutRequest{key, "value"}));
+    ASSERT(conn->recv_response());
+  }
+  for (size_t i = 0; i < N_GETS; i++) {
+    ASSERT(conn->send_request(GetRequest{keys[i]}));
+    ASSERT(conn->recv_response());
+  }
+  ASSERT(conn->send_request(MultiGetRequest{keys}));
+  ASSERT(conn->recv_response());
+
+  ASSERT(conn->send_request(StatsRequest{}));
+  std::optional<Response> res = conn->recv_response();
+  ASSERT(res);
+  auto* stats = std::get_if<StatsResponse>(&*res);
+  ASSERT(stats);
+
+  ASSERT_EQ(stats->ops.size(), N_STATS_OPS);
+  for (auto&& op : stats->ops) {
+    uint64_t expected = 0;
+    if (op.op == "Put") expected = N_PUTS;
+    if (op.op == "Get") expected = N_GETS;
+    if (op.op == "MultiGet") expected = 1;
+    ASSERT_EQ(op.latency.count, expected);
+    ASSERT(op.errors <= op.latency.count);
+    ASSERT(op.latency.p50_ns <= op.latency.p99_ns);
+    ASSERT(op.latency.p99_ns <= op.latency.max_ns);
+  }
+  ASSERT_EQ(stats->queue_depths.size(), N_WORKERS_STATS);
+  ASSERT(stats->bytes_in > 0);
+  ASSERT(stats->bytes_out > 0);
+  // No shardcontroller, so the config is never refreshed
+  ASSERT_EQ(stats->config_refreshes.count, uint64_t(0));
+
+  conn->shutdown();
+  server->stop();
+
+  cout_color(GREEN, "Test passed!");
+  return 0;
+}
@@ -0,0 +1,208 @@
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "client/simple_client.hpp"
+#include "client/transaction.hpp"
+#include "net/network_conn.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+// Keys starting with 'a' live on the first server, the rest on the second.
+std::vector<std::string> addrs;
+Transaction begin() {
+  return Transaction([](const std::string& key) -> std::optional<std::string> {
+    return addrs[key[0] == 'a' ? 0 : 1];
+  });
+}
+
+Response call(const std::string& addr, const Request& req) {
+  std::shared_ptr<ServerConn> conn = connect_to_server(addr);
+  ASSERT(conn);
+  ASSERT(conn->send_request(req));
+  std::optional<Response> res = conn->recv_response();
+  ASSERT(res);
+  return *res;
+}
+
+uint64_t version_of(const std::string& key) {
+  Response res = call(addrs[key[0] == 'a' ? 0 : 1], TxnReadRequest{{key}});
+  ASSERT(std::holds_alternative<TxnReadResponse>(res));
+  return std::get<TxnReadResponse>(res).versions[0];
+}
+
+bool prepare(const std::string& addr, uint64_t txn_id,
+             const std::string& primary,
+             const std::vector<std::string>& write_keys) {
+  std::vector<std::string> values(write_keys.size(), "value");
+  Response res = call(addr, TxnPrepareRequest{txn_id, primary, {}, {},
+                                              write_keys, values});
+  ASSERT(std::holds_alternative<TxnPrepareResponse>(res));
+  return std::get<TxnPrepareResponse>(res).prepared;
+}
+
+bool check_reads(const std::string& addr, uint64_t txn_id,
+                 const std::string& primary,
+                 const std::vector<std::string>& read_keys,
+                 const std::vector<uint64_t>& read_versions) {
+  Response res = call(addr, TxnPrepareRequest{txn_id, primary, read_keys,
+                                              read_versions, {}, {}});
+  ASSERT(std::holds_alternative<TxnPrepareResponse>(res));
+  return std::get<TxnPrepareResponse>(res).prepared;
+}
+
+bool finish(const std::string& addr, uint64_t txn_id, bool commit) {
+  Response res = call(addr, TxnFinishRequest{txn_id, commit});
+  ASSERT(std::holds_alternative<TxnFinishResponse>(res));
+  return std::get<TxnFinishResponse>(res).committed;
+}
+
+void test_commit() {
+  // A transaction's writes to both servers are applied
+  uint64_t a_version = version_of("a0"), b_version = version_of("b0");
+  Transaction txn = begin();
+  txn.Read("a0");
+  txn.Write("a0", "1");
+  txn.Write("b0", "2");
+  ASSERT(txn.Read("b0") == std::optional<std::string>("2"));
+  ASSERT(txn.Commit());
+  ASSERT(version_of("a0") > a_version);
+  ASSERT(version_of("b0") > b_version);
+
+  // Once finished, it can't commit again
+  ASSERT(!txn.Commit());
+}
+
+void test_stale_read() {
+  // A write to a key after the transaction read it aborts the transaction
+  Transaction txn = begin();
+  txn.Read("a1");
+  txn.Write("b1", "value");
+  ASSERT(SimpleClient(addrs[0]).Put("a1", "changed"));
+  ASSERT(!txn.Commit());
+
+  // And so does a write by another transaction
+  Transaction first = begin(), second = begin();
+  first.Read("b1");
+  second.Read("b1");
+  first.Write("b1", "first");
+  second.Write("b1", "second");
+  ASSERT(first.Commit());
+  ASSERT(!second.Commit());
+}
+
+void test_read_only() {
+  // Read-only transactions commit if nothing they read changed...
+  Transaction txn = begin();
+  txn.Read("a2");
+  txn.Read("b2");
+  ASSERT(txn.Commit());
+
+  // ...and abort otherwise
+  txn = begin();
+  txn.Read("a2");
+  txn.Read("b2");
+  ASSERT(SimpleClient(addrs[1]).Put("b2", "changed"));
+  ASSERT(!txn.Commit());
+}
+
+void test_locks() {
+  // Prepared writes lock their keys until the transaction finishes: other
+  // transactions can't prepare them, and plain writes wait for it
+  ASSERT(prepare(addrs[0], 1, "", {"a3"}));
+  ASSERT(!prepare(addrs[0], 2, "", {"a3"}));
+  Response res = call(addrs[0], TxnReadRequest{{"a3"}});
+  ASSERT(std::holds_alternative<ErrorResponse>(res));
+
+  std::atomic<bool> put_done = false;
+  std::thread writer([&] {
+    ASSERT(SimpleClient(addrs[0]).Put("a3", "value"));
+    put_done = true;
+  });
+  std::this_thread::sleep_for(TxnTable::LOCK_WAIT * 5);
+  ASSERT(!put_done);
+  ASSERT(finish(addrs[0], 1, true));
+  writer.join();
+  ASSERT(prepare(addrs[0], 2, "", {"a3"}));
+  ASSERT(!finish(addrs[0], 2, false));
+}
+
+void test_write_skew() {
+  // Transaction 5 reads a6 and writes b6; transaction 6 reads b6 and writes
+  // a6. If either could check its read before the other locked its write,
+  // both could commit, each having read what the other overwrote. But every
+  // write is locked before any read is checked, so whichever checks second
+  // finds the other's lock (or, once it's finished, a new version)
+  uint64_t a_version = version_of("a6"), b_version = version_of("b6");
+  ASSERT(prepare(addrs[1], 5, "", {"b6"}));
+  ASSERT(prepare(addrs[0], 6, "", {"a6"}));
+  ASSERT(!check_reads(addrs[1], 6, addrs[0], {"b6"}, {b_version}));
+  ASSERT(!check_reads(addrs[0], 5, addrs[1], {"a6"}, {a_version}));
+  ASSERT(!finish(addrs[1], 5, false));
+  ASSERT(!finish(addrs[0], 6, false));
+
+  ASSERT(prepare(addrs[1], 7, "", {"b6"}));
+  ASSERT(check_reads(addrs[0], 7, addrs[1], {"a6"}, {a_version}));
+  ASSERT(finish(addrs[1], 7, true));
+  ASSERT(prepare(addrs[0], 8, "", {"a6"}));
+  ASSERT(!check_reads(addrs[1], 8, addrs[0], {"b6"}, {b_version}));
+  ASSERT(!finish(addrs[0], 8, false));
+
+  // A transaction's reads of keys it has locked itself check out
+  ASSERT(prepare(addrs[0], 9, "", {"a6"}));
+  ASSERT(check_reads(addrs[0], 9, "", {"a6"}, {a_version}));
+  ASSERT(finish(addrs[0], 9, true));
+
+  // And through the client: the second to commit read a stale value
+  Transaction txn1 = begin(), txn2 = begin();
+  txn1.Read("a7");
+  txn1.Write("b7", "from txn1");
+  txn2.Read("b7");
+  txn2.Write("a7", "from txn2");
+  ASSERT(txn1.Commit());
+  ASSERT(!txn2.Commit());
+}
+
+void test_abandoned() {
+  // A client prepares a transaction on both servers, then disappears
+  ASSERT(prepare(addrs[0], 3, "", {"a4"}));
+  ASSERT(prepare(addrs[1], 3, addrs[0], {"b4"}));
+
+  // Once the locks are stale, the second server asks the primary about the
+  // transaction, which aborts it
+  std::this_thread::sleep_for(TxnTable::LOCK_TIMEOUT + 100ms);
+  ASSERT(SimpleClient(addrs[1]).Put("b4", "value"));
+  ASSERT(SimpleClient(addrs[0]).Put("a4", "value"));
+
+  // So if the client comes back, it can't commit
+  ASSERT(!finish(addrs[0], 3, true));
+  Response res = call(addrs[0], TxnStatusRequest{3});
+  ASSERT(std::holds_alternative<TxnStatusResponse>(res));
+  ASSERT(!std::get<TxnStatusResponse>(res).committed);
+
+  // A committed transaction stays committed
+  ASSERT(prepare(addrs[0], 4, "", {"a5"}));
+  ASSERT(finish(addrs[0], 4, true));
+  res = call(addrs[0], TxnStatusRequest{4});
+  ASSERT(std::get<TxnStatusResponse>(res).committed);
+}
+
+int main() {
+  addrs = make_server_addresses(2);
+  std::vector<std::shared_ptr<KvServer>> servers;
+  for (auto&& addr : addrs) {
+    servers.push_back(start_server<KvServer, const std::string&, uint64_t>(
+        addr, uint64_t(2)));
+  }
+
+  test_commit();
+  test_stale_read();
+  test_read_only();
+  test_locks();
+  test_write_skew();
+  test_abandoned();
+
+  for (auto&& server : servers) server->stop();
+  cout_color(GREEN, "Test passed!");
+  return 0;
+}
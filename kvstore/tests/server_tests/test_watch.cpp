@@ -0,0 +1,165 @@
+#include <map>
+#include <string>
+
+#include "client/simple_client.hpp"
+#include "client/watcher.hpp"
+#include "net/network_conn.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+constexpr size_t N_SERVERS_WATCH = 2;
+constexpr size_t N_WORKERS_WATCH = 3;
+constexpr size_t N_WATCHED_KEYS = 50;
+constexpr size_t N_WRITES = 500;
+// Puts made while a watcher reads nothing at all
+constexpr size_t N_UNREAD_PUTS = 20'000;
+
+// Applies `event` to `model`, a copy of the watched keys and values.
+void replay(std::map<std::string, std::string>& model,
+            const WatchEvent& event) {
+  switch (event.type) {
+    case WatchEventType::PUT:
+      model[event.key] = event.value;
+      break;
+    case WatchEventType::APPEND:
+      model[event.key] += event.value;
+      break;
+    case WatchEventType::DELETE:
+      model.erase(event.key);
+      break;
+  }
+}
+
+// A watch's queue merges each key's changes until they're taken, and drops
+// changes to keys it has no room for.
+void test_hub() {
+  WatchHub hub(2);
+  ASSERT(hub.empty());
+  hub.publish(WatchEventType::PUT, "a:1", "x");
+  auto sub = hub.subscribe("a:");
+  ASSERT(!hub.empty());
+  ASSERT(!sub->take(1ms));
+
+  hub.publish(WatchEventType::PUT, "a:1", "x");
+  hub.publish(WatchEventType::APPEND, "a:1", "y");
+  hub.publish(WatchEventType::PUT, "b:1", "not watched");
+  hub.publish(WatchEventType::DELETE, "a:2");
+  hub.publish(WatchEventType::APPEND, "a:2", "z");
+  hub.publish(WatchEventType::APPEND, "a:1", "w");
+  std::optional<WatchResponse> res = sub->take(1ms);
+  ASSERT(res && !res->lost);
+  ASSERT_EQ(res->events.size(), size_t(2));
+  ASSERT(res->events[0].type == WatchEventType::PUT);
+  ASSERT_EQ(res->events[0].key, "a:1");
+  ASSERT_EQ(res->events[0].value, "xyw");
+  // Appending to a deleted key starts it over
+  ASSERT(res->events[1].type == WatchEventType::PUT);
+  ASSERT_EQ(res->events[1].value, "z");
+
+  hub.publish(WatchEventType::APPEND, "a:1", "v");
+  hub.publish(WatchEventType::DELETE, "a:1");
+  hub.publish(WatchEventType::PUT, "a:2", "");
+  hub.publish(WatchEventType::PUT, "a:3", "dropped");
+  hub.publish(WatchEventType::PUT, "a:2", "u");
+  res = sub->take(1ms);
+  ASSERT(res && res->lost);
+  ASSERT_EQ(res->events.size(), size_t(2));
+  ASSERT(res->events[0].type == WatchEventType::DELETE);
+  ASSERT_EQ(res->events[1].value, "u");
+  ASSERT(!sub->take(1ms));
+
+  hub.unsubscribe(sub);
+  ASSERT(hub.empty());
+}
+
+int main() {
+  test_hub();
+
+  auto addrs = make_server_addresses(N_SERVERS_WATCH);
+  std::vector<std::shared_ptr<KvServer>> servers;
+  std::vector<std::shared_ptr<ServerConn>> conns;
+  for (auto&& addr : addrs) {
+    servers.push_back(start_server<KvServer, const std::string&, uint64_t>(
+        addr, uint64_t(N_WORKERS_WATCH)));
+    conns.push_back(connect_to_server(addr));
+    ASSERT(conns.back());
+  }
+  std::unique_ptr<Watcher> watcher = Watcher::open(addrs, "hot:");
+  ASSERT(watcher);
+
+  // Changes to watched keys, made on either server, come through as they're
+  // made, or merged; either way, replaying them gives the keys' values
+  auto keys = make_rand_strs(N_WATCHED_KEYS, 8, std::string(VALID_CHARS));
+  std::map<std::string, std::string> expected, watched;
+  for (size_t i = 0; i < N_WRITES; i++) {
+    std::string key = "hot:" + keys[i % N_WATCHED_KEYS];
+    std::string value = std::to_string(i);
+    ServerConn& conn = *conns[i % N_SERVERS_WATCH];
+    if (i % 7 == 3) {
+      ASSERT(conn.send_request(DeleteRequest{key}));
+      expected.erase(key);
+    } else if (i % 3 == 1) {
+      ASSERT(conn.send_request(AppendRequest{key, value}));
+      expected[key] += value;
+    } else {
+      ASSERT(conn.send_request(PutRequest{key, value, 0}));
+      expected[key] = value;
+    }
+    ASSERT(conn.recv_response());
+    // Unwatched, and not reported
+    ASSERT(conn.send_request(PutRequest{"cold:" + keys[0], value, 0}));
+    ASSERT(conn.recv_response());
+  }
+  while (true) {
+    std::optional<WatchResponse> changes = watcher->next(500ms);
+    ASSERT(changes);
+    if (changes->events.empty()) break;
+    ASSERT(!changes->lost);
+    for (auto&& event : changes->events) {
+      ASSERT(event.key.starts_with("hot:"));
+      replay(watched, event);
+    }
+  }
+  ASSERT(watched == expected);
+
+  // Open watches don't keep workers to themselves, so there can be more of
+  // them than workers, and other clients are still served. (Each connection
+  // above keeps a worker for as long as it's open, though.)
+  conns.clear();
+  std::vector<std::unique_ptr<Watcher>> more_watchers;
+  for (size_t i = 0; i < N_WORKERS_WATCH; i++) {
+    more_watchers.push_back(Watcher::open({addrs[0]}, "more:"));
+    ASSERT(more_watchers.back());
+  }
+  ASSERT(SimpleClient(addrs[0]).Put("more:key", "value"));
+  for (auto&& more_watcher : more_watchers) {
+    std::optional<WatchResponse> changes = more_watcher->next(500ms);
+    ASSERT(changes && changes->events.size() == 1);
+  }
+  more_watchers.clear();
+  for (auto&& addr : addrs) {
+    conns.push_back(connect_to_server(addr));
+    ASSERT(conns.back());
+  }
+
+  // A watcher that reads nothing never holds up writers: its changes pile up
+  // (merged, then dropped) until the server gives up on sending them
+  std::shared_ptr<ServerConn> stalled = connect_to_server(addrs[0]);
+  ASSERT(stalled);
+  ASSERT(stalled->send_request(WatchRequest{""}));
+  ASSERT(stalled->recv_response());
+  std::string value(1000, 'v');
+  auto unread_keys =
+      make_rand_strs(N_UNREAD_PUTS, 12, std::string(VALID_CHARS));
+  for (auto&& key : unread_keys) {
+    ASSERT(conns[0]->send_request(PutRequest{key, value, 0}));
+    std::optional<Response> res = conns[0]->recv_response();
+    ASSERT(res && std::holds_alternative<PutResponse>(*res));
+  }
+  stalled.reset();
+
+  watcher.reset();
+  conns.clear();
+  for (auto&& server : servers) server->stop();
+  cout_color(GREEN, "Test passed!");
+}
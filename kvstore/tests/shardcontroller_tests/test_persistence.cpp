@@ -0,0 +1,124 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "net/network_conn.hpp"
+#include "net/network_helpers.hpp"
+#include "shardcontroller/config_log.hpp"
+#include "shardcontroller/static_shardcontroller.hpp"
+#include "test_utils/test_utils.hpp"
+
+constexpr size_t N_CHANGES = 200;
+
+std::string make_temp_dir() {
+  char dir[] = "/tmp/shardcontroller_XXXXXX";
+  ASSERT(mkdtemp(dir));
+  return dir;
+}
+
+void test_log() {
+  std::string dir = make_temp_dir();
+  {
+    ConfigLog log(dir);
+    ASSERT(log.recover());
+    ASSERT(log.append(1, JoinRequest{"server1"}));
+    ASSERT(log.append(2, MoveRequest{"server1", {Shard{"A", "M"}}}));
+  }
+
+  // Everything appended comes back, in order
+  ShardControllerConfig config;
+  config.server_to_shards["server1"] = {Shard{"A", "M"}};
+  {
+    ConfigLog log(dir);
+    std::optional<ConfigLog::Recovered> recovered = log.recover();
+    ASSERT(recovered);
+    ASSERT_EQ(recovered->requests.size(), size_t(2));
+    ASSERT(std::holds_alternative<JoinRequest>(recovered->requests[0]));
+    auto& move_req = std::get<MoveRequest>(recovered->requests[1]);
+    ASSERT(move_req.shards == std::vector<Shard>{Shard({"A", "M"})});
+    ASSERT_EQ(recovered->versions[1], uint64_t(2));
+
+    // After a snapshot, only later changes are left to replay
+    ASSERT(log.snapshot(1, 2, config));
+    ASSERT(log.append(3, JoinRequest{"server2"}));
+  }
+
+  // A record torn by a crash is dropped, and the log carries on after it
+  int fd = open((dir + "/config.log").c_str(), O_WRONLY | O_APPEND);
+  ASSERT(fd >= 0);
+  ASSERT(write(fd, "\x20\x00\x00\x00garbage", 11) == 11);
+  close(fd);
+  {
+    ConfigLog log(dir);
+    std::optional<ConfigLog::Recovered> recovered = log.recover();
+    ASSERT(recovered);
+    ASSERT_EQ(recovered->epoch, uint64_t(1));
+    ASSERT_EQ(recovered->version, uint64_t(2));
+    ASSERT(recovered->config.server_to_shards == config.server_to_shards);
+    ASSERT_EQ(recovered->requests.size(), size_t(1));
+    ASSERT(log.append(4, LeaveRequest{"server2"}));
+  }
+  {
+    ConfigLog log(dir);
+    std::optional<ConfigLog::Recovered> recovered = log.recover();
+    ASSERT(recovered);
+    ASSERT_EQ(recovered->requests.size(), size_t(2));
+    ASSERT_EQ(recovered->versions.back(), uint64_t(4));
+  }
+}
+
+QueryResponse query(const std::string& addr) {
+  std::shared_ptr<ServerConn> conn = connect_to_server(addr);
+  ASSERT(conn);
+  ASSERT(conn->send_request(QueryRequest{}));
+  std::optional<Response> res = conn->recv_response();
+  ASSERT(res && std::holds_alternative<QueryResponse>(*res));
+  return std::get<QueryResponse>(*res);
+}
+
+void test_restart() {
+  std::string dir = make_temp_dir();
+  std::string addr = get_host_address("8080");
+  std::vector<std::string> servers = make_server_addresses(N_CHANGES / 2);
+  std::vector<Shard> shards = split_into(N_CHANGES / 2);
+
+  auto sm = std::make_shared<StaticShardController>(addr, dir);
+  ASSERT(sm->start() == 0);
+  std::shared_ptr<ServerConn> conn = connect_to_server(addr);
+  ASSERT(conn);
+  for (size_t i = 0; i < N_CHANGES / 2; i++) {
+    ASSERT(conn->send_request(JoinRequest{servers[i]}));
+    ASSERT(conn->recv_response());
+    ASSERT(conn->send_request(MoveRequest{servers[i], {shards[i]}}));
+    ASSERT(conn->recv_response());
+  }
+  QueryResponse before = query(addr);
+  ASSERT_EQ(before.version, uint64_t(N_CHANGES));
+  conn->shutdown();
+  sm->stop();
+
+  // The restarted controller has the same config, in a new epoch, and gets
+  // there quickly
+  sm = std::make_shared<StaticShardController>(addr, dir);
+  auto start = steady_clock::now();
+  ASSERT(sm->start() == 0);
+  auto restart_time = steady_clock::now() - start;
+  QueryResponse after = query(addr);
+  ASSERT_EQ(after.version, before.version);
+  ASSERT_EQ(after.epoch, before.epoch + 1);
+  ASSERT(after.config.server_to_shards == before.config.server_to_shards);
+  std::cout << "Restarted after " << N_CHANGES << " changes in "
+            << duration_cast<microseconds>(restart_time).count() << " us\n";
+  ASSERT(restart_time < 100ms);
+  sm->stop();
+}
+
+int main() {
+  test_log();
+  test_restart();
+
+  cout_color(GREEN, "Test passed!");
+  return 0;
+}
@@ -0,0 +1,240 @@
+#include <stdlib.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/shard.hpp"
+#include "net/network_conn.hpp"
+#include "shardcontroller/config_log.hpp"
+#include "shardcontroller/replicated_shardcontroller.hpp"
+#include "test_utils/test_utils.hpp"
+
+constexpr size_t N_NODES = 3;
+constexpr size_t N_SERVERS = 100;
+constexpr size_t N_CHUNKS = 10;
+// A new leader must take over within this long of the old one failing.
+constexpr milliseconds FAILOVER_BOUND = 2s;
+
+std::vector<std::string> nodes;
+std::string node_list;
+std::vector<std::string> state_dirs;
+std::vector<std::shared_ptr<ReplicatedShardController>> controllers;
+std::array<std::atomic<bool>, N_NODES> running;
+
+// Waits for one of the running nodes to become leader; returns its index.
+size_t wait_for_leader() {
+  auto deadline = steady_clock::now() + FAILOVER_BOUND;
+  while (steady_clock::now() < deadline) {
+    for (size_t i = 0; i < N_NODES; i++) {
+      if (running[i] && controllers[i]->is_leader()) return i;
+    }
+    std::this_thread::sleep_for(5ms);
+  }
+  ASSERT(false);
+  return 0;
+}
+
+// Makes a config change through whichever node is up, retrying until it's
+// acknowledged.
+void change(const Request& req) {
+  auto deadline = steady_clock::now() + 10s;
+  while (true) {
+    ASSERT(steady_clock::now() < deadline);
+    std::shared_ptr<ServerConn> conn = connect_to_server(node_list);
+    std::optional<Response> res;
+    if (conn && conn->send_request(req)) res = conn->recv_response();
+    if (res && !std::holds_alternative<ErrorResponse>(*res)) return;
+    std::this_thread::sleep_for(20ms);
+  }
+}
+
+QueryResponse query(const std::string& node) {
+  std::shared_ptr<ServerConn> conn = connect_to_server(node);
+  ASSERT(conn);
+  ASSERT(conn->send_request(QueryRequest{}));
+  std::optional<Response> res = conn->recv_response();
+  ASSERT(res && std::holds_alternative<QueryResponse>(*res));
+  return std::get<QueryResponse>(*res);
+}
+
+std::string make_temp_dir() {
+  char dir[] = "/tmp/shardcontroller_XXXXXX";
+  ASSERT(mkdtemp(dir));
+  return dir;
+}
+
+void start_node(size_t i) {
+  controllers[i] =
+      start_server<ReplicatedShardController, const std::string&,
+                   const std::vector<std::string>&, const std::string&>(
+          nodes[i], nodes, state_dirs[i]);
+  running[i] = true;
+}
+
+// Waits for the running nodes to agree, and returns their configs.
+std::vector<QueryResponse> wait_for_agreement() {
+  std::vector<QueryResponse> results;
+  auto deadline = steady_clock::now() + 1s;
+  while (true) {
+    results.clear();
+    for (size_t i = 0; i < N_NODES; i++) {
+      if (running[i]) results.push_back(query(nodes[i]));
+    }
+    bool agreed = true;
+    for (auto&& result : results) {
+      agreed = agreed && result.version == results[0].version &&
+               result.epoch == results[0].epoch;
+    }
+    if (agreed || steady_clock::now() >= deadline) break;
+    std::this_thread::sleep_for(ReplicatedShardController::HEARTBEAT_INTERVAL);
+  }
+  for (auto&& result : results) {
+    ASSERT_EQ(result.version, results[0].version);
+    ASSERT_EQ(result.epoch, results[0].epoch);
+    ASSERT(result.config.server_to_shards ==
+           results[0].config.server_to_shards);
+  }
+  return results;
+}
+
+int main() {
+  nodes = make_server_addresses(N_NODES, 8080);
+  controllers.resize(N_NODES);
+  for (size_t i = 0; i < N_NODES; i++) {
+    node_list += (node_list.empty() ? "" : ",") + nodes[i];
+    state_dirs.push_back(make_temp_dir());
+    start_node(i);
+  }
+  size_t leader = wait_for_leader();
+  uint64_t first_term = controllers[leader]->term();
+
+  std::vector<std::vector<std::string>> server_chunks =
+      make_server_chunks(N_SERVERS, N_CHUNKS);
+  std::atomic<size_t> n_changes{0};
+  execute_in_parallel(
+      [&](std::vector<std::string>&& chunk) {
+        for (std::string server : chunk) {
+          change(JoinRequest{server});
+          n_changes++;
+        }
+      },
+      server_chunks);
+
+  /* The same Move storm as test_concurrent_moves, through the replicated
+    controller: shard #i goes to the i-th server of each chunk, concurrently,
+    and then every shard goes to the first server. Part way through, the
+    leader is stopped; the moves must carry on once another takes over. */
+  std::vector<Shard> shards = split_into(N_SERVERS / N_CHUNKS);
+  milliseconds failover_time;
+  std::thread killer([&] {
+    while (n_changes < N_SERVERS + N_SERVERS / 4) {
+      std::this_thread::sleep_for(1ms);
+    }
+    controllers[leader]->stop();
+    running[leader] = false;
+    auto killed = steady_clock::now();
+    size_t new_leader = wait_for_leader();
+    failover_time = duration_cast<milliseconds>(steady_clock::now() - killed);
+    ASSERT(controllers[new_leader]->term() > first_term);
+  });
+
+  execute_in_parallel(
+      [&](std::vector<std::string>&& chunk) {
+        for (std::size_t i = 0; i < chunk.size(); i++) {
+          change(MoveRequest{chunk[i], {shards[i]}});
+          n_changes++;
+        }
+      },
+      server_chunks);
+  execute_in_parallel(
+      [&](Shard&& shard) {
+        change(MoveRequest{server_chunks[0][0], {shard}});
+        n_changes++;
+      },
+      shards);
+  killer.join();
+  cout_color(BLUE, "Failed over in ", failover_time.count(), " ms");
+  ASSERT(failover_time < FAILOVER_BOUND);
+
+  // The surviving nodes agree, and have every acknowledged change (a change
+  // whose reply was lost with the old leader may have been made twice)
+  std::vector<QueryResponse> results = wait_for_agreement();
+  ASSERT(results[0].version >= n_changes);
+
+  // The old leader had logged every change acknowledged before it stopped
+  {
+    RaftLog log(state_dirs[leader]);
+    std::optional<RaftLog::Recovered> recovered = log.recover();
+    ASSERT(recovered);
+    ASSERT(recovered->term >= first_term);
+    ASSERT(recovered->entries.size() >= N_SERVERS + N_SERVERS / 4);
+  }
+
+  /* Restart a follower: with the old leader back, stop one of the others
+    that isn't leading, make a change without it, and bring it back. It must
+    come back with its term, and catch up on the change. */
+  start_node(leader);
+  wait_for_agreement();
+  leader = wait_for_leader();
+  size_t follower = (leader + 1) % N_NODES;
+  uint64_t follower_term = controllers[follower]->term();
+  controllers[follower]->stop();
+  running[follower] = false;
+  change(LeaveRequest{server_chunks[0][0]});
+  start_node(follower);
+  ASSERT(controllers[follower]->term() >= follower_term);
+  results = wait_for_agreement();
+  ASSERT_EQ(results.size(), N_NODES);
+  ASSERT(results[0].version > n_changes);
+  ASSERT(!results[0].config.server_to_shards.contains(server_chunks[0][0]));
+
+  /* A candidate that can't win, since its log is empty, keeps asking for
+    votes in ever newer terms. That deposes each leader, but turning it down
+    mustn't put off the other nodes' elections, so they still elect new
+    ones. */
+  auto newest_term = [&] {
+    uint64_t term = 0;
+    for (auto&& controller : controllers) {
+      term = std::max(term, controller->term());
+    }
+    return term;
+  };
+  uint64_t stale_from = newest_term() + 1;
+  std::atomic<bool> campaigning = true;
+  std::thread stale_candidate([&] {
+    while (campaigning) {
+      RaftVoteRequest req{newest_term() + 1, "stale candidate", 0, 0};
+      for (auto&& node : nodes) {
+        std::shared_ptr<ServerConn> conn = connect_to_server(node);
+        ASSERT(conn && conn->send_request(req));
+        std::optional<Response> res = conn->recv_response();
+        ASSERT(res && std::holds_alternative<RaftVoteResponse>(*res));
+        ASSERT(!std::get<RaftVoteResponse>(*res).granted);
+      }
+      std::this_thread::sleep_for(
+          ReplicatedShardController::MIN_ELECTION_TIMEOUT / 3);
+    }
+  });
+  auto deadline = steady_clock::now() + FAILOVER_BOUND;
+  bool elected = false;
+  while (!elected && steady_clock::now() < deadline) {
+    for (auto&& controller : controllers) {
+      elected = elected ||
+                (controller->is_leader() && controller->term() > stale_from);
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+  campaigning = false;
+  stale_candidate.join();
+  ASSERT(elected);
+
+  for (size_t i = 0; i < N_NODES; i++) {
+    if (running[i]) controllers[i]->stop();
+  }
+  cout_color(GREEN, "Test passed!");
+  return 0;
+}
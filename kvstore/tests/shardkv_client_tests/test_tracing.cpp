@@ -0,0 +1,95 @@
+#include <fstream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "client/shardkv_client.hpp"
+#include "common/trace.hpp"
+#include "server/server.hpp"
+#include "test_utils/test_utils.hpp"
+
+static const std::string TRACE_FILE = "test-tracing-trace.json";
+
+std::string read_trace() {
+  ASSERT(Tracer::global().flush());
+  std::ifstream file(TRACE_FILE);
+  ASSERT(file);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+size_t count_spans(const std::string& trace, const std::string& name) {
+  std::string needle = "\"name\":\"" + name + "\"";
+  size_t count = 0;
+  for (size_t pos = trace.find(needle); pos != std::string::npos;
+       pos = trace.find(needle, pos + 1)) {
+    count++;
+  }
+  return count;
+}
+
+int main() {
+  // A trace context survives the trip through a message, compressed or not
+  for (size_t size : {size_t(10), WIRE_COMPRESSION_MIN * 4}) {
+    Message msg{};
+    ASSERT(serialize_request(PutRequest{"key", std::string(size, 'v'), 0},
+                             &msg));
+    compress_message(&msg);
+    msg.trace = TraceContext{12, 34};
+    attach_trace(&msg);
+    Message received{msg.type, msg.sz, 0, {}, msg.buf};
+    ASSERT(detach_trace(&received));
+    ASSERT_EQ(received.trace.trace_id, uint64_t(12));
+    ASSERT_EQ(received.trace.span_id, uint64_t(34));
+    ASSERT(decompress_message(&received));
+    std::optional<Request> req = deserialize_request(received);
+    ASSERT(req && std::get<PutRequest>(*req).value.size() == size);
+  }
+
+  std::string sm_addr = get_host_address("8080");
+  std::shared_ptr<Shardcontroller> sm = start_shardcontroller(sm_addr);
+  std::shared_ptr<ShardKvClient> client = make_shared<ShardKvClient>(sm_addr);
+  std::string server_addr = make_server_addresses(1)[0];
+  std::shared_ptr<KvServer> server =
+      start_server<KvServer, const std::string&, uint64_t>(server_addr,
+                                                           uint64_t(2));
+
+  // Every request is sampled, and traced through each stage, in one trace.
+  // ShardKvClient's routing is left to students, so its two halves (the
+  // Query, then the request to the server) are traced under a root of the
+  // test's own
+  Tracer::global().configure(1, TRACE_FILE);
+  {
+    Span root("request", Tracer::global().sample());
+    ASSERT(client->Query());
+    ASSERT(SimpleClient(server_addr).Put("key", "value"));
+  }
+  Tracer::global().configure(0, TRACE_FILE);
+  std::string trace = read_trace();
+  for (auto&& name : {"request", "Query", "shardcontroller",
+                      "SimpleClient::Put", "connect", "accept", "queue wait",
+                      "process_request", "send"}) {
+    ASSERT_EQ(count_spans(trace, name), size_t(1));
+  }
+  std::regex trace_id_re("\"trace_id\":\"([0-9a-f]{16})\"");
+  std::set<std::string> trace_ids;
+  for (auto it = std::sregex_iterator(trace.begin(), trace.end(), trace_id_re);
+       it != std::sregex_iterator(); it++) {
+    trace_ids.insert((*it)[1]);
+  }
+  ASSERT_EQ(trace_ids.size(), size_t(1));
+
+  // With sampling off, nothing more is recorded
+  for (size_t i = 0; i < 10; i++) {
+    ASSERT(client->Query());
+    ASSERT(SimpleClient(server_addr).Put("key", "value"));
+  }
+  ASSERT_EQ(read_trace(), trace);
+
+  client.reset();
+  server->stop();
+  sm->stop();
+  cout_color(GREEN, "Test passed!");
+}